@@ -682,6 +682,7 @@ init_post (GOptionContext * context, GOptionGroup * group, gpointer data,
 
   _priv_gst_mini_object_initialize ();
   _priv_gst_quarks_initialize ();
+  _priv_gst_magazine_initialize ();
   _priv_gst_allocator_initialize ();
   _priv_gst_memory_initialize ();
   _priv_gst_format_initialize ();
@@ -840,6 +841,7 @@ init_post (GOptionContext * context, GOptionGroup * group, gpointer data,
   _priv_gst_plugin_feature_rank_initialize ();
 
 #ifndef GST_DISABLE_GST_DEBUG
+  _priv_gst_tracer_record_initialize ();
   _priv_gst_tracing_init ();
 #endif
 
@@ -1156,11 +1158,13 @@ gst_deinit (void)
    * gst_caps_to_string() to display leaked caps. */
 #ifndef GST_DISABLE_GST_DEBUG
   _priv_gst_tracing_deinit ();
+  _priv_gst_tracer_record_cleanup ();
 #endif
 
   _priv_gst_caps_features_cleanup ();
   _priv_gst_caps_cleanup ();
   _priv_gst_meta_cleanup ();
+  _priv_gst_magazine_cleanup ();
 
   g_type_class_unref (g_type_class_peek (gst_object_get_type ()));
   g_type_class_unref (g_type_class_peek (gst_pad_get_type ()));
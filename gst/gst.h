@@ -33,6 +33,7 @@
 
 #include <gst/gstatomicqueue.h>
 #include <gst/gstbin.h>
+#include <gst/gstboundedqueue.h>
 #include <gst/gstbuffer.h>
 #include <gst/gstbufferlist.h>
 #include <gst/gstbufferpool.h>
@@ -116,9 +116,14 @@ G_GNUC_INTERNAL  gboolean _priv_plugin_deps_env_vars_changed (GstPlugin * plugin
 
 G_GNUC_INTERNAL  gboolean _priv_plugin_deps_files_changed (GstPlugin * plugin);
 
+/* per-thread cached slices for buffers and small memory blocks */
+G_GNUC_INTERNAL  gpointer _priv_gst_magazine_alloc (gsize size);
+G_GNUC_INTERNAL  void     _priv_gst_magazine_free  (gsize size, gpointer mem);
+
 /* init functions called from gst_init(). */
 G_GNUC_INTERNAL  void  _priv_gst_quarks_initialize (void);
 G_GNUC_INTERNAL  void  _priv_gst_mini_object_initialize (void);
+G_GNUC_INTERNAL  void  _priv_gst_magazine_initialize (void);
 G_GNUC_INTERNAL  void  _priv_gst_memory_initialize (void);
 G_GNUC_INTERNAL  void  _priv_gst_allocator_initialize (void);
 G_GNUC_INTERNAL  void  _priv_gst_buffer_initialize (void);
@@ -140,6 +145,12 @@ G_GNUC_INTERNAL  void  _priv_gst_context_initialize (void);
 G_GNUC_INTERNAL  void  _priv_gst_toc_initialize (void);
 G_GNUC_INTERNAL  void  _priv_gst_date_time_initialize (void);
 G_GNUC_INTERNAL  void  _priv_gst_plugin_feature_rank_initialize (void);
+#ifndef GST_DISABLE_GST_DEBUG
+G_GNUC_INTERNAL  void  _priv_gst_tracer_record_initialize (void);
+#endif
+
+/* registers the "HugePageMemory" allocator when supported */
+G_GNUC_INTERNAL  void  _priv_gst_huge_page_allocator_initialize (GstAllocator * sysmem);
 
 /* cleanup functions called from gst_deinit(). */
 G_GNUC_INTERNAL  void  _priv_gst_allocator_cleanup (void);
@@ -147,6 +158,10 @@ G_GNUC_INTERNAL  void  _priv_gst_caps_features_cleanup (void);
 G_GNUC_INTERNAL  void  _priv_gst_caps_cleanup (void);
 G_GNUC_INTERNAL  void  _priv_gst_debug_cleanup (void);
 G_GNUC_INTERNAL  void  _priv_gst_meta_cleanup (void);
+G_GNUC_INTERNAL  void  _priv_gst_magazine_cleanup (void);
+#ifndef GST_DISABLE_GST_DEBUG
+G_GNUC_INTERNAL  void  _priv_gst_tracer_record_cleanup (void);
+#endif
 
 /* called from gst_task_cleanup_all(). */
 G_GNUC_INTERNAL  void  _priv_gst_element_cleanup (void);
@@ -410,7 +410,7 @@ _sysmem_new (GstMemoryFlags flags,
 
   slice_size = sizeof (GstMemorySystem);
 
-  mem = g_slice_alloc (slice_size);
+  mem = _priv_gst_magazine_alloc (slice_size);
   _sysmem_init (mem, flags, parent, slice_size,
       data, maxsize, align, offset, size, user_data, notify);
 
@@ -433,7 +433,7 @@ _sysmem_new_block (GstMemoryFlags flags,
   /* alloc header and data in one block */
   slice_size = sizeof (GstMemorySystem) + maxsize;
 
-  mem = g_slice_alloc (slice_size);
+  mem = _priv_gst_magazine_alloc (slice_size);
   if (mem == NULL)
     return NULL;
 
@@ -552,7 +552,7 @@ default_free (GstAllocator * allocator, GstMemory * mem)
   memset (mem, 0xff, sizeof (GstMemorySystem));
 #endif
 
-  g_slice_free1 (slice_size, mem);
+  _priv_gst_magazine_free (slice_size, mem);
 }
 
 static void
@@ -620,6 +620,23 @@ _priv_gst_allocator_initialize (void)
       gst_object_ref (_sysmem_allocator));
 
   _default_allocator = gst_object_ref (_sysmem_allocator);
+
+  _priv_gst_huge_page_allocator_initialize (_sysmem_allocator);
+
+  {
+    const gchar *name = g_getenv ("GST_DEFAULT_ALLOCATOR");
+
+    if (name && *name) {
+      GstAllocator *allocator = gst_allocator_find (name);
+
+      if (allocator) {
+        GST_CAT_INFO (GST_CAT_MEMORY, "using %s as default allocator", name);
+        gst_allocator_set_default (allocator);
+      } else {
+        GST_CAT_WARNING (GST_CAT_MEMORY, "unknown allocator %s", name);
+      }
+    }
+  }
 }
 
 void
@@ -149,6 +149,10 @@ GST_DEBUG_CATEGORY_STATIC (bin_debug);
  * a toplevel bin */
 #define BIN_IS_TOPLEVEL(bin) ((GST_OBJECT_PARENT (bin) == NULL) || bin->priv->asynchandling)
 
+/* max_threads of the state pool, -1 is unlimited */
+#define STATE_POOL_MAX_THREADS(bin) ((bin)->priv->state_change_threads ? \
+    (gint) MIN ((bin)->priv->state_change_threads, G_MAXINT) : -1)
+
 struct _GstBinPrivate
 {
   gboolean asynchandling;
@@ -161,6 +165,11 @@ struct _GstBinPrivate
 
   guint32 structure_cookie;
 
+  /* topological order of the children computed by the last complete sort,
+   * valid as long as sorted_cookie is the structure_cookie */
+  GArray *sorted;
+  guint32 sorted_cookie;
+
 #if 0
   /* cached index */
   GstIndex *index;
@@ -172,6 +181,14 @@ struct _GstBinPrivate
   gboolean posted_eos;
   gboolean posted_playing;
   GstElementFlags suppressed_flags;
+
+  /* change the state of independent children concurrently */
+  gboolean parallel_state_change;
+  guint state_change_threads;
+  GThreadPool *state_pool;
+  GMutex state_lock;
+  GCond state_cond;
+  guint state_pending;          /* protected by state_lock */
 };
 
 typedef struct
@@ -181,6 +198,7 @@ typedef struct
 } BinContinueData;
 
 static void gst_bin_dispose (GObject * object);
+static void gst_bin_finalize (GObject * object);
 
 static void gst_bin_set_property (GObject * object, guint prop_id,
     const GValue * value, GParamSpec * pspec);
@@ -246,12 +264,16 @@ enum
 
 #define DEFAULT_ASYNC_HANDLING	FALSE
 #define DEFAULT_MESSAGE_FORWARD	FALSE
+#define DEFAULT_PARALLEL_STATE_CHANGE	FALSE
+#define DEFAULT_STATE_CHANGE_THREADS	0
 
 enum
 {
   PROP_0,
   PROP_ASYNC_HANDLING,
   PROP_MESSAGE_FORWARD,
+  PROP_PARALLEL_STATE_CHANGE,
+  PROP_STATE_CHANGE_THREADS,
   PROP_LAST
 };
 
@@ -446,7 +468,46 @@ gst_bin_class_init (GstBinClass * klass)
           "Forwards all children messages",
           DEFAULT_MESSAGE_FORWARD, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
+  /**
+   * GstBin:parallel-state-change:
+   *
+   * Change the state of children that don't depend on each other at the same
+   * time from a pool of worker threads instead of one after the other. This
+   * speeds up state changes of bins with many independent branches, like
+   * sources that need to open a file or a device when going to PAUSED.
+   *
+   * Children are still changed in topological order: an element only changes
+   * its state after all the elements it is linked to downstream are done. The
+   * return value of the bin is the same as without this property, a child
+   * that returns %GST_STATE_CHANGE_ASYNC or %GST_STATE_CHANGE_NO_PREROLL
+   * makes the bin return that too and a failing child reverts the state of
+   * all children.
+   *
+   * Since: 1.20
+   */
+  g_object_class_install_property (gobject_class, PROP_PARALLEL_STATE_CHANGE,
+      g_param_spec_boolean ("parallel-state-change", "Parallel State Change",
+          "Change the state of independent children concurrently",
+          DEFAULT_PARALLEL_STATE_CHANGE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstBin:state-change-threads:
+   *
+   * The maximum number of threads used to change the state of the children
+   * when #GstBin:parallel-state-change is enabled, 0 for as many as there
+   * are children that can change their state at the same time.
+   *
+   * Since: 1.20
+   */
+  g_object_class_install_property (gobject_class, PROP_STATE_CHANGE_THREADS,
+      g_param_spec_uint ("state-change-threads", "State Change Threads",
+          "Maximum number of threads for parallel state changes (0 = unlimited)",
+          0, G_MAXUINT, DEFAULT_STATE_CHANGE_THREADS,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
   gobject_class->dispose = gst_bin_dispose;
+  gobject_class->finalize = gst_bin_finalize;
 
   gst_element_class_set_static_metadata (gstelement_class, "Generic bin",
       "Generic/Bin",
@@ -505,6 +566,10 @@ gst_bin_init (GstBin * bin)
   bin->priv->asynchandling = DEFAULT_ASYNC_HANDLING;
   bin->priv->structure_cookie = 0;
   bin->priv->message_forward = DEFAULT_MESSAGE_FORWARD;
+  bin->priv->parallel_state_change = DEFAULT_PARALLEL_STATE_CHANGE;
+  bin->priv->state_change_threads = DEFAULT_STATE_CHANGE_THREADS;
+  g_mutex_init (&bin->priv->state_lock);
+  g_cond_init (&bin->priv->state_cond);
 }
 
 static void
@@ -535,6 +600,22 @@ gst_bin_dispose (GObject * object)
   G_OBJECT_CLASS (parent_class)->dispose (object);
 }
 
+static void
+gst_bin_finalize (GObject * object)
+{
+  GstBin *bin = GST_BIN_CAST (object);
+
+  if (bin->priv->sorted)
+    g_array_unref (bin->priv->sorted);
+
+  if (bin->priv->state_pool)
+    g_thread_pool_free (bin->priv->state_pool, FALSE, TRUE);
+  g_mutex_clear (&bin->priv->state_lock);
+  g_cond_clear (&bin->priv->state_cond);
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
 /**
  * gst_bin_new:
  * @name: (allow-none): the name of the new bin
@@ -568,6 +649,19 @@ gst_bin_set_property (GObject * object, guint prop_id,
       gstbin->priv->message_forward = g_value_get_boolean (value);
       GST_OBJECT_UNLOCK (gstbin);
       break;
+    case PROP_PARALLEL_STATE_CHANGE:
+      GST_OBJECT_LOCK (gstbin);
+      gstbin->priv->parallel_state_change = g_value_get_boolean (value);
+      GST_OBJECT_UNLOCK (gstbin);
+      break;
+    case PROP_STATE_CHANGE_THREADS:
+      GST_OBJECT_LOCK (gstbin);
+      gstbin->priv->state_change_threads = g_value_get_uint (value);
+      if (gstbin->priv->state_pool)
+        g_thread_pool_set_max_threads (gstbin->priv->state_pool,
+            STATE_POOL_MAX_THREADS (gstbin), NULL);
+      GST_OBJECT_UNLOCK (gstbin);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -593,6 +687,16 @@ gst_bin_get_property (GObject * object, guint prop_id,
       g_value_set_boolean (value, gstbin->priv->message_forward);
       GST_OBJECT_UNLOCK (gstbin);
       break;
+    case PROP_PARALLEL_STATE_CHANGE:
+      GST_OBJECT_LOCK (gstbin);
+      g_value_set_boolean (value, gstbin->priv->parallel_state_change);
+      GST_OBJECT_UNLOCK (gstbin);
+      break;
+    case PROP_STATE_CHANGE_THREADS:
+      GST_OBJECT_LOCK (gstbin);
+      g_value_set_uint (value, gstbin->priv->state_change_threads);
+      GST_OBJECT_UNLOCK (gstbin);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -2114,6 +2218,12 @@ gst_bin_get_state_func (GstElement * element, GstState * state,
  * on the sinkpads. When an element reaches degree 0, its state is
  * changed next.
  * When all elements are handled the algorithm stops.
+ *
+ * The order of a complete run is kept in the bin and replayed by the
+ * following iterators until the structure_cookie changes, which happens when
+ * children are added, removed, linked or unlinked. The order also depends on
+ * the SINK and SOURCE flags of the children, so those are kept with it and
+ * checked before replaying.
  */
 typedef struct _GstBinSortIterator
 {
@@ -2125,8 +2235,20 @@ typedef struct _GstBinSortIterator
   gint best_deg;                /* best degree */
   GHashTable *hash;             /* hashtable with element dependencies */
   gboolean dirty;               /* we detected structure change */
+  GArray *sorted;               /* cached order we replay */
+  guint pos;                    /* position in sorted */
+  GArray *order;                /* order we computed so far */
 } GstBinSortIterator;
 
+/* an element in the cached order with the flags that decided its position */
+typedef struct
+{
+  GstElement *element;
+  GstElementFlags flags;
+} GstBinSortEntry;
+
+#define SORT_FLAGS (GST_ELEMENT_FLAG_SINK | GST_ELEMENT_FLAG_SOURCE)
+
 static void
 copy_to_queue (gpointer data, gpointer user_data)
 {
@@ -2155,6 +2277,11 @@ gst_bin_sort_iterator_copy (const GstBinSortIterator * it,
   g_hash_table_iter_init (&iter, it->hash);
   while (g_hash_table_iter_next (&iter, &key, &value))
     g_hash_table_insert (copy->hash, key, value);
+
+  if (it->sorted)
+    copy->sorted = g_array_ref (it->sorted);
+  /* only the original stores its order in the bin */
+  copy->order = NULL;
 }
 
 /* we add and subtract 1 to make sure we don't confuse NULL and 0 */
@@ -2339,6 +2466,25 @@ find_element (GstElement * element, GstBinSortIterator * bit)
   }
 }
 
+/* remember the order we computed in the bin when we got to the end without
+ * detecting structure changes */
+static void
+gst_bin_sort_iterator_store (GstBinSortIterator * bit)
+{
+  GstBinPrivate *priv = bit->bin->priv;
+
+  if (bit->order == NULL || bit->dirty)
+    return;
+
+  GST_DEBUG_OBJECT (bit->bin, "caching order of %u elements", bit->order->len);
+
+  if (priv->sorted)
+    g_array_unref (priv->sorted);
+  priv->sorted = bit->order;
+  priv->sorted_cookie = priv->structure_cookie;
+  bit->order = NULL;
+}
+
 /* get next element in iterator. */
 static GstIteratorResult
 gst_bin_sort_iterator_next (GstBinSortIterator * bit, GValue * result)
@@ -2346,6 +2492,19 @@ gst_bin_sort_iterator_next (GstBinSortIterator * bit, GValue * result)
   GstElement *best;
   GstBin *bin = bit->bin;
 
+  if (bit->sorted) {
+    GstBinSortEntry *entry;
+
+    /* the cookie did not change, all elements are still in the bin */
+    if (bit->pos == bit->sorted->len)
+      return GST_ITERATOR_DONE;
+
+    entry = &g_array_index (bit->sorted, GstBinSortEntry, bit->pos++);
+    g_value_set_object (result, entry->element);
+
+    return GST_ITERATOR_OK;
+  }
+
   /* empty queue, we have to find a next best element */
   if (g_queue_is_empty (&bit->queue)) {
     bit->best = NULL;
@@ -2367,6 +2526,7 @@ gst_bin_sort_iterator_next (GstBinSortIterator * bit, GValue * result)
       g_value_set_object (result, best);
     } else {
       GST_DEBUG_OBJECT (bin, "queue empty, elements exhausted");
+      gst_bin_sort_iterator_store (bit);
       /* no more unhandled elements, we are done */
       return GST_ITERATOR_DONE;
     }
@@ -2381,9 +2541,49 @@ gst_bin_sort_iterator_next (GstBinSortIterator * bit, GValue * result)
   /* update degrees of linked elements */
   update_degree (best, bit);
 
+  if (bit->order) {
+    GstBinSortEntry entry;
+
+    entry.element = best;
+    entry.flags = GST_OBJECT_FLAGS (best) & SORT_FLAGS;
+    g_array_append_val (bit->order, entry);
+  }
+
   return GST_ITERATOR_OK;
 }
 
+/* check if the cached order of the bin can be replayed */
+static gboolean
+gst_bin_sort_iterator_is_cached (GstBinSortIterator * bit)
+{
+  GstBinPrivate *priv = bit->bin->priv;
+  guint i;
+
+  if (priv->sorted == NULL || priv->sorted_cookie != priv->structure_cookie)
+    return FALSE;
+
+  /* NO_RESYNC bins don't update the cookie for structure changes */
+  if (GST_BIN_IS_NO_RESYNC (bit->bin))
+    return FALSE;
+
+  /* pads that are being linked or unlinked are skipped when sorting */
+  if (find_message (bit->bin, NULL, GST_MESSAGE_STRUCTURE_CHANGE))
+    return FALSE;
+
+  for (i = 0; i < priv->sorted->len; i++) {
+    GstBinSortEntry *entry = &g_array_index (priv->sorted, GstBinSortEntry, i);
+    GstElementFlags flags;
+
+    GST_OBJECT_LOCK (entry->element);
+    flags = GST_OBJECT_FLAGS (entry->element) & SORT_FLAGS;
+    GST_OBJECT_UNLOCK (entry->element);
+
+    if (flags != entry->flags)
+      return FALSE;
+  }
+  return TRUE;
+}
+
 /* clear queues, recalculate the degrees and restart. */
 static void
 gst_bin_sort_iterator_resync (GstBinSortIterator * bit)
@@ -2393,6 +2593,19 @@ gst_bin_sort_iterator_resync (GstBinSortIterator * bit)
   GST_DEBUG_OBJECT (bin, "resync");
   bit->dirty = FALSE;
   clear_queue (&bit->queue);
+  g_clear_pointer (&bit->sorted, g_array_unref);
+  g_clear_pointer (&bit->order, g_array_unref);
+
+  if (gst_bin_sort_iterator_is_cached (bit)) {
+    GST_DEBUG_OBJECT (bin, "replaying cached order");
+    bit->sorted = g_array_ref (bin->priv->sorted);
+    bit->pos = 0;
+    return;
+  }
+
+  bit->order = g_array_sized_new (FALSE, FALSE, sizeof (GstBinSortEntry),
+      bin->numchildren);
+  g_hash_table_remove_all (bit->hash);
   /* reset degrees */
   g_list_foreach (bin->children, (GFunc) reset_degree, bit);
   /* calc degrees, incrementing */
@@ -2411,6 +2624,10 @@ gst_bin_sort_iterator_free (GstBinSortIterator * bit)
   GST_DEBUG_OBJECT (bin, "free");
   clear_queue (&bit->queue);
   g_hash_table_destroy (bit->hash);
+  if (bit->sorted)
+    g_array_unref (bit->sorted);
+  if (bit->order)
+    g_array_unref (bit->order);
   gst_object_unref (bin);
 }
 
@@ -2434,6 +2651,8 @@ gst_bin_sort_iterator_new (GstBin * bin)
       (GstIteratorFreeFunction) gst_bin_sort_iterator_free);
   g_queue_init (&result->queue);
   result->hash = g_hash_table_new (NULL, NULL);
+  result->sorted = NULL;
+  result->order = NULL;
   gst_object_ref (bin);
   result->bin = bin;
   gst_bin_sort_iterator_resync (result);
@@ -2837,6 +3056,191 @@ reset_state (const GValue * data, gpointer user_data)
         gst_element_state_get_name (state));
 }
 
+/* handle the return value of the state change of @child. Returns %FALSE when
+ * the child failed and the state change of the bin has to be undone. */
+static gboolean
+gst_bin_child_state_return (GstBin * bin, GstElement * child, GstState next,
+    GstStateChangeReturn ret, gboolean * have_async,
+    gboolean * have_no_preroll)
+{
+  GstElement *element = GST_ELEMENT_CAST (bin);
+
+  switch (ret) {
+    case GST_STATE_CHANGE_SUCCESS:
+      GST_CAT_INFO_OBJECT (GST_CAT_STATES, element,
+          "child '%s' changed state to %d(%s) successfully",
+          GST_ELEMENT_NAME (child), next, gst_element_state_get_name (next));
+      break;
+    case GST_STATE_CHANGE_ASYNC:
+    {
+      GST_CAT_INFO_OBJECT (GST_CAT_STATES, element,
+          "child '%s' is changing state asynchronously to %s",
+          GST_ELEMENT_NAME (child), gst_element_state_get_name (next));
+      *have_async = TRUE;
+      break;
+    }
+    case GST_STATE_CHANGE_FAILURE:{
+      GstObject *parent;
+
+      GST_CAT_INFO_OBJECT (GST_CAT_STATES, element,
+          "child '%s' failed to go to state %d(%s)",
+          GST_ELEMENT_NAME (child), next, gst_element_state_get_name (next));
+
+      /* Only fail if the child is still inside
+       * this bin. It might've been removed already
+       * because of the error by the bin subclass
+       * to ignore the error.  */
+      parent = gst_object_get_parent (GST_OBJECT_CAST (child));
+      if (parent == GST_OBJECT_CAST (element)) {
+        /* element is still in bin, really error now */
+        gst_object_unref (parent);
+        return FALSE;
+      }
+      /* child removed from bin, let the resync code redo the state
+       * change */
+      GST_CAT_INFO_OBJECT (GST_CAT_STATES, element,
+          "child '%s' was removed from the bin", GST_ELEMENT_NAME (child));
+
+      if (parent)
+        gst_object_unref (parent);
+
+      break;
+    }
+    case GST_STATE_CHANGE_NO_PREROLL:
+      GST_CAT_INFO_OBJECT (GST_CAT_STATES, element,
+          "child '%s' changed state to %d(%s) successfully without preroll",
+          GST_ELEMENT_NAME (child), next, gst_element_state_get_name (next));
+      *have_no_preroll = TRUE;
+      break;
+    default:
+      g_assert_not_reached ();
+      break;
+  }
+  return TRUE;
+}
+
+/* A child whose state is changed from the state pool when
+ * #GstBin:parallel-state-change is enabled. The children of one batch are not
+ * linked to each other and change their state at the same time. Since the
+ * sorted iterator returns a child only after the children downstream of it,
+ * a child can join the current batch unless it is linked to a child in the
+ * batch, in which case we wait for the batch to finish first. */
+typedef struct
+{
+  GstElement *child;
+  GstClockTime base_time;
+  GstClockTime start_time;
+  GstState current;
+  GstState next;
+  GstStateChangeReturn ret;
+} BinStateTask;
+
+static void
+bin_state_task_free (BinStateTask * task)
+{
+  gst_object_unref (task->child);
+  g_slice_free (BinStateTask, task);
+}
+
+/* called from the state pool */
+static void
+gst_bin_state_task_func (BinStateTask * task, GstBin * bin)
+{
+  task->ret = gst_bin_element_set_state (bin, task->child, task->base_time,
+      task->start_time, task->current, task->next);
+
+  g_mutex_lock (&bin->priv->state_lock);
+  if (--bin->priv->state_pending == 0)
+    g_cond_signal (&bin->priv->state_cond);
+  g_mutex_unlock (&bin->priv->state_lock);
+}
+
+static void
+gst_bin_state_tasks_push (GstBin * bin, GPtrArray * tasks, GstElement * child,
+    GstClockTime base_time, GstClockTime start_time, GstState current,
+    GstState next)
+{
+  BinStateTask *task;
+
+  task = g_slice_new (BinStateTask);
+  task->child = gst_object_ref (child);
+  task->base_time = base_time;
+  task->start_time = start_time;
+  task->current = current;
+  task->next = next;
+  task->ret = GST_STATE_CHANGE_FAILURE;
+  g_ptr_array_add (tasks, task);
+
+  g_mutex_lock (&bin->priv->state_lock);
+  bin->priv->state_pending++;
+  g_mutex_unlock (&bin->priv->state_lock);
+
+  g_thread_pool_push (bin->priv->state_pool, task, NULL);
+}
+
+/* check if @child is linked to one of the children in @tasks */
+static gboolean
+gst_bin_state_tasks_have_peer (GPtrArray * tasks, GstElement * child)
+{
+  gboolean found = FALSE;
+  GList *pads;
+  guint i;
+
+  GST_OBJECT_LOCK (child);
+  for (pads = child->pads; pads && !found; pads = g_list_next (pads)) {
+    GstPad *peer;
+    GstElement *peer_element;
+
+    if (!(peer = gst_pad_get_peer (GST_PAD_CAST (pads->data))))
+      continue;
+
+    if ((peer_element = gst_pad_get_parent_element (peer))) {
+      for (i = 0; i < tasks->len && !found; i++) {
+        BinStateTask *task = g_ptr_array_index (tasks, i);
+
+        found = (task->child == peer_element);
+      }
+      gst_object_unref (peer_element);
+    }
+    gst_object_unref (peer);
+  }
+  GST_OBJECT_UNLOCK (child);
+
+  return found;
+}
+
+/* wait for all children in @tasks to finish their state change and handle
+ * the return values. Returns %FALSE when one of them failed. */
+static gboolean
+gst_bin_state_tasks_finish (GstBin * bin, GPtrArray * tasks, GstState next,
+    gboolean * have_async, gboolean * have_no_preroll)
+{
+  gboolean res = TRUE;
+  guint i;
+
+  if (tasks->len == 0)
+    return TRUE;
+
+  GST_CAT_DEBUG_OBJECT (GST_CAT_STATES, bin,
+      "waiting for %u children to change state", tasks->len);
+
+  g_mutex_lock (&bin->priv->state_lock);
+  while (bin->priv->state_pending > 0)
+    g_cond_wait (&bin->priv->state_cond, &bin->priv->state_lock);
+  g_mutex_unlock (&bin->priv->state_lock);
+
+  for (i = 0; i < tasks->len; i++) {
+    BinStateTask *task = g_ptr_array_index (tasks, i);
+
+    if (!gst_bin_child_state_return (bin, task->child, next, task->ret,
+            have_async, have_no_preroll))
+      res = FALSE;
+  }
+  g_ptr_array_set_size (tasks, 0);
+
+  return res;
+}
+
 static GstStateChangeReturn
 gst_bin_change_state_func (GstElement * element, GstStateChange transition)
 {
@@ -2849,6 +3253,7 @@ gst_bin_change_state_func (GstElement * element, GstStateChange transition)
   GstIterator *it;
   gboolean done;
   GValue data = { 0, };
+  GPtrArray *tasks = NULL;
 
   /* we don't need to take the STATE_LOCK, it is already taken */
   current = (GstState) GST_STATE_TRANSITION_CURRENT (transition);
@@ -2920,6 +3325,14 @@ gst_bin_change_state_func (GstElement * element, GstStateChange transition)
    * don't want them to interfere with this state change */
   GST_OBJECT_LOCK (bin);
   bin->polling = TRUE;
+  if (bin->priv->parallel_state_change) {
+    if (!bin->priv->state_pool)
+      bin->priv->state_pool =
+          g_thread_pool_new ((GFunc) gst_bin_state_task_func, bin,
+          STATE_POOL_MAX_THREADS (bin), FALSE, NULL);
+    tasks =
+        g_ptr_array_new_with_free_func ((GDestroyNotify) bin_state_task_free);
+  }
   GST_OBJECT_UNLOCK (bin);
 
   /* iterate in state change order */
@@ -2947,75 +3360,43 @@ restart:
 
         child = g_value_get_object (&data);
 
+        if (tasks) {
+          /* a child linked to one in the current batch has to wait for it */
+          if (gst_bin_state_tasks_have_peer (tasks, child) &&
+              !gst_bin_state_tasks_finish (bin, tasks, next, &have_async,
+                  &have_no_preroll))
+            goto undo;
+
+          gst_bin_state_tasks_push (bin, tasks, child, base_time, start_time,
+              current, next);
+          g_value_reset (&data);
+          break;
+        }
+
         /* set state and base_time now */
         ret = gst_bin_element_set_state (bin, child, base_time, start_time,
             current, next);
 
-        switch (ret) {
-          case GST_STATE_CHANGE_SUCCESS:
-            GST_CAT_INFO_OBJECT (GST_CAT_STATES, element,
-                "child '%s' changed state to %d(%s) successfully",
-                GST_ELEMENT_NAME (child), next,
-                gst_element_state_get_name (next));
-            break;
-          case GST_STATE_CHANGE_ASYNC:
-          {
-            GST_CAT_INFO_OBJECT (GST_CAT_STATES, element,
-                "child '%s' is changing state asynchronously to %s",
-                GST_ELEMENT_NAME (child), gst_element_state_get_name (next));
-            have_async = TRUE;
-            break;
-          }
-          case GST_STATE_CHANGE_FAILURE:{
-            GstObject *parent;
-
-            GST_CAT_INFO_OBJECT (GST_CAT_STATES, element,
-                "child '%s' failed to go to state %d(%s)",
-                GST_ELEMENT_NAME (child),
-                next, gst_element_state_get_name (next));
-
-            /* Only fail if the child is still inside
-             * this bin. It might've been removed already
-             * because of the error by the bin subclass
-             * to ignore the error.  */
-            parent = gst_object_get_parent (GST_OBJECT_CAST (child));
-            if (parent == GST_OBJECT_CAST (element)) {
-              /* element is still in bin, really error now */
-              gst_object_unref (parent);
-              goto undo;
-            }
-            /* child removed from bin, let the resync code redo the state
-             * change */
-            GST_CAT_INFO_OBJECT (GST_CAT_STATES, element,
-                "child '%s' was removed from the bin",
-                GST_ELEMENT_NAME (child));
-
-            if (parent)
-              gst_object_unref (parent);
+        if (!gst_bin_child_state_return (bin, child, next, ret, &have_async,
+                &have_no_preroll))
+          goto undo;
 
-            break;
-          }
-          case GST_STATE_CHANGE_NO_PREROLL:
-            GST_CAT_INFO_OBJECT (GST_CAT_STATES, element,
-                "child '%s' changed state to %d(%s) successfully without preroll",
-                GST_ELEMENT_NAME (child), next,
-                gst_element_state_get_name (next));
-            have_no_preroll = TRUE;
-            break;
-          default:
-            g_assert_not_reached ();
-            break;
-        }
         g_value_reset (&data);
         break;
       }
       case GST_ITERATOR_RESYNC:
         GST_CAT_DEBUG_OBJECT (GST_CAT_STATES, element, "iterator doing resync");
+        if (tasks && !gst_bin_state_tasks_finish (bin, tasks, next,
+                &have_async, &have_no_preroll))
+          goto undo;
         gst_iterator_resync (it);
         goto restart;
       default:
       case GST_ITERATOR_DONE:
         GST_CAT_DEBUG_OBJECT (GST_CAT_STATES, element, "iterator done");
+        if (tasks && !gst_bin_state_tasks_finish (bin, tasks, next,
+                &have_async, &have_no_preroll))
+          goto undo;
         done = TRUE;
         break;
     }
@@ -3040,6 +3421,8 @@ restart:
 done:
   g_value_unset (&data);
   gst_iterator_free (it);
+  if (tasks)
+    g_ptr_array_unref (tasks);
 
   GST_OBJECT_LOCK (bin);
   bin->polling = FALSE;
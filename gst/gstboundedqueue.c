@@ -0,0 +1,367 @@
+/* GStreamer
+ *
+ * gstboundedqueue.c: bounded multi-producer single-consumer queue
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "gst_private.h"
+
+#include <gst/gst.h>
+#include "gstboundedqueue.h"
+
+/**
+ * SECTION:gstboundedqueue
+ * @title: GstBoundedQueue
+ * @short_description: A bounded queue with a single consumer
+ *
+ * The #GstBoundedQueue object implements a fixed size queue that can be
+ * pushed into from multiple threads and popped from by one thread at a time
+ * without performing any blocking operations.
+ *
+ * Compared to #GstAtomicQueue it never allocates after creation and does not
+ * need to coordinate between readers, which makes push and pop a lot cheaper.
+ * In exchange gst_bounded_queue_push() fails when the queue is full and the
+ * caller must make sure that gst_bounded_queue_pop(), gst_bounded_queue_pop_many()
+ * and gst_bounded_queue_peek() are never called concurrently.
+ *
+ * When only one thread at a time pushes into the queue,
+ * %GST_BOUNDED_QUEUE_FLAG_SINGLE_PRODUCER can be passed to
+ * gst_bounded_queue_new() to avoid the compare-and-swap on the tail.
+ *
+ * Since: 1.20
+ */
+
+G_DEFINE_BOXED_TYPE (GstBoundedQueue, gst_bounded_queue,
+    (GBoxedCopyFunc) gst_bounded_queue_ref,
+    (GBoxedFreeFunc) gst_bounded_queue_unref);
+
+/* the producers write the tail and the consumer writes the head, keep them
+ * in different cache lines so that they don't bounce between the cores */
+#define CACHE_LINE_SIZE 64
+
+/* A cell is published when its seq is one more than the position it was
+ * written at. Producers first reserve a range of positions by moving the
+ * tail, then fill the cells and publish them. The consumer only takes cells
+ * that are published, in order, and then moves the head past them, which
+ * gives the cells back to the producers. */
+typedef struct
+{
+  gint seq;                     /* ATOMIC */
+  gpointer data;
+} GstBQueueCell;
+
+struct _GstBoundedQueue
+{
+  gint refcount;
+  GstBoundedQueueFlags flags;
+  guint mask;
+  GstBQueueCell *cells;
+
+  guint8 _pad0[CACHE_LINE_SIZE];
+  gint tail;                    /* ATOMIC, moved by the producers */
+  guint8 _pad1[CACHE_LINE_SIZE - sizeof (gint)];
+  gint head;                    /* ATOMIC, moved by the consumer */
+  guint8 _pad2[CACHE_LINE_SIZE - sizeof (gint)];
+};
+
+static guint
+clp2 (guint n)
+{
+  guint res = 1;
+
+  while (res < n)
+    res <<= 1;
+
+  return res;
+}
+
+/**
+ * gst_bounded_queue_new:
+ * @capacity: the maximum number of items in the queue
+ * @flags: #GstBoundedQueueFlags
+ *
+ * Create a new bounded queue instance. @capacity will be rounded up to the
+ * nearest power of 2.
+ *
+ * Returns: a new #GstBoundedQueue
+ *
+ * Since: 1.20
+ */
+GstBoundedQueue *
+gst_bounded_queue_new (guint capacity, GstBoundedQueueFlags flags)
+{
+  GstBoundedQueue *queue;
+
+  g_return_val_if_fail (capacity > 0 && capacity <= G_MAXINT / 2 + 1, NULL);
+
+  queue = g_new0 (GstBoundedQueue, 1);
+
+  queue->refcount = 1;
+  queue->flags = flags;
+  queue->mask = clp2 (capacity) - 1;
+  /* all seq are 0, which is not published for any position of the first
+   * lap */
+  queue->cells = g_new0 (GstBQueueCell, queue->mask + 1);
+
+  return queue;
+}
+
+/**
+ * gst_bounded_queue_ref:
+ * @queue: a #GstBoundedQueue
+ *
+ * Increase the refcount of @queue.
+ *
+ * Returns: (transfer full): @queue
+ *
+ * Since: 1.20
+ */
+GstBoundedQueue *
+gst_bounded_queue_ref (GstBoundedQueue * queue)
+{
+  g_return_val_if_fail (queue != NULL, NULL);
+
+  g_atomic_int_inc (&queue->refcount);
+
+  return queue;
+}
+
+/**
+ * gst_bounded_queue_unref:
+ * @queue: a #GstBoundedQueue
+ *
+ * Unref @queue and free the memory when the refcount reaches 0. Items that
+ * are still in the queue are not freed.
+ *
+ * Since: 1.20
+ */
+void
+gst_bounded_queue_unref (GstBoundedQueue * queue)
+{
+  g_return_if_fail (queue != NULL);
+
+  if (g_atomic_int_dec_and_test (&queue->refcount)) {
+    g_free (queue->cells);
+    g_free (queue);
+  }
+}
+
+/**
+ * gst_bounded_queue_push_many:
+ * @queue: a #GstBoundedQueue
+ * @data: (array length=n_data): the items to push
+ * @n_data: the number of items in @data
+ *
+ * Append as many items of @data to the tail of the queue as there is space
+ * for. The items are reserved with one atomic operation and become visible
+ * to the consumer in order.
+ *
+ * Returns: the number of items that were pushed, starting from the first
+ * item of @data. This is less than @n_data when the queue is full.
+ *
+ * Since: 1.20
+ */
+guint
+gst_bounded_queue_push_many (GstBoundedQueue * queue, gpointer * data,
+    guint n_data)
+{
+  guint pos, head, space, n, i;
+
+  g_return_val_if_fail (queue != NULL, 0);
+  g_return_val_if_fail (data != NULL || n_data == 0, 0);
+
+  if (queue->flags & GST_BOUNDED_QUEUE_FLAG_SINGLE_PRODUCER) {
+    pos = g_atomic_int_get (&queue->tail);
+    head = g_atomic_int_get (&queue->head);
+    space = queue->mask + 1 - (pos - head);
+    n = MIN (n_data, space);
+    if (n == 0)
+      return 0;
+    g_atomic_int_set (&queue->tail, pos + n);
+  } else {
+    do {
+      pos = g_atomic_int_get (&queue->tail);
+      head = g_atomic_int_get (&queue->head);
+      space = queue->mask + 1 - (pos - head);
+      n = MIN (n_data, space);
+      if (n == 0)
+        return 0;
+    } while (!g_atomic_int_compare_and_exchange (&queue->tail, pos, pos + n));
+  }
+
+  /* the cells up to head + capacity were given back by the consumer, fill
+   * them and publish them in order */
+  for (i = 0; i < n; i++) {
+    GstBQueueCell *cell = &queue->cells[(pos + i) & queue->mask];
+
+    cell->data = data[i];
+    g_atomic_int_set (&cell->seq, pos + i + 1);
+  }
+  return n;
+}
+
+/**
+ * gst_bounded_queue_push:
+ * @queue: a #GstBoundedQueue
+ * @data: the data
+ *
+ * Append @data to the tail of the queue.
+ *
+ * Returns: %TRUE when @data was added, %FALSE when the queue is full.
+ *
+ * Since: 1.20
+ */
+gboolean
+gst_bounded_queue_push (GstBoundedQueue * queue, gpointer data)
+{
+  return gst_bounded_queue_push_many (queue, &data, 1) == 1;
+}
+
+/**
+ * gst_bounded_queue_pop_many:
+ * @queue: a #GstBoundedQueue
+ * @data: (out caller-allocates) (array length=n_data): location for the
+ *     items
+ * @n_data: the size of @data
+ *
+ * Take up to @n_data items from the head of the queue. Only one thread at
+ * a time can pop items from @queue.
+ *
+ * Returns: the number of items stored in @data.
+ *
+ * Since: 1.20
+ */
+guint
+gst_bounded_queue_pop_many (GstBoundedQueue * queue, gpointer * data,
+    guint n_data)
+{
+  guint pos, i;
+
+  g_return_val_if_fail (queue != NULL, 0);
+  g_return_val_if_fail (data != NULL || n_data == 0, 0);
+
+  pos = g_atomic_int_get (&queue->head);
+
+  for (i = 0; i < n_data; i++) {
+    GstBQueueCell *cell = &queue->cells[(pos + i) & queue->mask];
+
+    /* stop at the first cell that is not published yet, even when later
+     * cells are, so that we keep the order */
+    if ((guint) g_atomic_int_get (&cell->seq) != pos + i + 1)
+      break;
+
+    data[i] = cell->data;
+  }
+
+  if (i > 0)
+    g_atomic_int_set (&queue->head, pos + i);
+
+  return i;
+}
+
+/**
+ * gst_bounded_queue_pop:
+ * @queue: a #GstBoundedQueue
+ *
+ * Get the head element of the queue.
+ *
+ * Returns: (transfer full) (nullable): the head element of @queue or %NULL
+ * when the queue is empty.
+ *
+ * Since: 1.20
+ */
+gpointer
+gst_bounded_queue_pop (GstBoundedQueue * queue)
+{
+  gpointer data;
+
+  if (gst_bounded_queue_pop_many (queue, &data, 1) == 0)
+    return NULL;
+
+  return data;
+}
+
+/**
+ * gst_bounded_queue_peek:
+ * @queue: a #GstBoundedQueue
+ *
+ * Peek the head element of the queue without removing it from the queue.
+ *
+ * Returns: (transfer none) (nullable): the head element of @queue or
+ * %NULL when the queue is empty.
+ *
+ * Since: 1.20
+ */
+gpointer
+gst_bounded_queue_peek (GstBoundedQueue * queue)
+{
+  GstBQueueCell *cell;
+  guint pos;
+
+  g_return_val_if_fail (queue != NULL, NULL);
+
+  pos = g_atomic_int_get (&queue->head);
+  cell = &queue->cells[pos & queue->mask];
+
+  if ((guint) g_atomic_int_get (&cell->seq) != pos + 1)
+    return NULL;
+
+  return cell->data;
+}
+
+/**
+ * gst_bounded_queue_length:
+ * @queue: a #GstBoundedQueue
+ *
+ * Get the number of elements in the queue. This includes the items that
+ * producers are in the middle of pushing.
+ *
+ * Returns: the number of elements in the queue.
+ *
+ * Since: 1.20
+ */
+guint
+gst_bounded_queue_length (GstBoundedQueue * queue)
+{
+  guint head, tail;
+
+  g_return_val_if_fail (queue != NULL, 0);
+
+  head = g_atomic_int_get (&queue->head);
+  tail = g_atomic_int_get (&queue->tail);
+
+  /* the head can have moved on after we read it */
+  return MIN (tail - head, queue->mask + 1);
+}
+
+/**
+ * gst_bounded_queue_get_capacity:
+ * @queue: a #GstBoundedQueue
+ *
+ * Get the maximum number of elements in the queue.
+ *
+ * Returns: the capacity of @queue.
+ *
+ * Since: 1.20
+ */
+guint
+gst_bounded_queue_get_capacity (GstBoundedQueue * queue)
+{
+  g_return_val_if_fail (queue != NULL, 0);
+
+  return queue->mask + 1;
+}
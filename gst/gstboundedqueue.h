@@ -0,0 +1,101 @@
+/* GStreamer
+ *
+ * gstboundedqueue.h: bounded multi-producer single-consumer queue
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <glib.h>
+#include <glib-object.h>
+#include <gst/gstconfig.h>
+
+#ifndef __GST_BOUNDED_QUEUE_H__
+#define __GST_BOUNDED_QUEUE_H__
+
+G_BEGIN_DECLS
+
+#define GST_TYPE_BOUNDED_QUEUE (gst_bounded_queue_get_type())
+
+/**
+ * GstBoundedQueue:
+ *
+ * Opaque bounded data queue.
+ *
+ * Use the accessor functions to get the stored values.
+ *
+ * Since: 1.20
+ */
+typedef struct _GstBoundedQueue GstBoundedQueue;
+
+/**
+ * GstBoundedQueueFlags:
+ * @GST_BOUNDED_QUEUE_FLAG_NONE: no flags, any number of threads can push
+ * @GST_BOUNDED_QUEUE_FLAG_SINGLE_PRODUCER: only one thread at a time pushes
+ *     into the queue
+ *
+ * Flags passed to gst_bounded_queue_new().
+ *
+ * Since: 1.20
+ */
+typedef enum {
+  GST_BOUNDED_QUEUE_FLAG_NONE            = 0,
+  GST_BOUNDED_QUEUE_FLAG_SINGLE_PRODUCER = (1 << 0)
+} GstBoundedQueueFlags;
+
+GST_API
+GType              gst_bounded_queue_get_type     (void);
+
+GST_API
+GstBoundedQueue *  gst_bounded_queue_new          (guint capacity,
+                                                   GstBoundedQueueFlags flags) G_GNUC_MALLOC;
+
+GST_API
+GstBoundedQueue *  gst_bounded_queue_ref          (GstBoundedQueue * queue);
+
+GST_API
+void               gst_bounded_queue_unref        (GstBoundedQueue * queue);
+
+GST_API
+gboolean           gst_bounded_queue_push         (GstBoundedQueue * queue,
+                                                   gpointer data);
+
+GST_API
+guint              gst_bounded_queue_push_many    (GstBoundedQueue * queue,
+                                                   gpointer * data,
+                                                   guint n_data);
+
+GST_API
+gpointer           gst_bounded_queue_pop          (GstBoundedQueue * queue);
+
+GST_API
+guint              gst_bounded_queue_pop_many     (GstBoundedQueue * queue,
+                                                   gpointer * data,
+                                                   guint n_data);
+
+GST_API
+gpointer           gst_bounded_queue_peek         (GstBoundedQueue * queue);
+
+GST_API
+guint              gst_bounded_queue_length       (GstBoundedQueue * queue);
+
+GST_API
+guint              gst_bounded_queue_get_capacity (GstBoundedQueue * queue);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(GstBoundedQueue, gst_bounded_queue_unref)
+
+G_END_DECLS
+
+#endif /* __GST_BOUNDED_QUEUE_H__ */
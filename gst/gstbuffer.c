@@ -790,7 +790,7 @@ _gst_buffer_free (GstBuffer * buffer)
 
     next = walk->next;
     /* and free the slice */
-    g_slice_free1 (ITEM_SIZE (info), walk);
+    _priv_gst_magazine_free (ITEM_SIZE (info), walk);
   }
 
   /* get the size, when unreffing the memory, we could also unref the buffer
@@ -811,7 +811,7 @@ _gst_buffer_free (GstBuffer * buffer)
 #ifdef USE_POISONING
     memset (buffer, 0xff, msize);
 #endif
-    g_slice_free1 (msize, buffer);
+    _priv_gst_magazine_free (msize, buffer);
   } else {
     gst_memory_unref (GST_BUFFER_BUFMEM (buffer));
   }
@@ -850,7 +850,7 @@ gst_buffer_new (void)
 {
   GstBufferImpl *newbuf;
 
-  newbuf = g_slice_new (GstBufferImpl);
+  newbuf = _priv_gst_magazine_alloc (sizeof (GstBufferImpl));
   GST_CAT_LOG (GST_CAT_BUFFER, "new %p", newbuf);
 
   gst_buffer_init (newbuf, sizeof (GstBufferImpl));
@@ -2306,10 +2306,9 @@ gst_buffer_add_meta (GstBuffer * buffer, const GstMetaInfo * info,
    * init function but let's play safe here and prevent
    * uninitialized memory
    */
+  item = _priv_gst_magazine_alloc (size);
   if (!info->init_func)
-    item = g_slice_alloc0 (size);
-  else
-    item = g_slice_alloc (size);
+    memset (item, 0, size);
   result = &item->meta;
   result->info = info;
   result->flags = GST_META_FLAG_NONE;
@@ -2337,7 +2336,7 @@ gst_buffer_add_meta (GstBuffer * buffer, const GstMetaInfo * info,
 
 init_failed:
   {
-    g_slice_free1 (size, item);
+    _priv_gst_magazine_free (size, item);
     return NULL;
   }
 }
@@ -2388,7 +2387,7 @@ gst_buffer_remove_meta (GstBuffer * buffer, GstMeta * meta)
         info->free_func (m, buffer);
 
       /* and free the slice */
-      g_slice_free1 (ITEM_SIZE (info), walk);
+      _priv_gst_magazine_free (ITEM_SIZE (info), walk);
       break;
     }
     prev = walk;
@@ -2536,7 +2535,7 @@ gst_buffer_foreach_meta (GstBuffer * buffer, GstBufferForeachMetaFunc func,
         info->free_func (m, buffer);
 
       /* and free the slice */
-      g_slice_free1 (ITEM_SIZE (info), walk);
+      _priv_gst_magazine_free (ITEM_SIZE (info), walk);
     } else {
       prev = walk;
     }
@@ -56,6 +56,12 @@
  * Buffers allocated from a bufferpool will automatically be returned to the
  * pool with gst_buffer_pool_release_buffer() when their refcount drops to 0.
  *
+ * Threads waiting in gst_buffer_pool_acquire_buffer() for a buffer to be
+ * released are woken up through a condition variable. Releasing a buffer only
+ * costs an atomic operation when nobody is waiting.
+ * gst_buffer_pool_get_stats() returns how long acquiring buffers took and
+ * how often the pool ran empty.
+ *
  * The bufferpool can be deactivated again with gst_buffer_pool_set_active().
  * All further gst_buffer_pool_acquire_buffer() calls will return an error. When
  * all buffers are returned to the pool they will be freed.
@@ -64,36 +70,31 @@
 #include "gst_private.h"
 #include "glib-compat-private.h"
 
-#include <errno.h>
-#ifdef HAVE_UNISTD_H
-#  include <unistd.h>
-#endif
-#include <sys/types.h>
-
 #include "gstatomicqueue.h"
-#include "gstpoll.h"
 #include "gstinfo.h"
 #include "gstquark.h"
 #include "gstvalue.h"
 
 #include "gstbufferpool.h"
 
-#ifdef G_OS_WIN32
-#  ifndef EWOULDBLOCK
-#  define EWOULDBLOCK EAGAIN    /* This is just to placate gcc */
-#  endif
-#endif /* G_OS_WIN32 */
-
 GST_DEBUG_CATEGORY_STATIC (gst_buffer_pool_debug);
 #define GST_CAT_DEFAULT gst_buffer_pool_debug
 
 #define GST_BUFFER_POOL_LOCK(pool)   (g_rec_mutex_lock(&pool->priv->rec_lock))
 #define GST_BUFFER_POOL_UNLOCK(pool) (g_rec_mutex_unlock(&pool->priv->rec_lock))
 
+/* acquire latency buckets: < 1us, < 2us, < 4us, ... and the rest */
+#define N_LATENCY_BUCKETS 16
+
 struct _GstBufferPoolPrivate
 {
   GstAtomicQueue *queue;
-  GstPoll *poll;
+
+  /* waking up threads blocked in acquire */
+  GMutex wait_lock;
+  GCond wait_cond;
+  gint waiters;                 /* ATOMIC, modified with wait_lock */
+  gint release_seq;             /* ATOMIC, bumped on every release */
 
   GRecMutex rec_lock;
 
@@ -110,6 +111,10 @@ struct _GstBufferPoolPrivate
   guint cur_buffers;
   GstAllocator *allocator;
   GstAllocationParams params;
+
+  /* stats, ATOMIC */
+  gsize n_starved;
+  gsize latency[N_LATENCY_BUCKETS];
 };
 
 static void gst_buffer_pool_finalize (GObject * object);
@@ -156,8 +161,9 @@ gst_buffer_pool_init (GstBufferPool * pool)
   priv = pool->priv = gst_buffer_pool_get_instance_private (pool);
 
   g_rec_mutex_init (&priv->rec_lock);
+  g_mutex_init (&priv->wait_lock);
+  g_cond_init (&priv->wait_cond);
 
-  priv->poll = gst_poll_new_timer ();
   priv->queue = gst_atomic_queue_new (16);
   pool->flushing = 1;
   priv->active = FALSE;
@@ -169,10 +175,6 @@ gst_buffer_pool_init (GstBufferPool * pool)
   gst_allocation_params_init (&priv->params);
   gst_buffer_pool_config_set_allocator (priv->config, priv->allocator,
       &priv->params);
-  /* 1 control write for flushing - the flush token */
-  gst_poll_write_control (priv->poll);
-  /* 1 control write for marking that we are not waiting for poll - the wait token */
-  gst_poll_write_control (priv->poll);
 
   GST_DEBUG_OBJECT (pool, "created");
 }
@@ -190,7 +192,8 @@ gst_buffer_pool_finalize (GObject * object)
 
   gst_buffer_pool_set_active (pool, FALSE);
   gst_atomic_queue_unref (priv->queue);
-  gst_poll_free (priv->poll);
+  g_cond_clear (&priv->wait_cond);
+  g_mutex_clear (&priv->wait_lock);
   gst_structure_free (priv->config);
   g_rec_mutex_clear (&priv->rec_lock);
   if (priv->allocator)
@@ -391,20 +394,9 @@ default_stop (GstBufferPool * pool)
   GstBuffer *buffer;
 
   /* clear the pool */
-  while ((buffer = gst_atomic_queue_pop (priv->queue))) {
-    while (!gst_poll_read_control (priv->poll)) {
-      if (errno == EWOULDBLOCK) {
-        /* We put the buffer into the queue but did not finish writing control
-         * yet, let's wait a bit and retry */
-        g_thread_yield ();
-        continue;
-      } else {
-        /* Critical error but GstPoll already complained */
-        break;
-      }
-    }
+  while ((buffer = gst_atomic_queue_pop (priv->queue)))
     do_free_buffer (pool, buffer);
-  }
+
   return priv->cur_buffers == 0;
 }
 
@@ -443,8 +435,10 @@ do_set_flushing (GstBufferPool * pool, gboolean flushing)
 
   if (flushing) {
     g_atomic_int_set (&pool->flushing, 1);
-    /* Write the flush token to wake up any waiters */
-    gst_poll_write_control (priv->poll);
+    /* wake up any waiters */
+    g_mutex_lock (&priv->wait_lock);
+    g_cond_broadcast (&priv->wait_cond);
+    g_mutex_unlock (&priv->wait_lock);
 
     if (pclass->flush_start)
       pclass->flush_start (pool);
@@ -452,19 +446,6 @@ do_set_flushing (GstBufferPool * pool, gboolean flushing)
     if (pclass->flush_stop)
       pclass->flush_stop (pool);
 
-    while (!gst_poll_read_control (priv->poll)) {
-      if (errno == EWOULDBLOCK) {
-        /* This should not really happen unless flushing and unflushing
-         * happens on different threads. Let's wait a bit to get back flush
-         * token from the thread that was setting it to flushing */
-        g_thread_yield ();
-        continue;
-      } else {
-        /* Critical error but GstPoll already complained */
-        break;
-      }
-    }
-
     g_atomic_int_set (&pool->flushing, 0);
   }
 }
@@ -1089,36 +1070,85 @@ gst_buffer_pool_config_validate_params (GstStructure * config, GstCaps * caps,
   return ret;
 }
 
+/* Wake up the threads waiting in default_acquire_buffer(), called after a
+ * buffer was put back in the queue or freed. This is only an atomic
+ * increment when nobody is waiting. */
+static inline void
+wake_waiters (GstBufferPool * pool)
+{
+  GstBufferPoolPrivate *priv = pool->priv;
+
+  g_atomic_int_inc (&priv->release_seq);
+  if (G_UNLIKELY (g_atomic_int_get (&priv->waiters) > 0)) {
+    g_mutex_lock (&priv->wait_lock);
+    g_cond_broadcast (&priv->wait_cond);
+    g_mutex_unlock (&priv->wait_lock);
+  }
+}
+
+/* Block until wake_waiters() was called after @release_seq was read or the
+ * pool is flushing */
+static void
+wait_for_release (GstBufferPool * pool, gint release_seq)
+{
+  GstBufferPoolPrivate *priv = pool->priv;
+
+  g_mutex_lock (&priv->wait_lock);
+  /* announce ourselves before checking, any release after this will take
+   * wait_lock to wake us up */
+  g_atomic_int_inc (&priv->waiters);
+  while (g_atomic_int_get (&priv->release_seq) == release_seq &&
+      !GST_BUFFER_POOL_IS_FLUSHING (pool))
+    g_cond_wait (&priv->wait_cond, &priv->wait_lock);
+  g_atomic_int_add (&priv->waiters, -1);
+  g_mutex_unlock (&priv->wait_lock);
+}
+
+static void
+record_acquire_latency (GstBufferPool * pool, gint64 start)
+{
+  GstBufferPoolPrivate *priv = pool->priv;
+  gint64 elapsed;
+  guint bucket = 0;
+
+  elapsed = g_get_monotonic_time () - start;
+  while (bucket < N_LATENCY_BUCKETS - 1 && elapsed >= (1 << bucket))
+    bucket++;
+
+  g_atomic_pointer_add (&priv->latency[bucket], 1);
+}
+
 static GstFlowReturn
 default_acquire_buffer (GstBufferPool * pool, GstBuffer ** buffer,
     GstBufferPoolAcquireParams * params)
 {
   GstFlowReturn result;
   GstBufferPoolPrivate *priv = pool->priv;
+  gint64 start = -1;
+  gboolean starved = FALSE;
+  gint release_seq;
 
   while (TRUE) {
     if (G_UNLIKELY (GST_BUFFER_POOL_IS_FLUSHING (pool)))
       goto flushing;
 
+    /* read before looking at the queue so that we don't miss any release
+     * while we try to get or allocate a buffer */
+    release_seq = g_atomic_int_get (&priv->release_seq);
+
     /* try to get a buffer from the queue */
     *buffer = gst_atomic_queue_pop (priv->queue);
     if (G_LIKELY (*buffer)) {
-      while (!gst_poll_read_control (priv->poll)) {
-        if (errno == EWOULDBLOCK) {
-          /* We put the buffer into the queue but did not finish writing control
-           * yet, let's wait a bit and retry */
-          g_thread_yield ();
-          continue;
-        } else {
-          /* Critical error but GstPoll already complained */
-          break;
-        }
-      }
       result = GST_FLOW_OK;
       GST_LOG_OBJECT (pool, "acquired buffer %p", *buffer);
       break;
     }
 
+    /* only time the acquires that did not find a buffer in the queue, the
+     * others go to the first bucket */
+    if (start == -1)
+      start = g_get_monotonic_time ();
+
     /* no buffer, try to allocate some more */
     GST_LOG_OBJECT (pool, "no buffer, trying to allocate");
     result = do_alloc_buffer (pool, buffer, params);
@@ -1130,41 +1160,27 @@ default_acquire_buffer (GstBufferPool * pool, GstBuffer ** buffer,
       /* something went wrong, return error */
       break;
 
+    if (!starved) {
+      g_atomic_pointer_add (&priv->n_starved, 1);
+      starved = TRUE;
+    }
+
     /* check if we need to wait */
     if (params && (params->flags & GST_BUFFER_POOL_ACQUIRE_FLAG_DONTWAIT)) {
       GST_LOG_OBJECT (pool, "no more buffers");
       break;
     }
 
-    /* now we release the control socket, we wait for a buffer release or
-     * flushing */
-    if (!gst_poll_read_control (pool->priv->poll)) {
-      if (errno == EWOULDBLOCK) {
-        /* This means that we have two threads trying to allocate buffers
-         * already, and the other one already got the wait token. This
-         * means that we only have to wait for the poll now and not write the
-         * token afterwards: we will be woken up once the other thread is
-         * woken up and that one will write the wait token it removed */
-        GST_LOG_OBJECT (pool, "waiting for free buffers or flushing");
-        gst_poll_wait (priv->poll, GST_CLOCK_TIME_NONE);
-      } else {
-        /* This is a critical error, GstPoll already gave a warning */
-        result = GST_FLOW_ERROR;
-        break;
-      }
-    } else {
-      /* We're the first thread waiting, we got the wait token and have to
-       * write it again later
-       * OR
-       * We're a second thread and just consumed the flush token and block all
-       * other threads, in which case we must not wait and give it back
-       * immediately */
-      if (!GST_BUFFER_POOL_IS_FLUSHING (pool)) {
-        GST_LOG_OBJECT (pool, "waiting for free buffers or flushing");
-        gst_poll_wait (priv->poll, GST_CLOCK_TIME_NONE);
-      }
-      gst_poll_write_control (pool->priv->poll);
-    }
+    /* we wait for a buffer release or flushing */
+    GST_LOG_OBJECT (pool, "waiting for free buffers or flushing");
+    wait_for_release (pool, release_seq);
+  }
+
+  if (result == GST_FLOW_OK) {
+    if (start == -1)
+      g_atomic_pointer_add (&priv->latency[0], 1);
+    else
+      record_acquire_latency (pool, start);
   }
 
   return result;
@@ -1306,7 +1322,7 @@ default_release_buffer (GstBufferPool * pool, GstBuffer * buffer)
 
   /* keep it around in our queue */
   gst_atomic_queue_push (pool->priv->queue, buffer);
-  gst_poll_write_control (pool->priv->poll);
+  wake_waiters (pool);
 
   return;
 
@@ -1332,7 +1348,7 @@ not_writable:
 discard:
   {
     do_free_buffer (pool, buffer);
-    gst_poll_write_control (pool->priv->poll);
+    wake_waiters (pool);
     return;
   }
 }
@@ -1409,3 +1425,58 @@ gst_buffer_pool_set_flushing (GstBufferPool * pool, gboolean flushing)
 done:
   GST_BUFFER_POOL_UNLOCK (pool);
 }
+
+/**
+ * gst_buffer_pool_get_stats:
+ * @pool: a #GstBufferPool
+ *
+ * Get statistics about the buffers acquired from @pool with the default
+ * acquire_buffer implementation. The returned structure contains the
+ * following fields:
+ *
+ * * `acquired` (#G_TYPE_UINT64): the number of buffers acquired
+ * * `starved` (#G_TYPE_UINT64): the number of acquires that found the pool
+ *   empty and could not allocate a new buffer, either waiting for a buffer
+ *   to be released or failing with %GST_BUFFER_POOL_ACQUIRE_FLAG_DONTWAIT
+ * * `latency-histogram` (#GST_TYPE_ARRAY of #G_TYPE_UINT64): the number of
+ *   acquires that took less than 1, 2, 4, 8, ... microseconds. The last
+ *   element counts all slower acquires. Acquires that found a buffer in the
+ *   pool are not timed and counted in the first element.
+ *
+ * Returns: (transfer full): a new #GstStructure with the statistics.
+ *
+ * Since: 1.20
+ */
+GstStructure *
+gst_buffer_pool_get_stats (GstBufferPool * pool)
+{
+  GstBufferPoolPrivate *priv;
+  GValue histogram = G_VALUE_INIT;
+  GValue val = G_VALUE_INIT;
+  GstStructure *stats;
+  guint64 acquired = 0;
+  guint i;
+
+  g_return_val_if_fail (GST_IS_BUFFER_POOL (pool), NULL);
+
+  priv = pool->priv;
+
+  gst_value_array_init (&histogram, N_LATENCY_BUCKETS);
+  g_value_init (&val, G_TYPE_UINT64);
+  for (i = 0; i < N_LATENCY_BUCKETS; i++) {
+    guint64 count = (gsize) g_atomic_pointer_get (&priv->latency[i]);
+
+    acquired += count;
+    g_value_set_uint64 (&val, count);
+    gst_value_array_append_value (&histogram, &val);
+  }
+  g_value_unset (&val);
+
+  stats = gst_structure_new ("GstBufferPoolStats",
+      "acquired", G_TYPE_UINT64, acquired,
+      "starved", G_TYPE_UINT64,
+      (guint64) (gsize) g_atomic_pointer_get (&priv->n_starved), NULL);
+  gst_structure_take_value (stats, "latency-histogram", &histogram);
+
+  return stats;
+}
@@ -345,6 +345,11 @@ GstFlowReturn    gst_buffer_pool_acquire_buffer  (GstBufferPool *pool, GstBuffer
 GST_API
 void             gst_buffer_pool_release_buffer  (GstBufferPool *pool, GstBuffer *buffer);
 
+/* statistics */
+
+GST_API
+GstStructure *   gst_buffer_pool_get_stats       (GstBufferPool *pool);
+
 G_END_DECLS
 
 #endif /* __GST_BUFFER_POOL_H__ */
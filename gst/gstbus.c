@@ -74,6 +74,7 @@
 #include <sys/types.h>
 
 #include "gstatomicqueue.h"
+#include "gstboundedqueue.h"
 #include "gstinfo.h"
 #include "gstpoll.h"
 
@@ -97,11 +98,13 @@ enum
 };
 
 #define DEFAULT_ENABLE_ASYNC (TRUE)
+#define DEFAULT_QUEUE_CAPACITY (0)
 
 enum
 {
   PROP_0,
-  PROP_ENABLE_ASYNC
+  PROP_ENABLE_ASYNC,
+  PROP_QUEUE_CAPACITY
 };
 
 static void gst_bus_dispose (GObject * object);
@@ -142,6 +145,11 @@ struct _GstBusPrivate
   GstAtomicQueue *queue;
   GMutex queue_lock;
 
+  /* when not NULL, messages go here first and only go to queue when this
+   * is full. Popped with the queue_lock */
+  GstBoundedQueue *bqueue;
+  guint queue_capacity;
+
   SyncHandler *sync_handler;
 
   guint num_signal_watchers;
@@ -167,6 +175,25 @@ gst_bus_set_property (GObject * object,
     case PROP_ENABLE_ASYNC:
       bus->priv->enable_async = g_value_get_boolean (value);
       break;
+    case PROP_QUEUE_CAPACITY:
+      bus->priv->queue_capacity = g_value_get_uint (value);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+static void
+gst_bus_get_property (GObject * object,
+    guint prop_id, GValue * value, GParamSpec * pspec)
+{
+  GstBus *bus = GST_BUS_CAST (object);
+
+  switch (prop_id) {
+    case PROP_QUEUE_CAPACITY:
+      g_value_set_uint (value, bus->priv->queue_capacity);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -181,6 +208,10 @@ gst_bus_constructed (GObject * object)
   if (bus->priv->enable_async) {
     bus->priv->poll = gst_poll_new_timer ();
     gst_poll_get_read_gpollfd (bus->priv->poll, &bus->priv->pollfd);
+
+    if (bus->priv->queue_capacity > 0)
+      bus->priv->bqueue = gst_bounded_queue_new (bus->priv->queue_capacity,
+          GST_BOUNDED_QUEUE_FLAG_NONE);
   }
 
   G_OBJECT_CLASS (gst_bus_parent_class)->constructed (object);
@@ -194,6 +225,7 @@ gst_bus_class_init (GstBusClass * klass)
   gobject_class->dispose = gst_bus_dispose;
   gobject_class->finalize = gst_bus_finalize;
   gobject_class->set_property = gst_bus_set_property;
+  gobject_class->get_property = gst_bus_get_property;
   gobject_class->constructed = gst_bus_constructed;
 
   /**
@@ -212,6 +244,24 @@ gst_bus_class_init (GstBusClass * klass)
           DEFAULT_ENABLE_ASYNC,
           G_PARAM_CONSTRUCT_ONLY | G_PARAM_WRITABLE | G_PARAM_STATIC_STRINGS));
 
+  /**
+   * GstBus:queue-capacity:
+   *
+   * When not 0, messages are queued in a #GstBoundedQueue of this size
+   * before falling back to the unbounded queue. This makes posting
+   * cheaper on buses that are popped from by one thread at a time, which is
+   * always the case for the messages handled by a bus watch or
+   * gst_bus_pop(). The number of messages on the bus is not limited by this.
+   *
+   * Since: 1.20
+   */
+  g_object_class_install_property (gobject_class, PROP_QUEUE_CAPACITY,
+      g_param_spec_uint ("queue-capacity", "Queue Capacity",
+          "Size of the bounded message queue (0 = don't use a bounded queue)",
+          0, G_MAXINT / 2, DEFAULT_QUEUE_CAPACITY,
+          G_PARAM_CONSTRUCT_ONLY | G_PARAM_READWRITE |
+          G_PARAM_STATIC_STRINGS));
+
   /**
    * GstBus::sync-message:
    * @self: the object which received the signal
@@ -250,12 +300,71 @@ gst_bus_init (GstBus * bus)
 {
   bus->priv = gst_bus_get_instance_private (bus);
   bus->priv->enable_async = DEFAULT_ENABLE_ASYNC;
+  bus->priv->queue_capacity = DEFAULT_QUEUE_CAPACITY;
   g_mutex_init (&bus->priv->queue_lock);
   bus->priv->queue = gst_atomic_queue_new (32);
 
   GST_DEBUG_OBJECT (bus, "created");
 }
 
+/* messages only go to the bounded queue when the overflow queue is empty
+ * and are popped from the bounded queue first. That way messages posted
+ * from the same thread are popped in the order they were posted */
+static void
+gst_bus_queue_push (GstBus * bus, GstMessage * message)
+{
+  GstBusPrivate *priv = bus->priv;
+
+  if (priv->bqueue && gst_atomic_queue_length (priv->queue) == 0
+      && gst_bounded_queue_push (priv->bqueue, message))
+    return;
+
+  gst_atomic_queue_push (priv->queue, message);
+}
+
+/* must be called with the queue_lock */
+static GstMessage *
+gst_bus_queue_pop (GstBus * bus)
+{
+  GstBusPrivate *priv = bus->priv;
+  GstMessage *message = NULL;
+
+  if (priv->bqueue)
+    message = gst_bounded_queue_pop (priv->bqueue);
+  if (message == NULL)
+    message = gst_atomic_queue_pop (priv->queue);
+
+  return message;
+}
+
+/* must be called with the queue_lock */
+static GstMessage *
+gst_bus_queue_peek (GstBus * bus)
+{
+  GstBusPrivate *priv = bus->priv;
+  GstMessage *message = NULL;
+
+  if (priv->bqueue)
+    message = gst_bounded_queue_peek (priv->bqueue);
+  if (message == NULL)
+    message = gst_atomic_queue_peek (priv->queue);
+
+  return message;
+}
+
+static guint
+gst_bus_queue_length (GstBus * bus)
+{
+  GstBusPrivate *priv = bus->priv;
+  guint length;
+
+  length = gst_atomic_queue_length (priv->queue);
+  if (priv->bqueue)
+    length += gst_bounded_queue_length (priv->bqueue);
+
+  return length;
+}
+
 static void
 gst_bus_dispose (GObject * object)
 {
@@ -266,12 +375,13 @@ gst_bus_dispose (GObject * object)
 
     g_mutex_lock (&bus->priv->queue_lock);
     do {
-      message = gst_atomic_queue_pop (bus->priv->queue);
+      message = gst_bus_queue_pop (bus);
       if (message)
         gst_message_unref (message);
     } while (message != NULL);
     gst_atomic_queue_unref (bus->priv->queue);
     bus->priv->queue = NULL;
+    g_clear_pointer (&bus->priv->bqueue, gst_bounded_queue_unref);
     g_mutex_unlock (&bus->priv->queue_lock);
     g_mutex_clear (&bus->priv->queue_lock);
 
@@ -379,7 +489,7 @@ gst_bus_post (GstBus * bus, GstMessage * message)
     case GST_BUS_PASS:
       /* pass the message to the async queue, refcount passed in the queue */
       GST_DEBUG_OBJECT (bus, "[msg %p] pushing on async queue", message);
-      gst_atomic_queue_push (bus->priv->queue, message);
+      gst_bus_queue_push (bus, message);
       gst_poll_write_control (bus->priv->poll);
       GST_DEBUG_OBJECT (bus, "[msg %p] pushed on async queue", message);
 
@@ -403,7 +513,7 @@ gst_bus_post (GstBus * bus, GstMessage * message)
        * the cond will be signalled and we can continue */
       g_mutex_lock (lock);
 
-      gst_atomic_queue_push (bus->priv->queue, message);
+      gst_bus_queue_push (bus, message);
       gst_poll_write_control (bus->priv->poll);
 
       /* now block till the message is freed */
@@ -457,7 +567,7 @@ gst_bus_have_pending (GstBus * bus)
   g_return_val_if_fail (GST_IS_BUS (bus), FALSE);
 
   /* see if there is a message on the bus */
-  result = gst_atomic_queue_length (bus->priv->queue) != 0;
+  result = gst_bus_queue_length (bus) != 0;
 
   return result;
 }
@@ -535,9 +645,9 @@ gst_bus_timed_pop_filtered (GstBus * bus, GstClockTime timeout,
     gint ret;
 
     GST_LOG_OBJECT (bus, "have %d messages",
-        gst_atomic_queue_length (bus->priv->queue));
+        gst_bus_queue_length (bus));
 
-    while ((message = gst_atomic_queue_pop (bus->priv->queue))) {
+    while ((message = gst_bus_queue_pop (bus))) {
       if (bus->priv->poll) {
         while (!gst_poll_read_control (bus->priv->poll)) {
           if (errno == EWOULDBLOCK) {
@@ -697,7 +807,7 @@ gst_bus_peek (GstBus * bus)
   g_return_val_if_fail (GST_IS_BUS (bus), NULL);
 
   g_mutex_lock (&bus->priv->queue_lock);
-  message = gst_atomic_queue_peek (bus->priv->queue);
+  message = gst_bus_queue_peek (bus);
   if (message)
     gst_message_ref (message);
   g_mutex_unlock (&bus->priv->queue_lock);
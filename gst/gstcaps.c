@@ -129,6 +129,8 @@ static void gst_caps_transform_to_string (const GValue * src_value,
     GValue * dest_value);
 static gboolean gst_caps_from_string_inplace (GstCaps * caps,
     const gchar * string);
+static void gst_caps_cache_init (void);
+static void gst_caps_cache_clear (void);
 
 GType _gst_caps_type = 0;
 GstCaps *_gst_caps_any;
@@ -146,11 +148,15 @@ _priv_gst_caps_initialize (void)
 
   g_value_register_transform_func (_gst_caps_type,
       G_TYPE_STRING, gst_caps_transform_to_string);
+
+  gst_caps_cache_init ();
 }
 
 void
 _priv_gst_caps_cleanup (void)
 {
+  gst_caps_cache_clear ();
+
   gst_caps_unref (_gst_caps_any);
   _gst_caps_any = NULL;
   gst_caps_unref (_gst_caps_none);
@@ -1299,6 +1305,461 @@ gst_caps_is_always_compatible (const GstCaps * caps1, const GstCaps * caps2)
   return gst_caps_is_subset (caps1, caps2);
 }
 
+/* memo cache
+ *
+ * Negotiation intersects and compares the same caps over and over, for
+ * example the template caps of identical elements in many pipelines. The
+ * results of gst_caps_intersect_full(), gst_caps_can_intersect() and
+ * gst_caps_is_subset() on caps that are not fixed are kept in a small direct
+ * mapped table, indexed by a hash of the contents of both caps.
+ *
+ * Pad template and static caps are shared and live as long as their
+ * template, so they can't change. When both caps are such caps, the entry
+ * keeps a ref to them and is found by their addresses, without looking at
+ * their contents.
+ *
+ * Other caps can be modified by the caller after the call, so an entry keeps
+ * copies of the caps it was made for and a hit requires both caps to be
+ * strictly equal to those: same structures, fields and list items in the
+ * same order, since the order ends up in the result. Intersections return a
+ * copy of the cached result, so they stay writable like before.
+ *
+ * Each slot of the table is locked separately with a bit lock on the entry
+ * pointer, so threads negotiating different caps don't wait for each other.
+ *
+ * Fixed caps are not cached, operations on them are cheaper than the
+ * lookup. The number of entries is set with GST_CAPS_CACHE, 0 disables the
+ * cache.
+ */
+#define DEFAULT_CAPS_CACHE_SIZE 128
+
+typedef enum
+{
+  GST_CAPS_CACHE_INTERSECT_ZIG_ZAG,
+  GST_CAPS_CACHE_INTERSECT_FIRST,
+  GST_CAPS_CACHE_CAN_INTERSECT,
+  GST_CAPS_CACHE_IS_SUBSET
+} GstCapsCacheOp;
+
+typedef struct
+{
+  gint refcount;
+  guint key;
+  GstCapsCacheOp op;
+  /* the caps themselves when found by identity, copies otherwise */
+  gboolean identity;
+  GstCaps *caps1;
+  GstCaps *caps2;
+  GstCaps *result;
+  gboolean res;
+} GstCapsCacheEntry;
+
+/* template and static caps, see above */
+#define CAPS_CACHE_BY_IDENTITY(caps) \
+  (!gst_caps_is_writable (caps) && \
+   GST_MINI_OBJECT_FLAG_IS_SET (caps, GST_MINI_OBJECT_FLAG_MAY_BE_LEAKED))
+
+/* bit 0 of each slot is its lock */
+static gpointer *caps_cache = NULL;
+static guint caps_cache_mask = 0;
+static gint caps_cache_hits = 0;        /* ATOMIC */
+static gint caps_cache_misses = 0;      /* ATOMIC */
+
+#define HASH_COMBINE(h,v) ((h) * 31 + (guint) (v))
+
+static void
+gst_caps_cache_init (void)
+{
+  const gchar *env;
+  guint size = DEFAULT_CAPS_CACHE_SIZE;
+
+  env = g_getenv ("GST_CAPS_CACHE");
+  if (env) {
+    if (!g_ascii_strcasecmp (env, "no"))
+      size = 0;
+    else
+      size = MIN (g_ascii_strtoull (env, NULL, 10), 1 << 16);
+  }
+
+  if (size > 0) {
+    size = 1 << g_bit_storage (size - 1);
+    caps_cache = g_new0 (gpointer, size);
+    caps_cache_mask = size - 1;
+  }
+
+  GST_CAT_DEBUG (GST_CAT_PERFORMANCE, "caps cache with %u entries", size);
+}
+
+static GstCapsCacheEntry *
+gst_caps_cache_entry_ref (GstCapsCacheEntry * entry)
+{
+  g_atomic_int_inc (&entry->refcount);
+  return entry;
+}
+
+static void
+gst_caps_cache_entry_unref (GstCapsCacheEntry * entry)
+{
+  if (!g_atomic_int_dec_and_test (&entry->refcount))
+    return;
+
+  gst_caps_unref (entry->caps1);
+  gst_caps_unref (entry->caps2);
+  if (entry->result)
+    gst_caps_unref (entry->result);
+  g_slice_free (GstCapsCacheEntry, entry);
+}
+
+/* returns a ref to the entry in the slot of @key, if it is for @op */
+static GstCapsCacheEntry *
+gst_caps_cache_get (guint key, GstCapsCacheOp op)
+{
+  gpointer *slot = &caps_cache[key & caps_cache_mask];
+  GstCapsCacheEntry *entry;
+
+  g_pointer_bit_lock (slot, 0);
+  entry = (GstCapsCacheEntry *) ((guintptr) g_atomic_pointer_get (slot) &
+      ~(guintptr) 1);
+  if (entry && entry->key == key && entry->op == op)
+    gst_caps_cache_entry_ref (entry);
+  else
+    entry = NULL;
+  g_pointer_bit_unlock (slot, 0);
+
+  return entry;
+}
+
+/* takes ownership of @entry */
+static void
+gst_caps_cache_set (GstCapsCacheEntry * entry)
+{
+  gpointer *slot = &caps_cache[entry->key & caps_cache_mask];
+  GstCapsCacheEntry *old;
+
+  g_pointer_bit_lock (slot, 0);
+  /* direct mapped, the last result wins */
+  old = (GstCapsCacheEntry *) ((guintptr) g_atomic_pointer_get (slot) &
+      ~(guintptr) 1);
+  /* keep the lock bit set until the unlock */
+  g_atomic_pointer_set (slot, (gpointer) ((guintptr) entry | 1));
+  g_pointer_bit_unlock (slot, 0);
+
+  if (old)
+    gst_caps_cache_entry_unref (old);
+}
+
+static void
+gst_caps_cache_clear (void)
+{
+  gint hits, misses;
+  guint i;
+
+  hits = g_atomic_int_get (&caps_cache_hits);
+  misses = g_atomic_int_get (&caps_cache_misses);
+  if (hits || misses)
+    GST_CAT_INFO (GST_CAT_PERFORMANCE, "caps cache: %d hits, %d misses, "
+        "hit rate %.1f%%", hits, misses, 100.0 * hits / (hits + misses));
+
+  if (caps_cache == NULL)
+    return;
+
+  for (i = 0; i <= caps_cache_mask; i++) {
+    if (caps_cache[i])
+      gst_caps_cache_entry_unref (caps_cache[i]);
+  }
+  g_atomic_int_set (&caps_cache_hits, 0);
+  g_atomic_int_set (&caps_cache_misses, 0);
+  g_free (caps_cache);
+  caps_cache = NULL;
+  caps_cache_mask = 0;
+}
+
+static guint
+gst_caps_cache_hash_value (const GValue * value)
+{
+  GType type = G_VALUE_TYPE (value);
+  guint hash = (guint) type;
+  guint i, n;
+
+  /* values of other types only contribute their type, they are still
+   * compared when looking up the entry */
+  if (type == G_TYPE_INT) {
+    hash = HASH_COMBINE (hash, g_value_get_int (value));
+  } else if (type == G_TYPE_UINT) {
+    hash = HASH_COMBINE (hash, g_value_get_uint (value));
+  } else if (type == G_TYPE_BOOLEAN) {
+    hash = HASH_COMBINE (hash, g_value_get_boolean (value));
+  } else if (type == G_TYPE_STRING) {
+    const gchar *str = g_value_get_string (value);
+
+    if (str)
+      hash = HASH_COMBINE (hash, g_str_hash (str));
+  } else if (type == GST_TYPE_FRACTION) {
+    hash = HASH_COMBINE (hash, gst_value_get_fraction_numerator (value));
+    hash = HASH_COMBINE (hash, gst_value_get_fraction_denominator (value));
+  } else if (type == GST_TYPE_INT_RANGE) {
+    hash = HASH_COMBINE (hash, gst_value_get_int_range_min (value));
+    hash = HASH_COMBINE (hash, gst_value_get_int_range_max (value));
+  } else if (type == GST_TYPE_FRACTION_RANGE) {
+    hash = HASH_COMBINE (hash,
+        gst_caps_cache_hash_value (gst_value_get_fraction_range_min (value)));
+    hash = HASH_COMBINE (hash,
+        gst_caps_cache_hash_value (gst_value_get_fraction_range_max (value)));
+  } else if (type == GST_TYPE_LIST) {
+    n = gst_value_list_get_size (value);
+    for (i = 0; i < n; i++)
+      hash = HASH_COMBINE (hash,
+          gst_caps_cache_hash_value (gst_value_list_get_value (value, i)));
+  } else if (type == GST_TYPE_ARRAY) {
+    n = gst_value_array_get_size (value);
+    for (i = 0; i < n; i++)
+      hash = HASH_COMBINE (hash,
+          gst_caps_cache_hash_value (gst_value_array_get_value (value, i)));
+  } else if (G_TYPE_FUNDAMENTAL (type) == G_TYPE_ENUM) {
+    hash = HASH_COMBINE (hash, g_value_get_enum (value));
+  } else if (G_TYPE_FUNDAMENTAL (type) == G_TYPE_FLAGS) {
+    hash = HASH_COMBINE (hash, g_value_get_flags (value));
+  }
+  return hash;
+}
+
+static gboolean
+gst_caps_cache_hash_field (GQuark field_id, const GValue * value,
+    gpointer user_data)
+{
+  guint *hash = user_data;
+
+  *hash = HASH_COMBINE (*hash, field_id);
+  *hash = HASH_COMBINE (*hash, gst_caps_cache_hash_value (value));
+
+  return TRUE;
+}
+
+static guint
+gst_caps_cache_hash (const GstCaps * caps)
+{
+  guint hash = GST_CAPS_LEN (caps);
+  guint i, j, n;
+
+  for (i = 0; i < GST_CAPS_LEN (caps); i++) {
+    GstStructure *s = gst_caps_get_structure_unchecked (caps, i);
+    GstCapsFeatures *f = gst_caps_get_features_unchecked (caps, i);
+
+    hash = HASH_COMBINE (hash, gst_structure_get_name_id (s));
+    gst_structure_foreach (s, gst_caps_cache_hash_field, &hash);
+
+    if (f && gst_caps_features_is_any (f)) {
+      hash = HASH_COMBINE (hash, 1);
+    } else if (f) {
+      n = gst_caps_features_get_size (f);
+      for (j = 0; j < n; j++)
+        hash = HASH_COMBINE (hash, gst_caps_features_get_nth_id (f, j));
+    }
+  }
+  return hash;
+}
+
+/* like gst_value_compare() but lists have to be in the same order */
+static gboolean
+gst_caps_cache_value_equal (const GValue * value1, const GValue * value2)
+{
+  GType type = G_VALUE_TYPE (value1);
+  guint i, n;
+
+  if (type != G_VALUE_TYPE (value2))
+    return FALSE;
+
+  if (type == GST_TYPE_LIST) {
+    n = gst_value_list_get_size (value1);
+    if (n != gst_value_list_get_size (value2))
+      return FALSE;
+    for (i = 0; i < n; i++) {
+      if (!gst_caps_cache_value_equal (gst_value_list_get_value (value1, i),
+              gst_value_list_get_value (value2, i)))
+        return FALSE;
+    }
+    return TRUE;
+  } else if (type == GST_TYPE_ARRAY) {
+    n = gst_value_array_get_size (value1);
+    if (n != gst_value_array_get_size (value2))
+      return FALSE;
+    for (i = 0; i < n; i++) {
+      if (!gst_caps_cache_value_equal (gst_value_array_get_value (value1, i),
+              gst_value_array_get_value (value2, i)))
+        return FALSE;
+    }
+    return TRUE;
+  }
+  return gst_value_compare (value1, value2) == GST_VALUE_EQUAL;
+}
+
+/* like gst_caps_is_strictly_equal() but fields have to be in the same
+ * order too */
+static gboolean
+gst_caps_cache_caps_equal (const GstCaps * caps1, const GstCaps * caps2)
+{
+  guint i, j, n;
+
+  if (GST_CAPS_LEN (caps1) != GST_CAPS_LEN (caps2))
+    return FALSE;
+
+  for (i = 0; i < GST_CAPS_LEN (caps1); i++) {
+    GstStructure *s1 = gst_caps_get_structure_unchecked (caps1, i);
+    GstStructure *s2 = gst_caps_get_structure_unchecked (caps2, i);
+    GstCapsFeatures *f1 = gst_caps_get_features_unchecked (caps1, i);
+    GstCapsFeatures *f2 = gst_caps_get_features_unchecked (caps2, i);
+
+    if (!f1)
+      f1 = GST_CAPS_FEATURES_MEMORY_SYSTEM_MEMORY;
+    if (!f2)
+      f2 = GST_CAPS_FEATURES_MEMORY_SYSTEM_MEMORY;
+
+    if (gst_caps_features_is_any (f1) != gst_caps_features_is_any (f2) ||
+        !gst_caps_features_is_equal (f1, f2))
+      return FALSE;
+
+    n = gst_structure_n_fields (s1);
+    if (gst_structure_get_name_id (s1) != gst_structure_get_name_id (s2) ||
+        n != gst_structure_n_fields (s2))
+      return FALSE;
+
+    for (j = 0; j < n; j++) {
+      const gchar *name = gst_structure_nth_field_name (s1, j);
+
+      /* field names are interned strings */
+      if (name != gst_structure_nth_field_name (s2, j))
+        return FALSE;
+      if (!gst_caps_cache_value_equal (gst_structure_get_value (s1, name),
+              gst_structure_get_value (s2, name)))
+        return FALSE;
+    }
+  }
+  return TRUE;
+}
+
+/* Look up the result of @op on @caps1 and @caps2. On a hit, @result is set
+ * to a copy of the cached intersection and @res to the cached boolean.
+ * @key is set to the key to pass to gst_caps_cache_insert() after a miss, or
+ * 0 when the result should not be cached. */
+static gboolean
+gst_caps_cache_lookup (GstCapsCacheOp op, const GstCaps * caps1,
+    const GstCaps * caps2, guint * key, GstCaps ** result, gboolean * res)
+{
+  GstCapsCacheEntry *entry;
+  gboolean hit;
+
+  *key = 0;
+
+  if (caps_cache == NULL)
+    return FALSE;
+
+  if (gst_caps_is_fixed (caps1) || gst_caps_is_fixed (caps2))
+    return FALSE;
+
+  if (CAPS_CACHE_BY_IDENTITY (caps1) && CAPS_CACHE_BY_IDENTITY (caps2)) {
+    *key = HASH_COMBINE (HASH_COMBINE ((guint) ((guintptr) caps1 >> 3),
+            (guint) ((guintptr) caps2 >> 3)), op);
+    if (*key == 0)
+      *key = 1;
+
+    /* the entry holds a ref to both caps, so they can't have changed */
+    entry = gst_caps_cache_get (*key, op);
+    hit = entry && entry->identity && entry->caps1 == caps1
+        && entry->caps2 == caps2;
+  } else {
+    *key = HASH_COMBINE (HASH_COMBINE (gst_caps_cache_hash (caps1),
+            gst_caps_cache_hash (caps2)), op);
+    if (*key == 0)
+      *key = 1;
+
+    /* the entries never change, compare without the lock */
+    entry = gst_caps_cache_get (*key, op);
+    hit = entry && !entry->identity
+        && gst_caps_cache_caps_equal (caps1, entry->caps1)
+        && gst_caps_cache_caps_equal (caps2, entry->caps2);
+  }
+
+  if (hit) {
+    if (result) {
+      *result = _gst_caps_copy (entry->result);
+      GST_MINI_OBJECT_FLAG_UNSET (*result, GST_MINI_OBJECT_FLAG_MAY_BE_LEAKED);
+    }
+    if (res)
+      *res = entry->res;
+    g_atomic_int_inc (&caps_cache_hits);
+  } else {
+    g_atomic_int_inc (&caps_cache_misses);
+  }
+
+  if (entry)
+    gst_caps_cache_entry_unref (entry);
+
+  return hit;
+}
+
+static GstCaps *
+gst_caps_cache_copy (const GstCaps * caps)
+{
+  GstCaps *copy = _gst_caps_copy (caps);
+
+  /* kept until gst_deinit(), after the leaks tracer is done */
+  GST_MINI_OBJECT_FLAG_SET (copy, GST_MINI_OBJECT_FLAG_MAY_BE_LEAKED);
+
+  return copy;
+}
+
+static void
+gst_caps_cache_insert (guint key, GstCapsCacheOp op, const GstCaps * caps1,
+    const GstCaps * caps2, const GstCaps * result, gboolean res)
+{
+  GstCapsCacheEntry *entry;
+
+  if (key == 0)
+    return;
+
+  entry = g_slice_new (GstCapsCacheEntry);
+  entry->refcount = 1;
+  entry->key = key;
+  entry->op = op;
+  /* the same test as in the lookup, the caps are still not writable */
+  entry->identity = CAPS_CACHE_BY_IDENTITY (caps1)
+      && CAPS_CACHE_BY_IDENTITY (caps2);
+  if (entry->identity) {
+    entry->caps1 = gst_caps_ref ((GstCaps *) caps1);
+    entry->caps2 = gst_caps_ref ((GstCaps *) caps2);
+  } else {
+    entry->caps1 = gst_caps_cache_copy (caps1);
+    entry->caps2 = gst_caps_cache_copy (caps2);
+  }
+  entry->result = result ? gst_caps_cache_copy (result) : NULL;
+  entry->res = res;
+
+  gst_caps_cache_set (entry);
+}
+
+/**
+ * gst_caps_get_cache_stats:
+ * @hits: (out) (optional): the number of lookups that found a result
+ * @misses: (out) (optional): the number of lookups that didn't
+ *
+ * Gets the number of times the results of gst_caps_intersect_full(),
+ * gst_caps_can_intersect() and gst_caps_is_subset() were found in the cache
+ * of the results of those operations, and the number of times they had to
+ * be calculated. Operations on fixed caps are not counted, they are never
+ * cached. Both numbers are 0 when the cache is disabled with
+ * `GST_CAPS_CACHE=0`.
+ *
+ * Since: 1.20
+ */
+void
+gst_caps_get_cache_stats (guint * hits, guint * misses)
+{
+  if (hits)
+    *hits = g_atomic_int_get (&caps_cache_hits);
+  if (misses)
+    *misses = g_atomic_int_get (&caps_cache_misses);
+}
+
 /**
  * gst_caps_is_subset:
  * @subset: a #GstCaps
@@ -1315,6 +1776,7 @@ gst_caps_is_subset (const GstCaps * subset, const GstCaps * superset)
   GstCapsFeatures *f1, *f2;
   gboolean ret = TRUE;
   gint i, j;
+  guint key;
 
   g_return_val_if_fail (subset != NULL, FALSE);
   g_return_val_if_fail (superset != NULL, FALSE);
@@ -1324,6 +1786,10 @@ gst_caps_is_subset (const GstCaps * subset, const GstCaps * superset)
   if (CAPS_IS_ANY (subset) || CAPS_IS_EMPTY (superset))
     return FALSE;
 
+  if (gst_caps_cache_lookup (GST_CAPS_CACHE_IS_SUBSET, subset, superset, &key,
+          NULL, &ret))
+    return ret;
+
   for (i = GST_CAPS_LEN (subset) - 1; i >= 0; i--) {
     s1 = gst_caps_get_structure_unchecked (subset, i);
     f1 = gst_caps_get_features_unchecked (subset, i);
@@ -1352,6 +1818,9 @@ gst_caps_is_subset (const GstCaps * subset, const GstCaps * superset)
     }
   }
 
+  gst_caps_cache_insert (key, GST_CAPS_CACHE_IS_SUBSET, subset, superset, NULL,
+      ret);
+
   return ret;
 }
 
@@ -1515,18 +1984,8 @@ gst_caps_is_strictly_equal (const GstCaps * caps1, const GstCaps * caps2)
 
 /* intersect operation */
 
-/**
- * gst_caps_can_intersect:
- * @caps1: a #GstCaps to intersect
- * @caps2: a #GstCaps to intersect
- *
- * Tries intersecting @caps1 and @caps2 and reports whether the result would not
- * be empty
- *
- * Returns: %TRUE if intersection would be not empty
- */
-gboolean
-gst_caps_can_intersect (const GstCaps * caps1, const GstCaps * caps2)
+static gboolean
+gst_caps_can_intersect_zig_zag (const GstCaps * caps1, const GstCaps * caps2)
 {
   guint64 i;                    /* index can be up to 2 * G_MAX_UINT */
   guint j, k, len1, len2;
@@ -1535,21 +1994,6 @@ gst_caps_can_intersect (const GstCaps * caps1, const GstCaps * caps2)
   GstCapsFeatures *features1;
   GstCapsFeatures *features2;
 
-  g_return_val_if_fail (GST_IS_CAPS (caps1), FALSE);
-  g_return_val_if_fail (GST_IS_CAPS (caps2), FALSE);
-
-  /* caps are exactly the same pointers */
-  if (G_UNLIKELY (caps1 == caps2))
-    return TRUE;
-
-  /* empty caps on either side, return empty */
-  if (G_UNLIKELY (CAPS_IS_EMPTY (caps1) || CAPS_IS_EMPTY (caps2)))
-    return FALSE;
-
-  /* one of the caps is any */
-  if (G_UNLIKELY (CAPS_IS_ANY (caps1) || CAPS_IS_ANY (caps2)))
-    return TRUE;
-
   /* run zigzag on top line then right line, this preserves the caps order
    * much better than a simple loop.
    *
@@ -1601,6 +2045,49 @@ gst_caps_can_intersect (const GstCaps * caps1, const GstCaps * caps2)
   return FALSE;
 }
 
+/**
+ * gst_caps_can_intersect:
+ * @caps1: a #GstCaps to intersect
+ * @caps2: a #GstCaps to intersect
+ *
+ * Tries intersecting @caps1 and @caps2 and reports whether the result would not
+ * be empty
+ *
+ * Returns: %TRUE if intersection would be not empty
+ */
+gboolean
+gst_caps_can_intersect (const GstCaps * caps1, const GstCaps * caps2)
+{
+  gboolean res;
+  guint key;
+
+  g_return_val_if_fail (GST_IS_CAPS (caps1), FALSE);
+  g_return_val_if_fail (GST_IS_CAPS (caps2), FALSE);
+
+  /* caps are exactly the same pointers */
+  if (G_UNLIKELY (caps1 == caps2))
+    return TRUE;
+
+  /* empty caps on either side, return empty */
+  if (G_UNLIKELY (CAPS_IS_EMPTY (caps1) || CAPS_IS_EMPTY (caps2)))
+    return FALSE;
+
+  /* one of the caps is any */
+  if (G_UNLIKELY (CAPS_IS_ANY (caps1) || CAPS_IS_ANY (caps2)))
+    return TRUE;
+
+  if (gst_caps_cache_lookup (GST_CAPS_CACHE_CAN_INTERSECT, caps1, caps2, &key,
+          NULL, &res))
+    return res;
+
+  res = gst_caps_can_intersect_zig_zag (caps1, caps2);
+
+  gst_caps_cache_insert (key, GST_CAPS_CACHE_CAN_INTERSECT, caps1, caps2, NULL,
+      res);
+
+  return res;
+}
+
 static GstCaps *
 gst_caps_intersect_zig_zag (GstCaps * caps1, GstCaps * caps2)
 {
@@ -1745,6 +2232,10 @@ GstCaps *
 gst_caps_intersect_full (GstCaps * caps1, GstCaps * caps2,
     GstCapsIntersectMode mode)
 {
+  GstCapsCacheOp op;
+  GstCaps *result;
+  guint key;
+
   g_return_val_if_fail (GST_IS_CAPS (caps1), NULL);
   g_return_val_if_fail (GST_IS_CAPS (caps2), NULL);
 
@@ -1766,13 +2257,27 @@ gst_caps_intersect_full (GstCaps * caps1, GstCaps * caps2,
 
   switch (mode) {
     case GST_CAPS_INTERSECT_FIRST:
-      return gst_caps_intersect_first (caps1, caps2);
+      op = GST_CAPS_CACHE_INTERSECT_FIRST;
+      break;
     default:
       g_warning ("Unknown caps intersect mode: %d", mode);
       /* fallthrough */
     case GST_CAPS_INTERSECT_ZIG_ZAG:
-      return gst_caps_intersect_zig_zag (caps1, caps2);
+      op = GST_CAPS_CACHE_INTERSECT_ZIG_ZAG;
+      break;
   }
+
+  if (gst_caps_cache_lookup (op, caps1, caps2, &key, &result, NULL))
+    return result;
+
+  if (op == GST_CAPS_CACHE_INTERSECT_FIRST)
+    result = gst_caps_intersect_first (caps1, caps2);
+  else
+    result = gst_caps_intersect_zig_zag (caps1, caps2);
+
+  gst_caps_cache_insert (key, op, caps1, caps2, result, FALSE);
+
+  return result;
 }
 
 /**
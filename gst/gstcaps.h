@@ -536,6 +536,10 @@ gchar *           gst_caps_serialize               (const GstCaps *caps, GstSeri
 GST_API
 GstCaps *         gst_caps_from_string             (const gchar   *string) G_GNUC_WARN_UNUSED_RESULT;
 
+GST_API
+void              gst_caps_get_cache_stats         (guint *hits,
+                                                    guint *misses);
+
 G_DEFINE_AUTOPTR_CLEANUP_FUNC(GstCaps, gst_caps_unref)
 
 G_END_DECLS
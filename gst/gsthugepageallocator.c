@@ -0,0 +1,528 @@
+/* GStreamer
+ *
+ * gsthugepageallocator.c: allocator for big blocks backed by huge pages
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* The "HugePageMemory" allocator serves blocks of at least MIN_BLOCK_SIZE
+ * bytes, such as raw video frames, from mappings that are a multiple of the
+ * 2MB huge page size. Reserved huge pages of that size (MAP_HUGETLB) are
+ * used when available, otherwise the mapping is aligned to a huge page and
+ * transparent huge pages are requested. The pages of each block are bound
+ * to the NUMA node of the thread allocating it, which is usually the
+ * streaming thread that will fill it.
+ *
+ * Freed blocks are kept in a per-node arena and reused for allocations of
+ * the same size on that node. Smaller allocations are passed on to the
+ * system memory allocator.
+ *
+ * The arena usage can be retrieved with the "stats" property. The allocator
+ * can be made the default with gst_allocator_set_default() or by setting
+ * GST_DEFAULT_ALLOCATOR=HugePageMemory.
+ */
+
+#include "gst_private.h"
+
+#include "gstallocator.h"
+#include "gstinfo.h"
+#include "gstvalue.h"
+
+#if defined (__linux__) && defined (HAVE_MMAP)
+
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#define GST_HUGE_PAGE_ALLOCATOR_NAME "HugePageMemory"
+
+#define HUGE_PAGE_SIZE (2 * 1024 * 1024)
+#define MIN_BLOCK_SIZE (1024 * 1024)
+/* memory kept for reuse in each node arena */
+#define MAX_CACHED_PER_NODE (256 * 1024 * 1024)
+/* nodes that fit in the node mask */
+#define MAX_NODES 32
+
+#ifndef MPOL_PREFERRED
+#define MPOL_PREFERRED 1
+#endif
+
+/* MAP_HUGETLB alone uses the default huge page size of the system, which is
+ * not necessarily HUGE_PAGE_SIZE */
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+#ifndef MAP_HUGE_2MB
+#define MAP_HUGE_2MB (21 << MAP_HUGE_SHIFT)
+#endif
+
+typedef struct
+{
+  GstMemory mem;
+
+  guint8 *data;
+  /* size of the mapping, 0 for shared memory */
+  gsize block_size;
+  guint node;
+  gboolean hugetlb;
+} GstHugePageMemory;
+
+typedef struct
+{
+  GMutex lock;
+  /* GstHugePageMemory blocks ready for reuse */
+  GList *cached;
+  gsize cached_size;
+  gsize in_use;
+} GstHugePageArena;
+
+typedef struct
+{
+  GstAllocator parent;
+
+  GstAllocator *sysmem;
+  GstHugePageArena arenas[MAX_NODES];
+
+  /* ATOMIC */
+  gsize mapped;
+  gint hugetlb_blocks;
+} GstHugePageAllocator;
+
+typedef struct
+{
+  GstAllocatorClass parent_class;
+} GstHugePageAllocatorClass;
+
+enum
+{
+  PROP_0,
+  PROP_STATS,
+};
+
+static GType gst_huge_page_allocator_get_type (void);
+G_DEFINE_TYPE (GstHugePageAllocator, gst_huge_page_allocator,
+    GST_TYPE_ALLOCATOR);
+
+/* the NUMA node of the CPU the calling thread runs on */
+static guint
+current_node (void)
+{
+#ifdef SYS_getcpu
+  unsigned int cpu, node;
+
+  if (syscall (SYS_getcpu, &cpu, &node, NULL) == 0 && node < MAX_NODES)
+    return node;
+#endif
+
+  return 0;
+}
+
+static guint8 *
+map_block (gsize size, guint node, gboolean * hugetlb)
+{
+  guint8 *data, *aligned;
+  gsize head;
+
+#ifdef MAP_HUGETLB
+  data = mmap (NULL, size, PROT_READ | PROT_WRITE,
+      MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_HUGE_2MB, -1, 0);
+  if (data != MAP_FAILED) {
+    *hugetlb = TRUE;
+    goto bind;
+  }
+#endif
+
+  /* no reserved huge pages, map a huge page more than needed and trim the
+   * mapping so that it is aligned and transparent huge pages can be used */
+  data = mmap (NULL, size + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE,
+      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (data == MAP_FAILED)
+    goto map_failed;
+
+  aligned = (guint8 *) GST_ROUND_UP_N ((guintptr) data, HUGE_PAGE_SIZE);
+  head = aligned - data;
+  if (head > 0)
+    munmap (data, head);
+  munmap (aligned + size, HUGE_PAGE_SIZE - head);
+  data = aligned;
+  *hugetlb = FALSE;
+
+#ifdef MADV_HUGEPAGE
+  madvise (data, size, MADV_HUGEPAGE);
+#endif
+
+#ifdef MAP_HUGETLB
+bind:
+#endif
+#ifdef SYS_mbind
+  {
+    unsigned long mask = 1UL << node;
+
+    /* before any page is touched so that they are all placed on the node */
+    if (syscall (SYS_mbind, data, size, MPOL_PREFERRED, &mask,
+            sizeof (mask) * 8 + 1, 0) < 0)
+      GST_CAT_DEBUG (GST_CAT_MEMORY, "can't bind to node %u: %s", node,
+          g_strerror (errno));
+  }
+#endif
+
+  return data;
+
+  /* ERRORS */
+map_failed:
+  {
+    GST_CAT_WARNING (GST_CAT_MEMORY, "mmap of %" G_GSIZE_FORMAT " bytes "
+        "failed: %s", size, g_strerror (errno));
+    return NULL;
+  }
+}
+
+static void
+unmap_block (GstHugePageAllocator * self, GstHugePageMemory * mem)
+{
+  munmap (mem->data, mem->block_size);
+  g_atomic_pointer_add (&self->mapped, -(gssize) mem->block_size);
+  if (mem->hugetlb)
+    g_atomic_int_add (&self->hugetlb_blocks, -1);
+
+  g_slice_free (GstHugePageMemory, mem);
+}
+
+static GstMemory *
+gst_huge_page_allocator_alloc (GstAllocator * allocator, gsize size,
+    GstAllocationParams * params)
+{
+  GstHugePageAllocator *self = (GstHugePageAllocator *) allocator;
+  GstHugePageMemory *mem = NULL;
+  GstHugePageArena *arena;
+  gsize maxsize, block_size, align, padding;
+  guint node;
+  GList *walk;
+
+  maxsize = size + params->prefix + params->padding;
+  align = params->align | gst_memory_alignment;
+
+  /* the mappings are aligned to a huge page */
+  if (maxsize < MIN_BLOCK_SIZE || align >= HUGE_PAGE_SIZE)
+    return gst_allocator_alloc (self->sysmem, size, params);
+
+  block_size = GST_ROUND_UP_N (maxsize, HUGE_PAGE_SIZE);
+  node = current_node ();
+  arena = &self->arenas[node];
+
+  g_mutex_lock (&arena->lock);
+  for (walk = arena->cached; walk; walk = walk->next) {
+    GstHugePageMemory *cached = walk->data;
+
+    if (cached->block_size == block_size) {
+      arena->cached = g_list_delete_link (arena->cached, walk);
+      arena->cached_size -= block_size;
+      mem = cached;
+      break;
+    }
+  }
+  arena->in_use += block_size;
+  g_mutex_unlock (&arena->lock);
+
+  if (mem == NULL) {
+    gboolean hugetlb;
+    guint8 *data;
+
+    data = map_block (block_size, node, &hugetlb);
+    if (data == NULL)
+      goto no_memory;
+
+    mem = g_slice_new (GstHugePageMemory);
+    mem->data = data;
+    mem->block_size = block_size;
+    mem->node = node;
+    mem->hugetlb = hugetlb;
+
+    g_atomic_pointer_add (&self->mapped, block_size);
+    if (hugetlb)
+      g_atomic_int_inc (&self->hugetlb_blocks);
+
+    GST_CAT_DEBUG (GST_CAT_MEMORY, "mapped %" G_GSIZE_FORMAT " bytes on node "
+        "%u (%s)", block_size, node, hugetlb ? "hugetlb" : "transparent");
+  }
+
+  gst_memory_init (GST_MEMORY_CAST (mem), params->flags, allocator, NULL,
+      maxsize, align, params->prefix, size);
+
+  /* a reused block is not zeroed */
+  if (params->prefix && (params->flags & GST_MEMORY_FLAG_ZERO_PREFIXED))
+    memset (mem->data, 0, params->prefix);
+
+  padding = maxsize - (params->prefix + size);
+  if (padding && (params->flags & GST_MEMORY_FLAG_ZERO_PADDED))
+    memset (mem->data + params->prefix + size, 0, padding);
+
+  return GST_MEMORY_CAST (mem);
+
+  /* ERRORS */
+no_memory:
+  {
+    g_mutex_lock (&arena->lock);
+    arena->in_use -= block_size;
+    g_mutex_unlock (&arena->lock);
+    return NULL;
+  }
+}
+
+static void
+gst_huge_page_allocator_free (GstAllocator * allocator, GstMemory * memory)
+{
+  GstHugePageAllocator *self = (GstHugePageAllocator *) allocator;
+  GstHugePageMemory *mem = (GstHugePageMemory *) memory;
+  GstHugePageArena *arena;
+
+  if (mem->block_size == 0) {
+    g_slice_free (GstHugePageMemory, mem);
+    return;
+  }
+
+  arena = &self->arenas[mem->node];
+
+  g_mutex_lock (&arena->lock);
+  arena->in_use -= mem->block_size;
+  if (arena->cached_size + mem->block_size <= MAX_CACHED_PER_NODE) {
+    arena->cached = g_list_prepend (arena->cached, mem);
+    arena->cached_size += mem->block_size;
+    mem = NULL;
+  }
+  g_mutex_unlock (&arena->lock);
+
+  if (mem)
+    unmap_block (self, mem);
+}
+
+static gpointer
+gst_huge_page_mem_map (GstHugePageMemory * mem, gsize maxsize,
+    GstMapFlags flags)
+{
+  return mem->data;
+}
+
+static gboolean
+gst_huge_page_mem_unmap (GstHugePageMemory * mem)
+{
+  return TRUE;
+}
+
+static GstMemory *
+gst_huge_page_mem_copy (GstHugePageMemory * mem, gssize offset, gsize size)
+{
+  GstAllocationParams params = { 0, mem->mem.align, 0, 0, };
+  GstMemory *copy;
+  GstMapInfo info;
+
+  if (size == -1)
+    size = mem->mem.size > offset ? mem->mem.size - offset : 0;
+
+  copy = gst_allocator_alloc (mem->mem.allocator, size, &params);
+  if (copy == NULL)
+    return NULL;
+
+  if (!gst_memory_map (copy, &info, GST_MAP_WRITE)) {
+    gst_memory_unref (copy);
+    return NULL;
+  }
+
+  GST_CAT_DEBUG (GST_CAT_PERFORMANCE,
+      "memcpy %" G_GSIZE_FORMAT " memory %p -> %p", size, mem, copy);
+  memcpy (info.data, mem->data + mem->mem.offset + offset, size);
+  gst_memory_unmap (copy, &info);
+
+  return copy;
+}
+
+static GstHugePageMemory *
+gst_huge_page_mem_share (GstHugePageMemory * mem, gssize offset, gsize size)
+{
+  GstHugePageMemory *sub;
+  GstMemory *parent;
+
+  /* find the real parent */
+  if ((parent = mem->mem.parent) == NULL)
+    parent = (GstMemory *) mem;
+
+  if (size == -1)
+    size = mem->mem.size - offset;
+
+  /* the shared memory is always readonly */
+  sub = g_slice_new (GstHugePageMemory);
+  gst_memory_init (GST_MEMORY_CAST (sub), GST_MINI_OBJECT_FLAGS (parent) |
+      GST_MINI_OBJECT_FLAG_LOCK_READONLY, mem->mem.allocator, parent,
+      mem->mem.maxsize, mem->mem.align, mem->mem.offset + offset, size);
+  sub->data = mem->data;
+  sub->block_size = 0;
+  sub->node = mem->node;
+  sub->hugetlb = mem->hugetlb;
+
+  return sub;
+}
+
+static gboolean
+gst_huge_page_mem_is_span (GstHugePageMemory * mem1,
+    GstHugePageMemory * mem2, gsize * offset)
+{
+  if (offset) {
+    GstMemory *parent = mem1->mem.parent;
+
+    *offset = mem1->mem.offset - parent->offset;
+  }
+
+  /* and memory is contiguous */
+  return mem1->data + mem1->mem.offset + mem1->mem.size ==
+      mem2->data + mem2->mem.offset;
+}
+
+static GstStructure *
+gst_huge_page_allocator_get_stats (GstHugePageAllocator * self)
+{
+  GValue nodes = G_VALUE_INIT;
+  GValue val = G_VALUE_INIT;
+  GstStructure *stats;
+  guint64 node_in_use[MAX_NODES];
+  guint64 in_use = 0, cached = 0;
+  guint i, n_nodes = 1;
+
+  for (i = 0; i < MAX_NODES; i++) {
+    GstHugePageArena *arena = &self->arenas[i];
+
+    g_mutex_lock (&arena->lock);
+    node_in_use[i] = arena->in_use;
+    if (arena->in_use || arena->cached_size)
+      n_nodes = i + 1;
+    in_use += arena->in_use;
+    cached += arena->cached_size;
+    g_mutex_unlock (&arena->lock);
+  }
+
+  /* only report the nodes that were used */
+  gst_value_array_init (&nodes, n_nodes);
+  g_value_init (&val, G_TYPE_UINT64);
+  for (i = 0; i < n_nodes; i++) {
+    g_value_set_uint64 (&val, node_in_use[i]);
+    gst_value_array_append_value (&nodes, &val);
+  }
+  g_value_unset (&val);
+
+  stats = gst_structure_new ("GstHugePageAllocatorStats",
+      "mapped", G_TYPE_UINT64,
+      (guint64) (gsize) g_atomic_pointer_get (&self->mapped),
+      "in-use", G_TYPE_UINT64, in_use,
+      "cached", G_TYPE_UINT64, cached,
+      "hugetlb-blocks", G_TYPE_UINT,
+      (guint) g_atomic_int_get (&self->hugetlb_blocks), NULL);
+  gst_structure_take_value (stats, "node-in-use", &nodes);
+
+  return stats;
+}
+
+static void
+gst_huge_page_allocator_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec)
+{
+  GstHugePageAllocator *self = (GstHugePageAllocator *) object;
+
+  switch (prop_id) {
+    case PROP_STATS:
+      g_value_take_boxed (value, gst_huge_page_allocator_get_stats (self));
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+static void
+gst_huge_page_allocator_finalize (GObject * object)
+{
+  GstHugePageAllocator *self = (GstHugePageAllocator *) object;
+  guint i;
+
+  for (i = 0; i < MAX_NODES; i++) {
+    GstHugePageArena *arena = &self->arenas[i];
+
+    while (arena->cached) {
+      unmap_block (self, arena->cached->data);
+      arena->cached = g_list_delete_link (arena->cached, arena->cached);
+    }
+    g_mutex_clear (&arena->lock);
+  }
+
+  gst_object_unref (self->sysmem);
+
+  G_OBJECT_CLASS (gst_huge_page_allocator_parent_class)->finalize (object);
+}
+
+static void
+gst_huge_page_allocator_class_init (GstHugePageAllocatorClass * klass)
+{
+  GObjectClass *gobject_class = (GObjectClass *) klass;
+  GstAllocatorClass *allocator_class = (GstAllocatorClass *) klass;
+
+  gobject_class->get_property = gst_huge_page_allocator_get_property;
+  gobject_class->finalize = gst_huge_page_allocator_finalize;
+
+  g_object_class_install_property (gobject_class, PROP_STATS,
+      g_param_spec_boxed ("stats", "Statistics",
+          "Bytes mapped, in use and cached per NUMA node",
+          GST_TYPE_STRUCTURE, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  allocator_class->alloc = gst_huge_page_allocator_alloc;
+  allocator_class->free = gst_huge_page_allocator_free;
+}
+
+static void
+gst_huge_page_allocator_init (GstHugePageAllocator * self)
+{
+  GstAllocator *alloc = GST_ALLOCATOR_CAST (self);
+  guint i;
+
+  alloc->mem_type = GST_HUGE_PAGE_ALLOCATOR_NAME;
+  alloc->mem_map = (GstMemoryMapFunction) gst_huge_page_mem_map;
+  alloc->mem_unmap = (GstMemoryUnmapFunction) gst_huge_page_mem_unmap;
+  alloc->mem_copy = (GstMemoryCopyFunction) gst_huge_page_mem_copy;
+  alloc->mem_share = (GstMemoryShareFunction) gst_huge_page_mem_share;
+  alloc->mem_is_span = (GstMemoryIsSpanFunction) gst_huge_page_mem_is_span;
+
+  for (i = 0; i < MAX_NODES; i++)
+    g_mutex_init (&self->arenas[i].lock);
+}
+
+void
+_priv_gst_huge_page_allocator_initialize (GstAllocator * sysmem)
+{
+  GstHugePageAllocator *self;
+
+  self = g_object_new (gst_huge_page_allocator_get_type (), NULL);
+  gst_object_ref_sink (self);
+  self->sysmem = gst_object_ref (sysmem);
+
+  gst_allocator_register (GST_HUGE_PAGE_ALLOCATOR_NAME, GST_ALLOCATOR (self));
+}
+
+#else /* !__linux__ || !HAVE_MMAP */
+
+void
+_priv_gst_huge_page_allocator_initialize (GstAllocator * sysmem)
+{
+}
+
+#endif
@@ -104,6 +104,9 @@
 #  include <process.h>          /* getpid on win32 */
 #endif
 #include <string.h>             /* G_VA_COPY */
+#ifdef G_OS_UNIX
+#  include <signal.h>           /* sigaction for the asynchronous log */
+#endif
 #ifdef G_OS_WIN32
 #  define WIN32_LEAN_AND_MEAN   /* prevents from including too many things */
 #  include <windows.h>          /* GetStdHandle, windows console */
@@ -282,6 +285,8 @@ dladdr (void *address, Dl_info * dl)
 
 static void gst_debug_reset_threshold (gpointer category, gpointer unused);
 static void gst_debug_reset_all_thresholds (void);
+static void gst_debug_async_start (FILE * log_file);
+static void gst_debug_async_stop (void);
 
 struct _GstDebugMessage
 {
@@ -382,6 +387,10 @@ _priv_gst_debug_init (void)
     }
 
     gst_debug_add_log_function (gst_debug_log_default, log_file, NULL);
+
+    env = g_getenv ("GST_DEBUG_ASYNC");
+    if (env != NULL && *env != '\0' && strcmp (env, "0") != 0)
+      gst_debug_async_start (log_file);
   }
 
   __gst_printf_pointer_extension_set_func
@@ -1084,6 +1093,7 @@ gst_debug_construct_win_color (guint colorinfo)
 #define PID_FMT "%5d"
 #define CAT_FMT "%20s %s:%d:%s:%s"
 #define NOCOLOR_PRINT_FMT " "PID_FMT" "PTR_FMT" %s "CAT_FMT" %s\n"
+#define COLOR_PRINT_FMT " %s"PID_FMT"%s "PTR_FMT" %s%s%s %s"CAT_FMT"%s %s\n"
 
 #ifdef G_OS_WIN32
 static const guchar levelcolormap_w32[GST_LEVEL_COUNT] = {
@@ -1244,6 +1254,342 @@ _gst_debug_fprintf (FILE * file, const gchar * format, ...)
 }
 #endif
 
+/* Asynchronous output of gst_debug_log_default(), enabled with the
+ * GST_DEBUG_ASYNC environment variable.
+ *
+ * Instead of writing and flushing every line to the shared log file, the
+ * default log function formats the line into a ring buffer of the calling
+ * thread. Only that thread writes to the ring and only the writer thread reads
+ * from it, so logging takes no lock at all. The writer thread regularly drains
+ * all rings into the log file. Lines that don't fit into the ring of their
+ * thread are dropped and counted, and the writer notes the number of dropped
+ * lines in the log file.
+ *
+ * As a consequence, the lines of different threads are only ordered by their
+ * timestamps, not by their position in the log file anymore.
+ *
+ * The rings are drained synchronously after a line of level ERROR, at exit(),
+ * on gst_deinit() and, on UNIX, when the process aborts. The latter is best
+ * effort only, the SIGABRT handler uses stdio, which is not async-signal-safe.
+ * Lines that are still in the rings when the process is killed or crashes in
+ * any other way are lost.
+ */
+#define DEBUG_ASYNC_RING_SIZE (1 << 20)
+#define DEBUG_ASYNC_INTERVAL (50 * G_TIME_SPAN_MILLISECOND)
+
+typedef struct _GstDebugRing GstDebugRing;
+
+struct _GstDebugRing
+{
+  gint refcount;                /* ATOMIC, thread and writer */
+  gint orphaned;                /* ATOMIC, set when the thread exited */
+
+  gint head;                    /* ATOMIC, moved by the writer */
+  gint tail;                    /* ATOMIC, moved by the thread */
+  guint mask;
+  guint8 *data;
+
+  GString *scratch;             /* thread only */
+
+  /* protected by debug_async_lock */
+  GstDebugRing *next;
+};
+
+static FILE *debug_async_file = NULL;   /* ATOMIC */
+static GMutex debug_async_lock;
+static GCond debug_async_cond;
+static GThread *debug_async_thread = NULL;
+static gboolean debug_async_running = FALSE;
+static GstDebugRing *debug_async_rings = NULL;
+static gint debug_async_dropped = 0;    /* ATOMIC */
+static gint debug_async_reported = 0;
+#ifdef G_OS_UNIX
+static struct sigaction debug_async_old_sigabrt;
+#endif
+
+static void
+gst_debug_ring_unref (GstDebugRing * ring)
+{
+  if (g_atomic_int_dec_and_test (&ring->refcount)) {
+    g_string_free (ring->scratch, TRUE);
+    g_free (ring->data);
+    g_free (ring);
+  }
+}
+
+static void
+gst_debug_ring_orphan (gpointer data)
+{
+  GstDebugRing *ring = data;
+
+  g_atomic_int_set (&ring->orphaned, TRUE);
+  gst_debug_ring_unref (ring);
+}
+
+static GPrivate debug_ring_key = G_PRIVATE_INIT (gst_debug_ring_orphan);
+
+static GstDebugRing *
+gst_debug_ring_get (void)
+{
+  GstDebugRing *ring = g_private_get (&debug_ring_key);
+
+  if (G_LIKELY (ring != NULL))
+    return ring;
+
+  ring = g_new0 (GstDebugRing, 1);
+  ring->refcount = 2;
+  ring->data = g_malloc (DEBUG_ASYNC_RING_SIZE);
+  ring->mask = DEBUG_ASYNC_RING_SIZE - 1;
+  ring->scratch = g_string_sized_new (256);
+
+  g_mutex_lock (&debug_async_lock);
+  ring->next = debug_async_rings;
+  debug_async_rings = ring;
+  g_mutex_unlock (&debug_async_lock);
+
+  g_private_set (&debug_ring_key, ring);
+
+  return ring;
+}
+
+static gboolean
+gst_debug_ring_write (GstDebugRing * ring, const gchar * data, guint size)
+{
+  guint head, tail, offset, first;
+
+  tail = ring->tail;
+  head = g_atomic_int_get (&ring->head);
+
+  if (size > ring->mask + 1 - (tail - head))
+    return FALSE;
+
+  offset = tail & ring->mask;
+  first = MIN (size, ring->mask + 1 - offset);
+  memcpy (ring->data + offset, data, first);
+  memcpy (ring->data, data + first, size - first);
+
+  /* publish the line to the writer */
+  g_atomic_int_set (&ring->tail, tail + size);
+
+  return TRUE;
+}
+
+/* with debug_async_lock */
+static void
+gst_debug_ring_drain (GstDebugRing * ring, FILE * log_file)
+{
+  guint head, tail, size, offset, first;
+
+  head = ring->head;
+  tail = g_atomic_int_get (&ring->tail);
+  size = tail - head;
+  if (size == 0)
+    return;
+
+  offset = head & ring->mask;
+  first = MIN (size, ring->mask + 1 - offset);
+  fwrite (ring->data + offset, 1, first, log_file);
+  fwrite (ring->data, 1, size - first, log_file);
+
+  /* hand the space back to the thread */
+  g_atomic_int_set (&ring->head, tail);
+}
+
+/* with debug_async_lock */
+static void
+gst_debug_async_drain_all (FILE * log_file)
+{
+  GstDebugRing **prev = &debug_async_rings, *ring;
+  gint dropped;
+
+  while ((ring = *prev)) {
+    /* read the flag before draining, the thread doesn't write anymore once
+     * it is set */
+    gboolean orphaned = g_atomic_int_get (&ring->orphaned);
+
+    gst_debug_ring_drain (ring, log_file);
+
+    if (orphaned) {
+      *prev = ring->next;
+      gst_debug_ring_unref (ring);
+    } else {
+      prev = &ring->next;
+    }
+  }
+
+  dropped = g_atomic_int_get (&debug_async_dropped);
+  if (dropped != debug_async_reported) {
+    fprintf (log_file, "*** %d debug log lines dropped ***\n",
+        dropped - debug_async_reported);
+    debug_async_reported = dropped;
+  }
+
+  fflush (log_file);
+}
+
+/* Drains the rings of all threads from the calling thread. Lines logged by
+ * other threads while this runs may or may not be included. */
+static void
+gst_debug_async_flush (void)
+{
+  FILE *log_file;
+
+  g_mutex_lock (&debug_async_lock);
+  log_file = g_atomic_pointer_get (&debug_async_file);
+  if (log_file != NULL)
+    gst_debug_async_drain_all (log_file);
+  g_mutex_unlock (&debug_async_lock);
+}
+
+static gpointer
+gst_debug_async_writer (gpointer data)
+{
+  FILE *log_file = data;
+
+  g_mutex_lock (&debug_async_lock);
+  while (debug_async_running) {
+    gint64 end_time = g_get_monotonic_time () + DEBUG_ASYNC_INTERVAL;
+
+    g_cond_wait_until (&debug_async_cond, &debug_async_lock, end_time);
+    gst_debug_async_drain_all (log_file);
+  }
+  g_mutex_unlock (&debug_async_lock);
+
+  return NULL;
+}
+
+static void
+gst_debug_async_atexit (void)
+{
+  gst_debug_async_flush ();
+}
+
+#ifdef G_OS_UNIX
+static void
+gst_debug_async_sigabrt (int signum)
+{
+  FILE *log_file = g_atomic_pointer_get (&debug_async_file);
+
+  /* best effort: the aborting thread might hold the lock already, or another
+   * thread might be stuck while holding it */
+  if (log_file != NULL && g_mutex_trylock (&debug_async_lock)) {
+    gst_debug_async_drain_all (log_file);
+    g_mutex_unlock (&debug_async_lock);
+  }
+
+  /* let the previous handler or the default action deal with the signal once
+   * we return, the signal is blocked while its handler runs */
+  sigaction (SIGABRT, &debug_async_old_sigabrt, NULL);
+  raise (SIGABRT);
+}
+#endif
+
+static void
+gst_debug_async_start (FILE * log_file)
+{
+#ifdef G_OS_WIN32
+  /* the console needs the codepage handling of _gst_debug_fprintf() */
+  if (log_file == stderr || log_file == stdout)
+    return;
+#endif
+
+  debug_async_running = TRUE;
+  debug_async_thread = g_thread_new ("GstDebugWriter", gst_debug_async_writer,
+      log_file);
+
+#ifdef G_OS_UNIX
+  {
+    struct sigaction action;
+
+    memset (&action, 0, sizeof (action));
+    action.sa_handler = gst_debug_async_sigabrt;
+    sigemptyset (&action.sa_mask);
+    sigaction (SIGABRT, &action, &debug_async_old_sigabrt);
+  }
+#endif
+
+  g_atomic_pointer_set (&debug_async_file, log_file);
+  atexit (gst_debug_async_atexit);
+}
+
+static void
+gst_debug_async_stop (void)
+{
+  FILE *log_file = g_atomic_pointer_get (&debug_async_file);
+
+  if (log_file == NULL)
+    return;
+
+  g_mutex_lock (&debug_async_lock);
+  debug_async_running = FALSE;
+  g_cond_signal (&debug_async_cond);
+  g_mutex_unlock (&debug_async_lock);
+  g_thread_join (debug_async_thread);
+  debug_async_thread = NULL;
+
+#ifdef G_OS_UNIX
+  sigaction (SIGABRT, &debug_async_old_sigabrt, NULL);
+#endif
+
+  /* lines logged from now on are written directly again */
+  g_mutex_lock (&debug_async_lock);
+  gst_debug_async_drain_all (log_file);
+  g_atomic_pointer_set (&debug_async_file, NULL);
+  while (debug_async_rings) {
+    GstDebugRing *ring = debug_async_rings;
+
+    debug_async_rings = ring->next;
+    gst_debug_ring_unref (ring);
+  }
+  g_mutex_unlock (&debug_async_lock);
+
+  GST_CAT_INFO (GST_CAT_PERFORMANCE, "debug log: %d lines dropped",
+      g_atomic_int_get (&debug_async_dropped));
+}
+
+static void
+gst_debug_log_async (GstDebugCategory * category, GstDebugLevel level,
+    const gchar * file, const gchar * function, gint line,
+    const gchar * obj, const gchar * message_str, GstClockTime elapsed)
+{
+  GstDebugRing *ring = gst_debug_ring_get ();
+  gint pid = getpid ();
+
+#ifndef G_OS_WIN32
+  if (gst_debug_get_color_mode () != GST_DEBUG_COLOR_MODE_OFF) {
+    gchar *color;
+    const gchar *clear = "\033[00m";
+    gchar pidcolor[10];
+
+    color = gst_debug_construct_term_color (gst_debug_category_get_color
+        (category));
+    g_sprintf (pidcolor, "\033[%02dm", pid % 6 + 31);
+
+    g_string_printf (ring->scratch, "%" GST_TIME_FORMAT COLOR_PRINT_FMT,
+        GST_TIME_ARGS (elapsed), pidcolor, pid, clear, g_thread_self (),
+        levelcolormap[level], gst_debug_level_get_name (level), clear, color,
+        gst_debug_category_get_name (category), file, line, function, obj,
+        clear, message_str);
+    g_free (color);
+  } else
+#endif
+  {
+    /* there are no colors in files on windows */
+    g_string_printf (ring->scratch, "%" GST_TIME_FORMAT NOCOLOR_PRINT_FMT,
+        GST_TIME_ARGS (elapsed), pid, g_thread_self (),
+        gst_debug_level_get_name (level),
+        gst_debug_category_get_name (category), file, line, function, obj,
+        message_str);
+  }
+
+  if (!gst_debug_ring_write (ring, ring->scratch->str, ring->scratch->len))
+    g_atomic_int_inc (&debug_async_dropped);
+
+  /* errors often precede an abort, make sure they end up in the file */
+  if (level == GST_LEVEL_ERROR)
+    gst_debug_async_flush ();
+}
+
 /**
  * gst_debug_log_default:
  * @category: category to log
@@ -1265,6 +1611,10 @@ _gst_debug_fprintf (FILE * file, const gchar * format, ...)
  * You can add other handlers by using gst_debug_add_log_function().
  * And you can remove this handler by calling
  * gst_debug_remove_log_function(gst_debug_log_default);
+ *
+ * If the GST_DEBUG_ASYNC environment variable is set, messages for the log
+ * file set up by gst_init() are written to the file from a background thread
+ * instead of from the thread that logs them.
  */
 void
 gst_debug_log_default (GstDebugCategory * category, GstDebugLevel level,
@@ -1295,6 +1645,12 @@ gst_debug_log_default (GstDebugCategory * category, GstDebugLevel level,
   _gst_debug_log_preamble (message, object, &file, &message_str, &obj,
       &elapsed);
 
+  if (log_file == g_atomic_pointer_get (&debug_async_file)) {
+    gst_debug_log_async (category, level, file, function, line, obj,
+        message_str, elapsed);
+    goto done;
+  }
+
   pid = getpid ();
   color_mode = gst_debug_get_color_mode ();
 
@@ -1315,14 +1671,12 @@ gst_debug_log_default (GstDebugCategory * category, GstDebugLevel level,
       g_sprintf (pidcolor, "\033[%02dm", pid % 6 + 31);
       levelcolor = levelcolormap[level];
 
-#define PRINT_FMT " %s"PID_FMT"%s "PTR_FMT" %s%s%s %s"CAT_FMT"%s %s\n"
-      FPRINTF_DEBUG (log_file, "%" GST_TIME_FORMAT PRINT_FMT,
+      FPRINTF_DEBUG (log_file, "%" GST_TIME_FORMAT COLOR_PRINT_FMT,
           GST_TIME_ARGS (elapsed), pidcolor, pid, clear, g_thread_self (),
           levelcolor, gst_debug_level_get_name (level), clear, color,
           gst_debug_category_get_name (category), file, line, function, obj,
           clear, message_str);
       FFLUSH_DEBUG (log_file);
-#undef PRINT_FMT
       g_free (color);
 #ifdef G_OS_WIN32
     } else {
@@ -1365,6 +1719,7 @@ gst_debug_log_default (GstDebugCategory * category, GstDebugLevel level,
     FFLUSH_DEBUG (log_file);
   }
 
+done:
   if (object != NULL)
     g_free (obj);
 }
@@ -2201,6 +2556,8 @@ _gst_debug_register_funcptr (GstDebugFuncPtr func, const gchar * ptrname)
 void
 _priv_gst_debug_cleanup (void)
 {
+  gst_debug_async_stop ();
+
   g_mutex_lock (&__dbg_functions_mutex);
 
   if (__gst_function_pointers) {
@@ -3195,6 +3552,10 @@ typedef struct
   guint thread_timeout;
   GQueue threads;
   GHashTable *thread_index;
+
+  /* GST_DEBUG_RING_BUFFER_LOGGER_FLAG_DEFERRED */
+  gboolean deferred;
+  guint id;
 } GstRingBufferLogger;
 
 typedef struct
@@ -3205,10 +3566,617 @@ typedef struct
 
   GQueue log;
   gsize log_size;
+
+  /* in deferred mode, the log is a ring of max_size_per_thread bytes of
+   * entries instead, shared by the thread and the logger */
+  gint refcount;                /* ATOMIC */
+  guint logger_id;
+  GMutex lock;
+  /* protected by lock, as last_use */
+  gboolean removed;
+  guint8 *data;
+  gsize head, tail;
 } GstRingBufferLog;
 
 G_LOCK_DEFINE_STATIC (ring_buffer_logger);
 static GstRingBufferLogger *ring_buffer_logger = NULL;
+static guint ring_buffer_logger_id = 0;
+
+/* Deferred formatting
+ *
+ * With GST_DEBUG_RING_BUFFER_LOGGER_FLAG_DEFERRED, logging doesn't format the
+ * message. It stores the pointers to the category, file, function and format,
+ * a snapshot of the object and the arguments of the format as an entry in the
+ * ring of the calling thread. The lock of the ring is only ever contended by
+ * gst_debug_ring_buffer_logger_get_logs(), which formats the entries.
+ *
+ * An entry is a GstRingBufferEntry, followed by the object as string and one
+ * value per conversion of the format: a 64 bit integer for the integer
+ * conversions and %p, a double for the floating point conversions and a
+ * string for %s. Arguments of GST_PTR_FORMAT and the other printf extensions
+ * are formatted when logging, as what they point to might be gone by the time
+ * the logs are fetched, and stored as string. Strings are a 32 bit length
+ * followed by the bytes without terminator, a length of G_MAXUINT32 is a NULL
+ * string.
+ *
+ * Formats that can't be replayed like this (positional arguments, '*' widths,
+ * wide characters, ...) are formatted when logging and stored with a NULL
+ * format and the message as only string.
+ */
+typedef struct
+{
+  guint32 size;                 /* of the whole entry, first for skipping */
+  guint32 level;
+  gint32 line;
+  GstClockTime elapsed;
+  GstDebugCategory *category;
+  const gchar *file;
+  const gchar *function;
+  const gchar *format;
+} GstRingBufferEntry;
+
+typedef enum
+{
+  RING_ARG_INVALID,
+  RING_ARG_PERCENT,
+  RING_ARG_INT,
+  RING_ARG_LONG,
+  RING_ARG_LONG_LONG,
+  RING_ARG_SIZE,
+  RING_ARG_PTRDIFF,
+  RING_ARG_DOUBLE,
+  RING_ARG_STRING,
+  RING_ARG_POINTER,
+  RING_ARG_EXTENSION
+} GstRingBufferArg;
+
+/* longest conversion we replay, including the terminator */
+#define RING_ARG_MAX_SPEC 32
+
+static void
+gst_ring_buffer_log_unref (GstRingBufferLog * log)
+{
+  if (g_atomic_int_dec_and_test (&log->refcount)) {
+    g_mutex_clear (&log->lock);
+    g_free (log->data);
+    g_free (log);
+  }
+}
+
+/* the ring of the thread for the current logger and a scratch array to build
+ * the entries in */
+static GPrivate ring_buffer_log_key =
+G_PRIVATE_INIT ((GDestroyNotify) gst_ring_buffer_log_unref);
+static GPrivate ring_buffer_scratch_key =
+G_PRIVATE_INIT ((GDestroyNotify) g_byte_array_unref);
+
+/* Parses the conversion at @p, which points to a '%', and returns the type of
+ * its argument. Sets @end to the first character after the conversion unless
+ * it can't be deferred, and @precision to its precision or -1. */
+static GstRingBufferArg
+gst_ring_buffer_parse_conversion (const gchar * p, const gchar ** end,
+    gint * precision)
+{
+  GstRingBufferArg arg = RING_ARG_INT;
+  const gchar *start = p++;
+  gboolean modifier = TRUE;
+
+  *precision = -1;
+
+  if (*p == '%') {
+    *end = p + 1;
+    return RING_ARG_PERCENT;
+  }
+
+  /* flags, width and precision, but no '*' or positional arguments */
+  while (*p != '\0' && strchr ("-+ #0'I", *p))
+    p++;
+  while (g_ascii_isdigit (*p))
+    p++;
+  if (*p == '.') {
+    *precision = 0;
+    p++;
+    while (g_ascii_isdigit (*p)) {
+      if (*precision < G_MAXINT / 10)
+        *precision = *precision * 10 + (*p - '0');
+      p++;
+    }
+  }
+
+  switch (*p) {
+    case 'h':
+      p += (p[1] == 'h') ? 2 : 1;
+      break;
+    case 'l':
+      if (p[1] == 'l') {
+        arg = RING_ARG_LONG_LONG;
+        p += 2;
+      } else {
+        arg = RING_ARG_LONG;
+        p++;
+      }
+      break;
+    case 'q':
+      arg = RING_ARG_LONG_LONG;
+      p++;
+      break;
+    case 'z':
+    case 'Z':
+      arg = RING_ARG_SIZE;
+      p++;
+      break;
+    case 't':
+      arg = RING_ARG_PTRDIFF;
+      p++;
+      break;
+    default:
+      modifier = FALSE;
+      break;
+  }
+
+  switch (*p) {
+    case 'd':
+    case 'i':
+    case 'o':
+    case 'u':
+    case 'x':
+    case 'X':
+      break;
+    case 'c':
+      if (modifier)
+        return RING_ARG_INVALID;
+      break;
+    case 's':
+      if (modifier)
+        return RING_ARG_INVALID;
+      arg = RING_ARG_STRING;
+      break;
+    case 'e':
+    case 'E':
+    case 'f':
+    case 'F':
+    case 'g':
+    case 'G':
+    case 'a':
+    case 'A':
+      /* 'l' has no effect on doubles */
+      if (arg != RING_ARG_INT && arg != RING_ARG_LONG)
+        return RING_ARG_INVALID;
+      arg = RING_ARG_DOUBLE;
+      break;
+    case 'p':
+      if (modifier)
+        return RING_ARG_INVALID;
+      if (p[1] == '\a' && p[2] != '\0') {
+        *end = p + 3;
+        return RING_ARG_EXTENSION;
+      }
+      arg = RING_ARG_POINTER;
+      break;
+    default:
+      return RING_ARG_INVALID;
+  }
+
+  if (p + 1 - start >= RING_ARG_MAX_SPEC)
+    return RING_ARG_INVALID;
+
+  *end = p + 1;
+  return arg;
+}
+
+/* Appends @str, or at most @max_len bytes of it if @max_len is not -1. The
+ * string doesn't need to be terminated then, like for a %.4s conversion. */
+static void
+ring_append_string (GByteArray * array, const gchar * str, gint max_len)
+{
+  guint32 len = G_MAXUINT32;
+
+  if (str != NULL && max_len >= 0) {
+    const gchar *nul = memchr (str, '\0', max_len);
+
+    len = nul ? nul - str : max_len;
+  } else if (str != NULL) {
+    len = strlen (str);
+  }
+
+  g_byte_array_append (array, (const guint8 *) &len, sizeof (len));
+  if (str)
+    g_byte_array_append (array, (const guint8 *) str, len);
+}
+
+/* Stores the arguments for @format, returns FALSE if the format can't be
+ * deferred */
+static gboolean
+gst_ring_buffer_append_args (GByteArray * array, const gchar * format,
+    va_list args)
+{
+  const gchar *p, *end;
+  gint precision;
+  gint64 v;
+  gdouble d;
+
+  for (p = format; (p = strchr (p, '%')); p = end) {
+    switch (gst_ring_buffer_parse_conversion (p, &end, &precision)) {
+      case RING_ARG_PERCENT:
+        continue;
+      case RING_ARG_INT:
+        v = va_arg (args, gint);
+        break;
+      case RING_ARG_LONG:
+        v = va_arg (args, glong);
+        break;
+      case RING_ARG_LONG_LONG:
+        v = va_arg (args, long long);
+        break;
+      case RING_ARG_SIZE:
+        v = va_arg (args, gsize);
+        break;
+      case RING_ARG_PTRDIFF:
+        v = va_arg (args, ptrdiff_t);
+        break;
+      case RING_ARG_POINTER:
+        v = (guintptr) va_arg (args, gpointer);
+        break;
+      case RING_ARG_DOUBLE:
+        d = va_arg (args, gdouble);
+        g_byte_array_append (array, (const guint8 *) &d, sizeof (d));
+        continue;
+      case RING_ARG_STRING:
+        ring_append_string (array, va_arg (args, const gchar *), precision);
+        continue;
+      case RING_ARG_EXTENSION:{
+        gchar *str;
+
+        str = gst_info_printf_pointer_extension_func (end - 3,
+            va_arg (args, gpointer));
+        ring_append_string (array, str, -1);
+        g_free (str);
+        continue;
+      }
+      default:
+        return FALSE;
+    }
+    g_byte_array_append (array, (const guint8 *) &v, sizeof (v));
+  }
+
+  return TRUE;
+}
+
+static void
+ring_read (const guint8 ** data, gpointer dest, gsize len)
+{
+  memcpy (dest, *data, len);
+  *data += len;
+}
+
+/* returns a copy of the string at @data */
+static gchar *
+ring_read_string (const guint8 ** data)
+{
+  guint32 len;
+
+  ring_read (data, &len, sizeof (len));
+  if (len == G_MAXUINT32)
+    return NULL;
+
+  *data += len;
+  return g_strndup ((const gchar *) *data - len, len);
+}
+
+/* the conversions are taken from the format of the message */
+#ifdef __GNUC__
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wformat-nonliteral"
+#endif
+
+/* Appends the message for @format with the arguments stored at @data */
+static void
+gst_ring_buffer_format_args (GString * str, const gchar * format,
+    const guint8 ** data)
+{
+  gchar spec[RING_ARG_MAX_SPEC];
+  const gchar *p = format, *conv, *end;
+  gint64 v;
+  gdouble d;
+  gchar *s;
+
+  while ((conv = strchr (p, '%'))) {
+    gint precision;
+    GstRingBufferArg arg =
+        gst_ring_buffer_parse_conversion (conv, &end, &precision);
+
+    g_string_append_len (str, p, conv - p);
+    memcpy (spec, conv, end - conv);
+    spec[end - conv] = '\0';
+    p = end;
+
+    switch (arg) {
+      case RING_ARG_PERCENT:
+        g_string_append_c (str, '%');
+        continue;
+      case RING_ARG_DOUBLE:
+        ring_read (data, &d, sizeof (d));
+        g_string_append_printf (str, spec, d);
+        continue;
+      case RING_ARG_STRING:
+        s = ring_read_string (data);
+        g_string_append_printf (str, spec, s ? s : "(null)");
+        g_free (s);
+        continue;
+      case RING_ARG_EXTENSION:
+        s = ring_read_string (data);
+        g_string_append (str, s);
+        g_free (s);
+        continue;
+      default:
+        break;
+    }
+
+    ring_read (data, &v, sizeof (v));
+    switch (arg) {
+      case RING_ARG_INT:
+        g_string_append_printf (str, spec, (gint) v);
+        break;
+      case RING_ARG_LONG:
+        g_string_append_printf (str, spec, (glong) v);
+        break;
+      case RING_ARG_LONG_LONG:
+        g_string_append_printf (str, spec, (long long) v);
+        break;
+      case RING_ARG_SIZE:
+        g_string_append_printf (str, spec, (gsize) v);
+        break;
+      case RING_ARG_PTRDIFF:
+        g_string_append_printf (str, spec, (ptrdiff_t) v);
+        break;
+      case RING_ARG_POINTER:
+        g_string_append_printf (str, spec, (gpointer) (guintptr) v);
+        break;
+      default:
+        g_assert_not_reached ();
+        break;
+    }
+  }
+
+  g_string_append (str, p);
+}
+
+#ifdef __GNUC__
+#pragma GCC diagnostic pop
+#endif
+
+/* with the ring_buffer_logger lock */
+static void
+gst_ring_buffer_logger_expire (GstRingBufferLogger * logger, gint64 now)
+{
+  GList *l, *next;
+
+  if (logger->thread_timeout == 0)
+    return;
+
+  for (l = logger->threads.head; l; l = next) {
+    GstRingBufferLog *log = l->data;
+    gboolean expired;
+
+    next = l->next;
+
+    g_mutex_lock (&log->lock);
+    expired = log->last_use + logger->thread_timeout * G_USEC_PER_SEC < now;
+    if (expired)
+      log->removed = TRUE;
+    g_mutex_unlock (&log->lock);
+
+    if (expired) {
+      g_queue_delete_link (&logger->threads, l);
+      gst_ring_buffer_log_unref (log);
+    }
+  }
+}
+
+/* Returns the locked ring of the calling thread, or NULL if the logger is
+ * being removed */
+static GstRingBufferLog *
+gst_ring_buffer_logger_get_log (GstRingBufferLogger * logger, gint64 now)
+{
+  GstRingBufferLog *log = g_private_get (&ring_buffer_log_key);
+
+  if (log != NULL) {
+    g_mutex_lock (&log->lock);
+    if (log->logger_id == logger->id && !log->removed)
+      return log;
+    g_mutex_unlock (&log->lock);
+  }
+
+  log = g_new0 (GstRingBufferLog, 1);
+  log->refcount = 2;
+  log->thread = g_thread_self ();
+  log->logger_id = logger->id;
+  log->last_use = now;
+  log->data = g_malloc (logger->max_size_per_thread);
+  g_mutex_init (&log->lock);
+
+  G_LOCK (ring_buffer_logger);
+  if (ring_buffer_logger != logger) {
+    G_UNLOCK (ring_buffer_logger);
+    log->refcount = 1;
+    gst_ring_buffer_log_unref (log);
+    return NULL;
+  }
+  gst_ring_buffer_logger_expire (logger, now);
+  g_queue_push_head (&logger->threads, log);
+  G_UNLOCK (ring_buffer_logger);
+
+  /* drops the ring of a previous logger, if any */
+  g_private_replace (&ring_buffer_log_key, log);
+
+  g_mutex_lock (&log->lock);
+  return log;
+}
+
+/* with log->lock */
+static void
+gst_ring_buffer_log_read (GstRingBufferLog * log, gsize size, gsize pos,
+    gpointer dest, gsize len)
+{
+  gsize offset = pos % size, first = MIN (len, size - offset);
+
+  memcpy (dest, log->data + offset, first);
+  memcpy ((guint8 *) dest + first, log->data, len - first);
+}
+
+/* with log->lock */
+static void
+gst_ring_buffer_log_push (GstRingBufferLog * log, gsize size,
+    const guint8 * entry, gsize len)
+{
+  gsize offset, first;
+
+  if (len > size) {
+    /* Can't really write anything as the entry is bigger than the maximum
+     * allowed log size already, so just remove everything */
+    log->head = log->tail;
+    return;
+  }
+
+  while (log->tail - log->head + len > size) {
+    guint32 old_size;
+
+    gst_ring_buffer_log_read (log, size, log->head, &old_size,
+        sizeof (old_size));
+    log->head += old_size;
+  }
+
+  offset = log->tail % size;
+  first = MIN (len, size - offset);
+  memcpy (log->data + offset, entry, first);
+  memcpy (log->data, entry + first, len - first);
+  log->tail += len;
+}
+
+static void
+gst_ring_buffer_logger_log_deferred (GstRingBufferLogger * logger,
+    GstDebugCategory * category, GstDebugLevel level, const gchar * file,
+    const gchar * function, gint line, GObject * object,
+    GstDebugMessage * message)
+{
+  GstRingBufferEntry entry;
+  GstRingBufferLog *log;
+  GByteArray *array;
+  gchar *obj;
+  gchar c;
+  guint args_offset;
+  va_list args;
+  gboolean deferred;
+  gint64 now = g_get_monotonic_time ();
+
+  /* take the scratch array of the thread, messages logged while formatting
+   * the object or an argument below get a new one */
+  array = g_private_get (&ring_buffer_scratch_key);
+  if (array != NULL)
+    g_private_set (&ring_buffer_scratch_key, NULL);
+  else
+    array = g_byte_array_sized_new (256);
+  g_byte_array_set_size (array, sizeof (entry));
+
+  /* same as in gst_ring_buffer_logger_log() */
+  c = file[0];
+  if (c == '.' || c == '/' || c == '\\' || (c != '\0' && file[1] == ':')) {
+    file = gst_path_basename (file);
+  }
+
+  entry.level = level;
+  entry.line = line;
+  entry.elapsed =
+      GST_CLOCK_DIFF (_priv_gst_start_time, gst_util_get_timestamp ());
+  entry.category = category;
+  entry.file = file;
+  entry.function = function;
+  entry.format = message->format;
+
+  obj = object ? gst_debug_print_object (object) : NULL;
+  ring_append_string (array, obj ? obj : "", -1);
+  g_free (obj);
+
+  args_offset = array->len;
+  G_VA_COPY (args, message->arguments);
+  deferred = gst_ring_buffer_append_args (array, message->format, args);
+  va_end (args);
+
+  if (!deferred) {
+    g_byte_array_set_size (array, args_offset);
+    entry.format = NULL;
+    ring_append_string (array, gst_debug_message_get (message), -1);
+  }
+
+  entry.size = array->len;
+  memcpy (array->data, &entry, sizeof (entry));
+
+  log = gst_ring_buffer_logger_get_log (logger, now);
+  if (log != NULL) {
+    log->last_use = now;
+    gst_ring_buffer_log_push (log, logger->max_size_per_thread, array->data,
+        array->len);
+    g_mutex_unlock (&log->lock);
+  }
+
+  /* frees the array of a nested message, if any */
+  g_private_replace (&ring_buffer_scratch_key, array);
+}
+
+/* Formats all entries of @log */
+static gchar *
+gst_ring_buffer_log_format (GstRingBufferLog * log, gsize size)
+{
+  GString *str, *msg;
+  const guint8 *p, *end;
+  guint8 *data;
+  gsize len;
+  gint pid = getpid ();
+
+  /* copy the entries so the thread can go on logging while formatting */
+  g_mutex_lock (&log->lock);
+  len = log->tail - log->head;
+  data = g_malloc (len);
+  gst_ring_buffer_log_read (log, size, log->head, data, len);
+  g_mutex_unlock (&log->lock);
+
+  str = g_string_sized_new (2 * len);
+  msg = g_string_new (NULL);
+
+  for (p = data, end = data + len; p < end;) {
+    GstRingBufferEntry entry;
+    const guint8 *args;
+    gchar *obj;
+
+    memcpy (&entry, p, sizeof (entry));
+    args = p + sizeof (entry);
+    p += entry.size;
+
+    obj = ring_read_string (&args);
+    g_string_truncate (msg, 0);
+    if (entry.format != NULL) {
+      gst_ring_buffer_format_args (msg, entry.format, &args);
+    } else {
+      gchar *message_str = ring_read_string (&args);
+
+      g_string_append (msg, message_str);
+      g_free (message_str);
+    }
+
+    /* no color, all platforms */
+    g_string_append_printf (str, "%" GST_TIME_FORMAT NOCOLOR_PRINT_FMT,
+        GST_TIME_ARGS (entry.elapsed), pid, log->thread,
+        gst_debug_level_get_name (entry.level),
+        gst_debug_category_get_name (entry.category), entry.file, entry.line,
+        entry.function, obj, msg->str);
+    g_free (obj);
+  }
+
+  g_string_free (msg, TRUE);
+  g_free (data);
+
+  return g_string_free (str, FALSE);
+}
 
 static void
 gst_ring_buffer_logger_log (GstDebugCategory * category,
@@ -3226,8 +4194,17 @@ gst_ring_buffer_logger_log (GstDebugCategory * category,
   gchar *output;
   gsize output_len;
   GstRingBufferLog *log;
-  gint64 now = g_get_monotonic_time ();
-  const gchar *message_str = gst_debug_message_get (message);
+  gint64 now;
+  const gchar *message_str;
+
+  if (logger->deferred) {
+    gst_ring_buffer_logger_log_deferred (logger, category, level, file,
+        function, line, object, message);
+    return;
+  }
+
+  now = g_get_monotonic_time ();
+  message_str = gst_debug_message_get (message);
 
   /* __FILE__ might be a file name or an absolute path or a
    * relative path, irrespective of the exact compiler used,
@@ -3355,6 +4332,19 @@ gst_debug_ring_buffer_logger_get_logs (void)
 
   G_LOCK (ring_buffer_logger);
 
+  if (ring_buffer_logger->deferred) {
+    gst_ring_buffer_logger_expire (ring_buffer_logger,
+        g_get_monotonic_time ());
+
+    tmp = logs = g_new0 (gchar *, ring_buffer_logger->threads.length + 1);
+    for (l = ring_buffer_logger->threads.head; l; l = l->next)
+      *tmp++ = gst_ring_buffer_log_format (l->data,
+          ring_buffer_logger->max_size_per_thread);
+
+    G_UNLOCK (ring_buffer_logger);
+    return logs;
+  }
+
   tmp = logs = g_new0 (gchar *, ring_buffer_logger->threads.length + 1);
   for (l = ring_buffer_logger->threads.head; l; l = l->next) {
     GstRingBufferLog *log = l->data;
@@ -3387,6 +4377,16 @@ gst_ring_buffer_logger_free (GstRingBufferLogger * logger)
 
     while ((log = g_queue_pop_head (&logger->threads))) {
       gchar *buf;
+
+      if (logger->deferred) {
+        /* the thread might still hold a reference */
+        g_mutex_lock (&log->lock);
+        log->removed = TRUE;
+        g_mutex_unlock (&log->lock);
+        gst_ring_buffer_log_unref (log);
+        continue;
+      }
+
       while ((buf = g_queue_pop_head (&log->log)))
         g_free (buf);
       g_free (log);
@@ -3418,6 +4418,37 @@ gst_ring_buffer_logger_free (GstRingBufferLogger * logger)
 void
 gst_debug_add_ring_buffer_logger (guint max_size_per_thread,
     guint thread_timeout)
+{
+  gst_debug_add_ring_buffer_logger_full (max_size_per_thread, thread_timeout,
+      GST_DEBUG_RING_BUFFER_LOGGER_FLAG_NONE);
+}
+
+/**
+ * gst_debug_add_ring_buffer_logger_full:
+ * @max_size_per_thread: Maximum size of log per thread in bytes
+ * @thread_timeout: Timeout for threads in seconds
+ * @flags: #GstDebugRingBufferLoggerFlags
+ *
+ * Like gst_debug_add_ring_buffer_logger(), with @flags.
+ *
+ * With %GST_DEBUG_RING_BUFFER_LOGGER_FLAG_DEFERRED, the messages are not
+ * formatted when they are logged but only when the logs are fetched with
+ * gst_debug_ring_buffer_logger_get_logs(), and threads don't serialize on a
+ * global lock for logging. This makes it cheap enough to keep verbose logging
+ * to the ring buffer enabled all the time. @max_size_per_thread then is the
+ * size of the arguments of the messages that are kept, which is usually less
+ * than the size of the formatted messages. The memory for it is allocated
+ * for each thread once it logs its first message.
+ *
+ * In deferred mode, the format string, the file and the function name of the
+ * messages need to stay valid until the logger is removed, as is the case for
+ * the string literals used by the GST_* logging macros.
+ *
+ * Since: 1.20
+ */
+void
+gst_debug_add_ring_buffer_logger_full (guint max_size_per_thread,
+    guint thread_timeout, GstDebugRingBufferLoggerFlags flags)
 {
   GstRingBufferLogger *logger;
 
@@ -3433,6 +4464,8 @@ gst_debug_add_ring_buffer_logger (guint max_size_per_thread,
 
   logger->max_size_per_thread = max_size_per_thread;
   logger->thread_timeout = thread_timeout;
+  logger->deferred = (flags & GST_DEBUG_RING_BUFFER_LOGGER_FLAG_DEFERRED) != 0;
+  logger->id = ++ring_buffer_logger_id;
   logger->thread_index = g_hash_table_new (g_direct_hash, g_direct_equal);
   g_queue_init (&logger->threads);
 
@@ -3470,6 +4503,12 @@ gst_debug_add_ring_buffer_logger (guint max_size_per_thread,
 {
 }
 
+void
+gst_debug_add_ring_buffer_logger_full (guint max_size_per_thread,
+    guint thread_timeout, GstDebugRingBufferLoggerFlags flags)
+{
+}
+
 void
 gst_debug_remove_ring_buffer_logger (void)
 {
@@ -191,6 +191,21 @@ typedef enum {
     GST_STACK_TRACE_SHOW_FULL = 1 << 0
 } GstStackTraceFlags;
 
+/**
+ * GstDebugRingBufferLoggerFlags:
+ * @GST_DEBUG_RING_BUFFER_LOGGER_FLAG_NONE: No flags
+ * @GST_DEBUG_RING_BUFFER_LOGGER_FLAG_DEFERRED: Store the arguments of the
+ *     messages and only format them in gst_debug_ring_buffer_logger_get_logs()
+ *
+ * Flags for gst_debug_add_ring_buffer_logger_full().
+ *
+ * Since: 1.20
+ */
+typedef enum {
+    GST_DEBUG_RING_BUFFER_LOGGER_FLAG_NONE = 0,
+    GST_DEBUG_RING_BUFFER_LOGGER_FLAG_DEFERRED = 1 << 0
+} GstDebugRingBufferLoggerFlags;
+
 /**
  * GstDebugColorMode:
  * @GST_DEBUG_COLOR_MODE_OFF: Do not use colors in logs.
@@ -1793,6 +1808,9 @@ gchar * gst_debug_get_stack_trace (GstStackTraceFlags flags);
 GST_API
 void                  gst_debug_add_ring_buffer_logger      (guint max_size_per_thread, guint thread_timeout);
 GST_API
+void                  gst_debug_add_ring_buffer_logger_full (guint max_size_per_thread, guint thread_timeout,
+                                                             GstDebugRingBufferLoggerFlags flags);
+GST_API
 void                  gst_debug_remove_ring_buffer_logger   (void);
 GST_API
 gchar **              gst_debug_ring_buffer_logger_get_logs (void);
@@ -0,0 +1,332 @@
+/* GStreamer
+ *
+ * gstmagazine.c: per-thread cache of small slices
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* The buffer structs, their meta items and small system memory blocks are
+ * allocated and freed at a very high rate from all streaming threads. They
+ * are kept in per-thread magazines: arrays of free slices of one size class
+ * that can be used without any locking. Each thread has a loaded and a
+ * previous magazine per size class. Only when both are empty (on alloc) or
+ * full (on free) a whole magazine is exchanged with the depot of the size
+ * class under a lock. That way slices freed in another thread than the one
+ * they were allocated in migrate between threads in bulk.
+ *
+ * Slices bigger than the biggest size class go straight to g_slice. The
+ * cache is disabled when G_SLICE=always-malloc is set, so that memory
+ * debugging tools still see every allocation, or with GST_MAGAZINE_CACHE=0.
+ */
+
+#include "gst_private.h"
+
+#include <string.h>
+
+#include "gstinfo.h"
+
+/* number of slices in one magazine */
+#define MAGAZINE_SIZE 32
+/* number of magazines kept in the depot of each size class */
+#define DEPOT_MAX_FULL 16
+#define DEPOT_MAX_EMPTY 16
+
+/* 64 byte steps up to 1024 bytes, then 1024 byte steps up to 4096 */
+#define N_CLASSES 19
+#define MAX_CLASS_SIZE 4096
+
+typedef struct
+{
+  guint n_rounds;
+  gpointer rounds[MAGAZINE_SIZE];
+} GstMagazine;
+
+typedef struct
+{
+  GstMagazine *loaded;
+  GstMagazine *previous;
+  guint64 hits;
+  guint64 misses;
+} GstMagazineCache;
+
+typedef struct
+{
+  GMutex lock;
+  GstMagazine *full[DEPOT_MAX_FULL];
+  guint n_full;
+  GstMagazine *empty[DEPOT_MAX_EMPTY];
+  guint n_empty;
+  /* counters folded in from the threads on every exchange */
+  guint64 hits;
+  guint64 misses;
+} GstMagazineDepot;
+
+static gboolean magazines_enabled = FALSE;
+static GstMagazineDepot depots[N_CLASSES];
+
+static void gst_magazine_caches_free (GstMagazineCache * caches);
+
+static GPrivate thread_caches =
+G_PRIVATE_INIT ((GDestroyNotify) gst_magazine_caches_free);
+
+static inline guint
+class_index (gsize size)
+{
+  if (size <= 1024)
+    return size ? (size - 1) / 64 : 0;
+
+  return 15 + (size - 1) / 1024;
+}
+
+static inline gsize
+class_size (guint idx)
+{
+  if (idx < 16)
+    return (idx + 1) * 64;
+
+  return (idx - 14) * 1024;
+}
+
+static inline GstMagazineCache *
+get_thread_caches (void)
+{
+  GstMagazineCache *caches = g_private_get (&thread_caches);
+
+  if (G_UNLIKELY (caches == NULL)) {
+    caches = g_new0 (GstMagazineCache, N_CLASSES);
+    g_private_set (&thread_caches, caches);
+  }
+  return caches;
+}
+
+static void
+magazine_free_rounds (GstMagazine * mag, guint idx)
+{
+  gsize size = class_size (idx);
+
+  while (mag->n_rounds > 0)
+    g_slice_free1 (size, mag->rounds[--mag->n_rounds]);
+}
+
+/* put @mag back into the depot. Must be called with the depot lock */
+static void
+depot_put_unlocked (GstMagazineDepot * depot, GstMagazine * mag, guint idx)
+{
+  if (mag->n_rounds > 0) {
+    if (depot->n_full < DEPOT_MAX_FULL) {
+      depot->full[depot->n_full++] = mag;
+      return;
+    }
+    /* the depot is full, give the slices back */
+    magazine_free_rounds (mag, idx);
+  }
+
+  if (depot->n_empty < DEPOT_MAX_EMPTY)
+    depot->empty[depot->n_empty++] = mag;
+  else
+    g_free (mag);
+}
+
+static void
+depot_fold_counters_unlocked (GstMagazineDepot * depot,
+    GstMagazineCache * cache)
+{
+  depot->hits += cache->hits;
+  depot->misses += cache->misses;
+  cache->hits = cache->misses = 0;
+}
+
+/* replace the empty loaded magazine of @cache with a full one from the
+ * depot. Returns FALSE when the depot has no full magazines */
+static gboolean
+depot_exchange_full (guint idx, GstMagazineCache * cache)
+{
+  GstMagazineDepot *depot = &depots[idx];
+  gboolean res = FALSE;
+
+  g_mutex_lock (&depot->lock);
+  depot_fold_counters_unlocked (depot, cache);
+  if (depot->n_full > 0) {
+    if (cache->loaded)
+      depot_put_unlocked (depot, cache->loaded, idx);
+    cache->loaded = depot->full[--depot->n_full];
+    res = TRUE;
+  }
+  g_mutex_unlock (&depot->lock);
+
+  return res;
+}
+
+/* replace the full loaded magazine of @cache with an empty one */
+static void
+depot_exchange_empty (guint idx, GstMagazineCache * cache)
+{
+  GstMagazineDepot *depot = &depots[idx];
+  GstMagazine *mag = NULL;
+
+  g_mutex_lock (&depot->lock);
+  depot_fold_counters_unlocked (depot, cache);
+  if (cache->loaded)
+    depot_put_unlocked (depot, cache->loaded, idx);
+  if (depot->n_empty > 0)
+    mag = depot->empty[--depot->n_empty];
+  g_mutex_unlock (&depot->lock);
+
+  if (mag == NULL)
+    mag = g_new (GstMagazine, 1);
+  mag->n_rounds = 0;
+
+  cache->loaded = mag;
+}
+
+/* called when a thread exits */
+static void
+gst_magazine_caches_free (GstMagazineCache * caches)
+{
+  guint i;
+
+  for (i = 0; i < N_CLASSES; i++) {
+    GstMagazineCache *cache = &caches[i];
+    GstMagazineDepot *depot = &depots[i];
+
+    g_mutex_lock (&depot->lock);
+    depot_fold_counters_unlocked (depot, cache);
+    if (cache->loaded)
+      depot_put_unlocked (depot, cache->loaded, i);
+    if (cache->previous)
+      depot_put_unlocked (depot, cache->previous, i);
+    g_mutex_unlock (&depot->lock);
+  }
+  g_free (caches);
+}
+
+/* allocate a slice of @size bytes, like g_slice_alloc() */
+gpointer
+_priv_gst_magazine_alloc (gsize size)
+{
+  GstMagazineCache *cache;
+  guint idx;
+
+  if (G_UNLIKELY (!magazines_enabled || size > MAX_CLASS_SIZE))
+    return g_slice_alloc (size);
+
+  idx = class_index (size);
+  cache = &get_thread_caches ()[idx];
+
+  if (G_LIKELY (cache->loaded && cache->loaded->n_rounds > 0))
+    goto hit;
+
+  if (cache->previous && cache->previous->n_rounds > 0) {
+    GstMagazine *tmp = cache->loaded;
+
+    cache->loaded = cache->previous;
+    cache->previous = tmp;
+    goto hit;
+  }
+
+  if (depot_exchange_full (idx, cache))
+    goto hit;
+
+  cache->misses++;
+  return g_slice_alloc (class_size (idx));
+
+hit:
+  cache->hits++;
+  return cache->loaded->rounds[--cache->loaded->n_rounds];
+}
+
+/* free a slice allocated with _priv_gst_magazine_alloc(), like
+ * g_slice_free1() */
+void
+_priv_gst_magazine_free (gsize size, gpointer mem)
+{
+  GstMagazineCache *cache;
+  guint idx;
+
+  if (G_UNLIKELY (!magazines_enabled || size > MAX_CLASS_SIZE)) {
+    g_slice_free1 (size, mem);
+    return;
+  }
+
+  idx = class_index (size);
+  cache = &get_thread_caches ()[idx];
+
+  if (G_LIKELY (cache->loaded && cache->loaded->n_rounds < MAGAZINE_SIZE))
+    goto put;
+
+  if (cache->previous == NULL || cache->previous->n_rounds < MAGAZINE_SIZE) {
+    GstMagazine *tmp = cache->loaded;
+
+    cache->loaded = cache->previous;
+    cache->previous = tmp;
+    if (cache->loaded && cache->loaded->n_rounds < MAGAZINE_SIZE)
+      goto put;
+  }
+
+  depot_exchange_empty (idx, cache);
+
+put:
+  cache->loaded->rounds[cache->loaded->n_rounds++] = mem;
+}
+
+void
+_priv_gst_magazine_initialize (void)
+{
+  const gchar *env;
+
+  magazines_enabled = TRUE;
+
+  env = g_getenv ("G_SLICE");
+  if (env && strstr (env, "always-malloc"))
+    magazines_enabled = FALSE;
+
+  env = g_getenv ("GST_MAGAZINE_CACHE");
+  if (env && (!strcmp (env, "0") || !g_ascii_strcasecmp (env, "no")))
+    magazines_enabled = FALSE;
+
+  GST_CAT_DEBUG (GST_CAT_PERFORMANCE, "slice magazines %s",
+      magazines_enabled ? "enabled" : "disabled");
+}
+
+void
+_priv_gst_magazine_cleanup (void)
+{
+  guint i;
+
+  /* flush the cache of the calling thread, those of other threads are
+   * flushed when they exit */
+  g_private_replace (&thread_caches, NULL);
+
+  for (i = 0; i < N_CLASSES; i++) {
+    GstMagazineDepot *depot = &depots[i];
+
+    g_mutex_lock (&depot->lock);
+    if (depot->hits || depot->misses)
+      GST_CAT_INFO (GST_CAT_PERFORMANCE, "slice magazine %" G_GSIZE_FORMAT
+          ": %" G_GUINT64_FORMAT " hits, %" G_GUINT64_FORMAT " misses",
+          class_size (i), depot->hits, depot->misses);
+
+    while (depot->n_full > 0) {
+      GstMagazine *mag = depot->full[--depot->n_full];
+
+      magazine_free_rounds (mag, i);
+      g_free (mag);
+    }
+    while (depot->n_empty > 0)
+      g_free (depot->empty[--depot->n_empty]);
+    g_mutex_unlock (&depot->lock);
+  }
+}
@@ -132,6 +132,8 @@ typedef struct
   GstEvent *event;
 } PadEvent;
 
+typedef struct _GstProbeArray GstProbeArray;
+
 struct _GstPadPrivate
 {
   guint events_cookie;
@@ -140,6 +142,9 @@ struct _GstPadPrivate
 
   gint using;
   guint probe_list_cookie;
+  /* the probes in an array per data type, rebuilt after probes were added
+   * or removed */
+  GstProbeArray *probe_array;
 
   /* counter of how many idle probes are running directly from the add_probe
    * call. Used to block any data flowing in the pad while the idle callback
@@ -160,6 +165,11 @@ typedef struct
 #define GST_PAD_IS_RUNNING_IDLE_PROBE(p) \
     (((GstPad *)(p))->priv->idle_running > 0)
 
+/* the streaming threads store the last flow return without holding the
+ * object lock, so it is always accessed atomically */
+#define SET_LAST_FLOW_RETURN(pad,ret) \
+    g_atomic_int_set ((gint *) & (pad)->ABI.abi.last_flowret, (ret))
+
 typedef struct
 {
   GstPad *pad;
@@ -195,6 +205,8 @@ static GstFlowReturn gst_pad_push_event_unchecked (GstPad * pad,
 static gboolean activate_mode_internal (GstPad * pad, GstObject * parent,
     GstPadMode mode, gboolean active);
 
+static void probe_array_clear (GstPad * pad);
+
 static guint gst_pad_signals[LAST_SIGNAL] = { 0 };
 
 static GParamSpec *pspec_caps = NULL;
@@ -421,7 +433,7 @@ gst_pad_init (GstPad * pad)
   pad->priv->last_cookie = -1;
   g_cond_init (&pad->priv->activation_cond);
 
-  pad->ABI.abi.last_flowret = GST_FLOW_FLUSHING;
+  SET_LAST_FLOW_RETURN (pad, GST_FLOW_FLUSHING);
 }
 
 /* called when setting the pad inactive. It removes all sticky events from
@@ -723,6 +735,7 @@ gst_pad_dispose (GObject * object)
 
   GST_OBJECT_LOCK (pad);
   remove_events (pad);
+  probe_array_clear (pad);
   g_hook_list_clear (&pad->probes);
   GST_OBJECT_UNLOCK (pad);
 
@@ -982,7 +995,7 @@ pre_activate (GstPad * pad, GstPadMode new_mode)
       pad->priv->in_activation = TRUE;
       GST_DEBUG_OBJECT (pad, "setting PAD_MODE NONE, set flushing");
       GST_PAD_SET_FLUSHING (pad);
-      pad->ABI.abi.last_flowret = GST_FLOW_FLUSHING;
+      SET_LAST_FLOW_RETURN (pad, GST_FLOW_FLUSHING);
       GST_PAD_MODE (pad) = new_mode;
       /* unlock blocked pads so element can resume and stop */
       GST_PAD_BLOCK_BROADCAST (pad);
@@ -1003,7 +1016,7 @@ pre_activate (GstPad * pad, GstPadMode new_mode)
       GST_DEBUG_OBJECT (pad, "setting pad into %s mode, unset flushing",
           gst_pad_mode_get_name (new_mode));
       GST_PAD_UNSET_FLUSHING (pad);
-      pad->ABI.abi.last_flowret = GST_FLOW_OK;
+      SET_LAST_FLOW_RETURN (pad, GST_FLOW_OK);
       GST_PAD_MODE (pad) = new_mode;
       if (GST_PAD_IS_SINK (pad)) {
         GstPad *peer;
@@ -1098,7 +1111,7 @@ gst_pad_set_active (GstPad * pad, gboolean active)
       GST_DEBUG_OBJECT (pad, "activating pad from none");
       ret = (GST_PAD_ACTIVATEFUNC (pad)) (pad, parent);
       if (ret)
-        pad->ABI.abi.last_flowret = GST_FLOW_OK;
+        SET_LAST_FLOW_RETURN (pad, GST_FLOW_OK);
     } else {
       GST_DEBUG_OBJECT (pad, "pad was active in %s mode",
           gst_pad_mode_get_name (old));
@@ -1113,7 +1126,7 @@ gst_pad_set_active (GstPad * pad, gboolean active)
           gst_pad_mode_get_name (old));
       ret = activate_mode_internal (pad, parent, old, FALSE);
       if (ret)
-        pad->ABI.abi.last_flowret = GST_FLOW_FLUSHING;
+        SET_LAST_FLOW_RETURN (pad, GST_FLOW_FLUSHING);
     }
   }
 
@@ -1393,7 +1406,8 @@ cleanup_hook (GstPad * pad, GHook * hook)
     }
   }
   g_hook_destroy_link (&pad->probes, hook);
-  pad->num_probes--;
+  g_atomic_int_add (&pad->num_probes, -1);
+  probe_array_clear (pad);
 }
 
 /**
@@ -1456,7 +1470,9 @@ gst_pad_add_probe (GstPad * pad, GstPadProbeType mask,
 
   /* add the probe */
   g_hook_append (&pad->probes, hook);
-  pad->num_probes++;
+  /* atomic, pairs with the check after the fast path push */
+  g_atomic_int_inc (&pad->num_probes);
+  probe_array_clear (pad);
   /* incremenent cookie so that the new hook gets called */
   pad->priv->probe_list_cookie++;
 
@@ -1479,7 +1495,7 @@ gst_pad_add_probe (GstPad * pad, GstPadProbeType mask,
 
   /* call the callback if we need to be called for idle callbacks */
   if ((mask & GST_PAD_PROBE_TYPE_IDLE) && (callback != NULL)) {
-    if (pad->priv->using > 0) {
+    if (g_atomic_int_get (&pad->priv->using) > 0) {
       /* the pad is in use, we can't signal the idle callback yet. Since we set the
        * flag above, the last thread to leave the push will do the callback. New
        * threads going into the push will block. */
@@ -3733,6 +3749,147 @@ already_called:
   }
 }
 
+/* The data types that the probes are bucketed by. A probe is in the bucket of
+ * every data type in its mask so that calling the probes for an item only
+ * goes over the probes that can match it. */
+static const GstPadProbeType probe_bucket_types[] = {
+  GST_PAD_PROBE_TYPE_BUFFER,
+  GST_PAD_PROBE_TYPE_BUFFER_LIST,
+  GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM,
+  GST_PAD_PROBE_TYPE_EVENT_UPSTREAM,
+  GST_PAD_PROBE_TYPE_EVENT_FLUSH,
+  GST_PAD_PROBE_TYPE_QUERY_DOWNSTREAM,
+  GST_PAD_PROBE_TYPE_QUERY_UPSTREAM,
+};
+
+#define N_PROBE_BUCKETS G_N_ELEMENTS (probe_bucket_types)
+
+/* An immutable array of the valid probes of a pad, in the order in which they
+ * were added, with a ref on each hook. The pad drops its array when a probe is
+ * added or removed, threads that are calling probes keep using the array they
+ * took a ref on. Hooks that were removed in the meantime are no longer valid
+ * and skipped. Refcount and hooks are protected by the pad LOCK. */
+struct _GstProbeArray
+{
+  gint refcount;
+  guint n_hooks;
+  GHook **hooks;
+  guint n_bucket[N_PROBE_BUCKETS];
+  GHook **bucket[N_PROBE_BUCKETS];
+};
+
+/* with pad LOCK */
+static GstProbeArray *
+probe_array_new (GstPad * pad)
+{
+  GstProbeArray *array;
+  GHook *hook;
+  guint i, b, n = 0;
+
+  for (hook = pad->probes.hooks; hook; hook = hook->next) {
+    if (G_HOOK_IS_VALID (hook))
+      n++;
+  }
+
+  array = g_new0 (GstProbeArray, 1);
+  array->refcount = 1;
+  array->hooks = g_new (GHook *, n * (N_PROBE_BUCKETS + 1));
+
+  for (hook = pad->probes.hooks; hook; hook = hook->next) {
+    if (G_HOOK_IS_VALID (hook))
+      array->hooks[array->n_hooks++] = g_hook_ref (&pad->probes, hook);
+  }
+
+  for (b = 0; b < N_PROBE_BUCKETS; b++) {
+    array->bucket[b] = array->hooks + n * (b + 1);
+
+    for (i = 0; i < array->n_hooks; i++) {
+      GstPadProbeType flags =
+          array->hooks[i]->flags >> G_HOOK_FLAG_USER_SHIFT;
+
+      if (flags & probe_bucket_types[b])
+        array->bucket[b][array->n_bucket[b]++] = array->hooks[i];
+    }
+  }
+
+  GST_CAT_LOG_OBJECT (GST_CAT_SCHEDULING, pad, "made probe array of %u hooks",
+      array->n_hooks);
+
+  return array;
+}
+
+/* with pad LOCK */
+static void
+probe_array_unref (GstPad * pad, GstProbeArray * array)
+{
+  guint i;
+
+  if (--array->refcount > 0)
+    return;
+
+  for (i = 0; i < array->n_hooks; i++)
+    g_hook_unref (&pad->probes, array->hooks[i]);
+  g_free (array->hooks);
+  g_free (array);
+}
+
+/* with pad LOCK */
+static void
+probe_array_clear (GstPad * pad)
+{
+  if (pad->priv->probe_array) {
+    probe_array_unref (pad, pad->priv->probe_array);
+    pad->priv->probe_array = NULL;
+  }
+}
+
+/* call probe_hook_marshal() on the probes that can match the type of the
+ * item, in the order in which they were added. With pad LOCK, the lock is
+ * released while calling the probes. */
+static void
+probe_array_marshal (GstPad * pad, ProbeMarshall * data)
+{
+  GstProbeArray *array;
+  GstPadProbeType type;
+  GHook **hooks;
+  guint i, b, n_hooks;
+
+  if (G_UNLIKELY (pad->priv->probe_array == NULL))
+    pad->priv->probe_array = probe_array_new (pad);
+  array = pad->priv->probe_array;
+  array->refcount++;
+
+  /* idle and blocking probes without data, and flush events, can match
+   * probes of any type */
+  hooks = array->hooks;
+  n_hooks = array->n_hooks;
+  type = data->info->type & _PAD_PROBE_TYPE_ALL_BOTH_AND_FLUSH;
+  for (b = 0; b < N_PROBE_BUCKETS; b++) {
+    if (type == probe_bucket_types[b]) {
+      hooks = array->bucket[b];
+      n_hooks = array->n_bucket[b];
+      break;
+    }
+  }
+
+  for (i = 0; i < n_hooks; i++) {
+    GHook *hook = hooks[i];
+    gboolean was_in_call;
+
+    /* removed while we were calling the previous probes */
+    if (!G_HOOK_IS_VALID (hook))
+      continue;
+
+    was_in_call = G_HOOK_IN_CALL (hook);
+    hook->flags |= G_HOOK_FLAG_IN_CALL;
+    probe_hook_marshal (hook, data);
+    if (!was_in_call)
+      hook->flags &= ~G_HOOK_FLAG_IN_CALL;
+  }
+
+  probe_array_unref (pad, array);
+}
+
 /* a probe that does not take or return any data */
 #define PROBE_NO_DATA(pad,mask,label,defaultval)                \
   G_STMT_START {						\
@@ -3845,8 +4002,7 @@ again:
    * there are matching callbacks still will it get set */
   data.marshalled = FALSE;
 
-  g_hook_list_marshal (&pad->probes, TRUE,
-      (GHookMarshaller) probe_hook_marshal, &data);
+  probe_array_marshal (pad, &data);
 
   /* if the list changed, call the new callbacks (they will not be in
    * called_probes yet) */
@@ -4383,6 +4539,33 @@ probe_stopped:
  * Data passing functions
  */
 
+/* Data can go through a pad without looking at probes, sticky events or the
+ * flushing and EOS state when none of these flags are set and there are no
+ * probes. The flags are already updated on link and unlink, when sticky
+ * events change and when the pad starts or stops flushing, so this costs one
+ * check for every buffer.
+ *
+ * PENDING_EVENTS only matters on source pads, check_sticky() clears it once
+ * the events are pushed. Sink pads get it set when storing sticky events and
+ * nothing clears it there, so it is not checked on the chain side. */
+#define GST_PAD_SRC_SLOW_PATH_FLAGS \
+    (GST_PAD_FLAG_FLUSHING | GST_PAD_FLAG_EOS | GST_PAD_FLAG_PENDING_EVENTS)
+#define GST_PAD_SINK_SLOW_PATH_FLAGS \
+    (GST_PAD_FLAG_FLUSHING | GST_PAD_FLAG_EOS)
+
+#ifdef GST_ENABLE_EXTRA_CHECKS
+#define GST_PAD_EVENTS_CHECKED(pad) \
+    ((pad)->priv->last_cookie == (pad)->priv->events_cookie)
+#else
+#define GST_PAD_EVENTS_CHECKED(pad) TRUE
+#endif
+
+/* with the pad LOCK */
+#define GST_PAD_IS_FAST_PATH(pad,flags) \
+    (!(GST_OBJECT_FLAGS (pad) & (flags)) && \
+     (pad)->num_probes == 0 && GST_PAD_MODE (pad) == GST_PAD_MODE_PUSH && \
+     GST_PAD_EVENTS_CHECKED (pad))
+
 /* this is the chain function that does not perform the additional argument
  * checking for that little extra speed.
  */
@@ -4396,35 +4579,37 @@ gst_pad_chain_data_unchecked (GstPad * pad, GstPadProbeType type, void *data)
   GST_PAD_STREAM_LOCK (pad);
 
   GST_OBJECT_LOCK (pad);
-  if (G_UNLIKELY (GST_PAD_IS_FLUSHING (pad)))
-    goto flushing;
+  if (G_UNLIKELY (!GST_PAD_IS_FAST_PATH (pad, GST_PAD_SINK_SLOW_PATH_FLAGS))) {
+    if (G_UNLIKELY (GST_PAD_IS_FLUSHING (pad)))
+      goto flushing;
 
-  if (G_UNLIKELY (GST_PAD_IS_EOS (pad)))
-    goto eos;
+    if (G_UNLIKELY (GST_PAD_IS_EOS (pad)))
+      goto eos;
 
-  if (G_UNLIKELY (GST_PAD_MODE (pad) != GST_PAD_MODE_PUSH))
-    goto wrong_mode;
+    if (G_UNLIKELY (GST_PAD_MODE (pad) != GST_PAD_MODE_PUSH))
+      goto wrong_mode;
 
 #ifdef GST_ENABLE_EXTRA_CHECKS
-  if (G_UNLIKELY (pad->priv->last_cookie != pad->priv->events_cookie)) {
-    if (!find_event_by_type (pad, GST_EVENT_STREAM_START, 0)) {
-      g_warning (G_STRLOC
-          ":%s:<%s:%s> Got data flow before stream-start event",
-          G_STRFUNC, GST_DEBUG_PAD_NAME (pad));
-    }
-    if (!find_event_by_type (pad, GST_EVENT_SEGMENT, 0)) {
-      g_warning (G_STRLOC
-          ":%s:<%s:%s> Got data flow before segment event",
-          G_STRFUNC, GST_DEBUG_PAD_NAME (pad));
+    if (G_UNLIKELY (pad->priv->last_cookie != pad->priv->events_cookie)) {
+      if (!find_event_by_type (pad, GST_EVENT_STREAM_START, 0)) {
+        g_warning (G_STRLOC
+            ":%s:<%s:%s> Got data flow before stream-start event",
+            G_STRFUNC, GST_DEBUG_PAD_NAME (pad));
+      }
+      if (!find_event_by_type (pad, GST_EVENT_SEGMENT, 0)) {
+        g_warning (G_STRLOC
+            ":%s:<%s:%s> Got data flow before segment event",
+            G_STRFUNC, GST_DEBUG_PAD_NAME (pad));
+      }
+      pad->priv->last_cookie = pad->priv->events_cookie;
     }
-    pad->priv->last_cookie = pad->priv->events_cookie;
-  }
 #endif
 
-  PROBE_HANDLE (pad, type | GST_PAD_PROBE_TYPE_BLOCK, data, probe_stopped,
-      probe_handled);
+    PROBE_HANDLE (pad, type | GST_PAD_PROBE_TYPE_BLOCK, data, probe_stopped,
+        probe_handled);
 
-  PROBE_HANDLE (pad, type, data, probe_stopped, probe_handled);
+    PROBE_HANDLE (pad, type, data, probe_stopped, probe_handled);
+  }
 
   ACQUIRE_PARENT (pad, parent, no_parent);
   GST_OBJECT_UNLOCK (pad);
@@ -4466,7 +4651,7 @@ gst_pad_chain_data_unchecked (GstPad * pad, GstPadProbeType type, void *data)
         GST_DEBUG_FUNCPTR_NAME (chainlistfunc), gst_flow_get_name (ret));
   }
 
-  pad->ABI.abi.last_flowret = ret;
+  SET_LAST_FLOW_RETURN (pad, ret);
 
   RELEASE_PARENT (parent);
 
@@ -4479,7 +4664,7 @@ flushing:
   {
     GST_CAT_LOG_OBJECT (GST_CAT_SCHEDULING, pad,
         "chaining, but pad was flushing");
-    pad->ABI.abi.last_flowret = GST_FLOW_FLUSHING;
+    SET_LAST_FLOW_RETURN (pad, GST_FLOW_FLUSHING);
     GST_OBJECT_UNLOCK (pad);
     GST_PAD_STREAM_UNLOCK (pad);
     gst_mini_object_unref (GST_MINI_OBJECT_CAST (data));
@@ -4488,7 +4673,7 @@ flushing:
 eos:
   {
     GST_CAT_LOG_OBJECT (GST_CAT_SCHEDULING, pad, "chaining, but pad was EOS");
-    pad->ABI.abi.last_flowret = GST_FLOW_EOS;
+    SET_LAST_FLOW_RETURN (pad, GST_FLOW_EOS);
     GST_OBJECT_UNLOCK (pad);
     GST_PAD_STREAM_UNLOCK (pad);
     gst_mini_object_unref (GST_MINI_OBJECT_CAST (data));
@@ -4498,7 +4683,7 @@ wrong_mode:
   {
     g_critical ("chain on pad %s:%s but it was not in push mode",
         GST_DEBUG_PAD_NAME (pad));
-    pad->ABI.abi.last_flowret = GST_FLOW_ERROR;
+    SET_LAST_FLOW_RETURN (pad, GST_FLOW_ERROR);
     GST_OBJECT_UNLOCK (pad);
     GST_PAD_STREAM_UNLOCK (pad);
     gst_mini_object_unref (GST_MINI_OBJECT_CAST (data));
@@ -4523,7 +4708,7 @@ probe_stopped:
         GST_DEBUG_OBJECT (pad, "an error occurred %s", gst_flow_get_name (ret));
         break;
     }
-    pad->ABI.abi.last_flowret = ret;
+    SET_LAST_FLOW_RETURN (pad, ret);
     GST_OBJECT_UNLOCK (pad);
     GST_PAD_STREAM_UNLOCK (pad);
     return ret;
@@ -4531,7 +4716,7 @@ probe_stopped:
 no_parent:
   {
     GST_DEBUG_OBJECT (pad, "No parent when chaining %" GST_PTR_FORMAT, data);
-    pad->ABI.abi.last_flowret = GST_FLOW_FLUSHING;
+    SET_LAST_FLOW_RETURN (pad, GST_FLOW_FLUSHING);
     gst_mini_object_unref (GST_MINI_OBJECT_CAST (data));
     GST_OBJECT_UNLOCK (pad);
     GST_PAD_STREAM_UNLOCK (pad);
@@ -4539,7 +4724,7 @@ no_parent:
   }
 no_function:
   {
-    pad->ABI.abi.last_flowret = GST_FLOW_NOT_SUPPORTED;
+    SET_LAST_FLOW_RETURN (pad, GST_FLOW_NOT_SUPPORTED);
     RELEASE_PARENT (parent);
     gst_mini_object_unref (GST_MINI_OBJECT_CAST (data));
     g_critical ("chain on pad %s:%s but it has no chainfunction",
@@ -4657,55 +4842,57 @@ gst_pad_push_data (GstPad * pad, GstPadProbeType type, void *data)
   gboolean handled = FALSE;
 
   GST_OBJECT_LOCK (pad);
-  if (G_UNLIKELY (GST_PAD_IS_FLUSHING (pad)))
-    goto flushing;
+  if (G_UNLIKELY (!GST_PAD_IS_FAST_PATH (pad, GST_PAD_SRC_SLOW_PATH_FLAGS))) {
+    if (G_UNLIKELY (GST_PAD_IS_FLUSHING (pad)))
+      goto flushing;
 
-  if (G_UNLIKELY (GST_PAD_IS_EOS (pad)))
-    goto eos;
+    if (G_UNLIKELY (GST_PAD_IS_EOS (pad)))
+      goto eos;
 
-  if (G_UNLIKELY (GST_PAD_MODE (pad) != GST_PAD_MODE_PUSH))
-    goto wrong_mode;
+    if (G_UNLIKELY (GST_PAD_MODE (pad) != GST_PAD_MODE_PUSH))
+      goto wrong_mode;
 
 #ifdef GST_ENABLE_EXTRA_CHECKS
-  if (G_UNLIKELY (pad->priv->last_cookie != pad->priv->events_cookie)) {
-    if (!find_event_by_type (pad, GST_EVENT_STREAM_START, 0)) {
-      g_warning (G_STRLOC
-          ":%s:<%s:%s> Got data flow before stream-start event",
-          G_STRFUNC, GST_DEBUG_PAD_NAME (pad));
-    }
-    if (!find_event_by_type (pad, GST_EVENT_SEGMENT, 0)) {
-      g_warning (G_STRLOC
-          ":%s:<%s:%s> Got data flow before segment event",
-          G_STRFUNC, GST_DEBUG_PAD_NAME (pad));
+    if (G_UNLIKELY (pad->priv->last_cookie != pad->priv->events_cookie)) {
+      if (!find_event_by_type (pad, GST_EVENT_STREAM_START, 0)) {
+        g_warning (G_STRLOC
+            ":%s:<%s:%s> Got data flow before stream-start event",
+            G_STRFUNC, GST_DEBUG_PAD_NAME (pad));
+      }
+      if (!find_event_by_type (pad, GST_EVENT_SEGMENT, 0)) {
+        g_warning (G_STRLOC
+            ":%s:<%s:%s> Got data flow before segment event",
+            G_STRFUNC, GST_DEBUG_PAD_NAME (pad));
+      }
+      pad->priv->last_cookie = pad->priv->events_cookie;
     }
-    pad->priv->last_cookie = pad->priv->events_cookie;
-  }
 #endif
 
-  if (G_UNLIKELY ((ret = check_sticky (pad, NULL))) != GST_FLOW_OK)
-    goto events_error;
+    if (G_UNLIKELY ((ret = check_sticky (pad, NULL))) != GST_FLOW_OK)
+      goto events_error;
 
-  /* do block probes */
-  PROBE_HANDLE (pad, type | GST_PAD_PROBE_TYPE_BLOCK, data, probe_stopped,
-      probe_handled);
+    /* do block probes */
+    PROBE_HANDLE (pad, type | GST_PAD_PROBE_TYPE_BLOCK, data, probe_stopped,
+        probe_handled);
 
-  /* recheck sticky events because the probe might have cause a relink */
-  if (G_UNLIKELY ((ret = check_sticky (pad, NULL))) != GST_FLOW_OK)
-    goto events_error;
+    /* recheck sticky events because the probe might have cause a relink */
+    if (G_UNLIKELY ((ret = check_sticky (pad, NULL))) != GST_FLOW_OK)
+      goto events_error;
 
-  /* do post-blocking probes */
-  PROBE_HANDLE (pad, type, data, probe_stopped, probe_handled);
+    /* do post-blocking probes */
+    PROBE_HANDLE (pad, type, data, probe_stopped, probe_handled);
 
-  /* recheck sticky events because the probe might have cause a relink */
-  if (G_UNLIKELY ((ret = check_sticky (pad, NULL))) != GST_FLOW_OK)
-    goto events_error;
+    /* recheck sticky events because the probe might have cause a relink */
+    if (G_UNLIKELY ((ret = check_sticky (pad, NULL))) != GST_FLOW_OK)
+      goto events_error;
+  }
 
   if (G_UNLIKELY ((peer = GST_PAD_PEER (pad)) == NULL))
     goto not_linked;
 
   /* take ref to peer pad before releasing the lock */
   gst_object_ref (peer);
-  pad->priv->using++;
+  g_atomic_int_inc (&pad->priv->using);
   GST_OBJECT_UNLOCK (pad);
 
   ret = gst_pad_chain_data_unchecked (peer, type, data);
@@ -4713,15 +4900,22 @@ gst_pad_push_data (GstPad * pad, GstPadProbeType type, void *data)
 
   gst_object_unref (peer);
 
-  GST_OBJECT_LOCK (pad);
-  pad->ABI.abi.last_flowret = ret;
-  pad->priv->using--;
-  if (pad->priv->using == 0) {
-    /* pad is not active anymore, trigger idle callbacks */
-    PROBE_NO_DATA (pad, GST_PAD_PROBE_TYPE_PUSH | GST_PAD_PROBE_TYPE_IDLE,
-        probe_stopped, ret);
+  SET_LAST_FLOW_RETURN (pad, ret);
+
+  /* Only take the lock again when we were the last user and there are
+   * probes, the probe added while we were pushing might be an idle probe that
+   * waits for us. gst_pad_add_probe() increments num_probes before checking
+   * using, so one of us sees the other. */
+  if (g_atomic_int_dec_and_test (&pad->priv->using) &&
+      G_UNLIKELY (g_atomic_int_get (&pad->num_probes))) {
+    GST_OBJECT_LOCK (pad);
+    if (g_atomic_int_get (&pad->priv->using) == 0) {
+      /* pad is not active anymore, trigger idle callbacks */
+      PROBE_NO_DATA (pad, GST_PAD_PROBE_TYPE_PUSH | GST_PAD_PROBE_TYPE_IDLE,
+          probe_stopped, ret);
+    }
+    GST_OBJECT_UNLOCK (pad);
   }
-  GST_OBJECT_UNLOCK (pad);
 
   return ret;
 
@@ -4731,7 +4925,7 @@ flushing:
   {
     GST_CAT_LOG_OBJECT (GST_CAT_SCHEDULING, pad,
         "pushing, but pad was flushing");
-    pad->ABI.abi.last_flowret = GST_FLOW_FLUSHING;
+    SET_LAST_FLOW_RETURN (pad, GST_FLOW_FLUSHING);
     GST_OBJECT_UNLOCK (pad);
     gst_mini_object_unref (GST_MINI_OBJECT_CAST (data));
     return GST_FLOW_FLUSHING;
@@ -4739,7 +4933,7 @@ flushing:
 eos:
   {
     GST_CAT_LOG_OBJECT (GST_CAT_SCHEDULING, pad, "pushing, but pad was EOS");
-    pad->ABI.abi.last_flowret = GST_FLOW_EOS;
+    SET_LAST_FLOW_RETURN (pad, GST_FLOW_EOS);
     GST_OBJECT_UNLOCK (pad);
     gst_mini_object_unref (GST_MINI_OBJECT_CAST (data));
     return GST_FLOW_EOS;
@@ -4748,7 +4942,7 @@ wrong_mode:
   {
     g_critical ("pushing on pad %s:%s but it was not activated in push mode",
         GST_DEBUG_PAD_NAME (pad));
-    pad->ABI.abi.last_flowret = GST_FLOW_ERROR;
+    SET_LAST_FLOW_RETURN (pad, GST_FLOW_ERROR);
     GST_OBJECT_UNLOCK (pad);
     gst_mini_object_unref (GST_MINI_OBJECT_CAST (data));
     return GST_FLOW_ERROR;
@@ -4757,7 +4951,7 @@ events_error:
   {
     GST_CAT_LOG_OBJECT (GST_CAT_SCHEDULING, pad,
         "error pushing events, return %s", gst_flow_get_name (ret));
-    pad->ABI.abi.last_flowret = ret;
+    SET_LAST_FLOW_RETURN (pad, ret);
     GST_OBJECT_UNLOCK (pad);
     gst_mini_object_unref (GST_MINI_OBJECT_CAST (data));
     return ret;
@@ -4781,14 +4975,14 @@ probe_stopped:
         GST_DEBUG_OBJECT (pad, "an error occurred %s", gst_flow_get_name (ret));
         break;
     }
-    pad->ABI.abi.last_flowret = ret;
+    SET_LAST_FLOW_RETURN (pad, ret);
     return ret;
   }
 not_linked:
   {
     GST_CAT_LOG_OBJECT (GST_CAT_SCHEDULING, pad,
         "pushing, but it was not linked");
-    pad->ABI.abi.last_flowret = GST_FLOW_NOT_LINKED;
+    SET_LAST_FLOW_RETURN (pad, GST_FLOW_NOT_LINKED);
     GST_OBJECT_UNLOCK (pad);
     gst_mini_object_unref (GST_MINI_OBJECT_CAST (data));
     return GST_FLOW_NOT_LINKED;
@@ -4929,7 +5123,7 @@ gst_pad_get_range_unchecked (GstPad * pad, guint64 offset, guint size,
 probed_data:
   PROBE_PULL (pad, GST_PAD_PROBE_TYPE_PULL | GST_PAD_PROBE_TYPE_BUFFER,
       res_buf, offset, size, probe_stopped_unref);
-  pad->ABI.abi.last_flowret = ret;
+  SET_LAST_FLOW_RETURN (pad, ret);
   GST_OBJECT_UNLOCK (pad);
 
   GST_PAD_STREAM_UNLOCK (pad);
@@ -4947,7 +5141,7 @@ flushing:
   {
     GST_CAT_LOG_OBJECT (GST_CAT_SCHEDULING, pad,
         "getrange, but pad was flushing");
-    pad->ABI.abi.last_flowret = GST_FLOW_FLUSHING;
+    SET_LAST_FLOW_RETURN (pad, GST_FLOW_FLUSHING);
     GST_OBJECT_UNLOCK (pad);
     GST_PAD_STREAM_UNLOCK (pad);
     return GST_FLOW_FLUSHING;
@@ -4956,7 +5150,7 @@ wrong_mode:
   {
     g_critical ("getrange on pad %s:%s but it was not activated in pull mode",
         GST_DEBUG_PAD_NAME (pad));
-    pad->ABI.abi.last_flowret = GST_FLOW_ERROR;
+    SET_LAST_FLOW_RETURN (pad, GST_FLOW_ERROR);
     GST_OBJECT_UNLOCK (pad);
     GST_PAD_STREAM_UNLOCK (pad);
     return GST_FLOW_ERROR;
@@ -4964,7 +5158,7 @@ wrong_mode:
 events_error:
   {
     GST_CAT_LOG_OBJECT (GST_CAT_SCHEDULING, pad, "error pushing events");
-    pad->ABI.abi.last_flowret = ret;
+    SET_LAST_FLOW_RETURN (pad, ret);
     GST_OBJECT_UNLOCK (pad);
     GST_PAD_STREAM_UNLOCK (pad);
     return ret;
@@ -4972,7 +5166,7 @@ events_error:
 no_parent:
   {
     GST_DEBUG_OBJECT (pad, "no parent");
-    pad->ABI.abi.last_flowret = GST_FLOW_FLUSHING;
+    SET_LAST_FLOW_RETURN (pad, GST_FLOW_FLUSHING);
     GST_OBJECT_UNLOCK (pad);
     GST_PAD_STREAM_UNLOCK (pad);
     return GST_FLOW_FLUSHING;
@@ -5002,7 +5196,7 @@ probe_stopped:
         ret = GST_FLOW_EOS;
       }
     }
-    pad->ABI.abi.last_flowret = ret;
+    SET_LAST_FLOW_RETURN (pad, ret);
     GST_OBJECT_UNLOCK (pad);
     GST_PAD_STREAM_UNLOCK (pad);
 
@@ -5015,7 +5209,7 @@ probe_stopped_unref:
     /* if we drop here, it signals EOS */
     if (ret == GST_FLOW_CUSTOM_SUCCESS)
       ret = GST_FLOW_EOS;
-    pad->ABI.abi.last_flowret = ret;
+    SET_LAST_FLOW_RETURN (pad, ret);
     GST_OBJECT_UNLOCK (pad);
     GST_PAD_STREAM_UNLOCK (pad);
     if (*buffer == NULL)
@@ -5024,7 +5218,7 @@ probe_stopped_unref:
   }
 get_range_failed:
   {
-    pad->ABI.abi.last_flowret = ret;
+    SET_LAST_FLOW_RETURN (pad, ret);
     GST_OBJECT_UNLOCK (pad);
     GST_PAD_STREAM_UNLOCK (pad);
     GST_CAT_LEVEL_LOG (GST_CAT_SCHEDULING,
@@ -5159,7 +5353,7 @@ gst_pad_pull_range (GstPad * pad, guint64 offset, guint size,
     goto not_linked;
 
   gst_object_ref (peer);
-  pad->priv->using++;
+  g_atomic_int_inc (&pad->priv->using);
   GST_OBJECT_UNLOCK (pad);
 
   ret = gst_pad_get_range_unchecked (peer, offset, size, &res_buf);
@@ -5167,9 +5361,8 @@ gst_pad_pull_range (GstPad * pad, guint64 offset, guint size,
   gst_object_unref (peer);
 
   GST_OBJECT_LOCK (pad);
-  pad->priv->using--;
-  pad->ABI.abi.last_flowret = ret;
-  if (pad->priv->using == 0) {
+  SET_LAST_FLOW_RETURN (pad, ret);
+  if (g_atomic_int_dec_and_test (&pad->priv->using)) {
     /* pad is not active anymore, trigger idle callbacks */
     PROBE_NO_DATA (pad, GST_PAD_PROBE_TYPE_PULL | GST_PAD_PROBE_TYPE_IDLE,
         probe_stopped_unref, ret);
@@ -5194,7 +5387,7 @@ flushing:
   {
     GST_CAT_LOG_OBJECT (GST_CAT_SCHEDULING, pad,
         "pullrange, but pad was flushing");
-    pad->ABI.abi.last_flowret = GST_FLOW_FLUSHING;
+    SET_LAST_FLOW_RETURN (pad, GST_FLOW_FLUSHING);
     GST_OBJECT_UNLOCK (pad);
     ret = GST_FLOW_FLUSHING;
     goto done;
@@ -5203,7 +5396,7 @@ wrong_mode:
   {
     g_critical ("pullrange on pad %s:%s but it was not activated in pull mode",
         GST_DEBUG_PAD_NAME (pad));
-    pad->ABI.abi.last_flowret = GST_FLOW_ERROR;
+    SET_LAST_FLOW_RETURN (pad, GST_FLOW_ERROR);
     GST_OBJECT_UNLOCK (pad);
     ret = GST_FLOW_ERROR;
     goto done;
@@ -5225,7 +5418,7 @@ probe_stopped:
         ret = GST_FLOW_EOS;
       }
     }
-    pad->ABI.abi.last_flowret = ret;
+    SET_LAST_FLOW_RETURN (pad, ret);
     GST_OBJECT_UNLOCK (pad);
     goto done;
   }
@@ -5233,14 +5426,14 @@ not_linked:
   {
     GST_CAT_LOG_OBJECT (GST_CAT_SCHEDULING, pad,
         "pulling range, but it was not linked");
-    pad->ABI.abi.last_flowret = GST_FLOW_NOT_LINKED;
+    SET_LAST_FLOW_RETURN (pad, GST_FLOW_NOT_LINKED);
     GST_OBJECT_UNLOCK (pad);
     ret = GST_FLOW_NOT_LINKED;
     goto done;
   }
 pull_range_failed:
   {
-    pad->ABI.abi.last_flowret = ret;
+    SET_LAST_FLOW_RETURN (pad, ret);
     GST_OBJECT_UNLOCK (pad);
     GST_CAT_LEVEL_LOG (GST_CAT_SCHEDULING,
         (ret >= GST_FLOW_EOS) ? GST_LEVEL_INFO : GST_LEVEL_WARNING,
@@ -5256,7 +5449,7 @@ probe_stopped_unref:
     if (ret == GST_FLOW_CUSTOM_SUCCESS)
       ret = GST_FLOW_EOS;
 
-    pad->ABI.abi.last_flowret = ret;
+    SET_LAST_FLOW_RETURN (pad, ret);
     GST_OBJECT_UNLOCK (pad);
 
     if (*buffer == NULL)
@@ -5371,7 +5564,7 @@ store_sticky_event (GstPad * pad, GstEvent * event)
   }
   if (type == GST_EVENT_EOS) {
     GST_OBJECT_FLAG_SET (pad, GST_PAD_FLAG_EOS);
-    pad->ABI.abi.last_flowret = GST_FLOW_EOS;
+    SET_LAST_FLOW_RETURN (pad, GST_FLOW_EOS);
   }
 
   return GST_PAD_IS_FLUSHING (pad) ? GST_FLOW_FLUSHING : GST_FLOW_OK;
@@ -5466,7 +5659,7 @@ gst_pad_push_event_unchecked (GstPad * pad, GstEvent * event,
       remove_event_by_type (pad, GST_EVENT_STREAM_GROUP_DONE);
       remove_event_by_type (pad, GST_EVENT_SEGMENT);
       GST_OBJECT_FLAG_UNSET (pad, GST_PAD_FLAG_EOS);
-      pad->ABI.abi.last_flowret = GST_FLOW_OK;
+      SET_LAST_FLOW_RETURN (pad, GST_FLOW_OK);
 
       type |= GST_PAD_PROBE_TYPE_EVENT_FLUSH;
       break;
@@ -5535,7 +5728,7 @@ gst_pad_push_event_unchecked (GstPad * pad, GstEvent * event,
     goto not_linked;
 
   gst_object_ref (peerpad);
-  pad->priv->using++;
+  g_atomic_int_inc (&pad->priv->using);
   GST_OBJECT_UNLOCK (pad);
 
   GST_LOG_OBJECT (pad, "sending event %p (%s) to peerpad %" GST_PTR_FORMAT,
@@ -5552,8 +5745,7 @@ gst_pad_push_event_unchecked (GstPad * pad, GstEvent * event,
   gst_object_unref (peerpad);
 
   GST_OBJECT_LOCK (pad);
-  pad->priv->using--;
-  if (pad->priv->using == 0) {
+  if (g_atomic_int_dec_and_test (&pad->priv->using)) {
     /* pad is not active anymore, trigger idle callbacks */
     PROBE_NO_DATA (pad, GST_PAD_PROBE_TYPE_PUSH | GST_PAD_PROBE_TYPE_IDLE,
         idle_probe_stopped, ret);
@@ -5813,7 +6005,7 @@ gst_pad_send_event_unchecked (GstPad * pad, GstEvent * event,
       remove_event_by_type (pad, GST_EVENT_STREAM_GROUP_DONE);
       remove_event_by_type (pad, GST_EVENT_SEGMENT);
       GST_OBJECT_FLAG_UNSET (pad, GST_PAD_FLAG_EOS);
-      pad->ABI.abi.last_flowret = GST_FLOW_OK;
+      SET_LAST_FLOW_RETURN (pad, GST_FLOW_OK);
 
       GST_OBJECT_UNLOCK (pad);
       /* grab stream lock */
@@ -6546,11 +6738,5 @@ gst_pad_probe_info_get_buffer_list (GstPadProbeInfo * info)
 GstFlowReturn
 gst_pad_get_last_flow_return (GstPad * pad)
 {
-  GstFlowReturn ret;
-
-  GST_OBJECT_LOCK (pad);
-  ret = GST_PAD_LAST_FLOW_RETURN (pad);
-  GST_OBJECT_UNLOCK (pad);
-
-  return ret;
+  return g_atomic_int_get ((gint *) & GST_PAD_LAST_FLOW_RETURN (pad));
 }
@@ -44,6 +44,14 @@
  * in time. The wait can be controlled by calling gst_poll_restart() and
  * gst_poll_set_flushing().
  *
+ * On Linux, sets created with gst_poll_new() are backed by epoll, so that
+ * the cost of a wait depends on the number of descriptors with activity
+ * rather than the number of descriptors in the set. Such sets can be put in
+ * edge-triggered mode with gst_poll_set_edge_triggered(). Like with epoll,
+ * a file descriptor has to be removed with gst_poll_remove_fd() before it is
+ * closed: a closed descriptor silently stops being polled instead of being
+ * reported with gst_poll_fd_has_closed().
+ *
  * Once the file descriptor set has been waited for, one can use
  * gst_poll_fd_has_closed() to see if the file descriptor has been closed,
  * gst_poll_fd_has_error() to see if it has generated an error,
@@ -83,6 +91,9 @@
 #endif
 #include <sys/time.h>
 #include <sys/socket.h>
+#ifdef HAVE_SYS_EPOLL_H
+#include <sys/epoll.h>
+#endif
 #endif
 
 #ifdef G_OS_WIN32
@@ -124,6 +135,7 @@ typedef enum
   GST_POLL_MODE_PSELECT,
   GST_POLL_MODE_POLL,
   GST_POLL_MODE_PPOLL,
+  GST_POLL_MODE_EPOLL,
   GST_POLL_MODE_WINDOWS
 } GstPollMode;
 
@@ -142,6 +154,21 @@ struct _GstPoll
 #ifndef G_OS_WIN32
   GstPollFD control_read_fd;
   GstPollFD control_write_fd;
+#ifdef HAVE_SYS_EPOLL_H
+  /* epoll instance, -1 when polling with the other modes. The kernel keeps
+   * the interest list, fds is only used for the query functions */
+  gint epoll_fd;
+  gboolean edge_triggered;
+  /* struct epoll_event filled by the waiting thread */
+  GArray *epoll_events;
+  /* indices in active_fds that have revents set */
+  GArray *ready;
+  /* struct pollfd for fds epoll refuses (regular files), reported with
+   * the revents poll() would give them on every wait */
+  GArray *unpollable;
+  /* struct pollfd with the revents of fds passed to gst_poll_fd_ignored() */
+  GArray *ignored;
+#endif
 #else
   GArray *active_fds_ignored;
   GArray *events;
@@ -521,6 +548,229 @@ fd_set_to_pollfd (GstPoll * set, fd_set * readfds, fd_set * writefds,
 
   g_mutex_unlock (&set->lock);
 }
+
+#ifdef HAVE_SYS_EPOLL_H
+static guint32
+pollfd_to_epoll_events (GstPoll * set, struct pollfd *pfd)
+{
+  guint32 events = 0;
+
+  if (pfd->events & POLLIN)
+    events |= EPOLLIN;
+  if (pfd->events & POLLOUT)
+    events |= EPOLLOUT;
+  if (pfd->events & POLLPRI)
+    events |= EPOLLPRI;
+  /* the control socket is always level-triggered, a wakeup must not get lost
+   * when it was raised more than once */
+  if (set->edge_triggered && pfd->fd != set->control_read_fd.fd)
+    events |= EPOLLET;
+
+  return events;
+}
+
+static gushort
+epoll_events_to_revents (guint32 events)
+{
+  gushort revents = 0;
+
+  if (events & EPOLLIN)
+    revents |= POLLIN;
+  if (events & EPOLLOUT)
+    revents |= POLLOUT;
+  if (events & EPOLLPRI)
+    revents |= POLLPRI;
+  if (events & EPOLLERR)
+    revents |= POLLERR;
+  if (events & EPOLLHUP)
+    revents |= POLLHUP;
+
+  return revents;
+}
+
+/* add or update the fd at @idx in set->fds in the epoll interest list. The
+ * index is stored next to the fd so that a wakeup can find the pollfd
+ * without a lookup, it is updated when the array is reordered. */
+static void
+gst_poll_epoll_ctl (GstPoll * set, gint op, gint idx)
+{
+  struct pollfd *pfd = &g_array_index (set->fds, struct pollfd, idx);
+  struct epoll_event ev;
+  guint i;
+  gint err;
+
+  ev.events = pollfd_to_epoll_events (set, pfd);
+  ev.data.u64 = ((guint64) idx << 32) | (guint32) pfd->fd;
+
+  if (epoll_ctl (set->epoll_fd, op, pfd->fd, &ev) == 0)
+    return;
+
+  err = errno;
+
+  /* the fd was closed and dropped out of the epoll set without being
+   * removed, its number may have been reused since. Poll whatever it refers
+   * to now, like poll() would */
+  if (op == EPOLL_CTL_MOD && err == ENOENT) {
+    if (epoll_ctl (set->epoll_fd, EPOLL_CTL_ADD, pfd->fd, &ev) == 0)
+      return;
+    op = EPOLL_CTL_ADD;
+    err = errno;
+  }
+
+  /* already reported without epoll */
+  for (i = 0; i < set->unpollable->len; i++) {
+    if (g_array_index (set->unpollable, struct pollfd, i).fd == pfd->fd)
+      return;
+  }
+
+  /* poll() considers regular files always readable and writable and
+   * reports invalid fds with POLLNVAL, do the same */
+  if ((op == EPOLL_CTL_ADD && err == EPERM) || err == EBADF) {
+    struct pollfd ufd;
+
+    ufd.fd = pfd->fd;
+    ufd.events = err == EPERM ? (POLLIN | POLLOUT) : POLLNVAL;
+    ufd.revents = 0;
+    g_array_append_val (set->unpollable, ufd);
+    GST_DEBUG ("%p: fd %d can't be polled with epoll", set, pfd->fd);
+    return;
+  }
+
+  GST_WARNING ("%p: epoll_ctl on fd %d failed: %s", set, pfd->fd,
+      g_strerror (err));
+}
+
+static void
+gst_poll_epoll_remove (GstPoll * set, gint fd)
+{
+  guint i;
+
+  for (i = 0; i < set->unpollable->len; i++) {
+    if (g_array_index (set->unpollable, struct pollfd, i).fd == fd) {
+      g_array_remove_index_fast (set->unpollable, i);
+      break;
+    }
+  }
+  for (i = 0; i < set->ignored->len; i++) {
+    if (g_array_index (set->ignored, struct pollfd, i).fd == fd) {
+      g_array_remove_index_fast (set->ignored, i);
+      break;
+    }
+  }
+
+  /* fails when the fd was closed before it was removed, which already took
+   * it out of the epoll set */
+  epoll_ctl (set->epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+}
+
+/* sets the revents of @fd in active_fds, returns 1 if @fd was not reported
+ * yet in this wait */
+static gint
+gst_poll_epoll_set_revents (GstPoll * set, gint idx, gint fd, gushort revents)
+{
+  struct pollfd *pfd;
+
+  if (idx < 0 || idx >= set->active_fds->len
+      || g_array_index (set->active_fds, struct pollfd, idx).fd != fd) {
+    GstPollFD tmp = GST_POLL_FD_INIT;
+
+    tmp.fd = fd;
+    idx = find_index (set->active_fds, &tmp);
+    /* removed while we were waiting */
+    if (idx < 0)
+      return 0;
+  }
+
+  pfd = &g_array_index (set->active_fds, struct pollfd, idx);
+  if (pfd->revents != 0) {
+    pfd->revents |= revents;
+    return 0;
+  }
+
+  pfd->revents = revents;
+  g_array_append_val (set->ready, idx);
+
+  return 1;
+}
+
+static gint
+gst_poll_epoll_wait (GstPoll * set, GstClockTime timeout)
+{
+  struct epoll_event *events;
+  guint i;
+  gint n, res, t;
+
+  g_mutex_lock (&set->lock);
+  g_array_set_size (set->epoll_events, MAX (set->fds->len, 1));
+  /* ignored and unpollable fds are ready right away, only collect the
+   * others */
+  if (set->unpollable->len > 0 || set->ignored->len > 0)
+    t = 0;
+  else if (timeout == GST_CLOCK_TIME_NONE)
+    t = -1;
+  else
+    t = MIN ((timeout + GST_MSECOND - 1) / GST_MSECOND, G_MAXINT);
+  g_mutex_unlock (&set->lock);
+
+  events = (struct epoll_event *) set->epoll_events->data;
+
+  n = epoll_wait (set->epoll_fd, events, set->epoll_events->len, t);
+  if (n < 0)
+    return -1;
+
+  g_mutex_lock (&set->lock);
+
+  /* active_fds mirrors fds so that the query functions can find the fds
+   * with the same index, only the ones reported last time need clearing */
+  if (TEST_REBUILD (set)) {
+    g_array_set_size (set->active_fds, set->fds->len);
+    memcpy (set->active_fds->data, set->fds->data,
+        set->fds->len * sizeof (struct pollfd));
+  } else {
+    for (i = 0; i < set->ready->len; i++) {
+      gint idx = g_array_index (set->ready, gint, i);
+
+      g_array_index (set->active_fds, struct pollfd, idx).revents = 0;
+    }
+  }
+  g_array_set_size (set->ready, 0);
+
+  res = 0;
+  for (i = 0; i < (guint) n; i++) {
+    res += gst_poll_epoll_set_revents (set, events[i].data.u64 >> 32,
+        (gint) (guint32) events[i].data.u64,
+        epoll_events_to_revents (events[i].events));
+  }
+
+  for (i = 0; i < set->unpollable->len; i++) {
+    struct pollfd *ufd = &g_array_index (set->unpollable, struct pollfd, i);
+    GstPollFD tmp = GST_POLL_FD_INIT;
+    gushort revents;
+    gint idx;
+
+    tmp.fd = ufd->fd;
+    idx = find_index (set->active_fds, &tmp);
+    if (idx < 0)
+      continue;
+
+    revents = ufd->events & (g_array_index (set->active_fds, struct pollfd,
+            idx).events | POLLNVAL);
+    if (revents)
+      res += gst_poll_epoll_set_revents (set, idx, ufd->fd, revents);
+  }
+
+  for (i = 0; i < set->ignored->len; i++) {
+    struct pollfd *ifd = &g_array_index (set->ignored, struct pollfd, i);
+
+    res += gst_poll_epoll_set_revents (set, -1, ifd->fd, ifd->revents);
+  }
+  g_array_set_size (set->ignored, 0);
+
+  g_mutex_unlock (&set->lock);
+
+  return res;
+}
+#endif /* HAVE_SYS_EPOLL_H */
 #else /* G_OS_WIN32 */
 /*
  * Translate errors thrown by the Winsock API used by GstPoll:
@@ -659,21 +909,8 @@ gst_poll_collect_winsock_events (GstPoll * set)
 }
 #endif
 
-/**
- * gst_poll_new: (skip)
- * @controllable: whether it should be possible to control a wait.
- *
- * Create a new file descriptor set. If @controllable, it
- * is possible to restart or flush a call to gst_poll_wait() with
- * gst_poll_restart() and gst_poll_set_flushing() respectively.
- *
- * Free-function: gst_poll_free
- *
- * Returns: (transfer full) (nullable): a new #GstPoll, or %NULL in
- *     case of an error.  Free with gst_poll_free().
- */
-GstPoll *
-gst_poll_new (gboolean controllable)
+static GstPoll *
+gst_poll_new_internal (gboolean controllable, gboolean timer)
 {
   GstPoll *nset;
 
@@ -686,6 +923,25 @@ gst_poll_new (gboolean controllable)
   nset->active_fds = g_array_new (FALSE, FALSE, sizeof (struct pollfd));
   nset->control_read_fd.fd = -1;
   nset->control_write_fd.fd = -1;
+#ifdef HAVE_SYS_EPOLL_H
+  /* timers can be waited on from multiple threads at once, which would need
+   * a result buffer per thread. They only have the control socket anyway. */
+  nset->epoll_fd = -1;
+  if (!timer) {
+    nset->epoll_fd = epoll_create1 (EPOLL_CLOEXEC);
+    if (nset->epoll_fd >= 0) {
+      nset->mode = GST_POLL_MODE_EPOLL;
+      nset->epoll_events =
+          g_array_new (FALSE, FALSE, sizeof (struct epoll_event));
+      nset->ready = g_array_new (FALSE, FALSE, sizeof (gint));
+      nset->unpollable = g_array_new (FALSE, FALSE, sizeof (struct pollfd));
+      nset->ignored = g_array_new (FALSE, FALSE, sizeof (struct pollfd));
+    } else {
+      GST_WARNING ("%p: can't create epoll instance: %s", nset,
+          g_strerror (errno));
+    }
+  }
+#endif
   {
     gint control_sock[2];
 
@@ -714,6 +970,7 @@ gst_poll_new (gboolean controllable)
 
   nset->controllable = controllable;
   nset->control_pending = 0;
+  nset->timer = timer;
 
   return nset;
 
@@ -728,6 +985,25 @@ no_socket_pair:
 #endif
 }
 
+/**
+ * gst_poll_new: (skip)
+ * @controllable: whether it should be possible to control a wait.
+ *
+ * Create a new file descriptor set. If @controllable, it
+ * is possible to restart or flush a call to gst_poll_wait() with
+ * gst_poll_restart() and gst_poll_set_flushing() respectively.
+ *
+ * Free-function: gst_poll_free
+ *
+ * Returns: (transfer full) (nullable): a new #GstPoll, or %NULL in
+ *     case of an error.  Free with gst_poll_free().
+ */
+GstPoll *
+gst_poll_new (gboolean controllable)
+{
+  return gst_poll_new_internal (controllable, FALSE);
+}
+
 /**
  * gst_poll_new_timer: (skip)
  *
@@ -745,17 +1021,8 @@ no_socket_pair:
 GstPoll *
 gst_poll_new_timer (void)
 {
-  GstPoll *poll;
-
-  /* make a new controllable poll set */
-  if (!(poll = gst_poll_new (TRUE)))
-    goto done;
-
-  /* we are a timer */
-  poll->timer = TRUE;
-
-done:
-  return poll;
+  /* make a new controllable poll set, we are a timer */
+  return gst_poll_new_internal (TRUE, TRUE);
 }
 
 /**
@@ -776,6 +1043,15 @@ gst_poll_free (GstPoll * set)
     close (set->control_write_fd.fd);
   if (set->control_read_fd.fd >= 0)
     close (set->control_read_fd.fd);
+#ifdef HAVE_SYS_EPOLL_H
+  if (set->epoll_fd >= 0) {
+    close (set->epoll_fd);
+    g_array_free (set->epoll_events, TRUE);
+    g_array_free (set->ready, TRUE);
+    g_array_free (set->unpollable, TRUE);
+    g_array_free (set->ignored, TRUE);
+  }
+#endif
 #else
   CloseHandle (set->wakeup_event);
 
@@ -859,6 +1135,10 @@ gst_poll_add_fd_unlocked (GstPoll * set, GstPollFD * fd)
     g_array_append_val (set->fds, nfd);
 
     fd->idx = set->fds->len - 1;
+#ifdef HAVE_SYS_EPOLL_H
+    if (set->epoll_fd >= 0)
+      gst_poll_epoll_ctl (set, EPOLL_CTL_ADD, fd->idx);
+#endif
 #else
     WinsockFd wfd;
     HANDLE event;
@@ -916,6 +1196,9 @@ gst_poll_add_fd (GstPoll * set, GstPollFD * fd)
  *
  * Remove a file descriptor from the file descriptor set.
  *
+ * The file descriptor should be removed before it is closed. Sets backed by
+ * epoll stop polling a closed file descriptor without reporting it.
+ *
  * Returns: %TRUE if the file descriptor was successfully removed from the set.
  */
 gboolean
@@ -938,12 +1221,21 @@ gst_poll_remove_fd (GstPoll * set, GstPollFD * fd)
 #ifdef G_OS_WIN32
     gst_poll_free_winsock_event (set, idx);
     g_array_remove_index_fast (set->events, idx);
+#elif defined(HAVE_SYS_EPOLL_H)
+    if (set->epoll_fd >= 0)
+      gst_poll_epoll_remove (set, fd->fd);
 #endif
 
     /* remove the fd at index, we use _remove_index_fast, which copies the last
      * element of the array to the freed index */
     g_array_remove_index_fast (set->fds, idx);
 
+#ifdef HAVE_SYS_EPOLL_H
+    /* the moved fd needs its new index */
+    if (set->epoll_fd >= 0 && idx < set->fds->len)
+      gst_poll_epoll_ctl (set, EPOLL_CTL_MOD, idx);
+#endif
+
     /* mark fd as removed by setting the index to -1 */
     fd->idx = -1;
     MARK_REBUILD (set);
@@ -992,6 +1284,10 @@ gst_poll_fd_ctl_write (GstPoll * set, GstPollFD * fd, gboolean active)
       pfd->events &= ~POLLOUT;
 
     GST_LOG ("%p: pfd->events now %d (POLLOUT:%d)", set, pfd->events, POLLOUT);
+#ifdef HAVE_SYS_EPOLL_H
+    if (set->epoll_fd >= 0)
+      gst_poll_epoll_ctl (set, EPOLL_CTL_MOD, idx);
+#endif
 #else
     gst_poll_update_winsock_event_mask (set, idx, FD_WRITE | FD_CONNECT,
         active);
@@ -1024,6 +1320,10 @@ gst_poll_fd_ctl_read_unlocked (GstPoll * set, GstPollFD * fd, gboolean active)
       pfd->events |= POLLIN;
     else
       pfd->events &= ~POLLIN;
+#ifdef HAVE_SYS_EPOLL_H
+    if (set->epoll_fd >= 0)
+      gst_poll_epoll_ctl (set, EPOLL_CTL_MOD, idx);
+#endif
 #else
     gst_poll_update_winsock_event_mask (set, idx, FD_READ | FD_ACCEPT, active);
 #endif
@@ -1106,6 +1406,10 @@ gst_poll_fd_ctl_pri (GstPoll * set, GstPollFD * fd, gboolean active)
       pfd->events &= ~POLLPRI;
 
     GST_LOG ("%p: pfd->events now %d (POLLPRI:%d)", set, pfd->events, POLLOUT);
+#ifdef HAVE_SYS_EPOLL_H
+    if (set->epoll_fd >= 0)
+      gst_poll_epoll_ctl (set, EPOLL_CTL_MOD, idx);
+#endif
     MARK_REBUILD (set);
   } else {
     GST_WARNING ("%p: couldn't find fd !", set);
@@ -1129,12 +1433,35 @@ gst_poll_fd_ctl_pri (GstPoll * set, GstPollFD * fd, gboolean active)
  *
  * The reason why this is needed is because the underlying implementation
  * might not allow querying the fd more than once between calls to one of
- * the re-enabling operations.
+ * the re-enabling operations. This is also the case for sets in
+ * edge-triggered mode, see gst_poll_set_edge_triggered().
  */
 void
 gst_poll_fd_ignored (GstPoll * set, GstPollFD * fd)
 {
-#ifdef G_OS_WIN32
+#if defined(HAVE_SYS_EPOLL_H) && !defined(G_OS_WIN32)
+  gint idx;
+
+  g_return_if_fail (set != NULL);
+  g_return_if_fail (fd != NULL);
+  g_return_if_fail (fd->fd >= 0);
+
+  /* level-triggered epoll reports the fd again by itself */
+  if (!set->edge_triggered)
+    return;
+
+  g_mutex_lock (&set->lock);
+
+  idx = find_index (set->active_fds, fd);
+  if (idx >= 0) {
+    struct pollfd ifd = g_array_index (set->active_fds, struct pollfd, idx);
+
+    if (ifd.revents != 0)
+      g_array_append_val (set->ignored, ifd);
+  }
+
+  g_mutex_unlock (&set->lock);
+#elif defined(G_OS_WIN32)
   gint idx;
 
   g_return_if_fail (set != NULL);
@@ -1434,7 +1761,9 @@ gst_poll_wait (GstPoll * set, GstClockTime timeout)
 
     mode = choose_mode (set, timeout);
 
-    if (TEST_REBUILD (set)) {
+    /* the epoll set is updated as fds change, active_fds is updated after
+     * the wait */
+    if (mode != GST_POLL_MODE_EPOLL && TEST_REBUILD (set)) {
       g_mutex_lock (&set->lock);
 #ifndef G_OS_WIN32
       g_array_set_size (set->active_fds, set->fds->len);
@@ -1550,6 +1879,16 @@ gst_poll_wait (GstPoll * set, GstClockTime timeout)
 #else /* G_OS_WIN32 */
         g_assert_not_reached ();
         errno = ENOSYS;
+#endif
+        break;
+      }
+      case GST_POLL_MODE_EPOLL:
+      {
+#ifdef HAVE_SYS_EPOLL_H
+        res = gst_poll_epoll_wait (set, timeout);
+#else
+        g_assert_not_reached ();
+        errno = ENOSYS;
 #endif
         break;
       }
@@ -1671,6 +2010,54 @@ gst_poll_set_controllable (GstPoll * set, gboolean controllable)
   return TRUE;
 }
 
+/**
+ * gst_poll_set_edge_triggered:
+ * @set: a #GstPoll.
+ * @edge_triggered: new edge-triggered state.
+ *
+ * When @edge_triggered is %TRUE, gst_poll_wait() only reports a file
+ * descriptor again after new activity happened on it, instead of for as long
+ * as it is readable or writable. The caller then has to read or write until
+ * the operation would block, or call gst_poll_fd_ignored() to have the next
+ * gst_poll_wait() report the descriptor again.
+ *
+ * This is only supported for non-timer #GstPoll objects created with
+ * gst_poll_new() on systems with epoll.
+ *
+ * Returns: %TRUE if the edge-triggered state of @set could be updated.
+ *
+ * Since: 1.20
+ */
+gboolean
+gst_poll_set_edge_triggered (GstPoll * set, gboolean edge_triggered)
+{
+#if defined(HAVE_SYS_EPOLL_H) && !defined(G_OS_WIN32)
+  guint i;
+
+  g_return_val_if_fail (set != NULL, FALSE);
+
+  if (set->epoll_fd < 0)
+    return FALSE;
+
+  GST_LOG ("%p: edge-triggered : %d", set, edge_triggered);
+
+  g_mutex_lock (&set->lock);
+  if (set->edge_triggered != edge_triggered) {
+    set->edge_triggered = edge_triggered;
+    for (i = 0; i < set->fds->len; i++)
+      gst_poll_epoll_ctl (set, EPOLL_CTL_MOD, i);
+    g_array_set_size (set->ignored, 0);
+  }
+  g_mutex_unlock (&set->lock);
+
+  return TRUE;
+#else
+  g_return_val_if_fail (set != NULL, FALSE);
+
+  return !edge_triggered;
+#endif
+}
+
 /**
  * gst_poll_restart:
  * @set: a #GstPoll.
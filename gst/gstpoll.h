@@ -115,6 +115,9 @@ gint            gst_poll_wait             (GstPoll *set, GstClockTime timeout);
 GST_API
 gboolean        gst_poll_set_controllable (GstPoll *set, gboolean controllable);
 
+GST_API
+gboolean        gst_poll_set_edge_triggered (GstPoll *set, gboolean edge_triggered);
+
 GST_API
 void            gst_poll_restart          (GstPoll *set);
 
@@ -29,6 +29,12 @@
  * The GStreamer core provides a GstSystemClock based on the system time.
  * Asynchronous callbacks are scheduled from an internal thread.
  *
+ * On Linux, pending async notifications are kept in a min-heap serviced by
+ * a single thread sleeping on a timerfd, so that thousands of outstanding
+ * entries cost one kernel timer. The #GstSystemClock:timer-slack property
+ * allows delaying callbacks slightly so that entries due close to each
+ * other are dispatched from the same wakeup.
+ *
  * Clock implementors are encouraged to subclass this systemclock as it
  * implements the async notification.
  *
@@ -47,6 +53,13 @@
 
 #include <errno.h>
 
+#ifdef HAVE_SYS_TIMERFD_H
+#include <unistd.h>
+#include <poll.h>
+#include <sys/timerfd.h>
+#include <sys/eventfd.h>
+#endif
+
 #ifdef G_OS_WIN32
 #  define WIN32_LEAN_AND_MEAN   /* prevents from including too many things */
 #  include <windows.h>          /* QueryPerformance* stuff */
@@ -99,6 +112,10 @@ struct _GstClockEntryFutex
   GDestroyNotify destroy_entry;
 
   gboolean initialized;
+#ifdef HAVE_SYS_TIMERFD_H
+  /* position in the heap plus one, 0 when not in the heap */
+  guint heap_pos;
+#endif
 
   GMutex lock;
   guint cond_val;
@@ -172,6 +189,10 @@ struct _GstClockEntryPThread
   GDestroyNotify destroy_entry;
 
   gboolean initialized;
+#ifdef HAVE_SYS_TIMERFD_H
+  /* position in the heap plus one, 0 when not in the heap */
+  guint heap_pos;
+#endif
 
   pthread_cond_t cond;
   pthread_mutex_t lock;
@@ -304,6 +325,10 @@ struct _GstClockEntryGLib
   GDestroyNotify destroy_entry;
 
   gboolean initialized;
+#ifdef HAVE_SYS_TIMERFD_H
+  /* position in the heap plus one, 0 when not in the heap */
+  guint heap_pos;
+#endif
 
   GMutex lock;
   GCond cond;
@@ -350,6 +375,16 @@ struct _GstSystemClockPrivate
 
   GstClockType clock_type;
 
+#ifdef HAVE_SYS_TIMERFD_H
+  /* when timer_fd is valid, async entries live in heap instead of entries
+   * and are serviced by gst_system_clock_timer_thread() */
+  gint timer_fd;
+  gint wakeup_fd;
+  gboolean wakeup_pending;
+  GPtrArray *heap;
+#endif
+  GstClockTime timer_slack;
+
 #ifdef G_OS_WIN32
   LARGE_INTEGER frequency;
 #endif                          /* G_OS_WIN32 */
@@ -358,6 +393,139 @@ struct _GstSystemClockPrivate
 #endif
 };
 
+#ifdef HAVE_SYS_TIMERFD_H
+/* The pending async entries form a binary min-heap ordered on the entry time.
+ * Every entry remembers its position so that unscheduled entries can be
+ * taken out of the middle of the heap right away. Must be called with the
+ * clock lock. */
+#define HEAP_ENTRY_POS(entry) (((GstClockEntryImpl *) (entry))->heap_pos)
+
+static inline void
+gst_system_clock_heap_set (GPtrArray * heap, guint idx, GstClockEntry * entry)
+{
+  heap->pdata[idx] = entry;
+  HEAP_ENTRY_POS (entry) = idx + 1;
+}
+
+static void
+gst_system_clock_heap_sift_up (GPtrArray * heap, guint idx,
+    GstClockEntry * entry)
+{
+  while (idx > 0) {
+    guint parent = (idx - 1) / 2;
+    GstClockEntry *p = heap->pdata[parent];
+
+    if (GST_CLOCK_ENTRY_TIME (p) <= GST_CLOCK_ENTRY_TIME (entry))
+      break;
+
+    gst_system_clock_heap_set (heap, idx, p);
+    idx = parent;
+  }
+  gst_system_clock_heap_set (heap, idx, entry);
+}
+
+static void
+gst_system_clock_heap_sift_down (GPtrArray * heap, guint idx,
+    GstClockEntry * entry)
+{
+  guint len = heap->len;
+
+  for (;;) {
+    guint child = 2 * idx + 1;
+    GstClockEntry *c;
+
+    if (child >= len)
+      break;
+    if (child + 1 < len &&
+        GST_CLOCK_ENTRY_TIME (heap->pdata[child + 1]) <
+        GST_CLOCK_ENTRY_TIME (heap->pdata[child]))
+      child++;
+
+    c = heap->pdata[child];
+    if (GST_CLOCK_ENTRY_TIME (entry) <= GST_CLOCK_ENTRY_TIME (c))
+      break;
+
+    gst_system_clock_heap_set (heap, idx, c);
+    idx = child;
+  }
+  gst_system_clock_heap_set (heap, idx, entry);
+}
+
+static void
+gst_system_clock_heap_push (GPtrArray * heap, GstClockEntry * entry)
+{
+  g_ptr_array_add (heap, entry);
+  gst_system_clock_heap_sift_up (heap, heap->len - 1, entry);
+}
+
+/* remove the entry at @idx and fill the hole with the last entry */
+static GstClockEntry *
+gst_system_clock_heap_remove (GPtrArray * heap, guint idx)
+{
+  GstClockEntry *entry, *last;
+
+  entry = heap->pdata[idx];
+  last = heap->pdata[heap->len - 1];
+  g_ptr_array_set_size (heap, heap->len - 1);
+  HEAP_ENTRY_POS (entry) = 0;
+
+  if (idx < heap->len) {
+    if (GST_CLOCK_ENTRY_TIME (last) < GST_CLOCK_ENTRY_TIME (entry))
+      gst_system_clock_heap_sift_up (heap, idx, last);
+    else
+      gst_system_clock_heap_sift_down (heap, idx, last);
+  }
+
+  return entry;
+}
+
+/* Wake up the timer thread so that it rearms the timer */
+static void
+gst_system_clock_timer_wakeup (GstSystemClockPrivate * priv)
+{
+  guint64 one = 1;
+
+  while (write (priv->wakeup_fd, &one, sizeof (one)) < 0 && errno == EINTR);
+}
+
+/* Create the fds for the timer thread. Must be called with the clock lock.
+ * Returns FALSE when timerfd is not usable, in which case the condition
+ * variable based async thread is used. */
+static gboolean
+gst_system_clock_open_timer (GstSystemClock * clock)
+{
+  GstSystemClockPrivate *priv = clock->priv;
+
+  priv->timer_fd = timerfd_create (CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+  if (priv->timer_fd < 0)
+    goto no_timerfd;
+
+  priv->wakeup_fd = eventfd (0, EFD_CLOEXEC | EFD_NONBLOCK);
+  if (priv->wakeup_fd < 0)
+    goto no_eventfd;
+
+  priv->heap = g_ptr_array_new ();
+
+  return TRUE;
+
+  /* ERRORS */
+no_timerfd:
+  {
+    GST_CAT_INFO_OBJECT (GST_CAT_CLOCK, clock,
+        "timerfd not available: %s", g_strerror (errno));
+    return FALSE;
+  }
+no_eventfd:
+  {
+    GST_CAT_INFO_OBJECT (GST_CAT_CLOCK, clock,
+        "eventfd not available: %s", g_strerror (errno));
+    close (priv->timer_fd);
+    priv->timer_fd = -1;
+    return FALSE;
+  }
+}
+#endif /* HAVE_SYS_TIMERFD_H */
+
 #ifdef HAVE_POSIX_TIMERS
 # ifdef HAVE_MONOTONIC_CLOCK
 #  define DEFAULT_CLOCK_TYPE GST_CLOCK_TYPE_MONOTONIC
@@ -368,10 +536,13 @@ struct _GstSystemClockPrivate
 #define DEFAULT_CLOCK_TYPE GST_CLOCK_TYPE_MONOTONIC
 #endif
 
+#define DEFAULT_TIMER_SLACK 0
+
 enum
 {
   PROP_0,
   PROP_CLOCK_TYPE,
+  PROP_TIMER_SLACK,
   /* FILL ME */
 };
 
@@ -401,6 +572,9 @@ static GstClockReturn gst_system_clock_id_wait_async (GstClock * clock,
 static void gst_system_clock_id_unschedule (GstClock * clock,
     GstClockEntry * entry);
 static void gst_system_clock_async_thread (GstClock * clock);
+#ifdef HAVE_SYS_TIMERFD_H
+static void gst_system_clock_timer_thread (GstClock * clock);
+#endif
 static gboolean gst_system_clock_start_async (GstSystemClock * clock);
 
 static GMutex _gst_sysclock_mutex;
@@ -429,6 +603,24 @@ gst_system_clock_class_init (GstSystemClockClass * klass)
           GST_TYPE_CLOCK_TYPE, DEFAULT_CLOCK_TYPE,
           G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
+  /**
+   * GstSystemClock:timer-slack:
+   *
+   * Maximum time by which async notifications may be delayed so that
+   * notifications due close to each other are dispatched from a single
+   * wakeup of the clock thread. Callbacks are never fired early.
+   *
+   * This is only used on platforms where async notifications are serviced
+   * by a kernel timer (currently Linux).
+   *
+   * Since: 1.20
+   */
+  g_object_class_install_property (gobject_class, PROP_TIMER_SLACK,
+      g_param_spec_uint64 ("timer-slack", "Timer slack",
+          "Maximum delay of async notifications used to coalesce wakeups "
+          "(in nanoseconds)", 0, G_MAXUINT64, DEFAULT_TIMER_SLACK,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
   gstclock_class->get_internal_time = gst_system_clock_get_internal_time;
   gstclock_class->get_resolution = gst_system_clock_get_resolution;
   gstclock_class->wait = gst_system_clock_id_wait_jitter;
@@ -454,6 +646,12 @@ gst_system_clock_init (GstSystemClock * clock)
   priv->entries = NULL;
   g_cond_init (&priv->entries_changed);
 
+#ifdef HAVE_SYS_TIMERFD_H
+  priv->timer_fd = -1;
+  priv->wakeup_fd = -1;
+#endif
+  priv->timer_slack = DEFAULT_TIMER_SLACK;
+
 #ifdef G_OS_WIN32
   QueryPerformanceFrequency (&priv->frequency);
 #endif /* G_OS_WIN32 */
@@ -481,6 +679,18 @@ gst_system_clock_dispose (GObject * object)
   /* else we have to stop the thread */
   GST_SYSTEM_CLOCK_LOCK (clock);
   priv->stopping = TRUE;
+#ifdef HAVE_SYS_TIMERFD_H
+  if (priv->heap) {
+    guint i;
+
+    /* the timer thread only looks at entries with the clock lock, and
+     * checks for stopping after each wakeup */
+    for (i = 0; i < priv->heap->len; i++)
+      GST_CLOCK_ENTRY_STATUS ((GstClockEntry *) priv->heap->pdata[i]) =
+          GST_CLOCK_UNSCHEDULED;
+    gst_system_clock_timer_wakeup (priv);
+  }
+#endif
   /* unschedule all entries */
   for (entries = priv->entries; entries; entries = g_list_next (entries)) {
     GstClockEntryImpl *entry = (GstClockEntryImpl *) entries->data;
@@ -520,6 +730,26 @@ gst_system_clock_dispose (GObject * object)
   g_list_free (priv->entries);
   priv->entries = NULL;
 
+#ifdef HAVE_SYS_TIMERFD_H
+  if (priv->heap) {
+    guint i;
+
+    for (i = 0; i < priv->heap->len; i++) {
+      GstClockEntry *entry = priv->heap->pdata[i];
+
+      HEAP_ENTRY_POS (entry) = 0;
+      gst_clock_id_unref ((GstClockID) entry);
+    }
+    g_ptr_array_free (priv->heap, TRUE);
+    priv->heap = NULL;
+  }
+  if (priv->timer_fd >= 0)
+    close (priv->timer_fd);
+  if (priv->wakeup_fd >= 0)
+    close (priv->wakeup_fd);
+  priv->timer_fd = priv->wakeup_fd = -1;
+#endif
+
   g_cond_clear (&priv->entries_changed);
 
   G_OBJECT_CLASS (parent_class)->dispose (object);
@@ -542,6 +772,11 @@ gst_system_clock_set_property (GObject * object, guint prop_id,
       GST_CAT_DEBUG_OBJECT (GST_CAT_CLOCK, sysclock, "clock-type set to %d",
           sysclock->priv->clock_type);
       break;
+    case PROP_TIMER_SLACK:
+      GST_SYSTEM_CLOCK_LOCK (sysclock);
+      sysclock->priv->timer_slack = g_value_get_uint64 (value);
+      GST_SYSTEM_CLOCK_UNLOCK (sysclock);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -558,6 +793,11 @@ gst_system_clock_get_property (GObject * object, guint prop_id, GValue * value,
     case PROP_CLOCK_TYPE:
       g_value_set_enum (value, sysclock->priv->clock_type);
       break;
+    case PROP_TIMER_SLACK:
+      GST_SYSTEM_CLOCK_LOCK (sysclock);
+      g_value_set_uint64 (value, sysclock->priv->timer_slack);
+      GST_SYSTEM_CLOCK_UNLOCK (sysclock);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -805,6 +1045,160 @@ exit:
   GST_CAT_DEBUG_OBJECT (GST_CAT_CLOCK, clock, "exit system clock thread");
 }
 
+#ifdef HAVE_SYS_TIMERFD_H
+/* Arm the timerfd for the entry at the top of the heap, or disarm it when
+ * the heap is empty. @now is the clock time sampled at @mono_now. The
+ * deadline is rounded up to a multiple of the timer slack so that entries
+ * due within the same slack window share a wakeup. */
+static void
+gst_system_clock_timer_arm (GstSystemClock * sysclock, GstClockTime now,
+    GstClockTime mono_now)
+{
+  GstSystemClockPrivate *priv = sysclock->priv;
+  struct itimerspec its = { {0,}, {0,} };
+
+  if (priv->heap->len > 0) {
+    GstClockEntry *head = priv->heap->pdata[0];
+    GstClockTime deadline;
+
+    /* the head is not due yet, so this is in the future */
+    deadline = mono_now + GST_CLOCK_DIFF (now, GST_CLOCK_ENTRY_TIME (head));
+    if (priv->timer_slack > 0 && deadline <= G_MAXUINT64 - priv->timer_slack)
+      deadline = ((deadline + priv->timer_slack - 1) / priv->timer_slack) *
+          priv->timer_slack;
+    GST_TIME_TO_TIMESPEC (deadline, its.it_value);
+  }
+
+  if (timerfd_settime (priv->timer_fd, TFD_TIMER_ABSTIME, &its, NULL) < 0)
+    GST_CAT_ERROR_OBJECT (GST_CAT_CLOCK, sysclock,
+        "failed to arm timer: %s", g_strerror (errno));
+}
+
+/* Thread servicing the async entries when timerfd is available.
+ *
+ * All entries that are due are taken from the heap in one go and their
+ * callbacks are fired without the clock lock held. Periodic entries are then
+ * pushed back with their next time. When nothing is due the timerfd is armed
+ * for the first pending entry and the thread sleeps until either the timer
+ * fires or gst_system_clock_id_wait_async() added an entry in front of the
+ * heap.
+ *
+ * MT safe.
+ */
+static void
+gst_system_clock_timer_thread (GstClock * clock)
+{
+  GstSystemClock *sysclock = GST_SYSTEM_CLOCK_CAST (clock);
+  GstSystemClockPrivate *priv = sysclock->priv;
+  GPtrArray *batch;
+  gssize res G_GNUC_UNUSED;
+  guint i;
+
+  GST_CAT_DEBUG_OBJECT (GST_CAT_CLOCK, clock, "enter system clock thread");
+  batch = g_ptr_array_new ();
+
+  GST_SYSTEM_CLOCK_LOCK (clock);
+  /* signal spinup */
+  GST_SYSTEM_CLOCK_BROADCAST (clock);
+  while (!priv->stopping) {
+    GstClockTime now, mono_now;
+
+    /* gst_clock_get_time() can take the object lock */
+    GST_SYSTEM_CLOCK_UNLOCK (clock);
+    now = gst_clock_get_time (clock);
+    mono_now = g_get_monotonic_time () * GST_USECOND;
+    GST_SYSTEM_CLOCK_LOCK (clock);
+
+    if (priv->stopping)
+      break;
+
+    /* collect all entries that are due */
+    while (priv->heap->len > 0) {
+      GstClockEntry *entry = priv->heap->pdata[0];
+
+      if (GST_CLOCK_DIFF (now, GST_CLOCK_ENTRY_TIME (entry)) >
+          CLOCK_MIN_WAIT_TIME)
+        break;
+
+      g_ptr_array_add (batch, gst_system_clock_heap_remove (priv->heap, 0));
+    }
+
+    if (batch->len == 0) {
+      struct pollfd fds[2];
+      guint64 val;
+
+      gst_system_clock_timer_arm (sysclock, now, mono_now);
+      priv->wakeup_pending = FALSE;
+      GST_SYSTEM_CLOCK_UNLOCK (clock);
+
+      fds[0].fd = priv->timer_fd;
+      fds[0].events = POLLIN;
+      fds[1].fd = priv->wakeup_fd;
+      fds[1].events = POLLIN;
+
+      GST_CAT_LOG_OBJECT (GST_CAT_CLOCK, clock, "waiting for timer");
+      if (poll (fds, 2, -1) < 0 && errno != EINTR)
+        GST_CAT_ERROR_OBJECT (GST_CAT_CLOCK, clock, "poll failed: %s",
+            g_strerror (errno));
+
+      /* only drain them, the heap is looked at again below */
+      if (fds[0].revents & POLLIN)
+        res = read (priv->timer_fd, &val, sizeof (val));
+      if (fds[1].revents & POLLIN)
+        res = read (priv->wakeup_fd, &val, sizeof (val));
+
+      GST_SYSTEM_CLOCK_LOCK (clock);
+      continue;
+    }
+
+    GST_CAT_LOG_OBJECT (GST_CAT_CLOCK, clock, "%u async entries due",
+        batch->len);
+    GST_SYSTEM_CLOCK_UNLOCK (clock);
+
+    for (i = 0; i < batch->len; i++) {
+      GstClockEntry *entry = batch->pdata[i];
+
+      GST_SYSTEM_CLOCK_ENTRY_LOCK ((GstClockEntryImpl *) entry);
+      if (G_UNLIKELY (GST_CLOCK_ENTRY_STATUS (entry) == GST_CLOCK_UNSCHEDULED)) {
+        GST_SYSTEM_CLOCK_ENTRY_UNLOCK ((GstClockEntryImpl *) entry);
+        continue;
+      }
+      GST_CLOCK_ENTRY_STATUS (entry) = GST_CLOCK_OK;
+      GST_SYSTEM_CLOCK_ENTRY_UNLOCK ((GstClockEntryImpl *) entry);
+
+      GST_CAT_DEBUG_OBJECT (GST_CAT_CLOCK, clock, "async entry %p timed out",
+          entry);
+      if (entry->func)
+        entry->func (clock, entry->time, (GstClockID) entry, entry->user_data);
+    }
+
+    GST_SYSTEM_CLOCK_LOCK (clock);
+    for (i = 0; i < batch->len; i++) {
+      GstClockEntry *entry = batch->pdata[i];
+
+      if (entry->type == GST_CLOCK_ENTRY_PERIODIC && !priv->stopping &&
+          GST_CLOCK_ENTRY_STATUS (entry) != GST_CLOCK_UNSCHEDULED) {
+        GST_CAT_DEBUG_OBJECT (GST_CAT_CLOCK, clock,
+            "updating periodic entry %p", entry);
+        entry->time += entry->interval;
+        /* keeps the reference of the batch */
+        gst_system_clock_heap_push (priv->heap, entry);
+      } else {
+        gst_clock_id_unref ((GstClockID) entry);
+      }
+    }
+    g_ptr_array_set_size (batch, 0);
+  }
+
+  /* signal exit */
+  GST_SYSTEM_CLOCK_BROADCAST (clock);
+  GST_SYSTEM_CLOCK_UNLOCK (clock);
+
+  g_ptr_array_free (batch, TRUE);
+  GST_CAT_DEBUG_OBJECT (GST_CAT_CLOCK, clock, "exit system clock thread");
+}
+#endif /* HAVE_SYS_TIMERFD_H */
+
 #ifdef HAVE_POSIX_TIMERS
 static inline clockid_t
 clock_type_to_posix_id (GstClockType clock_type)
@@ -1135,12 +1529,17 @@ gst_system_clock_start_async (GstSystemClock * clock)
 {
   GError *error = NULL;
   GstSystemClockPrivate *priv = clock->priv;
+  GThreadFunc func = (GThreadFunc) gst_system_clock_async_thread;
 
   if (G_LIKELY (priv->thread != NULL))
     return TRUE;                /* Thread already running. Nothing to do */
 
-  priv->thread = g_thread_try_new ("GstSystemClock",
-      (GThreadFunc) gst_system_clock_async_thread, clock, &error);
+#ifdef HAVE_SYS_TIMERFD_H
+  if (priv->timer_fd >= 0 || gst_system_clock_open_timer (clock))
+    func = (GThreadFunc) gst_system_clock_timer_thread;
+#endif
+
+  priv->thread = g_thread_try_new ("GstSystemClock", func, clock, &error);
 
   if (G_UNLIKELY (error))
     goto no_thread;
@@ -1189,6 +1588,25 @@ gst_system_clock_id_wait_async (GstClock * clock, GstClockEntry * entry)
     goto was_unscheduled;
   GST_SYSTEM_CLOCK_ENTRY_UNLOCK ((GstClockEntryImpl *) entry);
 
+#ifdef HAVE_SYS_TIMERFD_H
+  if (priv->heap) {
+    gst_clock_id_ref ((GstClockID) entry);
+    gst_system_clock_heap_push (priv->heap, entry);
+
+    /* the thread only needs to rearm its timer when the entry became the
+     * first one, and only once until it looked at the heap again */
+    if (priv->heap->pdata[0] == entry && !priv->wakeup_pending) {
+      GST_CAT_DEBUG_OBJECT (GST_CAT_CLOCK, clock,
+          "async entry added to head, waking up timer thread");
+      priv->wakeup_pending = TRUE;
+      gst_system_clock_timer_wakeup (priv);
+    }
+    GST_SYSTEM_CLOCK_UNLOCK (clock);
+
+    return GST_CLOCK_OK;
+  }
+#endif
+
   if (priv->entries)
     head = priv->entries->data;
   else
@@ -1264,6 +1682,7 @@ static void
 gst_system_clock_id_unschedule (GstClock * clock, GstClockEntry * entry)
 {
   GstClockReturn status;
+  GstClockEntry *removed = NULL;
 
   GST_SYSTEM_CLOCK_LOCK (clock);
 
@@ -1283,5 +1702,22 @@ gst_system_clock_id_unschedule (GstClock * clock, GstClockEntry * entry)
     GST_SYSTEM_CLOCK_ENTRY_BROADCAST ((GstClockEntryImpl *) entry);
   }
   GST_SYSTEM_CLOCK_ENTRY_UNLOCK ((GstClockEntryImpl *) entry);
+
+#ifdef HAVE_SYS_TIMERFD_H
+  /* take pending async entries out of the heap right away instead of keeping
+   * them until their time comes. The timer may stay armed for a removed head,
+   * the timer thread then only rearms it. */
+  if (GST_SYSTEM_CLOCK_CAST (clock)->priv->heap &&
+      HEAP_ENTRY_POS (entry) > 0) {
+    GST_CAT_DEBUG_OBJECT (GST_CAT_CLOCK, clock,
+        "removing async entry %p from the heap", entry);
+    removed = gst_system_clock_heap_remove (GST_SYSTEM_CLOCK_CAST (clock)->
+        priv->heap, HEAP_ENTRY_POS (entry) - 1);
+  }
+#endif
   GST_SYSTEM_CLOCK_UNLOCK (clock);
+
+  /* drop the reference of the heap */
+  if (removed)
+    gst_clock_id_unref ((GstClockID) removed);
 }
@@ -27,6 +27,11 @@
  * Tracing modules will create instances of this class to announce the data they
  * will log and create a log formatter.
  *
+ * By default the records are formatted as text into the debug log. When the
+ * `GST_TRACER_FILE` environment variable is set, they are instead written in
+ * a compact binary format to the given file, which `gst-stats` can read
+ * directly. (Since: 1.20)
+ *
  * Since: 1.8
  */
 
@@ -37,16 +42,48 @@
 #include "gsttracerrecord.h"
 #include "gstvalue.h"
 #include <gobject/gvaluecollector.h>
+#include <glib/gstdio.h>
+#include <errno.h>
+#include <string.h>
 
 GST_DEBUG_CATEGORY_EXTERN (tracer_debug);
 #define GST_CAT_DEFAULT tracer_debug
 
+/* How the value of a field is stored in the binary trace file. The values are
+ * part of the file format, don't change them. */
+typedef enum
+{
+  GST_TRACER_FIELD_INT32 = 1,   /* int, uint, boolean, enums and flags */
+  GST_TRACER_FIELD_INT64 = 2,   /* int64 and uint64 */
+  GST_TRACER_FIELD_DOUBLE = 3,  /* float and double */
+  GST_TRACER_FIELD_POINTER = 4, /* pointers, stored in 64 bits */
+  GST_TRACER_FIELD_STRING = 5,  /* strings and GTypes, passed as string */
+  GST_TRACER_FIELD_SERIALIZED = 6       /* everything else, as a string */
+} GstTracerFieldKind;
+
+typedef struct
+{
+  GQuark name;
+  GType type;
+  GstTracerFieldKind kind;
+} GstTracerRecordField;
+
 struct _GstTracerRecord
 {
   GstObject parent;
 
   GstStructure *spec;
   gchar *format;
+
+  /* the fields in the order they are passed to gst_tracer_record_log(),
+   * including the booleans of the optional fields */
+  GstTracerRecordField *fields;
+  guint n_fields;
+
+  /* id of the record in the binary trace file, set when the record is
+   * announced there */
+  guint32 id;
+  gint announced;               /* ATOMIC */
 };
 
 struct _GstTracerRecordClass
@@ -95,6 +132,68 @@ build_field_template (GQuark field_id, const GValue * value, gpointer user_data)
   return res;
 }
 
+static GstTracerFieldKind
+gst_tracer_field_kind (GType type)
+{
+  switch (G_TYPE_FUNDAMENTAL (type)) {
+    case G_TYPE_INT:
+    case G_TYPE_UINT:
+    case G_TYPE_BOOLEAN:
+    case G_TYPE_ENUM:
+    case G_TYPE_FLAGS:
+      return GST_TRACER_FIELD_INT32;
+    case G_TYPE_INT64:
+    case G_TYPE_UINT64:
+      return GST_TRACER_FIELD_INT64;
+    case G_TYPE_FLOAT:
+    case G_TYPE_DOUBLE:
+      return GST_TRACER_FIELD_DOUBLE;
+    case G_TYPE_POINTER:
+      return GST_TRACER_FIELD_POINTER;
+    case G_TYPE_STRING:
+      return GST_TRACER_FIELD_STRING;
+    default:
+      /* like the format template, GTypes are logged as their name */
+      if (type == G_TYPE_GTYPE)
+        return GST_TRACER_FIELD_STRING;
+      return GST_TRACER_FIELD_SERIALIZED;
+  }
+}
+
+static gboolean
+build_field_layout (GQuark field_id, const GValue * value, gpointer user_data)
+{
+  GArray *fields = (GArray *) user_data;
+  const GstStructure *sub;
+  GstTracerRecordField field;
+  GType type = G_TYPE_INVALID;
+  GstTracerValueFlags flags = GST_TRACER_VALUE_FLAGS_NONE;
+
+  if (G_VALUE_TYPE (value) != GST_TYPE_STRUCTURE)
+    return FALSE;
+
+  sub = gst_value_get_structure (value);
+  gst_structure_get (sub, "type", G_TYPE_GTYPE, &type, "flags",
+      GST_TYPE_TRACER_VALUE_FLAGS, &flags, NULL);
+
+  if (flags & GST_TRACER_VALUE_FLAGS_OPTIONAL) {
+    gchar *opt_name = g_strconcat ("have-", g_quark_to_string (field_id), NULL);
+
+    field.name = g_quark_from_string (opt_name);
+    field.type = G_TYPE_BOOLEAN;
+    field.kind = GST_TRACER_FIELD_INT32;
+    g_array_append_val (fields, field);
+    g_free (opt_name);
+  }
+
+  field.name = field_id;
+  field.type = type;
+  field.kind = gst_tracer_field_kind (type);
+  g_array_append_val (fields, field);
+
+  return TRUE;
+}
+
 static void
 gst_tracer_record_build_format (GstTracerRecord * self)
 {
@@ -124,6 +223,21 @@ gst_tracer_record_build_format (GstTracerRecord * self)
   g_free (name);
 }
 
+static void
+gst_tracer_record_build_layout (GstTracerRecord * self)
+{
+  GArray *fields;
+
+  /* the spec was already checked when building the format */
+  if (self->format == NULL)
+    return;
+
+  fields = g_array_new (FALSE, FALSE, sizeof (GstTracerRecordField));
+  gst_structure_foreach (self->spec, build_field_layout, fields);
+  self->n_fields = fields->len;
+  self->fields = (GstTracerRecordField *) g_array_free (fields, FALSE);
+}
+
 static void
 gst_tracer_record_dispose (GObject * object)
 {
@@ -135,6 +249,9 @@ gst_tracer_record_dispose (GObject * object)
   }
   g_free (self->format);
   self->format = NULL;
+  g_free (self->fields);
+  self->fields = NULL;
+  self->n_fields = 0;
 }
 
 static void
@@ -232,11 +349,484 @@ gst_tracer_record_new (const gchar * name, const gchar * firstfield, ...)
 
   self->spec = structure;
   gst_tracer_record_build_format (self);
+  gst_tracer_record_build_layout (self);
 
   return self;
 }
 
 #ifndef GST_DISABLE_GST_DEBUG
+
+/* binary trace file
+ *
+ * When GST_TRACER_FILE is set, gst_tracer_record_log() does not format the
+ * records as text but appends them to a ring buffer of the calling thread.
+ * Only that thread writes to the ring and only the writer thread reads from
+ * it, so logging a record is a couple of memcpy() without any lock. The
+ * writer thread regularly drains all rings into the file. Records that don't
+ * fit into the ring of their thread are dropped and counted.
+ *
+ * The file starts with a GstTracerFileHeader, followed by records in host
+ * byte order that all start with a GstTracerFileRecord:
+ *
+ * - id 0 announces a record type. It contains the id that is used for the
+ *   records of that type, the name of the type without the ".class" suffix,
+ *   the number of fields and for each field its name, the name of its GType
+ *   and the GstTracerFieldKind that says how the value is stored.
+ * - id G_MAXUINT32 contains the 32 bit number of records that were dropped
+ *   so far. It is written whenever that number grew.
+ * - any other id is a record of an announced type with the values stored
+ *   one after the other, 4 bytes for GST_TRACER_FIELD_INT32, 8 bytes for
+ *   GST_TRACER_FIELD_INT64, GST_TRACER_FIELD_DOUBLE and
+ *   GST_TRACER_FIELD_POINTER, and a string for the other kinds.
+ *
+ * Strings are stored as a 32 bit length followed by the bytes without a
+ * terminator, a length of G_MAXUINT32 is a NULL string.
+ *
+ * A record type is always announced before the first record of that type is
+ * logged, and under the lock of the writer, so it ends up in the file before
+ * any record of that type.
+ *
+ * The records of one thread are in the order of their timestamps, the writer
+ * merges the rings so that the file is in that order too. A thread can take
+ * the timestamp of a record and publish it a bit later, so the writer holds
+ * back the records of the last TRACER_WRITER_INTERVAL until the next drain.
+ *
+ * tools/gst-stats.c has its own copy of these definitions.
+ */
+#define TRACER_FILE_MAGIC "GSTTRACE"
+#define TRACER_FILE_VERSION 1
+#define TRACER_FILE_BYTE_ORDER 0x01020304
+
+#define TRACER_FILE_ID_DROPPED G_MAXUINT32
+
+#define TRACER_RING_SIZE (256 * 1024)
+#define TRACER_WRITER_INTERVAL (50 * G_TIME_SPAN_MILLISECOND)
+
+typedef struct
+{
+  gchar magic[8];
+  guint32 version;
+  guint32 byte_order;
+} GstTracerFileHeader;
+
+typedef struct
+{
+  guint32 size;                 /* including this header */
+  guint32 id;
+  guint64 ts;
+} GstTracerFileRecord;
+
+typedef struct _GstTracerRing GstTracerRing;
+
+struct _GstTracerRing
+{
+  gint refcount;                /* ATOMIC, thread and writer */
+  guint8 *data;
+  guint mask;
+  gint head;                    /* ATOMIC, moved by the writer */
+  gint tail;                    /* ATOMIC, moved by the thread */
+  gint orphaned;                /* ATOMIC, set when the thread exits */
+
+  /* only used by the thread */
+  GByteArray *scratch;
+
+  /* protected by the writer lock */
+  GstTracerRing *next;
+  guint drain_pos;              /* next record to write to the file */
+  guint drain_end;              /* end of the records published so far */
+};
+
+static FILE *tracer_file = NULL;
+static GMutex tracer_lock;
+static GCond tracer_cond;
+static GThread *tracer_thread = NULL;
+static gboolean tracer_running = FALSE;
+static GstTracerRing *tracer_rings = NULL;
+static guint32 tracer_next_id = 1;
+static gint tracer_dropped = 0;
+static guint tracer_dropped_written = 0;
+
+static void
+gst_tracer_ring_unref (GstTracerRing * ring)
+{
+  if (g_atomic_int_dec_and_test (&ring->refcount)) {
+    g_byte_array_unref (ring->scratch);
+    g_free (ring->data);
+    g_free (ring);
+  }
+}
+
+static void
+gst_tracer_ring_orphan (gpointer data)
+{
+  GstTracerRing *ring = data;
+
+  g_atomic_int_set (&ring->orphaned, TRUE);
+  gst_tracer_ring_unref (ring);
+}
+
+static GPrivate tracer_ring_key = G_PRIVATE_INIT (gst_tracer_ring_orphan);
+
+static GstTracerRing *
+gst_tracer_ring_get (void)
+{
+  GstTracerRing *ring = g_private_get (&tracer_ring_key);
+
+  if (G_LIKELY (ring != NULL))
+    return ring;
+
+  ring = g_new0 (GstTracerRing, 1);
+  ring->refcount = 2;
+  ring->data = g_malloc (TRACER_RING_SIZE);
+  ring->mask = TRACER_RING_SIZE - 1;
+  ring->scratch = g_byte_array_sized_new (256);
+
+  g_mutex_lock (&tracer_lock);
+  ring->next = tracer_rings;
+  tracer_rings = ring;
+  g_mutex_unlock (&tracer_lock);
+
+  g_private_set (&tracer_ring_key, ring);
+
+  return ring;
+}
+
+static gboolean
+gst_tracer_ring_write (GstTracerRing * ring, const guint8 * data, guint size)
+{
+  guint head, tail, offset, first;
+
+  tail = ring->tail;
+  head = g_atomic_int_get (&ring->head);
+
+  if (size > ring->mask + 1 - (tail - head))
+    return FALSE;
+
+  offset = tail & ring->mask;
+  first = MIN (size, ring->mask + 1 - offset);
+  memcpy (ring->data + offset, data, first);
+  memcpy (ring->data, data + first, size - first);
+
+  /* publish the record to the writer */
+  g_atomic_int_set (&ring->tail, tail + size);
+
+  return TRUE;
+}
+
+/* with tracer_lock */
+static void
+gst_tracer_ring_read (GstTracerRing * ring, guint pos, guint8 * data,
+    guint size)
+{
+  guint offset, first;
+
+  offset = pos & ring->mask;
+  first = MIN (size, ring->mask + 1 - offset);
+  memcpy (data, ring->data + offset, first);
+  memcpy (data + first, ring->data, size - first);
+}
+
+/* with tracer_lock */
+static void
+gst_tracer_ring_write_out (GstTracerRing * ring, guint size)
+{
+  guint offset, first;
+
+  offset = ring->drain_pos & ring->mask;
+  first = MIN (size, ring->mask + 1 - offset);
+  fwrite (ring->data + offset, 1, first, tracer_file);
+  fwrite (ring->data, 1, size - first, tracer_file);
+  ring->drain_pos += size;
+}
+
+/* with tracer_lock */
+static void
+gst_tracer_file_write_dropped (void)
+{
+  GstTracerFileRecord header = { 0, };
+  guint32 dropped = g_atomic_int_get (&tracer_dropped);
+
+  if (dropped == tracer_dropped_written)
+    return;
+
+  header.size = sizeof (header) + sizeof (dropped);
+  header.id = TRACER_FILE_ID_DROPPED;
+  header.ts = GST_CLOCK_DIFF (_priv_gst_start_time, gst_util_get_timestamp ());
+  fwrite (&header, 1, sizeof (header), tracer_file);
+  fwrite (&dropped, 1, sizeof (dropped), tracer_file);
+  tracer_dropped_written = dropped;
+}
+
+/* with tracer_lock. Writes the published records of all rings ordered by
+ * their timestamp. Unless @all is set, records younger than
+ * TRACER_WRITER_INTERVAL are left for the next drain */
+static void
+gst_tracer_file_drain (gboolean all)
+{
+  GstTracerRing **prev, *ring;
+  GstTracerFileRecord header;
+  guint64 limit = G_MAXUINT64;
+
+  if (!all) {
+    GstClockTimeDiff now =
+        GST_CLOCK_DIFF (_priv_gst_start_time, gst_util_get_timestamp ());
+
+    now -= (GstClockTimeDiff) TRACER_WRITER_INTERVAL * 1000;
+    limit = MAX (now, 0);
+  }
+
+  for (ring = tracer_rings; ring; ring = ring->next) {
+    ring->drain_pos = ring->head;
+    ring->drain_end = g_atomic_int_get (&ring->tail);
+  }
+
+  /* merge the rings, each of them is already ordered */
+  while (TRUE) {
+    GstTracerRing *next = NULL;
+    guint64 next_ts = 0;
+    guint next_size = 0;
+
+    for (ring = tracer_rings; ring; ring = ring->next) {
+      if (ring->drain_pos == ring->drain_end)
+        continue;
+
+      gst_tracer_ring_read (ring, ring->drain_pos, (guint8 *) & header,
+          sizeof (header));
+      if (header.ts > limit)
+        continue;
+      if (next == NULL || header.ts < next_ts) {
+        next = ring;
+        next_ts = header.ts;
+        next_size = header.size;
+      }
+    }
+    if (next == NULL)
+      break;
+
+    gst_tracer_ring_write_out (next, next_size);
+  }
+
+  prev = &tracer_rings;
+  while ((ring = *prev)) {
+    /* read this first, everything the thread logged before it exited was
+     * published before */
+    gboolean orphaned = g_atomic_int_get (&ring->orphaned);
+
+    /* give the space back to the thread */
+    g_atomic_int_set (&ring->head, ring->drain_pos);
+
+    if (orphaned && ring->drain_pos == g_atomic_int_get (&ring->tail)) {
+      *prev = ring->next;
+      gst_tracer_ring_unref (ring);
+    } else {
+      prev = &ring->next;
+    }
+  }
+
+  gst_tracer_file_write_dropped ();
+  fflush (tracer_file);
+}
+
+static gpointer
+gst_tracer_file_writer (gpointer data)
+{
+  g_mutex_lock (&tracer_lock);
+  while (tracer_running) {
+    gint64 end_time = g_get_monotonic_time () + TRACER_WRITER_INTERVAL;
+
+    g_cond_wait_until (&tracer_cond, &tracer_lock, end_time);
+    gst_tracer_file_drain (FALSE);
+  }
+  g_mutex_unlock (&tracer_lock);
+
+  return NULL;
+}
+
+static inline void
+append_uint32 (GByteArray * array, guint32 val)
+{
+  g_byte_array_append (array, (const guint8 *) &val, sizeof (val));
+}
+
+static inline void
+append_uint64 (GByteArray * array, guint64 val)
+{
+  g_byte_array_append (array, (const guint8 *) &val, sizeof (val));
+}
+
+static inline void
+append_string (GByteArray * array, const gchar * str)
+{
+  if (str == NULL) {
+    append_uint32 (array, G_MAXUINT32);
+  } else {
+    guint32 len = strlen (str);
+
+    append_uint32 (array, len);
+    g_byte_array_append (array, (const guint8 *) str, len);
+  }
+}
+
+static void
+gst_tracer_record_announce (GstTracerRecord * self)
+{
+  GstTracerFileRecord header = { 0, };
+  GByteArray *array;
+  gchar *name;
+  guint i;
+
+  g_mutex_lock (&tracer_lock);
+  if (self->announced)
+    goto done;
+
+  name = g_strdup (g_quark_to_string (self->spec->name));
+  *strrchr (name, '.') = '\0';
+
+  self->id = tracer_next_id++;
+
+  array = g_byte_array_new ();
+  g_byte_array_append (array, (const guint8 *) &header, sizeof (header));
+  append_uint32 (array, self->id);
+  append_string (array, name);
+  append_uint32 (array, self->n_fields);
+  for (i = 0; i < self->n_fields; i++) {
+    append_string (array, g_quark_to_string (self->fields[i].name));
+    append_string (array, g_type_name (self->fields[i].type));
+    append_uint32 (array, self->fields[i].kind);
+  }
+  header.size = array->len;
+  header.ts = GST_CLOCK_DIFF (_priv_gst_start_time, gst_util_get_timestamp ());
+  memcpy (array->data, &header, sizeof (header));
+
+  fwrite (array->data, 1, array->len, tracer_file);
+  g_byte_array_unref (array);
+  g_free (name);
+
+  GST_DEBUG ("announced record %s with id %u", self->format, self->id);
+  g_atomic_int_set (&self->announced, TRUE);
+
+done:
+  g_mutex_unlock (&tracer_lock);
+}
+
+static void
+gst_tracer_record_log_binary (GstTracerRecord * self, va_list var_args)
+{
+  GstTracerFileRecord header = { 0, };
+  GstTracerRing *ring;
+  GByteArray *array;
+  guint i;
+
+  if (G_UNLIKELY (!g_atomic_int_get (&self->announced)))
+    gst_tracer_record_announce (self);
+
+  ring = gst_tracer_ring_get ();
+  array = ring->scratch;
+
+  g_byte_array_set_size (array, sizeof (header));
+  for (i = 0; i < self->n_fields; i++) {
+    switch (self->fields[i].kind) {
+      case GST_TRACER_FIELD_INT32:
+        append_uint32 (array, va_arg (var_args, guint));
+        break;
+      case GST_TRACER_FIELD_INT64:
+        append_uint64 (array, va_arg (var_args, guint64));
+        break;
+      case GST_TRACER_FIELD_DOUBLE:{
+        gdouble val = va_arg (var_args, gdouble);
+
+        g_byte_array_append (array, (const guint8 *) &val, sizeof (val));
+        break;
+      }
+      case GST_TRACER_FIELD_POINTER:
+        append_uint64 (array, (guintptr) va_arg (var_args, gpointer));
+        break;
+      case GST_TRACER_FIELD_STRING:
+        append_string (array, va_arg (var_args, const gchar *));
+        break;
+      case GST_TRACER_FIELD_SERIALIZED:{
+        gpointer val = va_arg (var_args, gpointer);
+        gchar *str;
+
+        /* the text log would use the same serialisation */
+        if (self->fields[i].type == GST_TYPE_STRUCTURE)
+          str = val ? gst_structure_to_string (val) : NULL;
+        else
+          str = gst_info_strdup_printf ("%" GST_PTR_FORMAT, val);
+        append_string (array, str);
+        g_free (str);
+        break;
+      }
+    }
+  }
+
+  header.size = array->len;
+  header.id = self->id;
+  header.ts = GST_CLOCK_DIFF (_priv_gst_start_time, gst_util_get_timestamp ());
+  memcpy (array->data, &header, sizeof (header));
+
+  if (!gst_tracer_ring_write (ring, array->data, array->len))
+    g_atomic_int_inc (&tracer_dropped);
+}
+
+void
+_priv_gst_tracer_record_initialize (void)
+{
+  const gchar *filename = g_getenv ("GST_TRACER_FILE");
+  GstTracerFileHeader header = { {0,}, };
+
+  if (filename == NULL || *filename == '\0')
+    return;
+
+  tracer_file = g_fopen (filename, "wb");
+  if (tracer_file == NULL) {
+    g_printerr ("Could not open tracer file '%s': %s\n", filename,
+        g_strerror (errno));
+    return;
+  }
+
+  memcpy (header.magic, TRACER_FILE_MAGIC, sizeof (header.magic));
+  header.version = TRACER_FILE_VERSION;
+  header.byte_order = TRACER_FILE_BYTE_ORDER;
+  fwrite (&header, 1, sizeof (header), tracer_file);
+
+  tracer_running = TRUE;
+  tracer_thread = g_thread_new ("GstTracerWriter", gst_tracer_file_writer,
+      NULL);
+
+  GST_INFO ("writing tracer records to %s", filename);
+}
+
+void
+_priv_gst_tracer_record_cleanup (void)
+{
+  if (tracer_file == NULL)
+    return;
+
+  g_mutex_lock (&tracer_lock);
+  tracer_running = FALSE;
+  g_cond_signal (&tracer_cond);
+  g_mutex_unlock (&tracer_lock);
+  g_thread_join (tracer_thread);
+  tracer_thread = NULL;
+
+  /* the final reports of the tracers were logged before we got here */
+  g_mutex_lock (&tracer_lock);
+  gst_tracer_file_drain (TRUE);
+  while (tracer_rings) {
+    GstTracerRing *ring = tracer_rings;
+
+    tracer_rings = ring->next;
+    gst_tracer_ring_unref (ring);
+  }
+  fclose (tracer_file);
+  tracer_file = NULL;
+  g_mutex_unlock (&tracer_lock);
+
+  GST_CAT_INFO (GST_CAT_PERFORMANCE, "tracer file: %d records dropped",
+      g_atomic_int_get (&tracer_dropped));
+}
+
 /**
  * gst_tracer_record_log:
  * @self: the tracer-record
@@ -245,7 +835,8 @@ gst_tracer_record_new (const gchar * name, const gchar * firstfield, ...)
  * Serialzes the trace event into the log.
  *
  * Right now this is using the gstreamer debug log with the level TRACE (7) and
- * the category "GST_TRACER".
+ * the category "GST_TRACER", or the binary trace file when `GST_TRACER_FILE`
+ * is set.
  *
  * > Please note that this is still under discussion and subject to change.
  *
@@ -269,7 +860,10 @@ gst_tracer_record_log (GstTracerRecord * self, ...)
    */
 
   va_start (var_args, self);
-  if (G_LIKELY (GST_LEVEL_TRACE <= _gst_debug_min)) {
+  if (tracer_file != NULL) {
+    if (G_LIKELY (self->format != NULL))
+      gst_tracer_record_log_binary (self, var_args);
+  } else if (G_LIKELY (GST_LEVEL_TRACE <= _gst_debug_min)) {
     gst_debug_log_valist (GST_CAT_DEFAULT, GST_LEVEL_TRACE, "", "", 0, NULL,
         self->format, var_args);
   }
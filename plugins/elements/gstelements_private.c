@@ -25,6 +25,10 @@
 #ifdef HAVE_CONFIG_H
 # include "config.h"
 #endif
+#ifdef __linux__
+/* for splice() and copy_file_range() */
+#define _GNU_SOURCE
+#endif
 #include <stdio.h>
 #ifdef HAVE_UNISTD_H
 #include <unistd.h>
@@ -39,6 +43,12 @@
 #include "gst/gst.h"
 #include "gstelements_private.h"
 
+#ifdef HAVE_FD_RANGE_MEMORY
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/sendfile.h>
+#endif
+
 #ifdef G_OS_WIN32
 #  include <io.h>               /* lseek, open, close, read */
 #  undef lseek
@@ -637,3 +647,426 @@ gst_writev_buffer_list (GstObject * sink, gint fd, GstPoll * fdset,
 
   return flow_ret;
 }
+
+#ifdef HAVE_FD_RANGE_MEMORY
+
+struct _GstFdRangeFile
+{
+  gint refcount;
+  gint fd;
+};
+
+typedef struct
+{
+  GstMemory mem;
+
+  GstFdRangeFile *file;
+  guint64 offset;               /* file offset of the start of the memory */
+  gpointer data;                /* contents, read on first map */
+} GstFdRangeMemory;
+
+typedef enum
+{
+  GST_FD_RANGE_SENDFILE,
+  GST_FD_RANGE_SPLICE,
+  GST_FD_RANGE_COPY_FILE_RANGE,
+  GST_FD_RANGE_READ_WRITE
+} GstFdRangeMethod;
+
+typedef GstAllocator GstFdRangeAllocator;
+typedef GstAllocatorClass GstFdRangeAllocatorClass;
+
+static GType gst_fd_range_allocator_get_type (void);
+G_DEFINE_TYPE (GstFdRangeAllocator, gst_fd_range_allocator,
+    GST_TYPE_ALLOCATOR);
+
+static GstAllocator *_fd_range_allocator;
+
+GType
+gst_fd_range_meta_api_get_type (void)
+{
+  static gsize type = 0;
+  static const gchar *tags[] = { NULL };
+
+  if (g_once_init_enter (&type)) {
+    GType _type = gst_meta_api_type_register ("GstFdRangeMetaAPI", tags);
+    g_once_init_leave (&type, _type);
+  }
+  return type;
+}
+
+GstFdRangeFile *
+gst_fd_range_file_new (gint fd)
+{
+  GstFdRangeFile *file;
+  gint dup_fd;
+
+  /* keep our own descriptor, memory can outlive the source closing its fd */
+  dup_fd = fcntl (fd, F_DUPFD_CLOEXEC, 0);
+  if (dup_fd < 0) {
+    GST_WARNING ("failed to duplicate fd %d: %s", fd, g_strerror (errno));
+    return NULL;
+  }
+
+  file = g_slice_new (GstFdRangeFile);
+  file->refcount = 1;
+  file->fd = dup_fd;
+
+  return file;
+}
+
+static GstFdRangeFile *
+gst_fd_range_file_ref (GstFdRangeFile * file)
+{
+  g_atomic_int_inc (&file->refcount);
+  return file;
+}
+
+void
+gst_fd_range_file_unref (GstFdRangeFile * file)
+{
+  if (g_atomic_int_dec_and_test (&file->refcount)) {
+    close (file->fd);
+    g_slice_free (GstFdRangeFile, file);
+  }
+}
+
+static GstMemory *
+gst_fd_range_allocator_alloc (GstAllocator * allocator, gsize size,
+    GstAllocationParams * params)
+{
+  g_warning ("Use gst_fd_range_memory_new() to allocate from this allocator");
+
+  return NULL;
+}
+
+static void
+gst_fd_range_allocator_free (GstAllocator * allocator, GstMemory * memory)
+{
+  GstFdRangeMemory *mem = (GstFdRangeMemory *) memory;
+
+  gst_fd_range_file_unref (mem->file);
+  g_free (mem->data);
+  g_slice_free (GstFdRangeMemory, mem);
+}
+
+static gpointer
+gst_fd_range_mem_map (GstFdRangeMemory * mem, gsize maxsize, GstMapFlags flags)
+{
+  guint8 *data;
+  gsize done = 0;
+  gssize ret = 0;
+
+  data = g_atomic_pointer_get (&mem->data);
+  if (data != NULL)
+    return data;
+
+  data = g_malloc (maxsize);
+  while (done < maxsize) {
+    ret = pread (mem->file->fd, data + done, maxsize - done,
+        mem->offset + done);
+    if (ret < 0 && errno == EINTR)
+      continue;
+    if (ret <= 0)
+      goto read_failed;
+    done += ret;
+  }
+
+  /* another thread may have mapped the memory meanwhile */
+  if (!g_atomic_pointer_compare_and_exchange (&mem->data, NULL, data)) {
+    g_free (data);
+    data = g_atomic_pointer_get (&mem->data);
+  }
+
+  return data;
+
+read_failed:
+  {
+    GST_WARNING ("failed to read %" G_GSIZE_FORMAT " bytes at offset %"
+        G_GUINT64_FORMAT ": %s", maxsize, mem->offset,
+        ret < 0 ? g_strerror (errno) : "short read");
+    g_free (data);
+    return NULL;
+  }
+}
+
+static void
+gst_fd_range_mem_unmap (GstFdRangeMemory * mem)
+{
+}
+
+static GstFdRangeMemory *
+gst_fd_range_mem_share (GstFdRangeMemory * mem, gssize offset, gssize size)
+{
+  if (size == -1)
+    size = mem->mem.size - offset;
+
+  /* not a sub-memory, the shared range is read on its own when mapped */
+  return (GstFdRangeMemory *) gst_fd_range_memory_new (mem->file,
+      mem->offset + mem->mem.offset + offset, size);
+}
+
+static void
+gst_fd_range_allocator_class_init (GstFdRangeAllocatorClass * klass)
+{
+  GstAllocatorClass *allocator_class = GST_ALLOCATOR_CLASS (klass);
+
+  allocator_class->alloc = gst_fd_range_allocator_alloc;
+  allocator_class->free = gst_fd_range_allocator_free;
+}
+
+static void
+gst_fd_range_allocator_init (GstFdRangeAllocator * allocator)
+{
+  GstAllocator *alloc = GST_ALLOCATOR_CAST (allocator);
+
+  alloc->mem_type = "FdRange";
+  alloc->mem_map = (GstMemoryMapFunction) gst_fd_range_mem_map;
+  alloc->mem_unmap = (GstMemoryUnmapFunction) gst_fd_range_mem_unmap;
+  alloc->mem_share = (GstMemoryShareFunction) gst_fd_range_mem_share;
+
+  GST_OBJECT_FLAG_SET (allocator, GST_ALLOCATOR_FLAG_CUSTOM_ALLOC);
+}
+
+static GstAllocator *
+gst_fd_range_allocator_get (void)
+{
+  static gsize once = 0;
+
+  if (g_once_init_enter (&once)) {
+    _fd_range_allocator = g_object_new (gst_fd_range_allocator_get_type (),
+        NULL);
+    gst_object_ref_sink (_fd_range_allocator);
+    GST_OBJECT_FLAG_SET (_fd_range_allocator, GST_OBJECT_FLAG_MAY_BE_LEAKED);
+    g_once_init_leave (&once, 1);
+  }
+  return _fd_range_allocator;
+}
+
+GstMemory *
+gst_fd_range_memory_new (GstFdRangeFile * file, guint64 offset, gsize size)
+{
+  GstFdRangeMemory *mem;
+
+  mem = g_slice_new (GstFdRangeMemory);
+  gst_memory_init (GST_MEMORY_CAST (mem), GST_MEMORY_FLAG_READONLY,
+      gst_fd_range_allocator_get (), NULL, size, 0, 0, size);
+  mem->file = gst_fd_range_file_ref (file);
+  mem->offset = offset;
+  mem->data = NULL;
+
+  return GST_MEMORY_CAST (mem);
+}
+
+gboolean
+gst_is_fd_range_memory (GstMemory * mem)
+{
+  return mem->allocator != NULL
+      && mem->allocator == _fd_range_allocator;
+}
+
+gboolean
+gst_buffer_has_fd_range_memory (GstBuffer * buffer)
+{
+  guint i, n_mem;
+
+  if (_fd_range_allocator == NULL)
+    return FALSE;
+
+  n_mem = gst_buffer_n_memory (buffer);
+  for (i = 0; i < n_mem; i++) {
+    if (gst_is_fd_range_memory (gst_buffer_peek_memory (buffer, i)))
+      return TRUE;
+  }
+  return FALSE;
+}
+
+/* Copies the range of @mem starting @skip bytes in to @fd without going
+ * through user space. Falls back to writing the mapped memory when the
+ * kernel can't copy between the two descriptors. */
+static GstFlowReturn
+gst_fd_range_write_memory (GstObject * sink, gint fd, GstPoll * fdset,
+    GstFdRangeMemory * mem, gsize skip, GstFdRangeMethod * method,
+    guint64 * bytes_written)
+{
+  GstFlowReturn flow_ret = GST_FLOW_OK;
+  guint64 offset;
+  gsize left;
+
+  offset = mem->offset + mem->mem.offset + skip;
+  left = mem->mem.size - skip;
+
+  while (left > 0) {
+    gssize ret;
+
+    if (*method == GST_FD_RANGE_READ_WRITE) {
+      GstMapInfo map;
+
+      if (!gst_memory_map (GST_MEMORY_CAST (mem), &map, GST_MAP_READ))
+        goto read_error;
+      flow_ret = gst_writev_mem (sink, fd, fdset,
+          map.data + (map.size - left), left, bytes_written, 0, 0, -1, NULL);
+      gst_memory_unmap (GST_MEMORY_CAST (mem), &map);
+      break;
+    }
+
+    if (fdset != NULL) {
+      do {
+        ret = gst_poll_wait (fdset, GST_CLOCK_TIME_NONE);
+      } while (ret == -1 && (errno == EINTR || errno == EAGAIN));
+
+      if (ret == -1) {
+        if (errno == EBUSY)
+          goto stopped;
+        else
+          goto select_error;
+      }
+    }
+
+    switch (*method) {
+      case GST_FD_RANGE_SPLICE:{
+        loff_t off = offset;
+
+        ret = splice (mem->file->fd, &off, fd, NULL, left,
+            SPLICE_F_MOVE | SPLICE_F_MORE);
+        break;
+      }
+#ifdef HAVE_COPY_FILE_RANGE
+      case GST_FD_RANGE_COPY_FILE_RANGE:{
+        loff_t off = offset;
+
+        ret = copy_file_range (mem->file->fd, &off, fd, NULL, left, 0);
+        break;
+      }
+#endif
+      default:{
+        off_t off = offset;
+
+        ret = sendfile (fd, mem->file->fd, &off, left);
+        break;
+      }
+    }
+
+    if (ret > 0) {
+      offset += ret;
+      left -= ret;
+      if (bytes_written)
+        *bytes_written += ret;
+    } else if (ret == 0) {
+      /* the file got truncated under us */
+      goto read_error;
+    } else if (errno == EINTR || errno == EAGAIN) {
+      /* try again */
+    } else if (errno == EINVAL || errno == ENOSYS || errno == EXDEV
+        || errno == EOPNOTSUPP || (errno == EBADF
+            && *method == GST_FD_RANGE_COPY_FILE_RANGE)) {
+      /* copy_file_range() fails with EBADF on O_APPEND fds */
+      GST_DEBUG_OBJECT (sink, "kernel copy method %d not usable: %s",
+          *method, g_strerror (errno));
+      if (*method != GST_FD_RANGE_SENDFILE)
+        *method = GST_FD_RANGE_SENDFILE;
+      else
+        *method = GST_FD_RANGE_READ_WRITE;
+    } else {
+      goto write_error;
+    }
+  }
+
+  return flow_ret;
+
+  /* ERRORS */
+select_error:
+  {
+    GST_ELEMENT_ERROR (sink, RESOURCE, READ, (NULL),
+        ("select on file descriptor: %s", g_strerror (errno)));
+    return GST_FLOW_ERROR;
+  }
+stopped:
+  {
+    GST_DEBUG_OBJECT (sink, "Select stopped");
+    return GST_FLOW_FLUSHING;
+  }
+read_error:
+  {
+    GST_ELEMENT_ERROR (sink, RESOURCE, READ, (NULL),
+        ("Could not read %" G_GSIZE_FORMAT " bytes at offset %"
+            G_GUINT64_FORMAT " from file descriptor %d", left, offset,
+            mem->file->fd));
+    return GST_FLOW_ERROR;
+  }
+write_error:
+  {
+    switch (errno) {
+      case ENOSPC:
+        GST_ELEMENT_ERROR (sink, RESOURCE, NO_SPACE_LEFT, (NULL), (NULL));
+        break;
+      default:{
+        GST_ELEMENT_ERROR (sink, RESOURCE, WRITE, (NULL),
+            ("Error while writing to file descriptor %d: %s",
+                fd, g_strerror (errno)));
+      }
+    }
+    return GST_FLOW_ERROR;
+  }
+}
+
+GstFlowReturn
+gst_fd_range_write_buffer (GstObject * sink, gint fd, GstPoll * fdset,
+    GstBuffer * buffer, guint64 * bytes_written, guint64 skip)
+{
+  GstFlowReturn flow_ret = GST_FLOW_OK;
+  GstFdRangeMethod method = GST_FD_RANGE_SENDFILE;
+  struct stat st;
+  guint i, num_mem;
+  gint flags;
+
+  /* splice() needs a pipe on one end and copy_file_range() a regular file
+   * on both, sendfile() takes anything else. Neither copy_file_range() nor
+   * sendfile() can append, so O_APPEND fds (e.g. stdout redirected with >>)
+   * go through read/write directly */
+  flags = fcntl (fd, F_GETFL);
+  if (flags != -1 && (flags & O_APPEND)) {
+    method = GST_FD_RANGE_READ_WRITE;
+  } else if (fstat (fd, &st) == 0) {
+    if (S_ISFIFO (st.st_mode))
+      method = GST_FD_RANGE_SPLICE;
+#ifdef HAVE_COPY_FILE_RANGE
+    else if (S_ISREG (st.st_mode))
+      method = GST_FD_RANGE_COPY_FILE_RANGE;
+#endif
+  }
+
+  num_mem = gst_buffer_n_memory (buffer);
+
+  GST_DEBUG ("Writing buffer %p with %u memories and %" G_GSIZE_FORMAT " bytes",
+      buffer, num_mem, gst_buffer_get_size (buffer));
+
+  for (i = 0; i < num_mem && flow_ret == GST_FLOW_OK; i++) {
+    GstMemory *mem = gst_buffer_peek_memory (buffer, i);
+
+    if (skip >= mem->size) {
+      skip -= mem->size;
+      continue;
+    }
+
+    if (gst_is_fd_range_memory (mem)) {
+      flow_ret = gst_fd_range_write_memory (sink, fd, fdset,
+          (GstFdRangeMemory *) mem, skip, &method, bytes_written);
+    } else {
+      GstMapInfo map;
+
+      if (!gst_memory_map (mem, &map, GST_MAP_READ)) {
+        GST_WARNING ("Failed to map memory %p for reading", mem);
+        continue;
+      }
+      flow_ret = gst_writev_mem (sink, fd, fdset, map.data + skip,
+          map.size - skip, bytes_written, 0, 0, -1, NULL);
+      gst_memory_unmap (mem, &map);
+    }
+    skip = 0;
+  }
+
+  return flow_ret;
+}
+
+#endif /* HAVE_FD_RANGE_MEMORY */
@@ -54,6 +54,46 @@ GstFlowReturn  gst_writev_mem         (GstObject * sink, gint fd, GstPoll * fdse
                                        gint max_transient_error_timeout, guint64 current_position,
                                        gboolean * flushing);
 
+/* Memory referencing a range of a regular file by descriptor and offset.
+ * Sinks that advertise GST_FD_RANGE_META_API_TYPE in the allocation query
+ * can copy it into their own descriptor inside the kernel. Mapping the
+ * memory falls back to reading the range with pread(). */
+#ifdef __linux__
+#define HAVE_FD_RANGE_MEMORY 1
+#endif
+
+#ifdef HAVE_FD_RANGE_MEMORY
+
+typedef struct _GstFdRangeFile GstFdRangeFile;
+
+#define GST_FD_RANGE_META_API_TYPE (gst_fd_range_meta_api_get_type())
+
+G_GNUC_INTERNAL
+GType            gst_fd_range_meta_api_get_type (void);
+
+G_GNUC_INTERNAL
+GstFdRangeFile * gst_fd_range_file_new   (gint fd);
+
+G_GNUC_INTERNAL
+void             gst_fd_range_file_unref (GstFdRangeFile * file);
+
+G_GNUC_INTERNAL
+GstMemory *      gst_fd_range_memory_new (GstFdRangeFile * file,
+                                          guint64 offset, gsize size);
+
+G_GNUC_INTERNAL
+gboolean         gst_is_fd_range_memory  (GstMemory * mem);
+
+G_GNUC_INTERNAL
+gboolean         gst_buffer_has_fd_range_memory (GstBuffer * buffer);
+
+G_GNUC_INTERNAL
+GstFlowReturn    gst_fd_range_write_buffer (GstObject * sink, gint fd, GstPoll * fdset,
+                                            GstBuffer * buffer,
+                                            guint64 * bytes_written, guint64 skip);
+
+#endif /* HAVE_FD_RANGE_MEMORY */
+
 G_END_DECLS
 
 #endif /* __GST_ELEMENTS_PRIVATE_H__ */
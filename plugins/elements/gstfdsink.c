@@ -30,6 +30,11 @@
  * This element will synchronize on the clock before writing the data on the
  * socket. For file descriptors where this does not make sense (files, ...) the
  * #GstBaseSink:sync property can be used to disable synchronisation.
+ *
+ * On Linux, when the data comes from #GstFileSrc or from #GstFdSrc reading a
+ * regular file, fdsink has the kernel copy it into the file descriptor with
+ * splice(), copy_file_range() or sendfile() instead of reading and writing
+ * it through user space.
  */
 
 #ifdef HAVE_CONFIG_H
@@ -122,6 +127,10 @@ static void gst_fd_sink_get_property (GObject * object, guint prop_id,
 static void gst_fd_sink_dispose (GObject * obj);
 
 static gboolean gst_fd_sink_query (GstBaseSink * bsink, GstQuery * query);
+#ifdef HAVE_FD_RANGE_MEMORY
+static gboolean gst_fd_sink_propose_allocation (GstBaseSink * bsink,
+    GstQuery * query);
+#endif
 static GstFlowReturn gst_fd_sink_render (GstBaseSink * sink,
     GstBuffer * buffer);
 static GstFlowReturn gst_fd_sink_render_list (GstBaseSink * bsink,
@@ -163,6 +172,10 @@ gst_fd_sink_class_init (GstFdSinkClass * klass)
   gstbasesink_class->unlock_stop = GST_DEBUG_FUNCPTR (gst_fd_sink_unlock_stop);
   gstbasesink_class->event = GST_DEBUG_FUNCPTR (gst_fd_sink_event);
   gstbasesink_class->query = GST_DEBUG_FUNCPTR (gst_fd_sink_query);
+#ifdef HAVE_FD_RANGE_MEMORY
+  gstbasesink_class->propose_allocation =
+      GST_DEBUG_FUNCPTR (gst_fd_sink_propose_allocation);
+#endif
 
   g_object_class_install_property (gobject_class, ARG_FD,
       g_param_spec_int ("fd", "fd", "An open file descriptor to write to",
@@ -245,6 +258,29 @@ gst_fd_sink_query (GstBaseSink * bsink, GstQuery * query)
   return res;
 }
 
+#ifdef HAVE_FD_RANGE_MEMORY
+/* Upstream may then hand us buffers referencing a range of a file, which are
+ * copied to our fd by the kernel instead of being read and written out */
+static gboolean
+gst_fd_sink_propose_allocation (GstBaseSink * bsink, GstQuery * query)
+{
+  gst_query_add_allocation_meta (query, GST_FD_RANGE_META_API_TYPE, NULL);
+
+  return TRUE;
+}
+
+static gboolean
+gst_fd_sink_list_has_fd_range_memory (GstBuffer ** buffer, guint idx,
+    gpointer user_data)
+{
+  gboolean *found = user_data;
+
+  *found = gst_buffer_has_fd_range_memory (*buffer);
+
+  return !*found;
+}
+#endif
+
 static GstFlowReturn
 gst_fd_sink_render_list (GstBaseSink * bsink, GstBufferList * buffer_list)
 {
@@ -259,6 +295,24 @@ gst_fd_sink_render_list (GstBaseSink * bsink, GstBufferList * buffer_list)
   if (num_buffers == 0)
     goto no_data;
 
+#ifdef HAVE_FD_RANGE_MEMORY
+  {
+    gboolean found = FALSE;
+
+    gst_buffer_list_foreach (buffer_list,
+        gst_fd_sink_list_has_fd_range_memory, &found);
+    if (found) {
+      guint i;
+
+      ret = GST_FLOW_OK;
+      for (i = 0; i < num_buffers && ret == GST_FLOW_OK; i++)
+        ret = gst_fd_sink_render (bsink, gst_buffer_list_get (buffer_list, i));
+
+      return ret;
+    }
+  }
+#endif
+
   for (;;) {
     guint64 bytes_written = 0;
 
@@ -297,8 +351,14 @@ gst_fd_sink_render (GstBaseSink * bsink, GstBuffer * buffer)
   for (;;) {
     guint64 bytes_written = 0;
 
-    ret = gst_writev_buffer (GST_OBJECT_CAST (sink), sink->fd, sink->fdset,
-        buffer, &bytes_written, skip, 0, -1, NULL);
+#ifdef HAVE_FD_RANGE_MEMORY
+    if (gst_buffer_has_fd_range_memory (buffer))
+      ret = gst_fd_range_write_buffer (GST_OBJECT_CAST (sink), sink->fd,
+          sink->fdset, buffer, &bytes_written, skip);
+    else
+#endif
+      ret = gst_writev_buffer (GST_OBJECT_CAST (sink), sink->fd, sink->fdset,
+          buffer, &bytes_written, skip, 0, -1, NULL);
 
     sink->current_pos += bytes_written;
     skip += bytes_written;
@@ -79,6 +79,7 @@
 #include <errno.h>
 
 #include "gstfdsrc.h"
+#include "gstelements_private.h"
 #include "gstcoreelementselements.h"
 
 #define struct_stat struct stat
@@ -138,6 +139,10 @@ static gboolean gst_fd_src_is_seekable (GstBaseSrc * bsrc);
 static gboolean gst_fd_src_get_size (GstBaseSrc * src, guint64 * size);
 static gboolean gst_fd_src_do_seek (GstBaseSrc * src, GstSegment * segment);
 static gboolean gst_fd_src_query (GstBaseSrc * src, GstQuery * query);
+#ifdef HAVE_FD_RANGE_MEMORY
+static gboolean gst_fd_src_decide_allocation (GstBaseSrc * src,
+    GstQuery * query);
+#endif
 
 static GstFlowReturn gst_fd_src_create (GstPushSrc * psrc, GstBuffer ** outbuf);
 
@@ -186,6 +191,10 @@ gst_fd_src_class_init (GstFdSrcClass * klass)
   gstbasesrc_class->get_size = GST_DEBUG_FUNCPTR (gst_fd_src_get_size);
   gstbasesrc_class->do_seek = GST_DEBUG_FUNCPTR (gst_fd_src_do_seek);
   gstbasesrc_class->query = GST_DEBUG_FUNCPTR (gst_fd_src_query);
+#ifdef HAVE_FD_RANGE_MEMORY
+  gstbasesrc_class->decide_allocation =
+      GST_DEBUG_FUNCPTR (gst_fd_src_decide_allocation);
+#endif
 
   gstpush_src_class->create = GST_DEBUG_FUNCPTR (gst_fd_src_create);
 }
@@ -200,6 +209,8 @@ gst_fd_src_init (GstFdSrc * fdsrc)
   fdsrc->timeout = DEFAULT_TIMEOUT;
   fdsrc->uri = g_strdup_printf ("fd://0");
   fdsrc->curoffset = 0;
+  fdsrc->fd_range = FALSE;
+  fdsrc->fd_range_file = NULL;
 }
 
 static void
@@ -243,6 +254,13 @@ gst_fd_src_update_fd (GstFdSrc * src, guint64 size)
 
     src->fd = src->new_fd;
 
+#ifdef HAVE_FD_RANGE_MEMORY
+    if (src->fd_range_file) {
+      gst_fd_range_file_unref (src->fd_range_file);
+      src->fd_range_file = NULL;
+    }
+#endif
+
     GST_INFO_OBJECT (src, "Setting size to fd %" G_GUINT64_FORMAT, size);
     src->size = size;
 
@@ -307,6 +325,14 @@ gst_fd_src_stop (GstBaseSrc * bsrc)
     src->fdset = NULL;
   }
 
+#ifdef HAVE_FD_RANGE_MEMORY
+  if (src->fd_range_file) {
+    gst_fd_range_file_unref (src->fd_range_file);
+    src->fd_range_file = NULL;
+  }
+  src->fd_range = FALSE;
+#endif
+
   return TRUE;
 }
 
@@ -387,6 +413,73 @@ gst_fd_src_get_property (GObject * object, guint prop_id, GValue * value,
   }
 }
 
+#ifdef HAVE_FD_RANGE_MEMORY
+static gboolean
+gst_fd_src_decide_allocation (GstBaseSrc * bsrc, GstQuery * query)
+{
+  GstFdSrc *src = GST_FD_SRC (bsrc);
+
+  src->fd_range = gst_query_find_allocation_meta (query,
+      GST_FD_RANGE_META_API_TYPE, NULL);
+  GST_DEBUG_OBJECT (src, "downstream accepts file ranges: %d", src->fd_range);
+
+  return GST_BASE_SRC_CLASS (parent_class)->decide_allocation (bsrc, query);
+}
+
+/* hands out a reference to the next blocksize bytes of the file instead of
+ * reading them, downstream copies them with the kernel */
+static GstFlowReturn
+gst_fd_src_create_fd_range (GstFdSrc * src, guint blocksize,
+    GstBuffer ** outbuf)
+{
+  struct_stat stat_results;
+  GstBuffer *buf;
+  off_t offset;
+  guint64 length;
+
+  offset = lseek (src->fd, 0, SEEK_CUR);
+  if (offset < 0 || fstat (src->fd, &stat_results) < 0)
+    goto read_error;
+
+  if (offset >= stat_results.st_size)
+    goto eos;
+
+  length = MIN (blocksize, stat_results.st_size - offset);
+
+  /* leave the fd where a read() would have left it */
+  if (lseek (src->fd, offset + length, SEEK_SET) < 0)
+    goto read_error;
+
+  buf = gst_buffer_new ();
+  gst_buffer_append_memory (buf,
+      gst_fd_range_memory_new (src->fd_range_file, offset, length));
+
+  GST_BUFFER_OFFSET (buf) = src->curoffset;
+  GST_BUFFER_TIMESTAMP (buf) = GST_CLOCK_TIME_NONE;
+  src->curoffset += length;
+
+  GST_LOG_OBJECT (src, "Created file range buffer of size %" G_GUINT64_FORMAT,
+      length);
+
+  *outbuf = buf;
+
+  return GST_FLOW_OK;
+
+  /* ERRORS */
+eos:
+  {
+    GST_DEBUG_OBJECT (src, "At end of file. EOS.");
+    return GST_FLOW_EOS;
+  }
+read_error:
+  {
+    GST_ELEMENT_ERROR (src, RESOURCE, READ, (NULL),
+        ("seek on file descriptor: %s.", g_strerror (errno)));
+    return GST_FLOW_ERROR;
+  }
+}
+#endif
+
 static GstFlowReturn
 gst_fd_src_create (GstPushSrc * psrc, GstBuffer ** outbuf)
 {
@@ -442,6 +535,15 @@ gst_fd_src_create (GstPushSrc * psrc, GstBuffer ** outbuf)
 
   blocksize = GST_BASE_SRC (src)->blocksize;
 
+#ifdef HAVE_FD_RANGE_MEMORY
+  if (src->fd_range && src->seekable_fd) {
+    if (src->fd_range_file == NULL)
+      src->fd_range_file = gst_fd_range_file_new (src->fd);
+    if (src->fd_range_file != NULL)
+      return gst_fd_src_create_fd_range (src, blocksize, outbuf);
+  }
+#endif
+
   /* create the buffer */
   buf = gst_buffer_new_allocate (NULL, blocksize, NULL);
   if (G_UNLIKELY (buf == NULL))
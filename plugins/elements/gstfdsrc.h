@@ -71,6 +71,9 @@ struct _GstFdSrc {
   GstPoll *fdset;
 
   gulong curoffset; /* current offset in file */
+
+  gboolean fd_range; /* downstream accepts file ranges */
+  gpointer fd_range_file; /* reference to fd handed out with them */
 };
 
 struct _GstFdSrcClass {
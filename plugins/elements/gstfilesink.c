@@ -32,12 +32,29 @@
  * gst-launch-1.0 v4l2src num-buffers=1 ! jpegenc ! filesink location=capture1.jpeg
  * ]| Capture one frame from a v4l2 camera and save as jpeg image.
  *
+ * With #GstFileSink:async-write enabled, incoming data is coalesced into
+ * page-aligned chunks of #GstFileSink:buffer-size bytes which a separate
+ * thread writes to disk, so that a slow disk does not stall the streaming
+ * thread until #GstFileSink:max-backlog-bytes are waiting to be written.
+ * #GstFileSink:queued-bytes and #GstFileSink:stall-time show how close the
+ * disk is to causing backpressure. #GstFileSink:o-direct additionally opens
+ * the file with O_DIRECT to bypass the page cache.
+ *
+ * |[
+ * gst-launch-1.0 videotestsrc ! x264enc ! mpegtsmux ! filesink location=rec.ts async-write=true buffer-size=1048576
+ * ]| Record to rec.ts through the writer thread, with 1MB writes.
+ *
  */
 
 #ifdef HAVE_CONFIG_H
 #  include "config.h"
 #endif
 
+#ifdef __linux__
+/* for O_DIRECT */
+#define _GNU_SOURCE 1
+#endif
+
 #include "../../gst/gst-i18n-lib.h"
 
 #include <gst/gst.h>
@@ -111,6 +128,9 @@ GST_DEBUG_CATEGORY_STATIC (gst_file_sink_debug);
 #define DEFAULT_APPEND		FALSE
 #define DEFAULT_O_SYNC		FALSE
 #define DEFAULT_MAX_TRANSIENT_ERROR_TIMEOUT	0
+#define DEFAULT_ASYNC_WRITE	FALSE
+#define DEFAULT_O_DIRECT	FALSE
+#define DEFAULT_MAX_BACKLOG_BYTES	(16 * 1024 * 1024)
 
 enum
 {
@@ -121,14 +141,55 @@ enum
   PROP_APPEND,
   PROP_O_SYNC,
   PROP_MAX_TRANSIENT_ERROR_TIMEOUT,
+  PROP_ASYNC_WRITE,
+  PROP_O_DIRECT,
+  PROP_MAX_BACKLOG_BYTES,
+  PROP_QUEUED_BYTES,
+  PROP_STALL_TIME,
   PROP_LAST
 };
 
+/* async-write: the streaming thread copies data into aligned chunks of
+ * buffer-size bytes, full chunks are handed to a writer thread. The number
+ * of bytes waiting to be written is bounded by max-backlog-bytes, the time
+ * the streaming thread spends waiting for the disk is accounted in
+ * stall-time. */
+typedef struct
+{
+  GstFileSink *sink;
+  gint fd;
+  GThread *thread;
+
+  GMutex lock;
+  GCond cond;
+  GQueue queue;                 /* full chunks waiting to be written */
+  GQueue free_chunks;           /* written chunks kept for reuse */
+  guint64 queued_bytes;
+  gboolean writing;             /* the thread is writing a chunk */
+  gboolean running;
+  GstFlowReturn last_flow;
+  GstClockTime stall_time;
+
+  /* only used by the writer thread, or while it is idle */
+  guint64 position;
+  gboolean o_direct;
+
+  /* only used by the streaming thread */
+  GstMemory *chunk;
+  GstMapInfo chunk_map;
+  gsize chunk_fill;
+  gsize chunk_size;
+} GstFileSinkWriter;
+
+#define WRITER_ALIGN            4096
+#define WRITER_MAX_FREE_CHUNKS  4
+
 /* Copy of glib's g_fopen due to win32 libc/cross-DLL brokenness: we can't
  * use the 'file pointer' opened in glib (and returned from this function)
  * in this library, as they may have unrelated C runtimes. */
 static FILE *
-gst_fopen (const gchar * filename, const gchar * mode, gboolean o_sync)
+gst_fopen (const gchar * filename, const gchar * mode, gboolean o_sync,
+    gboolean o_direct)
 {
   FILE *retval;
 #ifdef G_OS_WIN32
@@ -151,6 +212,11 @@ gst_fopen (const gchar * filename, const gchar * mode, gboolean o_sync)
   if (o_sync)
     flags |= O_SYNC;
 
+#ifdef O_DIRECT
+  if (o_direct)
+    flags |= O_DIRECT;
+#endif
+
   fd = open (filename, flags, 0666);
 
   retval = fdopen (fd, mode);
@@ -250,6 +316,73 @@ gst_file_sink_class_init (GstFileSinkClass * klass)
           G_MAXINT, DEFAULT_MAX_TRANSIENT_ERROR_TIMEOUT,
           G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
+  /**
+   * GstFileSink:async-write:
+   *
+   * Coalesce data into aligned chunks of #GstFileSink:buffer-size bytes and
+   * write them from a separate thread. Replaces #GstFileSink:buffer-mode.
+   *
+   * Since: 1.20
+   */
+  g_object_class_install_property (gobject_class, PROP_ASYNC_WRITE,
+      g_param_spec_boolean ("async-write", "Asynchronous write",
+          "Write aligned chunks from a separate thread", DEFAULT_ASYNC_WRITE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstFileSink:o-direct:
+   *
+   * Open the file with O_DIRECT to bypass the page cache. Only used with
+   * #GstFileSink:async-write, which keeps writes aligned. Not supported in
+   * append mode.
+   *
+   * Since: 1.20
+   */
+  g_object_class_install_property (gobject_class, PROP_O_DIRECT,
+      g_param_spec_boolean ("o-direct", "Direct IO",
+          "Open the file with O_DIRECT in async-write mode", DEFAULT_O_DIRECT,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstFileSink:max-backlog-bytes:
+   *
+   * Number of bytes that can be waiting for the writer thread before the
+   * streaming thread blocks.
+   *
+   * Since: 1.20
+   */
+  g_object_class_install_property (gobject_class, PROP_MAX_BACKLOG_BYTES,
+      g_param_spec_uint64 ("max-backlog-bytes", "Max backlog bytes",
+          "Bytes waiting to be written before blocking in async-write mode",
+          0, G_MAXUINT64, DEFAULT_MAX_BACKLOG_BYTES,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstFileSink:queued-bytes:
+   *
+   * Number of bytes waiting to be written in async-write mode.
+   *
+   * Since: 1.20
+   */
+  g_object_class_install_property (gobject_class, PROP_QUEUED_BYTES,
+      g_param_spec_uint64 ("queued-bytes", "Queued bytes",
+          "Bytes waiting to be written in async-write mode",
+          0, G_MAXUINT64, 0, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstFileSink:stall-time:
+   *
+   * Total time in nanoseconds the streaming thread waited because
+   * #GstFileSink:max-backlog-bytes were waiting to be written.
+   *
+   * Since: 1.20
+   */
+  g_object_class_install_property (gobject_class, PROP_STALL_TIME,
+      g_param_spec_uint64 ("stall-time", "Stall time",
+          "Time the streaming thread waited for the disk in async-write mode "
+          "(in ns)", 0, G_MAXUINT64, 0,
+          G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
   gst_element_class_set_static_metadata (gstelement_class,
       "File Sink",
       "Sink/File", "Write stream to a file",
@@ -284,6 +417,9 @@ gst_file_sink_init (GstFileSink * filesink)
   filesink->buffer_mode = DEFAULT_BUFFER_MODE;
   filesink->buffer_size = DEFAULT_BUFFER_SIZE;
   filesink->append = FALSE;
+  filesink->async_write = DEFAULT_ASYNC_WRITE;
+  filesink->o_direct = DEFAULT_O_DIRECT;
+  filesink->max_backlog_bytes = DEFAULT_MAX_BACKLOG_BYTES;
 
   gst_base_sink_set_sync (GST_BASE_SINK (filesink), FALSE);
 }
@@ -361,6 +497,15 @@ gst_file_sink_set_property (GObject * object, guint prop_id,
     case PROP_MAX_TRANSIENT_ERROR_TIMEOUT:
       sink->max_transient_error_timeout = g_value_get_int (value);
       break;
+    case PROP_ASYNC_WRITE:
+      sink->async_write = g_value_get_boolean (value);
+      break;
+    case PROP_O_DIRECT:
+      sink->o_direct = g_value_get_boolean (value);
+      break;
+    case PROP_MAX_BACKLOG_BYTES:
+      sink->max_backlog_bytes = g_value_get_uint64 (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -392,23 +537,351 @@ gst_file_sink_get_property (GObject * object, guint prop_id, GValue * value,
     case PROP_MAX_TRANSIENT_ERROR_TIMEOUT:
       g_value_set_int (value, sink->max_transient_error_timeout);
       break;
+    case PROP_ASYNC_WRITE:
+      g_value_set_boolean (value, sink->async_write);
+      break;
+    case PROP_O_DIRECT:
+      g_value_set_boolean (value, sink->o_direct);
+      break;
+    case PROP_MAX_BACKLOG_BYTES:
+      g_value_set_uint64 (value, sink->max_backlog_bytes);
+      break;
+    case PROP_QUEUED_BYTES:
+    case PROP_STALL_TIME:
+    {
+      guint64 val = 0;
+
+      GST_OBJECT_LOCK (sink);
+      if (sink->writer) {
+        GstFileSinkWriter *writer = sink->writer;
+
+        g_mutex_lock (&writer->lock);
+        if (prop_id == PROP_QUEUED_BYTES)
+          val = writer->queued_bytes;
+        else
+          val = writer->stall_time;
+        g_mutex_unlock (&writer->lock);
+      }
+      GST_OBJECT_UNLOCK (sink);
+
+      g_value_set_uint64 (value, val);
+      break;
+    }
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
   }
 }
 
+static void
+gst_file_sink_writer_clear_o_direct (GstFileSinkWriter * writer)
+{
+#ifdef O_DIRECT
+  gint flags;
+
+  if (!writer->o_direct)
+    return;
+
+  GST_DEBUG_OBJECT (writer->sink, "unaligned write, disabling O_DIRECT");
+
+  flags = fcntl (writer->fd, F_GETFL);
+  if (flags != -1)
+    fcntl (writer->fd, F_SETFL, flags & ~O_DIRECT);
+#endif
+  writer->o_direct = FALSE;
+}
+
+static gpointer
+gst_file_sink_writer_thread (gpointer data)
+{
+  GstFileSinkWriter *writer = data;
+  GstFileSink *sink = writer->sink;
+
+  g_mutex_lock (&writer->lock);
+  for (;;) {
+    GstMemory *chunk;
+    GstMapInfo map;
+    GstFlowReturn flow = GST_FLOW_OK;
+    guint64 bytes_written = 0;
+    gboolean failed;
+
+    while (writer->running && g_queue_is_empty (&writer->queue))
+      g_cond_wait (&writer->cond, &writer->lock);
+
+    /* only exit once everything queued has been written */
+    if (g_queue_is_empty (&writer->queue))
+      break;
+
+    chunk = g_queue_pop_head (&writer->queue);
+    writer->writing = TRUE;
+    failed = writer->last_flow != GST_FLOW_OK;
+    g_mutex_unlock (&writer->lock);
+
+    gst_memory_map (chunk, &map, GST_MAP_READ);
+
+    /* after an error, chunks are only drained to unblock the streaming
+     * thread */
+    if (!failed) {
+      if (map.size % WRITER_ALIGN != 0)
+        gst_file_sink_writer_clear_o_direct (writer);
+
+      GST_LOG_OBJECT (sink, "writing chunk of %" G_GSIZE_FORMAT
+          " bytes at position %" G_GUINT64_FORMAT, map.size, writer->position);
+
+      flow = gst_writev_mem (GST_OBJECT_CAST (sink), writer->fd, NULL,
+          map.data, map.size, &bytes_written, 0,
+          sink->max_transient_error_timeout, writer->position, NULL);
+    }
+    gst_memory_unmap (chunk, &map);
+
+    g_mutex_lock (&writer->lock);
+    writer->position += bytes_written;
+    writer->queued_bytes -= map.size;
+    if (flow != GST_FLOW_OK)
+      writer->last_flow = flow;
+    writer->writing = FALSE;
+
+    if (g_queue_get_length (&writer->free_chunks) < WRITER_MAX_FREE_CHUNKS) {
+      gst_memory_resize (chunk, 0, writer->chunk_size);
+      g_queue_push_tail (&writer->free_chunks, chunk);
+    } else {
+      gst_memory_unref (chunk);
+    }
+
+    g_cond_broadcast (&writer->cond);
+  }
+  g_mutex_unlock (&writer->lock);
+
+  return NULL;
+}
+
+static GstFileSinkWriter *
+gst_file_sink_writer_new (GstFileSink * sink)
+{
+  GstFileSinkWriter *writer;
+
+  writer = g_new0 (GstFileSinkWriter, 1);
+  writer->sink = sink;
+  writer->fd = fileno (sink->file);
+  g_mutex_init (&writer->lock);
+  g_cond_init (&writer->cond);
+  g_queue_init (&writer->queue);
+  g_queue_init (&writer->free_chunks);
+  writer->running = TRUE;
+  writer->last_flow = GST_FLOW_OK;
+  writer->position = sink->current_pos;
+  writer->chunk_size =
+      GST_ROUND_UP_N (MAX (sink->buffer_size, WRITER_ALIGN), WRITER_ALIGN);
+
+#ifdef O_DIRECT
+  writer->o_direct = (fcntl (writer->fd, F_GETFL) & O_DIRECT) != 0;
+#endif
+
+  writer->thread = g_thread_new ("filesink-writer",
+      gst_file_sink_writer_thread, writer);
+
+  GST_DEBUG_OBJECT (sink, "started writer thread, chunks of %" G_GSIZE_FORMAT
+      " bytes, O_DIRECT %d", writer->chunk_size, writer->o_direct);
+
+  return writer;
+}
+
+static void
+gst_file_sink_writer_free (GstFileSinkWriter * writer)
+{
+  g_mutex_lock (&writer->lock);
+  writer->running = FALSE;
+  g_cond_broadcast (&writer->cond);
+  g_mutex_unlock (&writer->lock);
+
+  g_thread_join (writer->thread);
+
+  if (writer->chunk) {
+    gst_memory_unmap (writer->chunk, &writer->chunk_map);
+    gst_memory_unref (writer->chunk);
+  }
+  while (!g_queue_is_empty (&writer->free_chunks))
+    gst_memory_unref (g_queue_pop_head (&writer->free_chunks));
+  g_mutex_clear (&writer->lock);
+  g_cond_clear (&writer->cond);
+  g_free (writer);
+}
+
+/* hand the partially or completely filled staging chunk to the thread */
+static void
+gst_file_sink_writer_push_chunk (GstFileSinkWriter * writer)
+{
+  GstMemory *chunk = writer->chunk;
+
+  if (chunk == NULL)
+    return;
+
+  gst_memory_unmap (chunk, &writer->chunk_map);
+  writer->chunk = NULL;
+
+  if (writer->chunk_fill == 0) {
+    gst_memory_unref (chunk);
+    return;
+  }
+
+  gst_memory_resize (chunk, 0, writer->chunk_fill);
+
+  g_mutex_lock (&writer->lock);
+  g_queue_push_tail (&writer->queue, chunk);
+  writer->queued_bytes += writer->chunk_fill;
+  g_cond_broadcast (&writer->cond);
+  g_mutex_unlock (&writer->lock);
+
+  writer->chunk_fill = 0;
+}
+
+static void
+gst_file_sink_writer_add (GstFileSinkWriter * writer, GstBuffer * buffer)
+{
+  gsize size, offset = 0;
+
+  size = gst_buffer_get_size (buffer);
+
+  while (offset < size) {
+    gsize n;
+
+    if (writer->chunk == NULL) {
+      g_mutex_lock (&writer->lock);
+      writer->chunk = g_queue_pop_head (&writer->free_chunks);
+      g_mutex_unlock (&writer->lock);
+
+      if (writer->chunk == NULL) {
+        GstAllocationParams params;
+
+        gst_allocation_params_init (&params);
+        params.align = WRITER_ALIGN - 1;
+        writer->chunk = gst_allocator_alloc (NULL, writer->chunk_size, &params);
+      }
+      gst_memory_map (writer->chunk, &writer->chunk_map, GST_MAP_WRITE);
+      writer->chunk_fill = 0;
+    }
+
+    n = MIN (size - offset, writer->chunk_size - writer->chunk_fill);
+    gst_buffer_extract (buffer, offset,
+        writer->chunk_map.data + writer->chunk_fill, n);
+    writer->chunk_fill += n;
+    offset += n;
+
+    if (writer->chunk_fill == writer->chunk_size)
+      gst_file_sink_writer_push_chunk (writer);
+  }
+}
+
+/* wait until @size more bytes fit in the backlog. A single buffer bigger
+ * than the backlog is let through once everything before it is written. */
+static GstFlowReturn
+gst_file_sink_writer_wait (GstFileSinkWriter * writer, gsize size)
+{
+  GstFileSink *sink = writer->sink;
+  GstClockTime start = GST_CLOCK_TIME_NONE;
+  GstFlowReturn flow;
+
+  g_mutex_lock (&writer->lock);
+  while (writer->last_flow == GST_FLOW_OK && writer->queued_bytes > 0
+      && writer->queued_bytes + size > sink->max_backlog_bytes) {
+    if (g_atomic_int_get (&sink->flushing)) {
+      flow = GST_FLOW_FLUSHING;
+      goto done;
+    }
+    if (!GST_CLOCK_TIME_IS_VALID (start)) {
+      GST_LOG_OBJECT (sink, "backlog full (%" G_GUINT64_FORMAT " bytes), "
+          "waiting", writer->queued_bytes);
+      start = gst_util_get_timestamp ();
+    }
+    g_cond_wait (&writer->cond, &writer->lock);
+  }
+  flow = writer->last_flow;
+
+done:
+  if (GST_CLOCK_TIME_IS_VALID (start))
+    writer->stall_time += gst_util_get_timestamp () - start;
+  g_mutex_unlock (&writer->lock);
+
+  return flow;
+}
+
+/* write out everything, including the partial staging chunk */
+static GstFlowReturn
+gst_file_sink_writer_drain (GstFileSinkWriter * writer)
+{
+  GstFlowReturn flow;
+
+  gst_file_sink_writer_push_chunk (writer);
+
+  g_mutex_lock (&writer->lock);
+  while (!g_queue_is_empty (&writer->queue) || writer->writing)
+    g_cond_wait (&writer->cond, &writer->lock);
+  flow = writer->last_flow;
+  g_mutex_unlock (&writer->lock);
+
+  return flow;
+}
+
+static void
+gst_file_sink_writer_unlock (GstFileSinkWriter * writer)
+{
+  g_mutex_lock (&writer->lock);
+  g_cond_broadcast (&writer->cond);
+  g_mutex_unlock (&writer->lock);
+}
+
+static GstFlowReturn
+gst_file_sink_render_async (GstFileSink * sink, GstBuffer * buffer)
+{
+  GstFileSinkWriter *writer = sink->writer;
+  gsize size = gst_buffer_get_size (buffer);
+  GstFlowReturn flow;
+
+  for (;;) {
+    flow = gst_file_sink_writer_wait (writer, size);
+
+    if (flow != GST_FLOW_FLUSHING)
+      break;
+
+    flow = gst_base_sink_wait_preroll (GST_BASE_SINK (sink));
+
+    if (flow != GST_FLOW_OK)
+      return flow;
+  }
+
+  if (flow != GST_FLOW_OK)
+    return flow;
+
+  GST_LOG_OBJECT (sink, "queueing buffer of %" G_GSIZE_FORMAT
+      " bytes at offset %" G_GUINT64_FORMAT, size, sink->current_pos);
+
+  gst_file_sink_writer_add (writer, buffer);
+  sink->current_pos += size;
+
+  return GST_FLOW_OK;
+}
+
 static gboolean
 gst_file_sink_open_file (GstFileSink * sink)
 {
+  gboolean o_direct;
+
   /* open the file */
   if (sink->filename == NULL || sink->filename[0] == '\0')
     goto no_filename;
 
+  o_direct = sink->async_write && sink->o_direct;
+  if (sink->o_direct && !o_direct)
+    GST_WARNING_OBJECT (sink, "o-direct requires async-write, ignoring");
+  if (o_direct && sink->append) {
+    GST_WARNING_OBJECT (sink, "o-direct is not supported in append mode");
+    o_direct = FALSE;
+  }
+
   if (sink->append)
-    sink->file = gst_fopen (sink->filename, "ab", sink->o_sync);
+    sink->file = gst_fopen (sink->filename, "ab", sink->o_sync, o_direct);
   else
-    sink->file = gst_fopen (sink->filename, "wb", sink->o_sync);
+    sink->file = gst_fopen (sink->filename, "wb", sink->o_sync, o_direct);
   if (sink->file == NULL)
     goto open_failed;
 
@@ -423,7 +896,14 @@ gst_file_sink_open_file (GstFileSink * sink)
     gst_buffer_list_unref (sink->buffer_list);
   sink->buffer_list = NULL;
 
-  if (sink->buffer_mode != GST_FILE_SINK_BUFFER_MODE_UNBUFFERED) {
+  if (sink->async_write) {
+    GstFileSinkWriter *writer = gst_file_sink_writer_new (sink);
+
+    GST_OBJECT_LOCK (sink);
+    sink->writer = writer;
+    GST_OBJECT_UNLOCK (sink);
+    sink->current_buffer_size = 0;
+  } else if (sink->buffer_mode != GST_FILE_SINK_BUFFER_MODE_UNBUFFERED) {
     if (sink->buffer_size == 0) {
       sink->buffer_size = DEFAULT_BUFFER_SIZE;
       g_object_notify (G_OBJECT (sink), "buffer-size");
@@ -467,6 +947,16 @@ gst_file_sink_close_file (GstFileSink * sink)
       GST_ELEMENT_ERROR (sink, RESOURCE, CLOSE,
           (_("Error closing file \"%s\"."), sink->filename), NULL);
 
+    if (sink->writer) {
+      GstFileSinkWriter *writer = sink->writer;
+
+      GST_OBJECT_LOCK (sink);
+      sink->writer = NULL;
+      GST_OBJECT_UNLOCK (sink);
+
+      gst_file_sink_writer_free (writer);
+    }
+
     if (fclose (sink->file) != 0)
       GST_ELEMENT_ERROR (sink, RESOURCE, CLOSE,
           (_("Error closing file \"%s\"."), sink->filename), GST_ERROR_SYSTEM);
@@ -574,6 +1064,15 @@ gst_file_sink_do_seek (GstFileSink * filesink, guint64 new_offset)
    * presumably this should basically yield new_offset */
   gst_file_sink_get_current_offset (filesink, &filesink->current_pos);
 
+  /* the writer thread is idle after the flush above */
+  if (filesink->writer) {
+    GstFileSinkWriter *writer = filesink->writer;
+
+    writer->position = filesink->current_pos;
+    if (writer->position % WRITER_ALIGN != 0)
+      gst_file_sink_writer_clear_o_direct (writer);
+  }
+
   return TRUE;
 
   /* ERRORS */
@@ -753,7 +1252,9 @@ gst_file_sink_flush_buffer (GstFileSink * filesink)
   GST_DEBUG_OBJECT (filesink, "Flushing out buffer of size %" G_GSIZE_FORMAT,
       filesink->current_buffer_size);
 
-  if (filesink->buffer && filesink->current_buffer_size) {
+  if (filesink->writer) {
+    flow_ret = gst_file_sink_writer_drain (filesink->writer);
+  } else if (filesink->buffer && filesink->current_buffer_size) {
     guint64 skip = 0;
 
     for (;;) {
@@ -863,7 +1364,14 @@ gst_file_sink_render_list (GstBaseSink * bsink, GstBufferList * buffer_list)
 
   gst_buffer_list_foreach (buffer_list, has_sync_after_buffer, &sync_after);
 
-  if (sync_after || (!sink->buffer && !sink->buffer_list)) {
+  if (sink->writer) {
+    flow = GST_FLOW_OK;
+    for (i = 0; i < num_buffers && flow == GST_FLOW_OK; i++)
+      flow = gst_file_sink_render_async (sink,
+          gst_buffer_list_get (buffer_list, i));
+    if (flow == GST_FLOW_OK && sync_after)
+      flow = gst_file_sink_flush_buffer (sink);
+  } else if (sync_after || (!sink->buffer && !sink->buffer_list)) {
     flow = gst_file_sink_flush_buffer (sink);
     if (flow == GST_FLOW_OK)
       flow = gst_file_sink_render_list_internal (sink, buffer_list);
@@ -952,7 +1460,11 @@ gst_file_sink_render (GstBaseSink * sink, GstBuffer * buffer)
 
   n_mem = gst_buffer_n_memory (buffer);
 
-  if (n_mem > 0 && (sync_after || (!filesink->buffer
+  if (n_mem > 0 && filesink->writer) {
+    flow = gst_file_sink_render_async (filesink, buffer);
+    if (flow == GST_FLOW_OK && sync_after)
+      flow = gst_file_sink_flush_buffer (filesink);
+  } else if (n_mem > 0 && (sync_after || (!filesink->buffer
               && !filesink->buffer_list))) {
     flow = gst_file_sink_flush_buffer (filesink);
     if (flow == GST_FLOW_OK) {
@@ -1045,6 +1557,11 @@ gst_file_sink_unlock (GstBaseSink * basesink)
   filesink = GST_FILE_SINK_CAST (basesink);
   g_atomic_int_set (&filesink->flushing, TRUE);
 
+  GST_OBJECT_LOCK (filesink);
+  if (filesink->writer)
+    gst_file_sink_writer_unlock (filesink->writer);
+  GST_OBJECT_UNLOCK (filesink);
+
   return TRUE;
 }
 
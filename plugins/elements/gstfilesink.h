@@ -96,6 +96,12 @@ struct _GstFileSink {
   gint max_transient_error_timeout;
 
   gboolean flushing;
+
+  /* For async-write */
+  gboolean async_write;
+  gboolean o_direct;
+  guint64 max_backlog_bytes;
+  gpointer writer;
 };
 
 struct _GstFileSinkClass {
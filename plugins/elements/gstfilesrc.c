@@ -31,6 +31,23 @@
  * gst-launch-1.0 filesrc location=song.ogg ! decodebin ! audioconvert ! audioresample ! autoaudiosink
  * ]| Play song.ogg audio file which must be in the current working directory.
  *
+ * Since 1.20 the #GstFileSrc:io-mode property can select io_uring for
+ * regular files. A number of reads (#GstFileSrc:queue-depth) is then kept in
+ * flight ahead of the current offset, so that sequential reading is not
+ * bounded by the latency of one read() call per buffer. When io_uring is not
+ * available, filesrc falls back to read().
+ *
+ * |[
+ * gst-launch-1.0 filesrc location=movie.mkv io-mode=io-uring queue-depth=8 ! matroskademux ! fakesink
+ * ]| Read movie.mkv with eight reads queued ahead of the demuxer.
+ *
+ * In mmap mode the file is mapped and the buffers wrap read-only ranges of
+ * the mapping instead of holding a copy of the data, so pipelines reading
+ * the same file share the page cache. The mapping is released when the last
+ * buffer referencing it is freed. Truncating a file while it is mapped makes
+ * accesses past the new end fail with SIGBUS, so only use this mode for files
+ * that are not modified while being read.
+ *
  */
 
 #ifdef HAVE_CONFIG_H
@@ -40,6 +57,7 @@
 #include <gst/gst.h>
 #include <glib/gstdio.h>
 #include "gstfilesrc.h"
+#include "gstelements_private.h"
 #include "gstcoreelementselements.h"
 
 #include <stdio.h>
@@ -79,6 +97,14 @@
 #include <errno.h>
 #include <string.h>
 
+#ifdef HAVE_LIBURING
+#include <liburing.h>
+#endif
+
+#ifdef HAVE_MMAP
+#include <sys/mman.h>
+#endif
+
 #include "../../gst/gst-i18n-lib.h"
 
 static GstStaticPadTemplate srctemplate = GST_STATIC_PAD_TEMPLATE ("src",
@@ -110,13 +136,86 @@ enum
 };
 
 #define DEFAULT_BLOCKSIZE       4*1024
+#define DEFAULT_IO_MODE         GST_FILE_SRC_IO_MODE_READ
+#define DEFAULT_QUEUE_DEPTH     4
 
 enum
 {
   PROP_0,
-  PROP_LOCATION
+  PROP_LOCATION,
+  PROP_IO_MODE,
+  PROP_QUEUE_DEPTH
 };
 
+#define GST_TYPE_FILE_SRC_IO_MODE (gst_file_src_io_mode_get_type ())
+static GType
+gst_file_src_io_mode_get_type (void)
+{
+  static GType io_mode_type = 0;
+  static const GEnumValue io_mode[] = {
+    {GST_FILE_SRC_IO_MODE_READ, "Blocking read()", "read"},
+    {GST_FILE_SRC_IO_MODE_URING, "Reads queued ahead with io_uring",
+        "io-uring"},
+    {GST_FILE_SRC_IO_MODE_MMAP, "Read-only memory mapped from the file",
+        "mmap"},
+    {0, NULL, NULL},
+  };
+
+  if (!io_mode_type) {
+    io_mode_type = g_enum_register_static ("GstFileSrcIOMode", io_mode);
+  }
+  return io_mode_type;
+}
+
+#ifdef HAVE_LIBURING
+/* One read queued on the ring. The buffer stays mapped until the kernel
+ * has completed the read into it. */
+typedef struct
+{
+  GstBuffer *buffer;
+  GstMapInfo map;
+  struct iovec iov;
+  guint64 offset;
+  gboolean done;
+  gint res;
+} GstFileSrcUringRead;
+
+typedef struct
+{
+  struct io_uring ring;
+
+  GstFileSrcUringRead *reads;   /* circular array of depth entries */
+  guint depth;
+  guint head;                   /* oldest queued read */
+  guint n_queued;               /* reads queued, completed or not */
+  guint n_inflight;             /* reads not completed yet */
+
+  guint64 next_offset;          /* offset of the next read to queue */
+  guint length;                 /* length of every queued read */
+  guint64 size;                 /* file size when last checked */
+} GstFileSrcUring;
+#endif
+
+#ifdef HAVE_MMAP
+/* The file mapped read-only. Every memory handed out holds a ref on the
+ * mapping so that it stays valid after the element remaps or stops. */
+typedef struct
+{
+  gint refcount;
+  guint8 *data;
+  gsize size;
+} GstFileSrcMapping;
+
+typedef struct
+{
+  GstFileSrcMapping *mapping;
+  gsize pagesize;
+
+  guint64 next_offset;          /* where a sequential read continues */
+  gboolean sequential;          /* current madvise() mode */
+} GstFileSrcMmap;
+#endif
+
 static void gst_file_src_finalize (GObject * object);
 
 static void gst_file_src_set_property (GObject * object, guint prop_id,
@@ -131,6 +230,10 @@ static gboolean gst_file_src_is_seekable (GstBaseSrc * src);
 static gboolean gst_file_src_get_size (GstBaseSrc * src, guint64 * size);
 static GstFlowReturn gst_file_src_fill (GstBaseSrc * src, guint64 offset,
     guint length, GstBuffer * buf);
+static GstFlowReturn gst_file_src_create (GstBaseSrc * src, guint64 offset,
+    guint length, GstBuffer ** buf);
+static gboolean gst_file_src_decide_allocation (GstBaseSrc * src,
+    GstQuery * query);
 
 static void gst_file_src_uri_handler_init (gpointer g_iface,
     gpointer iface_data);
@@ -163,6 +266,40 @@ gst_file_src_class_init (GstFileSrcClass * klass)
           G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
           GST_PARAM_MUTABLE_READY));
 
+  /**
+   * GstFileSrc:io-mode:
+   *
+   * How to read from the file. io-uring is only used for regular files and
+   * falls back to read() when the kernel or the build lacks support for it.
+   *
+   * In the default read mode, buffers hand out references to ranges of the
+   * file instead of its contents when downstream supports that (for example
+   * fdsink), so that the data is copied by the kernel. The other modes
+   * always provide the file contents in memory.
+   *
+   * Since: 1.20
+   */
+  g_object_class_install_property (gobject_class, PROP_IO_MODE,
+      g_param_spec_enum ("io-mode", "IO mode",
+          "How to read from the file", GST_TYPE_FILE_SRC_IO_MODE,
+          DEFAULT_IO_MODE, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
+
+  /**
+   * GstFileSrc:queue-depth:
+   *
+   * Number of blocks read ahead of the current offset: reads kept in flight
+   * in io-uring mode, pages prefetched with madvise() in mmap mode.
+   *
+   * Since: 1.20
+   */
+  g_object_class_install_property (gobject_class, PROP_QUEUE_DEPTH,
+      g_param_spec_uint ("queue-depth", "Queue depth",
+          "Number of blocks read ahead of the current offset "
+          "in io-uring and mmap mode", 1, 256, DEFAULT_QUEUE_DEPTH,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
+
   gobject_class->finalize = gst_file_src_finalize;
 
   gst_element_class_set_static_metadata (gstelement_class,
@@ -177,11 +314,16 @@ gst_file_src_class_init (GstFileSrcClass * klass)
   gstbasesrc_class->is_seekable = GST_DEBUG_FUNCPTR (gst_file_src_is_seekable);
   gstbasesrc_class->get_size = GST_DEBUG_FUNCPTR (gst_file_src_get_size);
   gstbasesrc_class->fill = GST_DEBUG_FUNCPTR (gst_file_src_fill);
+  gstbasesrc_class->create = GST_DEBUG_FUNCPTR (gst_file_src_create);
+  gstbasesrc_class->decide_allocation =
+      GST_DEBUG_FUNCPTR (gst_file_src_decide_allocation);
 
   if (sizeof (off_t) < 8) {
     GST_LOG ("No large file support, sizeof (off_t) = %" G_GSIZE_FORMAT "!",
         sizeof (off_t));
   }
+
+  gst_type_mark_as_plugin_api (GST_TYPE_FILE_SRC_IO_MODE, 0);
 }
 
 static void
@@ -193,6 +335,12 @@ gst_file_src_init (GstFileSrc * src)
 
   src->is_regular = FALSE;
 
+  src->io_mode = DEFAULT_IO_MODE;
+  src->queue_depth = DEFAULT_QUEUE_DEPTH;
+  src->uring = NULL;
+  src->mmap = NULL;
+  src->fd_range = NULL;
+
   gst_base_src_set_blocksize (GST_BASE_SRC (src), DEFAULT_BLOCKSIZE);
 }
 
@@ -270,6 +418,12 @@ gst_file_src_set_property (GObject * object, guint prop_id,
     case PROP_LOCATION:
       gst_file_src_set_location (src, g_value_get_string (value), NULL);
       break;
+    case PROP_IO_MODE:
+      src->io_mode = g_value_get_enum (value);
+      break;
+    case PROP_QUEUE_DEPTH:
+      src->queue_depth = g_value_get_uint (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -290,6 +444,12 @@ gst_file_src_get_property (GObject * object, guint prop_id, GValue * value,
     case PROP_LOCATION:
       g_value_set_string (value, src->filename);
       break;
+    case PROP_IO_MODE:
+      g_value_set_enum (value, src->io_mode);
+      break;
+    case PROP_QUEUE_DEPTH:
+      g_value_set_uint (value, src->queue_depth);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -395,6 +555,510 @@ buffer_write_fail:
   }
 }
 
+#ifdef HAVE_LIBURING
+static GstFileSrcUring *
+gst_file_src_uring_new (GstFileSrc * src)
+{
+  GstFileSrcUring *uring;
+  int ret;
+
+  uring = g_new0 (GstFileSrcUring, 1);
+  uring->depth = src->queue_depth;
+  uring->reads = g_new0 (GstFileSrcUringRead, uring->depth);
+
+  ret = io_uring_queue_init (uring->depth, &uring->ring, 0);
+  if (ret < 0) {
+    GST_WARNING_OBJECT (src, "io_uring not available (%s), using read()",
+        g_strerror (-ret));
+    g_free (uring->reads);
+    g_free (uring);
+    return NULL;
+  }
+
+  GST_DEBUG_OBJECT (src, "using io_uring with %u reads queued ahead",
+      uring->depth);
+
+  return uring;
+}
+
+/* collect completed reads, blocking for at least one if @wait is set */
+static gboolean
+gst_file_src_uring_reap (GstFileSrcUring * uring, gboolean wait)
+{
+  struct io_uring_cqe *cqe;
+  GstFileSrcUringRead *read;
+  int ret;
+
+  while (uring->n_inflight > 0) {
+    if (wait)
+      ret = io_uring_wait_cqe (&uring->ring, &cqe);
+    else
+      ret = io_uring_peek_cqe (&uring->ring, &cqe);
+
+    if (ret == -EINTR)
+      continue;
+    if (ret == -EAGAIN)
+      break;
+    if (G_UNLIKELY (ret < 0)) {
+      errno = -ret;
+      return FALSE;
+    }
+
+    read = io_uring_cqe_get_data (cqe);
+    read->res = cqe->res;
+    read->done = TRUE;
+    uring->n_inflight--;
+    io_uring_cqe_seen (&uring->ring, cqe);
+
+    /* only block for the first one, pick up the others if they are ready */
+    wait = FALSE;
+  }
+
+  return TRUE;
+}
+
+static void
+gst_file_src_uring_release (GstFileSrcUringRead * read)
+{
+  gst_buffer_unmap (read->buffer, &read->map);
+  gst_buffer_unref (read->buffer);
+  read->buffer = NULL;
+}
+
+/* wait for the reads still in flight and drop everything queued */
+static void
+gst_file_src_uring_flush (GstFileSrcUring * uring)
+{
+  while (uring->n_inflight > 0) {
+    if (!gst_file_src_uring_reap (uring, TRUE))
+      break;
+  }
+
+  while (uring->n_queued > 0) {
+    gst_file_src_uring_release (&uring->reads[uring->head]);
+    uring->head = (uring->head + 1) % uring->depth;
+    uring->n_queued--;
+  }
+  uring->head = 0;
+}
+
+static void
+gst_file_src_uring_free (GstFileSrcUring * uring)
+{
+  gst_file_src_uring_flush (uring);
+  io_uring_queue_exit (&uring->ring);
+  g_free (uring->reads);
+  g_free (uring);
+}
+
+/* queue reads until @depth are in flight, without going past the end of the
+ * file unless nothing at all is queued */
+static GstFlowReturn
+gst_file_src_uring_fill_queue (GstFileSrc * src, GstFileSrcUring * uring)
+{
+  GstBaseSrc *basesrc = GST_BASE_SRC_CAST (src);
+  GstFlowReturn ret = GST_FLOW_OK;
+  guint n_submit = 0;
+
+  while (uring->n_queued < uring->depth) {
+    GstFileSrcUringRead *read;
+    struct io_uring_sqe *sqe;
+
+    if (uring->n_queued > 0 && uring->next_offset >= uring->size)
+      break;
+
+    read = &uring->reads[(uring->head + uring->n_queued) % uring->depth];
+
+    ret = GST_BASE_SRC_CLASS (parent_class)->alloc (basesrc,
+        uring->next_offset, uring->length, &read->buffer);
+    if (G_UNLIKELY (ret != GST_FLOW_OK))
+      break;
+
+    if (!gst_buffer_map (read->buffer, &read->map, GST_MAP_WRITE)) {
+      gst_buffer_unref (read->buffer);
+      read->buffer = NULL;
+      GST_ELEMENT_ERROR (src, RESOURCE, WRITE, (NULL),
+          ("Can't write to buffer"));
+      ret = GST_FLOW_ERROR;
+      break;
+    }
+
+    sqe = io_uring_get_sqe (&uring->ring);
+    if (G_UNLIKELY (sqe == NULL)) {
+      gst_file_src_uring_release (read);
+      break;
+    }
+
+    read->iov.iov_base = read->map.data;
+    read->iov.iov_len = uring->length;
+    read->offset = uring->next_offset;
+    read->done = FALSE;
+    read->res = 0;
+
+    io_uring_prep_readv (sqe, src->fd, &read->iov, 1, read->offset);
+    io_uring_sqe_set_data (sqe, read);
+
+    GST_LOG_OBJECT (src, "Queueing read of %u bytes at offset 0x%"
+        G_GINT64_MODIFIER "x", uring->length, read->offset);
+
+    uring->next_offset += uring->length;
+    uring->n_queued++;
+    uring->n_inflight++;
+    n_submit++;
+  }
+
+  if (n_submit > 0)
+    io_uring_submit (&uring->ring);
+
+  return ret;
+}
+
+static GstFlowReturn
+gst_file_src_create_uring (GstFileSrc * src, guint64 offset, guint length,
+    GstBuffer ** buffer)
+{
+  GstFileSrcUring *uring = src->uring;
+  GstFileSrcUringRead *read;
+  GstFlowReturn ret;
+  GstBuffer *buf;
+  gint res;
+
+  /* the queued reads can only be used when this request continues where the
+   * previous one stopped, otherwise start over from the new offset */
+  if (uring->n_queued == 0 || uring->length != length
+      || uring->reads[uring->head].offset != offset) {
+    GST_DEBUG_OBJECT (src, "restarting queued reads at offset %"
+        G_GUINT64_FORMAT, offset);
+    gst_file_src_uring_flush (uring);
+    uring->next_offset = offset;
+    uring->length = length;
+    gst_file_src_get_size (GST_BASE_SRC_CAST (src), &uring->size);
+  }
+
+  ret = gst_file_src_uring_fill_queue (src, uring);
+  if (uring->n_queued == 0)
+    return ret == GST_FLOW_OK ? GST_FLOW_ERROR : ret;
+
+  read = &uring->reads[uring->head];
+  while (!read->done) {
+    if (!gst_file_src_uring_reap (uring, TRUE))
+      goto could_not_read;
+  }
+
+  buf = read->buffer;
+  res = read->res;
+  gst_buffer_unmap (buf, &read->map);
+  read->buffer = NULL;
+  uring->head = (uring->head + 1) % uring->depth;
+  uring->n_queued--;
+
+  if (G_UNLIKELY (res < 0)) {
+    gst_buffer_unref (buf);
+    if (res == -EAGAIN || res == -EINTR)
+      goto retry;
+    errno = -res;
+    goto could_not_read;
+  }
+
+  /* files should eos if they read 0 and more was requested */
+  if (G_UNLIKELY (res == 0)) {
+    gst_buffer_unref (buf);
+    gst_file_src_uring_flush (uring);
+    GST_DEBUG ("EOS");
+    return GST_FLOW_EOS;
+  }
+
+  if (res != length)
+    gst_buffer_resize (buf, 0, res);
+
+  GST_BUFFER_OFFSET (buf) = offset;
+  GST_BUFFER_OFFSET_END (buf) = offset + res;
+
+  /* keep the queue full for the next call, errors will show up there */
+  gst_file_src_uring_fill_queue (src, uring);
+
+  *buffer = buf;
+
+  return GST_FLOW_OK;
+
+  /* ERROR */
+retry:
+  {
+    GST_DEBUG_OBJECT (src, "read interrupted, retrying with read()");
+    gst_file_src_uring_flush (uring);
+    return GST_BASE_SRC_CLASS (parent_class)->create (GST_BASE_SRC_CAST (src),
+        offset, length, buffer);
+  }
+could_not_read:
+  {
+    GST_ELEMENT_ERROR (src, RESOURCE, READ, (NULL), GST_ERROR_SYSTEM);
+    gst_file_src_uring_flush (uring);
+    return GST_FLOW_ERROR;
+  }
+}
+#endif
+
+#ifdef HAVE_MMAP
+static GstFileSrcMapping *
+gst_file_src_mapping_new (GstFileSrc * src, gsize size)
+{
+  GstFileSrcMapping *mapping;
+  gpointer data;
+
+  data = mmap (NULL, size, PROT_READ, MAP_SHARED, src->fd, 0);
+  if (data == MAP_FAILED) {
+    GST_WARNING_OBJECT (src, "mmap of %" G_GSIZE_FORMAT " bytes failed: %s",
+        size, g_strerror (errno));
+    return NULL;
+  }
+
+  madvise (data, size, MADV_SEQUENTIAL);
+
+  GST_DEBUG_OBJECT (src, "mapped %" G_GSIZE_FORMAT " bytes at %p", size, data);
+
+  mapping = g_new (GstFileSrcMapping, 1);
+  mapping->refcount = 1;
+  mapping->data = data;
+  mapping->size = size;
+
+  return mapping;
+}
+
+static GstFileSrcMapping *
+gst_file_src_mapping_ref (GstFileSrcMapping * mapping)
+{
+  g_atomic_int_inc (&mapping->refcount);
+  return mapping;
+}
+
+static void
+gst_file_src_mapping_unref (GstFileSrcMapping * mapping)
+{
+  if (g_atomic_int_dec_and_test (&mapping->refcount)) {
+    munmap (mapping->data, mapping->size);
+    g_free (mapping);
+  }
+}
+
+static GstFileSrcMmap *
+gst_file_src_mmap_new (GstFileSrc * src)
+{
+  GstFileSrcMmap *mm;
+
+  mm = g_new0 (GstFileSrcMmap, 1);
+  mm->pagesize = sysconf (_SC_PAGESIZE);
+  mm->sequential = TRUE;
+
+  return mm;
+}
+
+static void
+gst_file_src_mmap_free (GstFileSrcMmap * mm)
+{
+  if (mm->mapping)
+    gst_file_src_mapping_unref (mm->mapping);
+  g_free (mm);
+}
+
+/* Sequential reading keeps the kernel readahead on and asks for the next
+ * queue-depth blocks in advance. Anything else switches the mapping to
+ * random access and only prefetches the requested range. */
+static void
+gst_file_src_mmap_advise (GstFileSrc * src, GstFileSrcMmap * mm,
+    guint64 offset, guint length)
+{
+  GstFileSrcMapping *mapping = mm->mapping;
+  guint64 start, end;
+
+  if (offset == mm->next_offset) {
+    if (!mm->sequential) {
+      GST_DEBUG_OBJECT (src, "sequential access, enabling readahead");
+      madvise (mapping->data, mapping->size, MADV_SEQUENTIAL);
+      mm->sequential = TRUE;
+    }
+    start = offset + length;
+    end = start + (guint64) length * src->queue_depth;
+  } else {
+    if (mm->sequential) {
+      GST_DEBUG_OBJECT (src, "random access, disabling readahead");
+      madvise (mapping->data, mapping->size, MADV_RANDOM);
+      mm->sequential = FALSE;
+    }
+    start = offset;
+    end = offset + length;
+  }
+  mm->next_offset = offset + length;
+
+  start -= start % mm->pagesize;
+  end = MIN (end, mapping->size);
+  if (start < end)
+    madvise (mapping->data + start, end - start, MADV_WILLNEED);
+}
+
+static GstFlowReturn
+gst_file_src_create_mmap (GstFileSrc * src, guint64 offset, guint length,
+    GstBuffer ** buffer)
+{
+  GstFileSrcMmap *mm = src->mmap;
+  GstFileSrcMapping *mapping;
+  GstMemory *mem;
+  GstBuffer *buf;
+  guint64 start;
+  gsize page_offset, maxsize;
+
+  /* the file may have grown since it was mapped, memory handed out earlier
+   * keeps the old mapping alive */
+  if (mm->mapping == NULL || offset + length > mm->mapping->size) {
+    guint64 size;
+
+    if (!gst_file_src_get_size (GST_BASE_SRC_CAST (src), &size))
+      goto could_not_stat;
+
+    if (size > 0 && (mm->mapping == NULL || size > mm->mapping->size)) {
+      mapping = gst_file_src_mapping_new (src, size);
+      if (mapping == NULL)
+        goto could_not_map;
+      if (mm->mapping)
+        gst_file_src_mapping_unref (mm->mapping);
+      mm->mapping = mapping;
+      mm->sequential = TRUE;
+    }
+  }
+
+  mapping = mm->mapping;
+  if (mapping == NULL || offset >= mapping->size)
+    goto eos;
+
+  length = MIN (length, mapping->size - offset);
+
+  gst_file_src_mmap_advise (src, mm, offset, length);
+
+  /* wrap the pages holding the requested range */
+  page_offset = offset % mm->pagesize;
+  start = offset - page_offset;
+  maxsize = page_offset + length + mm->pagesize - 1;
+  maxsize -= maxsize % mm->pagesize;
+  maxsize = MIN (maxsize, mapping->size - start);
+
+  mem = gst_memory_new_wrapped (GST_MEMORY_FLAG_READONLY,
+      mapping->data + start, maxsize, page_offset, length,
+      gst_file_src_mapping_ref (mapping),
+      (GDestroyNotify) gst_file_src_mapping_unref);
+
+  buf = gst_buffer_new ();
+  gst_buffer_append_memory (buf, mem);
+
+  GST_BUFFER_OFFSET (buf) = offset;
+  GST_BUFFER_OFFSET_END (buf) = offset + length;
+
+  *buffer = buf;
+
+  return GST_FLOW_OK;
+
+  /* ERROR */
+could_not_stat:
+  {
+    GST_ELEMENT_ERROR (src, RESOURCE, READ, (NULL), GST_ERROR_SYSTEM);
+    return GST_FLOW_ERROR;
+  }
+could_not_map:
+  {
+    GST_ELEMENT_ERROR (src, RESOURCE, READ, (NULL),
+        ("Could not map file \"%s\"", src->filename));
+    return GST_FLOW_ERROR;
+  }
+eos:
+  {
+    GST_DEBUG ("EOS");
+    return GST_FLOW_EOS;
+  }
+}
+#endif
+
+#ifdef HAVE_FD_RANGE_MEMORY
+/* hands out a reference to the file range instead of its contents, basesrc
+ * already clipped the range to the file size */
+static GstFlowReturn
+gst_file_src_create_fd_range (GstFileSrc * src, guint64 offset, guint length,
+    GstBuffer ** buffer)
+{
+  GstBuffer *buf;
+
+  buf = gst_buffer_new ();
+  gst_buffer_append_memory (buf,
+      gst_fd_range_memory_new (src->fd_range, offset, length));
+
+  GST_BUFFER_OFFSET (buf) = offset;
+  GST_BUFFER_OFFSET_END (buf) = offset + length;
+
+  *buffer = buf;
+
+  return GST_FLOW_OK;
+}
+#endif
+
+static GstFlowReturn
+gst_file_src_create (GstBaseSrc * basesrc, guint64 offset, guint length,
+    GstBuffer ** buffer)
+{
+#if defined (HAVE_LIBURING) || defined (HAVE_MMAP) || defined (HAVE_FD_RANGE_MEMORY)
+  GstFileSrc *src = GST_FILE_SRC_CAST (basesrc);
+#endif
+
+  /* buffers provided by downstream are filled with a plain read() */
+#ifdef HAVE_FD_RANGE_MEMORY
+  if (src->fd_range != NULL && *buffer == NULL && length > 0)
+    return gst_file_src_create_fd_range (src, offset, length, buffer);
+#endif
+#ifdef HAVE_LIBURING
+  if (src->uring != NULL && *buffer == NULL && length > 0)
+    return gst_file_src_create_uring (src, offset, length, buffer);
+#endif
+#ifdef HAVE_MMAP
+  if (src->mmap != NULL && *buffer == NULL && length > 0)
+    return gst_file_src_create_mmap (src, offset, length, buffer);
+#endif
+
+  return GST_BASE_SRC_CLASS (parent_class)->create (basesrc, offset, length,
+      buffer);
+}
+
+static gboolean
+gst_file_src_decide_allocation (GstBaseSrc * basesrc, GstQuery * query)
+{
+  GstFileSrc *src = GST_FILE_SRC_CAST (basesrc);
+
+#ifdef HAVE_FD_RANGE_MEMORY
+  /* downstream can copy straight from our file, don't read it ourselves */
+  if (src->fd_range) {
+    gst_fd_range_file_unref (src->fd_range);
+    src->fd_range = NULL;
+  }
+  /* only replaces read(), an explicitly selected io-mode is kept */
+  if (src->io_mode == GST_FILE_SRC_IO_MODE_READ && src->seekable &&
+      gst_query_find_allocation_meta (query, GST_FD_RANGE_META_API_TYPE,
+          NULL)) {
+    GST_DEBUG_OBJECT (src, "downstream accepts file ranges");
+    src->fd_range = gst_fd_range_file_new (src->fd);
+  }
+#endif
+
+  /* queued reads hold on to buffers from the pool, make room for them */
+  if (src->uring != NULL && gst_query_get_n_allocation_pools (query) > 0) {
+    GstBufferPool *pool;
+    guint size, min, max;
+
+    gst_query_parse_nth_allocation_pool (query, 0, &pool, &size, &min, &max);
+    if (max != 0)
+      max += src->queue_depth;
+    gst_query_set_nth_allocation_pool (query, 0, pool, size, min, max);
+    if (pool)
+      gst_object_unref (pool);
+  }
+
+  return GST_BASE_SRC_CLASS (parent_class)->decide_allocation (basesrc, query);
+}
+
 static gboolean
 gst_file_src_is_seekable (GstBaseSrc * basesrc)
 {
@@ -537,6 +1201,28 @@ gst_file_src_start (GstBaseSrc * basesrc)
 
   gst_base_src_set_dynamic_size (basesrc, src->seekable);
 
+  if (src->io_mode == GST_FILE_SRC_IO_MODE_URING) {
+    if (!src->seekable) {
+      GST_INFO_OBJECT (src, "io-uring mode needs a regular file, using read()");
+    } else {
+#ifdef HAVE_LIBURING
+      src->uring = gst_file_src_uring_new (src);
+#else
+      GST_WARNING_OBJECT (src, "built without io_uring support, using read()");
+#endif
+    }
+  } else if (src->io_mode == GST_FILE_SRC_IO_MODE_MMAP) {
+    if (!src->seekable) {
+      GST_INFO_OBJECT (src, "mmap mode needs a regular file, using read()");
+    } else {
+#ifdef HAVE_MMAP
+      src->mmap = gst_file_src_mmap_new (src);
+#else
+      GST_WARNING_OBJECT (src, "built without mmap support, using read()");
+#endif
+    }
+  }
+
   return TRUE;
 
   /* ERROR */
@@ -600,6 +1286,25 @@ gst_file_src_stop (GstBaseSrc * basesrc)
 {
   GstFileSrc *src = GST_FILE_SRC (basesrc);
 
+#ifdef HAVE_FD_RANGE_MEMORY
+  if (src->fd_range) {
+    gst_fd_range_file_unref (src->fd_range);
+    src->fd_range = NULL;
+  }
+#endif
+#ifdef HAVE_LIBURING
+  if (src->uring) {
+    gst_file_src_uring_free (src->uring);
+    src->uring = NULL;
+  }
+#endif
+#ifdef HAVE_MMAP
+  if (src->mmap) {
+    gst_file_src_mmap_free (src->mmap);
+    src->mmap = NULL;
+  }
+#endif
+
   /* close the file */
   g_close (src->fd, NULL);
 
@@ -46,6 +46,22 @@ G_BEGIN_DECLS
 typedef struct _GstFileSrc GstFileSrc;
 typedef struct _GstFileSrcClass GstFileSrcClass;
 
+/**
+ * GstFileSrcIOMode:
+ * @GST_FILE_SRC_IO_MODE_READ: blocking read() on the streaming thread
+ * @GST_FILE_SRC_IO_MODE_URING: reads queued ahead with io_uring
+ * @GST_FILE_SRC_IO_MODE_MMAP: read-only memory wrapping a mapping of the file
+ *
+ * The method used to read data from the file.
+ *
+ * Since: 1.20
+ */
+typedef enum {
+  GST_FILE_SRC_IO_MODE_READ,
+  GST_FILE_SRC_IO_MODE_URING,
+  GST_FILE_SRC_IO_MODE_MMAP
+} GstFileSrcIOMode;
+
 /**
  * GstFileSrc:
  *
@@ -63,6 +79,16 @@ struct _GstFileSrc {
   gboolean seekable;                    /* whether the file is seekable */
   gboolean is_regular;                  /* whether it's a (symlink to a)
                                            regular file */
+
+  GstFileSrcIOMode io_mode;             /* requested read method */
+  guint queue_depth;                    /* blocks read ahead in io-uring and
+                                           mmap mode */
+  gpointer uring;                       /* io-uring state, NULL when reading
+                                           with read() */
+  gpointer mmap;                        /* mmap state, NULL when not mapping
+                                           the file */
+  gpointer fd_range;                    /* file handed out by reference,
+                                           NULL unless downstream can use it */
 };
 
 struct _GstFileSrcClass {
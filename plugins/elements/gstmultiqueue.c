@@ -133,6 +133,11 @@ struct _GstSingleQueue
    */
   gboolean pushed;
 
+  /* protects the segment positions, the time level, the cached sink time
+   * and the buffering state of this queue against the other streaming
+   * thread of this queue. Taken after the multiqueue lock */
+  GMutex lock;
+
   /* segments */
   GstSegment sink_segment;
   GstSegment src_segment;
@@ -144,6 +149,10 @@ struct _GstSingleQueue
   GstClockTimeDiff sinktime, srctime;
   /* cached input value, used for interleave */
   GstClockTimeDiff cached_sinktime;
+  /* lowest and highest sink time seen by the last interleave calculation
+   * of this queue, and the sink time after which the interleave may shrink.
+   * New sink times that don't cross these can't change the interleave */
+  GstClockTimeDiff interleave_low, interleave_high, interleave_shrink;
   /* TRUE if either position needs to be recalculated */
   gboolean sink_tainted, src_tainted;
 
@@ -151,6 +160,10 @@ struct _GstSingleQueue
   GstDataQueue *queue;
   GstDataQueueSize max_size, extra_size;
   GstClockTime cur_time;
+  /* TRUE when this queue is counted in the full_queues of the multiqueue */
+  gboolean full;
+  /* TRUE once the pad was released, the queue is not counted anymore */
+  gboolean removed;
   gboolean is_eos;
   gboolean is_segment_done;
   gboolean is_sparse;
@@ -202,12 +215,15 @@ static void single_queue_overrun_cb (GstDataQueue * dq, GstSingleQueue * sq);
 static void single_queue_underrun_cb (GstDataQueue * dq, GstSingleQueue * sq);
 
 static void update_buffering (GstMultiQueue * mq, GstSingleQueue * sq);
+static gboolean update_full_queues (GstMultiQueue * mq, GstSingleQueue * sq,
+    gint buffering_level);
 static void gst_multi_queue_post_buffering (GstMultiQueue * mq);
 static void recheck_buffering_status (GstMultiQueue * mq);
 
 static void gst_single_queue_flush_queue (GstSingleQueue * sq, gboolean full);
 
 static void calculate_interleave (GstMultiQueue * mq, GstSingleQueue * sq);
+static void reset_interleave_ranges (GstMultiQueue * mq);
 
 static GstStaticPadTemplate sinktemplate = GST_STATIC_PAD_TEMPLATE ("sink_%u",
     GST_PAD_SINK,
@@ -257,6 +273,9 @@ enum
 
 #define DEFAULT_MINIMUM_INTERLEAVE (250 * GST_MSECOND)
 
+#define DEFAULT_MAX_BATCH_BUFFERS 1
+#define DEFAULT_MAX_BATCH_TIME 0
+
 enum
 {
   PROP_0,
@@ -276,6 +295,8 @@ enum
   PROP_UNLINKED_CACHE_TIME,
   PROP_MINIMUM_INTERLEAVE,
   PROP_STATS,
+  PROP_MAX_BATCH_BUFFERS,
+  PROP_MAX_BATCH_TIME,
   PROP_LAST
 };
 
@@ -333,10 +354,18 @@ enum
   g_mutex_unlock (&q->qlock);                                            \
 } G_STMT_END
 
+#define GST_SINGLE_QUEUE_MUTEX_LOCK(sq) G_STMT_START {                        \
+  g_mutex_lock (&sq->lock);                                              \
+} G_STMT_END
+
+#define GST_SINGLE_QUEUE_MUTEX_UNLOCK(sq) G_STMT_START {                      \
+  g_mutex_unlock (&sq->lock);                                            \
+} G_STMT_END
+
 #define SET_PERCENT(mq, perc) G_STMT_START {                             \
-  if (perc != mq->buffering_percent) {                                   \
-    mq->buffering_percent = perc;                                        \
-    mq->buffering_percent_changed = TRUE;                                \
+  if (perc != g_atomic_int_get (&mq->buffering_percent)) {               \
+    g_atomic_int_set (&mq->buffering_percent, perc);                     \
+    g_atomic_int_set (&mq->buffering_percent_changed, TRUE);             \
     GST_DEBUG_OBJECT (mq, "buffering %d percent", perc);                 \
   }                                                                      \
 } G_STMT_END
@@ -450,7 +479,9 @@ gst_multiqueue_pad_get_current_level_time (GstMultiQueuePad * pad)
     GST_MULTI_QUEUE_MUTEX_LOCK (mq);
   }
 
+  GST_SINGLE_QUEUE_MUTEX_LOCK (sq);
   ret = sq->cur_time;
+  GST_SINGLE_QUEUE_MUTEX_UNLOCK (sq);
 
   if (mq) {
     GST_MULTI_QUEUE_MUTEX_UNLOCK (mq);
@@ -828,6 +859,38 @@ gst_multi_queue_class_init (GstMultiQueueClass * klass)
           "Multiqueue Statistics",
           GST_TYPE_STRUCTURE, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
 
+  /**
+   * GstMultiQueue:max-batch-buffers:
+   *
+   * Maximum number of consecutive buffers that are taken out of a queue at
+   * once and pushed downstream as one #GstBufferList. Only buffers that are
+   * already queued are combined, the queue never waits for more data. 1
+   * pushes every buffer on its own.
+   *
+   * Since: 1.20
+   */
+  g_object_class_install_property (gobject_class, PROP_MAX_BATCH_BUFFERS,
+      g_param_spec_uint ("max-batch-buffers", "Max. batch buffers",
+          "Maximum number of queued buffers to push downstream as one buffer "
+          "list (1=disable)", 1, G_MAXUINT, DEFAULT_MAX_BATCH_BUFFERS,
+          G_PARAM_READWRITE | GST_PARAM_MUTABLE_PLAYING |
+          G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstMultiQueue:max-batch-time:
+   *
+   * Maximum total duration of the buffers that are pushed downstream as one
+   * #GstBufferList when #GstMultiQueue:max-batch-buffers is bigger than 1.
+   *
+   * Since: 1.20
+   */
+  g_object_class_install_property (gobject_class, PROP_MAX_BATCH_TIME,
+      g_param_spec_uint64 ("max-batch-time", "Max. batch time (ns)",
+          "Maximum duration of the buffers pushed downstream as one buffer "
+          "list (0=disable)", 0, G_MAXUINT64, DEFAULT_MAX_BATCH_TIME,
+          G_PARAM_READWRITE | GST_PARAM_MUTABLE_PLAYING |
+          G_PARAM_STATIC_STRINGS));
+
   gobject_class->finalize = gst_multi_queue_finalize;
 
   gst_element_class_set_static_metadata (gstelement_class,
@@ -870,6 +933,8 @@ gst_multi_queue_init (GstMultiQueue * mqueue)
   mqueue->use_interleave = DEFAULT_USE_INTERLEAVE;
   mqueue->min_interleave_time = DEFAULT_MINIMUM_INTERLEAVE;
   mqueue->unlinked_cache_time = DEFAULT_UNLINKED_CACHE_TIME;
+  mqueue->max_batch_buffers = DEFAULT_MAX_BATCH_BUFFERS;
+  mqueue->max_batch_time = DEFAULT_MAX_BATCH_TIME;
 
   mqueue->counter = 1;
   mqueue->highid = -1;
@@ -900,7 +965,9 @@ gst_multi_queue_finalize (GObject * object)
     while (tmp) {						\
       GstSingleQueue *q = (GstSingleQueue*)tmp->data;		\
       q->max_size.format = mq->max_size.format;                 \
+      GST_SINGLE_QUEUE_MUTEX_LOCK (q);                          \
       update_buffering (mq, q);                                 \
+      GST_SINGLE_QUEUE_MUTEX_UNLOCK (q);                        \
       gst_data_queue_limits_changed (q->queue);                 \
       tmp = g_list_next(tmp);					\
     };								\
@@ -948,7 +1015,9 @@ gst_multi_queue_set_property (GObject * object, guint prop_id,
         } else if (new_size > size.visible) {
           q->max_size.visible = new_size;
         }
+        GST_SINGLE_QUEUE_MUTEX_LOCK (q);
         update_buffering (mq, q);
+        GST_SINGLE_QUEUE_MUTEX_UNLOCK (q);
         gst_data_queue_limits_changed (q->queue);
         tmp = g_list_next (tmp);
       }
@@ -1017,6 +1086,16 @@ gst_multi_queue_set_property (GObject * object, guint prop_id,
         calculate_interleave (mq, NULL);
       GST_MULTI_QUEUE_MUTEX_UNLOCK (mq);
       break;
+    case PROP_MAX_BATCH_BUFFERS:
+      GST_MULTI_QUEUE_MUTEX_LOCK (mq);
+      mq->max_batch_buffers = g_value_get_uint (value);
+      GST_MULTI_QUEUE_MUTEX_UNLOCK (mq);
+      break;
+    case PROP_MAX_BATCH_TIME:
+      GST_MULTI_QUEUE_MUTEX_LOCK (mq);
+      mq->max_batch_time = g_value_get_uint64 (value);
+      GST_MULTI_QUEUE_MUTEX_UNLOCK (mq);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -1120,6 +1199,12 @@ gst_multi_queue_get_property (GObject * object, guint prop_id,
     case PROP_STATS:
       g_value_take_boxed (value, gst_multi_queue_get_stats (mq));
       break;
+    case PROP_MAX_BATCH_BUFFERS:
+      g_value_set_uint (value, mq->max_batch_buffers);
+      break;
+    case PROP_MAX_BATCH_TIME:
+      g_value_set_uint64 (value, mq->max_batch_time);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -1242,6 +1327,14 @@ gst_multi_queue_release_pad (GstElement * element, GstPad * pad)
   mqueue->queues = g_list_delete_link (mqueue->queues, tmp);
   mqueue->queues_cookie++;
 
+  /* a full queue that goes away must not keep the others from buffering */
+  GST_SINGLE_QUEUE_MUTEX_LOCK (sq);
+  sq->removed = TRUE;
+  update_full_queues (mqueue, sq, 0);
+  GST_SINGLE_QUEUE_MUTEX_UNLOCK (sq);
+
+  reset_interleave_ranges (mqueue);
+
   /* FIXME : recompute next-non-linked */
   GST_MULTI_QUEUE_MUTEX_UNLOCK (mqueue);
 
@@ -1385,6 +1478,7 @@ gst_single_queue_flush (GstMultiQueue * mq, GstSingleQueue * sq, gboolean flush,
     gst_single_queue_flush_queue (sq, full);
 
     GST_MULTI_QUEUE_MUTEX_LOCK (mq);
+    GST_SINGLE_QUEUE_MUTEX_LOCK (sq);
     gst_segment_init (&sq->sink_segment, GST_FORMAT_TIME);
     gst_segment_init (&sq->src_segment, GST_FORMAT_TIME);
     sq->has_src_segment = FALSE;
@@ -1401,6 +1495,9 @@ gst_single_queue_flush (GstMultiQueue * mq, GstSingleQueue * sq, gboolean flush,
     sq->next_time = GST_CLOCK_STIME_NONE;
     sq->last_time = GST_CLOCK_STIME_NONE;
     sq->cached_sinktime = GST_CLOCK_STIME_NONE;
+    sq->interleave_low = sq->interleave_high = GST_CLOCK_STIME_NONE;
+    sq->interleave_shrink = GST_CLOCK_STIME_NONE;
+    GST_SINGLE_QUEUE_MUTEX_UNLOCK (sq);
     sq->group_high_time = GST_CLOCK_STIME_NONE;
     gst_data_queue_set_flushing (sq->queue, FALSE);
 
@@ -1415,7 +1512,7 @@ gst_single_queue_flush (GstMultiQueue * mq, GstSingleQueue * sq, gboolean flush,
   }
 }
 
-/* WITH LOCK TAKEN */
+/* WITH THE SINGLE QUEUE LOCK TAKEN */
 static gint
 get_buffering_level (GstMultiQueue * mq, GstSingleQueue * sq)
 {
@@ -1452,17 +1549,41 @@ get_buffering_level (GstMultiQueue * mq, GstSingleQueue * sq)
   return buffering_level;
 }
 
-/* WITH LOCK TAKEN */
+/* update whether @sq is above the high watermark. The other queues only
+ * look at the number of full queues, not at the level of each queue.
+ * WITH THE SINGLE QUEUE LOCK TAKEN */
+static gboolean
+update_full_queues (GstMultiQueue * mq, GstSingleQueue * sq,
+    gint buffering_level)
+{
+  gboolean full = !sq->removed && buffering_level >= mq->high_watermark;
+
+  if (full != sq->full) {
+    sq->full = full;
+    if (full)
+      g_atomic_int_inc (&mq->full_queues);
+    else
+      g_atomic_int_add (&mq->full_queues, -1);
+  }
+
+  return full;
+}
+
+/* WITH THE SINGLE QUEUE LOCK TAKEN. The buffering state is shared between
+ * all queues and only changed atomically, so the multiqueue lock is not
+ * needed */
 static void
 update_buffering (GstMultiQueue * mq, GstSingleQueue * sq)
 {
-  gint buffering_level, percent;
+  gint buffering_level, percent, old_percent;
+  gboolean full;
 
   /* nothing to dowhen we are not in buffering mode */
   if (!mq->use_buffering)
     return;
 
   buffering_level = get_buffering_level (mq, sq);
+  full = update_full_queues (mq, sq, buffering_level);
 
   /* scale so that if buffering_level equals the high watermark,
    * the percentage is 100% */
@@ -1471,32 +1592,26 @@ update_buffering (GstMultiQueue * mq, GstSingleQueue * sq)
   if (percent > 100)
     percent = 100;
 
-  if (mq->buffering) {
-    if (buffering_level >= mq->high_watermark) {
-      mq->buffering = FALSE;
-    }
-    /* make sure it increases */
-    percent = MAX (mq->buffering_percent, percent);
-
-    SET_PERCENT (mq, percent);
-  } else {
-    GList *iter;
-    gboolean is_buffering = TRUE;
-
-    for (iter = mq->queues; iter; iter = g_list_next (iter)) {
-      GstSingleQueue *oq = (GstSingleQueue *) iter->data;
-
-      if (get_buffering_level (mq, oq) >= mq->high_watermark) {
-        is_buffering = FALSE;
+  if (g_atomic_int_get (&mq->buffering)) {
+    if (full)
+      g_atomic_int_set (&mq->buffering, FALSE);
 
+    /* make sure it increases */
+    do {
+      old_percent = g_atomic_int_get (&mq->buffering_percent);
+      if (percent <= old_percent)
         break;
-      }
-    }
+    } while (!g_atomic_int_compare_and_exchange (&mq->buffering_percent,
+            old_percent, percent));
 
-    if (is_buffering && buffering_level < mq->low_watermark) {
-      mq->buffering = TRUE;
-      SET_PERCENT (mq, percent);
+    if (percent > old_percent) {
+      g_atomic_int_set (&mq->buffering_percent_changed, TRUE);
+      GST_DEBUG_OBJECT (mq, "buffering %d percent", percent);
     }
+  } else if (g_atomic_int_get (&mq->full_queues) == 0
+      && buffering_level < mq->low_watermark
+      && g_atomic_int_compare_and_exchange (&mq->buffering, FALSE, TRUE)) {
+    SET_PERCENT (mq, percent);
   }
 }
 
@@ -1506,16 +1621,13 @@ gst_multi_queue_post_buffering (GstMultiQueue * mq)
   GstMessage *msg = NULL;
 
   g_mutex_lock (&mq->buffering_post_lock);
-  GST_MULTI_QUEUE_MUTEX_LOCK (mq);
-  if (mq->buffering_percent_changed) {
-    gint percent = mq->buffering_percent;
-
-    mq->buffering_percent_changed = FALSE;
+  if (g_atomic_int_compare_and_exchange (&mq->buffering_percent_changed, TRUE,
+          FALSE)) {
+    gint percent = g_atomic_int_get (&mq->buffering_percent);
 
     GST_DEBUG_OBJECT (mq, "Going to post buffering: %d%%", percent);
     msg = gst_message_new_buffering (GST_OBJECT_CAST (mq), percent);
   }
-  GST_MULTI_QUEUE_MUTEX_UNLOCK (mq);
 
   if (msg != NULL)
     gst_element_post_message (GST_ELEMENT_CAST (mq), msg);
@@ -1526,9 +1638,9 @@ gst_multi_queue_post_buffering (GstMultiQueue * mq)
 static void
 recheck_buffering_status (GstMultiQueue * mq)
 {
-  if (!mq->use_buffering && mq->buffering) {
+  if (!mq->use_buffering && g_atomic_int_get (&mq->buffering)) {
     GST_MULTI_QUEUE_MUTEX_LOCK (mq);
-    mq->buffering = FALSE;
+    g_atomic_int_set (&mq->buffering, FALSE);
     GST_DEBUG_OBJECT (mq,
         "Buffering property disabled, but queue was still buffering; "
         "setting buffering percentage to 100%%");
@@ -1542,21 +1654,33 @@ recheck_buffering_status (GstMultiQueue * mq)
 
     GST_MULTI_QUEUE_MUTEX_LOCK (mq);
 
+    /* the watermarks might have changed, count the full queues again before
+     * any of them looks at the count */
+    for (tmp = mq->queues; tmp; tmp = g_list_next (tmp)) {
+      GstSingleQueue *q = (GstSingleQueue *) tmp->data;
+
+      GST_SINGLE_QUEUE_MUTEX_LOCK (q);
+      update_full_queues (mq, q, get_buffering_level (mq, q));
+      GST_SINGLE_QUEUE_MUTEX_UNLOCK (q);
+    }
+
     /* force buffering percentage to be recalculated */
-    old_perc = mq->buffering_percent;
-    mq->buffering_percent = 0;
+    old_perc = g_atomic_int_get (&mq->buffering_percent);
+    g_atomic_int_set (&mq->buffering_percent, 0);
 
     tmp = mq->queues;
     while (tmp) {
       GstSingleQueue *q = (GstSingleQueue *) tmp->data;
+      GST_SINGLE_QUEUE_MUTEX_LOCK (q);
       update_buffering (mq, q);
+      GST_SINGLE_QUEUE_MUTEX_UNLOCK (q);
       gst_data_queue_limits_changed (q->queue);
       tmp = g_list_next (tmp);
     }
 
     GST_DEBUG_OBJECT (mq,
         "Recalculated buffering percentage: old: %d%% new: %d%%",
-        old_perc, mq->buffering_percent);
+        old_perc, g_atomic_int_get (&mq->buffering_percent));
 
     GST_MULTI_QUEUE_MUTEX_UNLOCK (mq);
   }
@@ -1564,11 +1688,13 @@ recheck_buffering_status (GstMultiQueue * mq)
   gst_multi_queue_post_buffering (mq);
 }
 
+/* WITH THE MULTIQUEUE LOCK TAKEN AND NO SINGLE QUEUE LOCK */
 static void
 calculate_interleave (GstMultiQueue * mq, GstSingleQueue * sq)
 {
-  GstClockTimeDiff low, high;
+  GstClockTimeDiff low, high, sinktime;
   GstClockTime interleave, other_interleave = 0;
+  guint n_times = 0;
   GList *tmp;
 
   low = high = GST_CLOCK_STIME_NONE;
@@ -1588,6 +1714,12 @@ calculate_interleave (GstMultiQueue * mq, GstSingleQueue * sq)
       /* Update max-size time */
       mq->max_size.time = mq->interleave;
       SET_CHILD_PROPERTY (mq, time);
+      if (sq) {
+        /* calculate again with the next sink time */
+        GST_SINGLE_QUEUE_MUTEX_LOCK (sq);
+        sq->interleave_low = sq->interleave_high = GST_CLOCK_STIME_NONE;
+        GST_SINGLE_QUEUE_MUTEX_UNLOCK (sq);
+      }
       goto beach;
     }
 
@@ -1598,17 +1730,21 @@ calculate_interleave (GstMultiQueue * mq, GstSingleQueue * sq)
       continue;
     }
 
-    if (GST_CLOCK_STIME_IS_VALID (oq->cached_sinktime)) {
-      if (low == GST_CLOCK_STIME_NONE || oq->cached_sinktime < low)
-        low = oq->cached_sinktime;
-      if (high == GST_CLOCK_STIME_NONE || oq->cached_sinktime > high)
-        high = oq->cached_sinktime;
+    GST_SINGLE_QUEUE_MUTEX_LOCK (oq);
+    sinktime = oq->cached_sinktime;
+    GST_SINGLE_QUEUE_MUTEX_UNLOCK (oq);
+
+    if (GST_CLOCK_STIME_IS_VALID (sinktime)) {
+      if (low == GST_CLOCK_STIME_NONE || sinktime < low)
+        low = sinktime;
+      if (high == GST_CLOCK_STIME_NONE || sinktime > high)
+        high = sinktime;
+      n_times++;
     }
     GST_LOG_OBJECT (mq,
         "queue %d , sinktime:%" GST_STIME_FORMAT " low:%" GST_STIME_FORMAT
-        " high:%" GST_STIME_FORMAT, oq->id,
-        GST_STIME_ARGS (oq->cached_sinktime), GST_STIME_ARGS (low),
-        GST_STIME_ARGS (high));
+        " high:%" GST_STIME_FORMAT, oq->id, GST_STIME_ARGS (sinktime),
+        GST_STIME_ARGS (low), GST_STIME_ARGS (high));
   }
 
   if (GST_CLOCK_STIME_IS_VALID (low) && GST_CLOCK_STIME_IS_VALID (high)) {
@@ -1635,6 +1771,25 @@ calculate_interleave (GstMultiQueue * mq, GstSingleQueue * sq)
       mq->max_size.time = mq->interleave;
       SET_CHILD_PROPERTY (mq, time);
     }
+
+    if (sq) {
+      GST_SINGLE_QUEUE_MUTEX_LOCK (sq);
+      if (n_times == 1) {
+        /* the only queue with a time in this thread, calculate again with
+         * every sink time like before */
+        sq->interleave_low = sq->interleave_high = GST_CLOCK_STIME_NONE;
+      } else {
+        sq->interleave_low = low;
+        sq->interleave_high = high;
+      }
+      sq->interleave_shrink = mq->last_interleave_update +
+          2 * MIN (GST_SECOND, mq->interleave);
+      GST_SINGLE_QUEUE_MUTEX_UNLOCK (sq);
+    }
+  } else if (sq) {
+    GST_SINGLE_QUEUE_MUTEX_LOCK (sq);
+    sq->interleave_low = sq->interleave_high = GST_CLOCK_STIME_NONE;
+    GST_SINGLE_QUEUE_MUTEX_UNLOCK (sq);
   }
 
 beach:
@@ -1648,13 +1803,87 @@ beach:
 }
 
 
-/* calculate the diff between running time on the sink and src of the queue.
- * This is the total amount of time in the queue.
- * WITH LOCK TAKEN */
+/* forget the sink time ranges of all queues, so that each of them calculates
+ * the interleave again with its next sink time. Needed whenever a queue
+ * appears, goes away or becomes active, the ranges don't cover that.
+ * WITH THE MULTIQUEUE LOCK TAKEN */
+static void
+reset_interleave_ranges (GstMultiQueue * mq)
+{
+  GList *tmp;
+
+  for (tmp = mq->queues; tmp; tmp = tmp->next) {
+    GstSingleQueue *oq = (GstSingleQueue *) tmp->data;
+
+    GST_SINGLE_QUEUE_MUTEX_LOCK (oq);
+    oq->interleave_low = oq->interleave_high = GST_CLOCK_STIME_NONE;
+    oq->interleave_shrink = GST_CLOCK_STIME_NONE;
+    GST_SINGLE_QUEUE_MUTEX_UNLOCK (oq);
+  }
+}
+
+/* WITH NO LOCK TAKEN */
+static void
+gst_single_queue_set_active (GstMultiQueue * mq, GstSingleQueue * sq)
+{
+  if (G_LIKELY (sq->active))
+    return;
+
+  GST_MULTI_QUEUE_MUTEX_LOCK (mq);
+  sq->active = TRUE;
+  reset_interleave_ranges (mq);
+  GST_MULTI_QUEUE_MUTEX_UNLOCK (mq);
+}
+
+/* store the new sink time of @sq and check whether it can change the
+ * interleave. The interleave only depends on the lowest and the highest sink
+ * time, so most sink times don't need a look at the other queues.
+ * WITH THE SINGLE QUEUE LOCK TAKEN */
+static gboolean
+update_cached_sinktime (GstSingleQueue * sq, GstClockTimeDiff sinktime)
+{
+  GstClockTimeDiff old = sq->cached_sinktime;
+
+  sq->cached_sinktime = sinktime;
+
+  if (!GST_CLOCK_STIME_IS_VALID (sq->interleave_low))
+    return TRUE;
+
+  if (sinktime < sq->interleave_low || sinktime > sq->interleave_high)
+    return TRUE;
+
+  /* the interleave may shrink once all queues went past this */
+  return GST_CLOCK_STIME_IS_VALID (sq->interleave_shrink)
+      && sinktime > sq->interleave_shrink
+      && (!GST_CLOCK_STIME_IS_VALID (old) || old <= sq->interleave_shrink);
+}
+
+/* called after the levels of @sq were updated, without any lock held.
+ * Calculating the interleave and posting the buffering message are the only
+ * things left that need the multiqueue lock */
 static void
+gst_single_queue_levels_updated (GstMultiQueue * mq, GstSingleQueue * sq,
+    gboolean interleave)
+{
+  if (interleave) {
+    GST_MULTI_QUEUE_MUTEX_LOCK (mq);
+    calculate_interleave (mq, sq);
+    GST_MULTI_QUEUE_MUTEX_UNLOCK (mq);
+  }
+
+  if (g_atomic_int_get (&mq->buffering_percent_changed))
+    gst_multi_queue_post_buffering (mq);
+}
+
+/* calculate the diff between running time on the sink and src of the queue.
+ * This is the total amount of time in the queue. Returns TRUE when the
+ * interleave needs to be calculated again.
+ * WITH THE SINGLE QUEUE LOCK TAKEN */
+static gboolean
 update_time_level (GstMultiQueue * mq, GstSingleQueue * sq)
 {
   GstClockTimeDiff sink_time, src_time;
+  gboolean interleave = FALSE;
 
   if (sq->sink_tainted) {
     sink_time = sq->sinktime = my_segment_to_running_time (&sq->sink_segment,
@@ -1675,10 +1904,8 @@ update_time_level (GstMultiQueue * mq, GstSingleQueue * sq)
     if (G_UNLIKELY (sink_time != GST_CLOCK_STIME_NONE)) {
       /* if we have a time, we become untainted and use the time */
       sq->sink_tainted = FALSE;
-      if (mq->use_interleave) {
-        sq->cached_sinktime = sink_time;
-        calculate_interleave (mq, sq);
-      }
+      if (mq->use_interleave)
+        interleave = update_cached_sinktime (sq, sink_time);
     }
   } else
     sink_time = sq->sinktime;
@@ -1726,7 +1953,7 @@ update_time_level (GstMultiQueue * mq, GstSingleQueue * sq)
   /* updating the time level can change the buffering state */
   update_buffering (mq, sq);
 
-  return;
+  return interleave;
 }
 
 /* take a SEGMENT event and apply the values to segment, updating the time
@@ -1735,6 +1962,8 @@ static void
 apply_segment (GstMultiQueue * mq, GstSingleQueue * sq, GstEvent * event,
     GstSegment * segment)
 {
+  gboolean interleave;
+
   gst_event_copy_segment (event, segment);
 
   /* now configure the values, we use these to track timestamps on the
@@ -1747,7 +1976,7 @@ apply_segment (GstMultiQueue * mq, GstSingleQueue * sq, GstEvent * event,
     segment->stop = -1;
     segment->time = 0;
   }
-  GST_MULTI_QUEUE_MUTEX_LOCK (mq);
+  GST_SINGLE_QUEUE_MUTEX_LOCK (sq);
 
   /* Make sure we have a valid initial segment position (and not garbage
    * from upstream) */
@@ -1766,10 +1995,10 @@ apply_segment (GstMultiQueue * mq, GstSingleQueue * sq, GstEvent * event,
       "queue %d, configured SEGMENT %" GST_SEGMENT_FORMAT, sq->id, segment);
 
   /* segment can update the time level of the queue */
-  update_time_level (mq, sq);
+  interleave = update_time_level (mq, sq);
 
-  GST_MULTI_QUEUE_MUTEX_UNLOCK (mq);
-  gst_multi_queue_post_buffering (mq);
+  GST_SINGLE_QUEUE_MUTEX_UNLOCK (sq);
+  gst_single_queue_levels_updated (mq, sq, interleave);
 }
 
 /* take a buffer and update segment, updating the time level of the queue. */
@@ -1777,7 +2006,9 @@ static void
 apply_buffer (GstMultiQueue * mq, GstSingleQueue * sq, GstClockTime timestamp,
     GstClockTime duration, GstSegment * segment)
 {
-  GST_MULTI_QUEUE_MUTEX_LOCK (mq);
+  gboolean interleave;
+
+  GST_SINGLE_QUEUE_MUTEX_LOCK (sq);
 
   /* if no timestamp is set, assume it's continuous with the previous
    * time */
@@ -1800,9 +2031,9 @@ apply_buffer (GstMultiQueue * mq, GstSingleQueue * sq, GstClockTime timestamp,
     sq->src_tainted = TRUE;
 
   /* calc diff with other end */
-  update_time_level (mq, sq);
-  GST_MULTI_QUEUE_MUTEX_UNLOCK (mq);
-  gst_multi_queue_post_buffering (mq);
+  interleave = update_time_level (mq, sq);
+  GST_SINGLE_QUEUE_MUTEX_UNLOCK (sq);
+  gst_single_queue_levels_updated (mq, sq, interleave);
 }
 
 static void
@@ -1811,8 +2042,9 @@ apply_gap (GstMultiQueue * mq, GstSingleQueue * sq, GstEvent * event,
 {
   GstClockTime timestamp;
   GstClockTime duration;
+  gboolean interleave = FALSE;
 
-  GST_MULTI_QUEUE_MUTEX_LOCK (mq);
+  GST_SINGLE_QUEUE_MUTEX_LOCK (sq);
 
   gst_event_parse_gap (event, &timestamp, &duration);
 
@@ -1834,11 +2066,11 @@ apply_gap (GstMultiQueue * mq, GstSingleQueue * sq, GstEvent * event,
       sq->src_tainted = TRUE;
 
     /* calc diff with other end */
-    update_time_level (mq, sq);
+    interleave = update_time_level (mq, sq);
   }
 
-  GST_MULTI_QUEUE_MUTEX_UNLOCK (mq);
-  gst_multi_queue_post_buffering (mq);
+  GST_SINGLE_QUEUE_MUTEX_UNLOCK (sq);
+  gst_single_queue_levels_updated (mq, sq, interleave);
 }
 
 static GstClockTimeDiff
@@ -1940,6 +2172,26 @@ gst_single_queue_push_one (GstMultiQueue * mq, GstSingleQueue * sq,
           sq->id, buffer, GST_TIME_ARGS (timestamp));
       result = gst_pad_push (srcpad, buffer);
     }
+  } else if (GST_IS_BUFFER_LIST (object)) {
+    GstBufferList *list;
+    guint i, n;
+
+    /* only created by gst_single_queue_take_batch(), never while dropping */
+    list = GST_BUFFER_LIST_CAST (object);
+    n = gst_buffer_list_length (list);
+
+    for (i = 0; i < n; i++) {
+      GstBuffer *buffer = gst_buffer_list_get (list, i);
+
+      apply_buffer (mq, sq, GST_BUFFER_DTS_OR_PTS (buffer),
+          GST_BUFFER_DURATION (buffer), &sq->src_segment);
+    }
+    gst_data_queue_limits_changed (sq->queue);
+
+    GST_DEBUG_OBJECT (mq,
+        "SingleQueue %d : Pushing buffer list %p with %u buffers", sq->id,
+        list, n);
+    result = gst_pad_push_list (srcpad, list);
   } else if (GST_IS_EVENT (object)) {
     GstEvent *event;
 
@@ -2076,6 +2328,66 @@ gst_multi_queue_mo_item_new (GstMiniObject * object, guint32 curid)
   return item;
 }
 
+/* take the buffers that are queued right after @buffer and combine them with
+ * @buffer into a buffer list. The first item that is not a buffer is returned
+ * in @pending and @lastid is updated to the id of the last buffer taken */
+static GstMiniObject *
+gst_single_queue_take_batch (GstMultiQueue * mq, GstSingleQueue * sq,
+    GstBuffer * buffer, guint32 * lastid, GstMultiQueueItem ** pending)
+{
+  GstBufferList *list = NULL;
+  GstClockTime duration, max_time;
+  guint n, max_buffers;
+
+  GST_MULTI_QUEUE_MUTEX_LOCK (mq);
+  max_buffers = mq->max_batch_buffers;
+  max_time = mq->max_batch_time;
+  GST_MULTI_QUEUE_MUTEX_UNLOCK (mq);
+
+  n = 1;
+  duration = GST_BUFFER_DURATION_IS_VALID (buffer) ?
+      GST_BUFFER_DURATION (buffer) : 0;
+
+  /* we are the only one popping, a non-empty queue doesn't block */
+  while (n < max_buffers && (max_time == 0 || duration < max_time)
+      && !gst_data_queue_is_empty (sq->queue)) {
+    GstDataQueueItem *sitem;
+    GstMultiQueueItem *item;
+    GstBuffer *next;
+
+    if (!gst_data_queue_pop (sq->queue, &sitem))
+      break;
+
+    item = (GstMultiQueueItem *) sitem;
+    if (!GST_IS_BUFFER (item->object)) {
+      *pending = item;
+      break;
+    }
+
+    *lastid = item->posid;
+    next = GST_BUFFER_CAST (gst_multi_queue_item_steal_object (item));
+    gst_multi_queue_item_destroy (item);
+
+    if (list == NULL) {
+      list = gst_buffer_list_new_sized (MIN (max_buffers, 64));
+      gst_buffer_list_add (list, buffer);
+    }
+    gst_buffer_list_add (list, next);
+    n++;
+
+    if (GST_BUFFER_DURATION_IS_VALID (next))
+      duration += GST_BUFFER_DURATION (next);
+  }
+
+  if (list == NULL)
+    return GST_MINI_OBJECT_CAST (buffer);
+
+  GST_LOG_OBJECT (mq, "SingleQueue %d : took a batch of %u buffers", sq->id,
+      n);
+
+  return GST_MINI_OBJECT_CAST (list);
+}
+
 /* Each main loop attempts to push buffers until the return value
  * is not-linked. not-linked pads are not allowed to push data beyond
  * any linked pads, so they don't 'rush ahead of the pack'.
@@ -2085,6 +2397,7 @@ gst_multi_queue_loop (GstPad * pad)
 {
   GstSingleQueue *sq;
   GstMultiQueueItem *item;
+  GstMultiQueueItem *pending = NULL;
   GstDataQueueItem *sitem;
   GstMultiQueue *mq;
   GstMiniObject *object = NULL;
@@ -2110,11 +2423,16 @@ next:
     goto out_flushing;
 
   /* Get something from the queue, blocking until that happens, or we get
-   * flushed */
-  if (!(gst_data_queue_pop (sq->queue, &sitem)))
+   * flushed. The item that ended the last batch goes first */
+  if (pending) {
+    item = pending;
+    pending = NULL;
+  } else if (gst_data_queue_pop (sq->queue, &sitem)) {
+    item = (GstMultiQueueItem *) sitem;
+  } else {
     goto out_flushing;
+  }
 
-  item = (GstMultiQueueItem *) sitem;
   newid = item->posid;
 
   /* steal the object and destroy the item */
@@ -2250,6 +2568,12 @@ next:
   GST_LOG_OBJECT (mq, "sq:%d BEFORE PUSHING sq->srcresult: %s", sq->id,
       gst_flow_get_name (sq->srcresult));
 
+  /* push the buffers that are already queued behind this one together */
+  if (is_buffer && !dropping && sq->srcresult == GST_FLOW_OK
+      && mq->max_batch_buffers > 1)
+    object = gst_single_queue_take_batch (mq, sq, GST_BUFFER_CAST (object),
+        &newid, &pending);
+
   /* Update time stats */
   GST_MULTI_QUEUE_MUTEX_LOCK (mq);
   next_time = get_running_time (&sq->src_segment, object, TRUE);
@@ -2328,25 +2652,28 @@ next:
   sq->srcresult = result;
   sq->last_oldid = newid;
 
-  if (do_update_buffering)
+  if (do_update_buffering) {
+    GST_SINGLE_QUEUE_MUTEX_LOCK (sq);
     update_buffering (mq, sq);
-
-  GST_MULTI_QUEUE_MUTEX_UNLOCK (mq);
-  gst_multi_queue_post_buffering (mq);
+    GST_SINGLE_QUEUE_MUTEX_UNLOCK (sq);
+  }
 
   GST_LOG_OBJECT (mq, "sq:%d AFTER PUSHING sq->srcresult: %s (is_eos:%d)",
       sq->id, gst_flow_get_name (sq->srcresult), GST_PAD_IS_EOS (srcpad));
 
   /* Need to make sure wake up any sleeping pads when we exit */
-  GST_MULTI_QUEUE_MUTEX_LOCK (mq);
   if (mq->numwaiting > 0 && (GST_PAD_IS_EOS (srcpad)
           || sq->srcresult == GST_FLOW_EOS)) {
     compute_high_time (mq, sq->groupid);
     compute_high_id (mq);
     wake_up_next_non_linked (mq);
   }
+
   GST_MULTI_QUEUE_MUTEX_UNLOCK (mq);
 
+  if (g_atomic_int_get (&mq->buffering_percent_changed))
+    gst_multi_queue_post_buffering (mq);
+
   if (dropping)
     goto next;
 
@@ -2354,6 +2681,10 @@ next:
       && result != GST_FLOW_EOS)
     goto out_flushing;
 
+  /* handle the item that ended the batch right away */
+  if (pending)
+    goto next;
+
 done:
   gst_clear_object (&mq);
   gst_clear_object (&srcpad);
@@ -2364,6 +2695,8 @@ out_flushing:
   {
     if (object && !GST_IS_QUERY (object))
       gst_mini_object_unref (object);
+    if (pending)
+      gst_multi_queue_item_destroy (pending);
 
     GST_MULTI_QUEUE_MUTEX_LOCK (mq);
     sq->last_query = FALSE;
@@ -2422,7 +2755,7 @@ gst_multi_queue_chain (GstPad * pad, GstObject * parent, GstBuffer * buffer)
   if (sq->is_eos)
     goto was_eos;
 
-  sq->active = TRUE;
+  gst_single_queue_set_active (mq, sq);
 
   /* Get a unique incrementing id */
   curid = g_atomic_int_add ((gint *) & mq->counter, 1);
@@ -2442,8 +2775,9 @@ gst_multi_queue_chain (GstPad * pad, GstObject * parent, GstBuffer * buffer)
   if (mq->use_interleave) {
     GstClockTime val = timestamp;
     GstClockTimeDiff dval;
+    gboolean interleave = FALSE;
 
-    GST_MULTI_QUEUE_MUTEX_LOCK (mq);
+    GST_SINGLE_QUEUE_MUTEX_LOCK (sq);
     if (val == GST_CLOCK_TIME_NONE)
       val = sq->sink_segment.position;
     if (duration != GST_CLOCK_TIME_NONE)
@@ -2451,14 +2785,18 @@ gst_multi_queue_chain (GstPad * pad, GstObject * parent, GstBuffer * buffer)
 
     dval = my_segment_to_running_time (&sq->sink_segment, val);
     if (GST_CLOCK_STIME_IS_VALID (dval)) {
-      sq->cached_sinktime = dval;
       GST_DEBUG_OBJECT (mq,
           "Queue %d cached sink time now %" G_GINT64_FORMAT " %"
-          GST_STIME_FORMAT, sq->id, sq->cached_sinktime,
-          GST_STIME_ARGS (sq->cached_sinktime));
+          GST_STIME_FORMAT, sq->id, dval, GST_STIME_ARGS (dval));
+      interleave = update_cached_sinktime (sq, dval);
+    }
+    GST_SINGLE_QUEUE_MUTEX_UNLOCK (sq);
+
+    if (interleave) {
+      GST_MULTI_QUEUE_MUTEX_LOCK (mq);
       calculate_interleave (mq, sq);
+      GST_MULTI_QUEUE_MUTEX_UNLOCK (mq);
     }
-    GST_MULTI_QUEUE_MUTEX_UNLOCK (mq);
   }
 
   if (!(gst_data_queue_push (sq->queue, (GstDataQueueItem *) item)))
@@ -2625,15 +2963,21 @@ gst_multi_queue_sink_event (GstPad * pad, GstObject * parent, GstEvent * event)
         GstClockTime stime;
         gst_event_parse_gap (event, &val, &dur);
         if (GST_CLOCK_TIME_IS_VALID (val)) {
-          GST_MULTI_QUEUE_MUTEX_LOCK (mq);
+          gboolean interleave = FALSE;
+
+          GST_SINGLE_QUEUE_MUTEX_LOCK (sq);
           if (GST_CLOCK_TIME_IS_VALID (dur))
             val += dur;
           stime = my_segment_to_running_time (&sq->sink_segment, val);
-          if (GST_CLOCK_STIME_IS_VALID (stime)) {
-            sq->cached_sinktime = stime;
+          if (GST_CLOCK_STIME_IS_VALID (stime))
+            interleave = update_cached_sinktime (sq, stime);
+          GST_SINGLE_QUEUE_MUTEX_UNLOCK (sq);
+
+          if (interleave) {
+            GST_MULTI_QUEUE_MUTEX_LOCK (mq);
             calculate_interleave (mq, sq);
+            GST_MULTI_QUEUE_MUTEX_UNLOCK (mq);
           }
-          GST_MULTI_QUEUE_MUTEX_UNLOCK (mq);
         }
       }
       break;
@@ -2667,9 +3011,9 @@ gst_multi_queue_sink_event (GstPad * pad, GstObject * parent, GstEvent * event)
   switch (type) {
     case GST_EVENT_SEGMENT_DONE:
       sq->is_segment_done = TRUE;
-      GST_MULTI_QUEUE_MUTEX_LOCK (mq);
+      GST_SINGLE_QUEUE_MUTEX_LOCK (sq);
       update_buffering (mq, sq);
-      GST_MULTI_QUEUE_MUTEX_UNLOCK (mq);
+      GST_SINGLE_QUEUE_MUTEX_UNLOCK (sq);
       single_queue_overrun_cb (sq->queue, sq);
       gst_multi_queue_post_buffering (mq);
       break;
@@ -2689,9 +3033,9 @@ gst_multi_queue_sink_event (GstPad * pad, GstObject * parent, GstEvent * event)
       }
 
       /* EOS affects the buffering state */
-      GST_MULTI_QUEUE_MUTEX_LOCK (mq);
+      GST_SINGLE_QUEUE_MUTEX_LOCK (sq);
       update_buffering (mq, sq);
-      GST_MULTI_QUEUE_MUTEX_UNLOCK (mq);
+      GST_SINGLE_QUEUE_MUTEX_UNLOCK (sq);
       single_queue_overrun_cb (sq->queue, sq);
       gst_multi_queue_post_buffering (mq);
       break;
@@ -2706,7 +3050,7 @@ gst_multi_queue_sink_event (GstPad * pad, GstObject * parent, GstEvent * event)
       GST_MULTI_QUEUE_MUTEX_UNLOCK (mq);
       break;
     case GST_EVENT_GAP:
-      sq->active = TRUE;
+      gst_single_queue_set_active (mq, sq);
       apply_gap (mq, sq, sref, &sq->sink_segment);
       gst_event_unref (sref);
     default:
@@ -3119,6 +3463,7 @@ single_queue_overrun_cb (GstDataQueue * dq, GstSingleQueue * sq)
 {
   GList *tmp;
   GstDataQueueSize size;
+  GstClockTime cur_time;
   gboolean filled = TRUE;
   gboolean empty_found = FALSE;
   GstMultiQueue *mq = g_weak_ref_get (&sq->mqueue);
@@ -3131,18 +3476,22 @@ single_queue_overrun_cb (GstDataQueue * dq, GstSingleQueue * sq)
 
   gst_data_queue_get_level (sq->queue, &size);
 
+  GST_MULTI_QUEUE_MUTEX_LOCK (mq);
+
+  GST_SINGLE_QUEUE_MUTEX_LOCK (sq);
+  cur_time = sq->cur_time;
+  GST_SINGLE_QUEUE_MUTEX_UNLOCK (sq);
+
   GST_LOG_OBJECT (mq,
       "Single Queue %d: EOS %d, visible %u/%u, bytes %u/%u, time %"
       G_GUINT64_FORMAT "/%" G_GUINT64_FORMAT, sq->id, sq->is_eos, size.visible,
-      sq->max_size.visible, size.bytes, sq->max_size.bytes, sq->cur_time,
+      sq->max_size.visible, size.bytes, sq->max_size.bytes, cur_time,
       sq->max_size.time);
 
-  GST_MULTI_QUEUE_MUTEX_LOCK (mq);
-
   /* check if we reached the hard time/bytes limits;
      time limit is only taken into account for non-sparse streams */
   if (sq->is_eos || IS_FILLED (sq, bytes, size.bytes) ||
-      (!sq->is_sparse && IS_FILLED (sq, time, sq->cur_time))) {
+      (!sq->is_sparse && IS_FILLED (sq, time, cur_time))) {
     goto done;
   }
 
@@ -3331,9 +3680,9 @@ gst_single_queue_flush_queue (GstSingleQueue * sq, gboolean full)
     gst_data_queue_set_flushing (sq->queue, TRUE);
 
   if (mq) {
-    GST_MULTI_QUEUE_MUTEX_LOCK (mq);
+    GST_SINGLE_QUEUE_MUTEX_LOCK (sq);
     update_buffering (mq, sq);
-    GST_MULTI_QUEUE_MUTEX_UNLOCK (mq);
+    GST_SINGLE_QUEUE_MUTEX_UNLOCK (sq);
     gst_multi_queue_post_buffering (mq);
     gst_object_unref (mq);
   }
@@ -3346,6 +3695,7 @@ gst_single_queue_unref (GstSingleQueue * sq)
     /* DRAIN QUEUE */
     gst_data_queue_flush (sq->queue);
     g_object_unref (sq->queue);
+    g_mutex_clear (&sq->lock);
     g_cond_clear (&sq->turn);
     g_cond_clear (&sq->query_handled);
     g_weak_ref_clear (&sq->sinkpad);
@@ -3435,11 +3785,14 @@ gst_single_queue_new (GstMultiQueue * mqueue, guint id)
   sq->oldid = 0;
   sq->next_time = GST_CLOCK_STIME_NONE;
   sq->last_time = GST_CLOCK_STIME_NONE;
+  g_mutex_init (&sq->lock);
   g_cond_init (&sq->turn);
   g_cond_init (&sq->query_handled);
 
   sq->sinktime = GST_CLOCK_STIME_NONE;
   sq->srctime = GST_CLOCK_STIME_NONE;
+  sq->interleave_low = sq->interleave_high = GST_CLOCK_STIME_NONE;
+  sq->interleave_shrink = GST_CLOCK_STIME_NONE;
   sq->sink_tainted = TRUE;
   sq->src_tainted = TRUE;
 
@@ -3485,6 +3838,8 @@ gst_single_queue_new (GstMultiQueue * mqueue, guint id)
       GST_DEBUG_FUNCPTR (gst_multi_queue_iterate_internal_links));
   GST_OBJECT_FLAG_SET (srcpad, GST_PAD_FLAG_PROXY_CAPS);
 
+  reset_interleave_ranges (mqueue);
+
   GST_MULTI_QUEUE_MUTEX_UNLOCK (mqueue);
 
   /* only activate the pads when we are not in the NULL state
@@ -67,8 +67,9 @@ struct _GstMultiQueue {
   GstDataQueueSize  max_size, extra_size;
   gboolean use_buffering;
   gint low_watermark, high_watermark;
-  gboolean buffering;
-  gint buffering_percent;
+  gboolean buffering;		/* use atomic accesses */
+  gint buffering_percent;	/* use atomic accesses */
+  gint full_queues;		/* queues above the high watermark, atomic */
 
   guint    counter;	/* incoming object counter, use atomic accesses */
   guint32  highid;	/* contains highest id of last outputted object */
@@ -80,13 +81,16 @@ struct _GstMultiQueue {
 
   gint numwaiting;	/* number of not-linked pads waiting */
 
-  gboolean buffering_percent_changed;
+  gboolean buffering_percent_changed; /* use atomic accesses */
   GMutex buffering_post_lock; /* assures only one posted at a time */
 
   GstClockTime interleave;	/* Input interleave */
   GstClockTimeDiff last_interleave_update;
 
   GstClockTime unlinked_cache_time;
+
+  guint max_batch_buffers;
+  GstClockTime max_batch_time;
 };
 
 struct _GstMultiQueueClass {
@@ -54,6 +54,17 @@
  * the specified minimum thresholds require (by default: when the queue is
  * empty). The #GstQueue::overrun signal is emitted when the queue is filled
  * up. Both signals are emitted from the context of the streaming thread.
+ *
+ * With #GstQueue:lockless, buffers are passed through a fixed size ring
+ * between the upstream thread and the queue thread without taking the queue
+ * lock, as long as #GstQueue:max-size-buffers is the only limit. The queue
+ * thread spins for a short while when the ring runs empty before it goes to
+ * sleep. Events and queries still take the locked path and keep their order
+ * relative to the buffers.
+ *
+ * With #GstQueue:max-batch-buffers, consecutive buffers that are already
+ * queued are pushed downstream together as one #GstBufferList, which saves
+ * the per-push overhead in elements that handle buffer lists.
  */
 
 #include "gst/gst_private.h"
@@ -122,13 +133,31 @@ enum
   PROP_MIN_THRESHOLD_TIME,
   PROP_LEAKY,
   PROP_SILENT,
-  PROP_FLUSH_ON_EOS
+  PROP_FLUSH_ON_EOS,
+  PROP_LOCKLESS,
+  PROP_MAX_BATCH_BUFFERS,
+  PROP_MAX_BATCH_TIME
 };
 
 /* default property values */
 #define DEFAULT_MAX_SIZE_BUFFERS  200   /* 200 buffers */
 #define DEFAULT_MAX_SIZE_BYTES    (10 * 1024 * 1024)    /* 10 MB       */
 #define DEFAULT_MAX_SIZE_TIME     GST_SECOND    /* 1 second    */
+#define DEFAULT_LOCKLESS          FALSE
+#define DEFAULT_MAX_BATCH_BUFFERS 1
+#define DEFAULT_MAX_BATCH_TIME    0
+
+/* number of times the lockless paths retry the ring before they fall back
+ * to waiting on the condition variables */
+#define LOCKLESS_SPIN_COUNT       1000
+
+/* buffers in the ring are not accounted in the byte and time levels, so the
+ * ring can only be used when max-size-buffers is the only limit */
+#define QUEUE_RING_USABLE(q)                                            \
+    ((q)->max_size.buffers != 0 &&                                      \
+     (q)->max_size.bytes == 0 && (q)->max_size.time == 0 &&             \
+     (q)->min_threshold.buffers == 0 && (q)->min_threshold.bytes == 0 &&  \
+     (q)->min_threshold.time == 0)
 
 #define GST_QUEUE_MUTEX_LOCK(q) G_STMT_START {                          \
   g_mutex_lock (&q->qlock);                                              \
@@ -156,10 +185,13 @@ enum
   STATUS (q, q->sinkpad, "received DEL");                               \
 } G_STMT_END
 
+/* the lockless chain function only takes the lock to wake us up when it
+ * sees waiting_add, so check the ring again after setting it */
 #define GST_QUEUE_WAIT_ADD_CHECK(q, label) G_STMT_START {               \
   STATUS (q, q->srcpad, "wait for ADD");                                \
-  q->waiting_add = TRUE;                                                \
-  g_cond_wait (&q->item_add, &q->qlock);                                  \
+  g_atomic_int_set (&q->waiting_add, TRUE);                             \
+  if (q->ring == NULL || gst_bounded_queue_peek (q->ring) == NULL)      \
+    g_cond_wait (&q->item_add, &q->qlock);                              \
   q->waiting_add = FALSE;                                               \
   if (q->srcresult != GST_FLOW_OK) {                                    \
     STATUS (q, q->srcpad, "received ADD wakeup");                       \
@@ -223,6 +255,9 @@ static gboolean gst_queue_sink_activate_mode (GstPad * pad, GstObject * parent,
 static gboolean gst_queue_is_empty (GstQueue * queue);
 static gboolean gst_queue_is_filled (GstQueue * queue);
 
+static GstFlowReturn gst_queue_push_item (GstQueue * queue,
+    GstMiniObject * data);
+
 
 typedef struct
 {
@@ -384,6 +419,64 @@ gst_queue_class_init (GstQueueClass * klass)
           G_PARAM_READWRITE | GST_PARAM_MUTABLE_PLAYING |
           G_PARAM_STATIC_STRINGS));
 
+  /**
+   * queue:lockless:
+   *
+   * Pass buffers and buffer lists through a lock-free single-producer,
+   * single-consumer ring instead of the locked queue. The queue thread spins
+   * for a short while when the ring is empty before it blocks.
+   *
+   * The ring is sized from #GstQueue:max-size-buffers when the queue is
+   * activated and holds at most that many buffers or buffer lists. Buffers
+   * in the ring are not accounted in the byte and time levels, so the ring
+   * is only used when #GstQueue:max-size-buffers is set and
+   * #GstQueue:max-size-bytes, #GstQueue:max-size-time and the minimum
+   * thresholds are 0. Otherwise the queue posts a warning when it is
+   * activated and uses the locked queue. Leaking downstream disables the
+   * ring too.
+   *
+   * Since: 1.20
+   */
+  g_object_class_install_property (gobject_class, PROP_LOCKLESS,
+      g_param_spec_boolean ("lockless", "Lockless",
+          "Pass buffers through a lock-free ring (needs max-size-buffers to "
+          "be set and max-size-bytes, max-size-time and the min-thresholds "
+          "to be 0)", DEFAULT_LOCKLESS,
+          G_PARAM_READWRITE | GST_PARAM_MUTABLE_READY |
+          G_PARAM_STATIC_STRINGS));
+
+  /**
+   * queue:max-batch-buffers:
+   *
+   * Maximum number of consecutive buffers that are taken out of the queue at
+   * once and pushed downstream as one #GstBufferList. Only buffers that are
+   * already queued are combined, the queue never waits for more data. 1
+   * pushes every buffer on its own.
+   *
+   * Since: 1.20
+   */
+  g_object_class_install_property (gobject_class, PROP_MAX_BATCH_BUFFERS,
+      g_param_spec_uint ("max-batch-buffers", "Max. batch buffers",
+          "Maximum number of queued buffers to push downstream as one buffer "
+          "list (1=disable)", 1, G_MAXUINT, DEFAULT_MAX_BATCH_BUFFERS,
+          G_PARAM_READWRITE | GST_PARAM_MUTABLE_PLAYING |
+          G_PARAM_STATIC_STRINGS));
+
+  /**
+   * queue:max-batch-time:
+   *
+   * Maximum total duration of the buffers that are pushed downstream as one
+   * #GstBufferList when #GstQueue:max-batch-buffers is bigger than 1.
+   *
+   * Since: 1.20
+   */
+  g_object_class_install_property (gobject_class, PROP_MAX_BATCH_TIME,
+      g_param_spec_uint64 ("max-batch-time", "Max. batch time (ns)",
+          "Maximum duration of the buffers pushed downstream as one buffer "
+          "list (0=disable)", 0, G_MAXUINT64, DEFAULT_MAX_BATCH_TIME,
+          G_PARAM_READWRITE | GST_PARAM_MUTABLE_PLAYING |
+          G_PARAM_STATIC_STRINGS));
+
   /**
    * queue:flush-on-eos:
    *
@@ -478,6 +571,10 @@ gst_queue_init (GstQueue * queue)
 
   queue->newseg_applied_to_src = FALSE;
 
+  queue->lockless = DEFAULT_LOCKLESS;
+  queue->max_batch_buffers = DEFAULT_MAX_BATCH_BUFFERS;
+  queue->max_batch_time = DEFAULT_MAX_BATCH_TIME;
+
   GST_DEBUG_OBJECT (queue,
       "initialized queue's not_empty & not_full conditions");
 }
@@ -498,6 +595,14 @@ gst_queue_finalize (GObject * object)
   }
   gst_queue_array_free (queue->queue);
 
+  if (queue->ring) {
+    GstMiniObject *item;
+
+    while ((item = gst_bounded_queue_pop (queue->ring)))
+      gst_mini_object_unref (item);
+    gst_bounded_queue_unref (queue->ring);
+  }
+
   g_mutex_clear (&queue->qlock);
   g_cond_clear (&queue->item_add);
   g_cond_clear (&queue->item_del);
@@ -698,6 +803,19 @@ apply_buffer_list (GstQueue * queue, GstBufferList * buffer_list,
   update_time_level (queue);
 }
 
+/* drop everything in the ring, with QUEUE_LOCK and only from the streaming
+ * thread or when it is not running */
+static void
+gst_queue_locked_flush_ring (GstQueue * queue)
+{
+  GstMiniObject *item;
+
+  while ((item = gst_bounded_queue_pop (queue->ring)))
+    gst_mini_object_unref (item);
+
+  g_atomic_int_set (&queue->ring_flush, 0);
+}
+
 static void
 gst_queue_locked_flush (GstQueue * queue, gboolean full)
 {
@@ -716,6 +834,17 @@ gst_queue_locked_flush (GstQueue * queue, gboolean full)
       gst_mini_object_unref (qitem->item);
     memset (qitem, 0, sizeof (GstQueueItem));
   }
+  g_atomic_int_set (&queue->n_locked_items, 0);
+
+  if (queue->ring) {
+    /* only the streaming thread pops from the ring, let it drop the items
+     * when it is running */
+    if (gst_pad_get_task_state (queue->srcpad) == GST_TASK_STARTED)
+      g_atomic_int_set (&queue->ring_flush, 1);
+    else
+      gst_queue_locked_flush_ring (queue);
+  }
+
   queue->last_query = FALSE;
   g_cond_signal (&queue->query_handled);
   GST_QUEUE_CLEAR_LEVEL (queue->cur_level);
@@ -733,6 +862,15 @@ gst_queue_locked_flush (GstQueue * queue, gboolean full)
   GST_QUEUE_SIGNAL_DEL (queue);
 }
 
+/* add an item to the locked queue, with QUEUE_LOCK */
+static inline void
+gst_queue_locked_push_item (GstQueue * queue, GstQueueItem * qitem)
+{
+  gst_queue_array_push_tail_struct (queue->queue, qitem);
+  /* makes the lockless chain function keep buffers behind this item */
+  g_atomic_int_inc (&queue->n_locked_items);
+}
+
 /* enqueue an item an update the level stats, with QUEUE_LOCK */
 static inline void
 gst_queue_locked_enqueue_buffer (GstQueue * queue, gpointer item)
@@ -749,7 +887,7 @@ gst_queue_locked_enqueue_buffer (GstQueue * queue, gpointer item)
   qitem.item = item;
   qitem.is_query = FALSE;
   qitem.size = bsize;
-  gst_queue_array_push_tail_struct (queue->queue, &qitem);
+  gst_queue_locked_push_item (queue, &qitem);
   GST_QUEUE_SIGNAL_ADD (queue);
 }
 
@@ -770,7 +908,7 @@ gst_queue_locked_enqueue_buffer_list (GstQueue * queue, gpointer item)
   qitem.item = item;
   qitem.is_query = FALSE;
   qitem.size = bsize;
-  gst_queue_array_push_tail_struct (queue->queue, &qitem);
+  gst_queue_locked_push_item (queue, &qitem);
   GST_QUEUE_SIGNAL_ADD (queue);
 }
 
@@ -795,7 +933,8 @@ gst_queue_locked_enqueue_event (GstQueue * queue, gpointer item)
     case GST_EVENT_SEGMENT:
       apply_segment (queue, event, &queue->sink_segment, TRUE);
       /* if the queue is empty, apply sink segment on the source */
-      if (gst_queue_array_is_empty (queue->queue)) {
+      if (gst_queue_array_is_empty (queue->queue) && (queue->ring == NULL
+              || gst_bounded_queue_length (queue->ring) == 0)) {
         GST_CAT_LOG_OBJECT (queue_dataflow, queue, "Apply segment on srcpad");
         apply_segment (queue, event, &queue->src_segment, FALSE);
         queue->newseg_applied_to_src = TRUE;
@@ -814,7 +953,7 @@ gst_queue_locked_enqueue_event (GstQueue * queue, gpointer item)
   qitem.item = item;
   qitem.is_query = FALSE;
   qitem.size = 0;
-  gst_queue_array_push_tail_struct (queue->queue, &qitem);
+  gst_queue_locked_push_item (queue, &qitem);
   GST_QUEUE_SIGNAL_ADD (queue);
 }
 
@@ -830,6 +969,8 @@ gst_queue_locked_dequeue (GstQueue * queue)
   if (qitem == NULL)
     goto no_item;
 
+  g_atomic_int_add (&queue->n_locked_items, -1);
+
   item = qitem->item;
   bufsize = qitem->size;
 
@@ -907,6 +1048,26 @@ no_item:
   }
 }
 
+/* dequeue the next item for the streaming thread, with QUEUE_LOCK. The
+ * buffers in the ring are always older than the items in the locked queue */
+static GstMiniObject *
+gst_queue_locked_dequeue_next (GstQueue * queue)
+{
+  if (queue->ring) {
+    GstMiniObject *item;
+
+    if (G_UNLIKELY (g_atomic_int_get (&queue->ring_flush)))
+      gst_queue_locked_flush_ring (queue);
+    else if ((item = gst_bounded_queue_pop (queue->ring))) {
+      GST_CAT_LOG_OBJECT (queue_dataflow, queue,
+          "retrieved %p from ring", item);
+      GST_QUEUE_SIGNAL_DEL (queue);
+      return item;
+    }
+  }
+  return gst_queue_locked_dequeue (queue);
+}
+
 static GstFlowReturn
 gst_queue_handle_sink_event (GstPad * pad, GstObject * parent, GstEvent * event)
 {
@@ -1069,7 +1230,7 @@ gst_queue_handle_sink_query (GstPad * pad, GstObject * parent, GstQuery * query)
         qitem.item = GST_MINI_OBJECT_CAST (query);
         qitem.is_query = TRUE;
         qitem.size = 0;
-        gst_queue_array_push_tail_struct (queue->queue, &qitem);
+        gst_queue_locked_push_item (queue, &qitem);
         GST_QUEUE_SIGNAL_ADD (queue);
         while (queue->srcresult == GST_FLOW_OK &&
             queue->last_handled_query != query)
@@ -1100,6 +1261,10 @@ gst_queue_is_empty (GstQueue * queue)
 {
   GstQueueItem *tail;
 
+  /* buffers in the ring don't count for the thresholds */
+  if (queue->ring && gst_bounded_queue_peek (queue->ring) != NULL)
+    return FALSE;
+
   tail = gst_queue_array_peek_tail_struct (queue->queue);
 
   if (tail == NULL)
@@ -1178,14 +1343,118 @@ discont_first_buffer (GstBuffer ** buffer, guint i, gpointer user_data)
   return FALSE;
 }
 
+/* the capacity of the ring is rounded up to a power of two, so check the
+ * limit too. Only the sink pad streaming thread pushes, the length can only
+ * shrink meanwhile */
+static inline gboolean
+gst_queue_ring_push (GstQueue * queue, GstMiniObject * obj)
+{
+  if (gst_bounded_queue_length (queue->ring) >= queue->max_size.buffers)
+    return FALSE;
+
+  return gst_bounded_queue_push (queue->ring, obj);
+}
+
+/* put a buffer or buffer list in the ring without taking the queue lock.
+ * Returns FALSE when the item has to take the locked path */
+static gboolean
+gst_queue_chain_lockless (GstQueue * queue, GstMiniObject * obj,
+    GstFlowReturn * ret)
+{
+  guint spin;
+
+  /* these are only changed with the lock. When we miss a change, the item
+   * ends up in the ring and is flushed or pushed like the ones before it */
+  if (G_UNLIKELY (queue->srcresult != GST_FLOW_OK || queue->eos
+          || queue->unexpected || queue->tail_needs_discont
+          || queue->leaky == GST_QUEUE_LEAK_DOWNSTREAM
+          || !QUEUE_RING_USABLE (queue)))
+    return FALSE;
+
+  /* events or queries are waiting in the locked queue, the item has to go
+   * after them */
+  if (g_atomic_int_get (&queue->n_locked_items) > 0)
+    return FALSE;
+
+  if (G_LIKELY (gst_queue_ring_push (queue, obj)))
+    goto pushed;
+
+  if (!queue->silent)
+    g_signal_emit (queue, gst_queue_signals[SIGNAL_OVERRUN], 0);
+
+  if (queue->leaky == GST_QUEUE_LEAK_UPSTREAM) {
+    GST_CAT_DEBUG_OBJECT (queue_dataflow, queue,
+        "ring is full, leaking item on upstream end");
+    queue->tail_needs_discont = TRUE;
+    gst_mini_object_unref (obj);
+    *ret = GST_FLOW_OK;
+    return TRUE;
+  }
+
+  for (spin = 0; spin < LOCKLESS_SPIN_COUNT; spin++) {
+    if (gst_queue_ring_push (queue, obj))
+      goto running;
+  }
+
+  GST_CAT_DEBUG_OBJECT (queue_dataflow, queue,
+      "ring is full, waiting for free space");
+
+  GST_QUEUE_MUTEX_LOCK_CHECK (queue, out_flushing);
+  while (TRUE) {
+    g_atomic_int_set (&queue->waiting_del, TRUE);
+    /* the streaming thread only takes the lock to wake us up when it sees
+     * waiting_del, try again now that it can */
+    if (gst_queue_ring_push (queue, obj))
+      break;
+
+    STATUS (queue, queue->sinkpad, "wait for DEL");
+    g_cond_wait (&queue->item_del, &queue->qlock);
+    if (queue->srcresult != GST_FLOW_OK) {
+      queue->waiting_del = FALSE;
+      goto out_flushing;
+    }
+  }
+  queue->waiting_del = FALSE;
+  GST_QUEUE_MUTEX_UNLOCK (queue);
+
+running:
+  if (!queue->silent)
+    g_signal_emit (queue, gst_queue_signals[SIGNAL_RUNNING], 0);
+
+pushed:
+  if (g_atomic_int_get (&queue->waiting_add)) {
+    GST_QUEUE_MUTEX_LOCK (queue);
+    GST_QUEUE_SIGNAL_ADD (queue);
+    GST_QUEUE_MUTEX_UNLOCK (queue);
+  }
+  *ret = GST_FLOW_OK;
+  return TRUE;
+
+out_flushing:
+  {
+    *ret = queue->srcresult;
+
+    GST_CAT_LOG_OBJECT (queue_dataflow, queue,
+        "exit because task paused, reason: %s", gst_flow_get_name (*ret));
+    GST_QUEUE_MUTEX_UNLOCK (queue);
+    gst_mini_object_unref (obj);
+
+    return TRUE;
+  }
+}
+
 static GstFlowReturn
 gst_queue_chain_buffer_or_list (GstPad * pad, GstObject * parent,
     GstMiniObject * obj, gboolean is_list)
 {
   GstQueue *queue;
+  GstFlowReturn ret;
 
   queue = GST_QUEUE_CAST (parent);
 
+  if (queue->ring && gst_queue_chain_lockless (queue, obj, &ret))
+    return ret;
+
   /* we have to lock the queue since we span threads */
   GST_QUEUE_MUTEX_LOCK_CHECK (queue, out_flushing);
   /* when we received EOS, we refuse any more data */
@@ -1350,20 +1619,155 @@ gst_queue_chain (GstPad * pad, GstObject * parent, GstBuffer * buffer)
       GST_MINI_OBJECT_CAST (buffer), FALSE);
 }
 
+/* combine @buffer with the buffers that are queued right after it into a
+ * buffer list. With @locked the QUEUE_LOCK is held and the locked queue is
+ * looked at too, else only the ring */
+static GstMiniObject *
+gst_queue_take_batch (GstQueue * queue, GstBuffer * buffer, gboolean locked)
+{
+  GstBufferList *list = NULL;
+  GstClockTime duration;
+  guint n = 1;
+
+  duration = GST_BUFFER_DURATION_IS_VALID (buffer) ?
+      GST_BUFFER_DURATION (buffer) : 0;
+
+  while (n < queue->max_batch_buffers && (queue->max_batch_time == 0
+          || duration < queue->max_batch_time)) {
+    GstMiniObject *item = NULL;
+
+    /* the ring goes first, like in gst_queue_locked_dequeue_next() */
+    if (queue->ring && !g_atomic_int_get (&queue->ring_flush))
+      item = gst_bounded_queue_peek (queue->ring);
+    if (item == NULL && locked) {
+      GstQueueItem *qitem = gst_queue_array_peek_head_struct (queue->queue);
+
+      if (qitem)
+        item = qitem->item;
+    }
+    if (item == NULL || !GST_IS_BUFFER (item))
+      break;
+
+    if (locked)
+      item = gst_queue_locked_dequeue_next (queue);
+    else
+      item = gst_bounded_queue_pop (queue->ring);
+
+    if (list == NULL) {
+      list = gst_buffer_list_new_sized (MIN (queue->max_batch_buffers, 64));
+      gst_buffer_list_add (list, buffer);
+    }
+    gst_buffer_list_add (list, GST_BUFFER_CAST (item));
+    n++;
+
+    if (GST_BUFFER_DURATION_IS_VALID (item))
+      duration += GST_BUFFER_DURATION (item);
+  }
+
+  if (list == NULL)
+    return GST_MINI_OBJECT_CAST (buffer);
+
+  /* we made space in the ring, see gst_queue_lockless_pop() */
+  if (!locked && g_atomic_int_get (&queue->waiting_del)) {
+    GST_QUEUE_MUTEX_LOCK (queue);
+    GST_QUEUE_SIGNAL_DEL (queue);
+    GST_QUEUE_MUTEX_UNLOCK (queue);
+  }
+
+  GST_CAT_LOG_OBJECT (queue_dataflow, queue,
+      "pushing a batch of %u buffers", n);
+
+  return GST_MINI_OBJECT_CAST (list);
+}
+
 /* dequeue an item from the queue an push it downstream. This functions returns
  * the result of the push. */
 static GstFlowReturn
 gst_queue_push_one (GstQueue * queue)
 {
-  GstFlowReturn result = queue->srcresult;
   GstMiniObject *data;
-  gboolean is_list;
 
-  data = gst_queue_locked_dequeue (queue);
+  data = gst_queue_locked_dequeue_next (queue);
   if (data == NULL)
     goto no_item;
 
-next:
+  /* push the buffers that are already queued behind this one together */
+  if (queue->max_batch_buffers > 1 && GST_IS_BUFFER (data))
+    data = gst_queue_take_batch (queue, GST_BUFFER_CAST (data), TRUE);
+
+  return gst_queue_push_item (queue, data);
+
+  /* ERRORS */
+no_item:
+  {
+    GST_CAT_ERROR_OBJECT (queue_dataflow, queue,
+        "exit because we have no item in the queue");
+    return GST_FLOW_ERROR;
+  }
+}
+
+/* downstream returned EOS, drop items until one that can be pushed again.
+ * Called with QUEUE_LOCK */
+static GstFlowReturn
+gst_queue_locked_drop_after_eos (GstQueue * queue)
+{
+  GstMiniObject *data;
+
+  GST_CAT_LOG_OBJECT (queue_dataflow, queue, "got EOS from downstream");
+  /* stop pushing buffers, we dequeue all items until we see an item that we
+   * can push again, which is EOS or SEGMENT. If there is nothing in the
+   * queue we can push, we set a flag to make the sinkpad refuse more
+   * buffers with an EOS return value. */
+  while ((data = gst_queue_locked_dequeue_next (queue))) {
+    if (GST_IS_BUFFER (data)) {
+      GST_CAT_LOG_OBJECT (queue_dataflow, queue,
+          "dropping EOS buffer %p", data);
+      gst_buffer_unref (GST_BUFFER_CAST (data));
+    } else if (GST_IS_BUFFER_LIST (data)) {
+      GST_CAT_LOG_OBJECT (queue_dataflow, queue,
+          "dropping EOS buffer list %p", data);
+      gst_buffer_list_unref (GST_BUFFER_LIST_CAST (data));
+    } else if (GST_IS_EVENT (data)) {
+      GstEvent *event = GST_EVENT_CAST (data);
+      GstEventType type = GST_EVENT_TYPE (event);
+
+      if (type == GST_EVENT_EOS || type == GST_EVENT_SEGMENT
+          || type == GST_EVENT_STREAM_START) {
+        /* we found a pushable item in the queue, push it out */
+        GST_CAT_LOG_OBJECT (queue_dataflow, queue,
+            "pushing pushable event %s after EOS",
+            GST_EVENT_TYPE_NAME (event));
+        return gst_queue_push_item (queue, data);
+      }
+      GST_CAT_LOG_OBJECT (queue_dataflow, queue,
+          "dropping EOS event %p", event);
+      gst_event_unref (event);
+    } else if (GST_IS_QUERY (data)) {
+      GstQuery *query = GST_QUERY_CAST (data);
+
+      GST_CAT_LOG_OBJECT (queue_dataflow, queue,
+          "dropping query %p because of EOS", query);
+      queue->last_query = FALSE;
+      g_cond_signal (&queue->query_handled);
+    }
+  }
+  /* no more items in the queue. Set the unexpected flag so that upstream
+   * make us refuse any more buffers on the sinkpad. Since we will still
+   * accept EOS and SEGMENT we return _FLOW_OK to the caller so that the
+   * task function does not shut down. */
+  queue->unexpected = TRUE;
+
+  return GST_FLOW_OK;
+}
+
+/* push a dequeued item downstream. This functions returns the result of the
+ * push. Called with QUEUE_LOCK, which is released while pushing */
+static GstFlowReturn
+gst_queue_push_item (GstQueue * queue, GstMiniObject * data)
+{
+  GstFlowReturn result = queue->srcresult;
+  gboolean is_list;
+
   is_list = GST_IS_BUFFER_LIST (data);
 
   if (GST_IS_BUFFER (data) || is_list) {
@@ -1404,52 +1808,8 @@ next:
     /* need to check for srcresult here as well */
     GST_QUEUE_MUTEX_LOCK_CHECK (queue, out_flushing);
 
-    if (result == GST_FLOW_EOS) {
-      GST_CAT_LOG_OBJECT (queue_dataflow, queue, "got EOS from downstream");
-      /* stop pushing buffers, we dequeue all items until we see an item that we
-       * can push again, which is EOS or SEGMENT. If there is nothing in the
-       * queue we can push, we set a flag to make the sinkpad refuse more
-       * buffers with an EOS return value. */
-      while ((data = gst_queue_locked_dequeue (queue))) {
-        if (GST_IS_BUFFER (data)) {
-          GST_CAT_LOG_OBJECT (queue_dataflow, queue,
-              "dropping EOS buffer %p", data);
-          gst_buffer_unref (GST_BUFFER_CAST (data));
-        } else if (GST_IS_BUFFER_LIST (data)) {
-          GST_CAT_LOG_OBJECT (queue_dataflow, queue,
-              "dropping EOS buffer list %p", data);
-          gst_buffer_list_unref (GST_BUFFER_LIST_CAST (data));
-        } else if (GST_IS_EVENT (data)) {
-          GstEvent *event = GST_EVENT_CAST (data);
-          GstEventType type = GST_EVENT_TYPE (event);
-
-          if (type == GST_EVENT_EOS || type == GST_EVENT_SEGMENT
-              || type == GST_EVENT_STREAM_START) {
-            /* we found a pushable item in the queue, push it out */
-            GST_CAT_LOG_OBJECT (queue_dataflow, queue,
-                "pushing pushable event %s after EOS",
-                GST_EVENT_TYPE_NAME (event));
-            goto next;
-          }
-          GST_CAT_LOG_OBJECT (queue_dataflow, queue,
-              "dropping EOS event %p", event);
-          gst_event_unref (event);
-        } else if (GST_IS_QUERY (data)) {
-          GstQuery *query = GST_QUERY_CAST (data);
-
-          GST_CAT_LOG_OBJECT (queue_dataflow, queue,
-              "dropping query %p because of EOS", query);
-          queue->last_query = FALSE;
-          g_cond_signal (&queue->query_handled);
-        }
-      }
-      /* no more items in the queue. Set the unexpected flag so that upstream
-       * make us refuse any more buffers on the sinkpad. Since we will still
-       * accept EOS and SEGMENT we return _FLOW_OK to the caller so that the
-       * task function does not shut down. */
-      queue->unexpected = TRUE;
-      result = GST_FLOW_OK;
-    }
+    if (result == GST_FLOW_EOS)
+      result = gst_queue_locked_drop_after_eos (queue);
   } else if (GST_IS_EVENT (data)) {
     GstEvent *event = GST_EVENT_CAST (data);
     GstEventType type = GST_EVENT_TYPE (event);
@@ -1481,12 +1841,6 @@ next:
   return result;
 
   /* ERRORS */
-no_item:
-  {
-    GST_CAT_ERROR_OBJECT (queue_dataflow, queue,
-        "exit because we have no item in the queue");
-    return GST_FLOW_ERROR;
-  }
 out_flushing:
   {
     GstFlowReturn ret = queue->srcresult;
@@ -1505,17 +1859,71 @@ out_flushing_query:
   }
 }
 
+/* take the next buffer or buffer list from the ring without taking the
+ * queue lock. Returns NULL when the locked path has to be taken */
+static GstMiniObject *
+gst_queue_lockless_pop (GstQueue * queue)
+{
+  GstMiniObject *data;
+  guint spin = 0;
+
+  /* only changed with the lock, the locked path checks them again */
+  if (G_UNLIKELY (queue->srcresult != GST_FLOW_OK || queue->head_needs_discont
+          || g_atomic_int_get (&queue->ring_flush)))
+    return NULL;
+
+  while ((data = gst_bounded_queue_pop (queue->ring)) == NULL) {
+    /* the next item is in the locked queue or we spun long enough */
+    if (g_atomic_int_get (&queue->n_locked_items) > 0
+        || ++spin > LOCKLESS_SPIN_COUNT)
+      return NULL;
+  }
+
+  GST_CAT_LOG_OBJECT (queue_dataflow, queue, "retrieved %p from ring", data);
+
+  /* the chain function only waits for space with the lock */
+  if (g_atomic_int_get (&queue->waiting_del)) {
+    GST_QUEUE_MUTEX_LOCK (queue);
+    GST_QUEUE_SIGNAL_DEL (queue);
+    GST_QUEUE_MUTEX_UNLOCK (queue);
+  }
+
+  return data;
+}
+
 static void
 gst_queue_loop (GstPad * pad)
 {
   GstQueue *queue;
   GstFlowReturn ret;
+  GstMiniObject *data;
 
   queue = (GstQueue *) GST_PAD_PARENT (pad);
 
+  if (queue->ring && (data = gst_queue_lockless_pop (queue))) {
+    if (queue->max_batch_buffers > 1 && GST_IS_BUFFER (data))
+      data = gst_queue_take_batch (queue, GST_BUFFER_CAST (data), FALSE);
+
+    if (GST_IS_BUFFER (data))
+      ret = gst_pad_push (queue->srcpad, GST_BUFFER_CAST (data));
+    else
+      ret = gst_pad_push_list (queue->srcpad, GST_BUFFER_LIST_CAST (data));
+
+    if (G_LIKELY (ret == GST_FLOW_OK))
+      return;
+
+    GST_QUEUE_MUTEX_LOCK_CHECK (queue, out_flushing);
+    if (ret == GST_FLOW_EOS)
+      ret = gst_queue_locked_drop_after_eos (queue);
+    goto pushed;
+  }
+
   /* have to lock for thread-safety */
   GST_QUEUE_MUTEX_LOCK_CHECK (queue, out_flushing);
 
+  if (queue->ring && g_atomic_int_get (&queue->ring_flush))
+    gst_queue_locked_flush_ring (queue);
+
   while (gst_queue_is_empty (queue)) {
     GST_CAT_DEBUG_OBJECT (queue_dataflow, queue, "queue is empty");
     if (!queue->silent) {
@@ -1539,6 +1947,8 @@ gst_queue_loop (GstPad * pad)
   }
 
   ret = gst_queue_push_one (queue);
+
+pushed:
   queue->srcresult = ret;
   if (ret != GST_FLOW_OK)
     goto out_flushing;
@@ -1734,6 +2144,33 @@ gst_queue_sink_activate_mode (GstPad * pad, GstObject * parent, GstPadMode mode,
   return result;
 }
 
+/* create, resize or free the ring for the lockless mode. Called with
+ * QUEUE_LOCK when the source pad is activated, before the sink pad is.
+ * Returns FALSE when the lockless mode was requested but can't be used */
+static gboolean
+gst_queue_locked_update_ring (GstQueue * queue)
+{
+  guint capacity = queue->max_size.buffers;
+  gboolean usable = QUEUE_RING_USABLE (queue);
+
+  if (queue->ring && (!queue->lockless || !usable
+          || gst_bounded_queue_get_capacity (queue->ring) < capacity
+          || gst_bounded_queue_get_capacity (queue->ring) / 2 >= capacity)) {
+    gst_queue_locked_flush_ring (queue);
+    gst_bounded_queue_unref (queue->ring);
+    queue->ring = NULL;
+  }
+
+  if (queue->lockless && usable && queue->ring == NULL) {
+    GST_DEBUG_OBJECT (queue, "using a lockless ring of %u buffers", capacity);
+    queue->ring =
+        gst_bounded_queue_new (capacity,
+        GST_BOUNDED_QUEUE_FLAG_SINGLE_PRODUCER);
+  }
+
+  return !queue->lockless || usable;
+}
+
 static gboolean
 gst_queue_src_activate_mode (GstPad * pad, GstObject * parent, GstPadMode mode,
     gboolean active)
@@ -1746,7 +2183,10 @@ gst_queue_src_activate_mode (GstPad * pad, GstObject * parent, GstPadMode mode,
   switch (mode) {
     case GST_PAD_MODE_PUSH:
       if (active) {
+        gboolean lockless;
+
         GST_QUEUE_MUTEX_LOCK (queue);
+        lockless = gst_queue_locked_update_ring (queue);
         queue->srcresult = GST_FLOW_OK;
         queue->eos = FALSE;
         queue->unexpected = FALSE;
@@ -1754,6 +2194,12 @@ gst_queue_src_activate_mode (GstPad * pad, GstObject * parent, GstPadMode mode,
             gst_pad_start_task (pad, (GstTaskFunction) gst_queue_loop, pad,
             NULL);
         GST_QUEUE_MUTEX_UNLOCK (queue);
+
+        if (!lockless)
+          GST_ELEMENT_WARNING (queue, CORE, FAILED, (NULL),
+              ("lockless mode needs max-size-buffers to be set and "
+                  "max-size-bytes, max-size-time and the min-thresholds to "
+                  "be 0, using the locked queue"));
       } else {
         /* step 1, unblock loop function */
         GST_QUEUE_MUTEX_LOCK (queue);
@@ -1844,6 +2290,15 @@ gst_queue_set_property (GObject * object,
     case PROP_FLUSH_ON_EOS:
       queue->flush_on_eos = g_value_get_boolean (value);
       break;
+    case PROP_LOCKLESS:
+      queue->lockless = g_value_get_boolean (value);
+      break;
+    case PROP_MAX_BATCH_BUFFERS:
+      queue->max_batch_buffers = g_value_get_uint (value);
+      break;
+    case PROP_MAX_BATCH_TIME:
+      queue->max_batch_time = g_value_get_uint64 (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -1865,7 +2320,8 @@ gst_queue_get_property (GObject * object,
       g_value_set_uint (value, queue->cur_level.bytes);
       break;
     case PROP_CUR_LEVEL_BUFFERS:
-      g_value_set_uint (value, queue->cur_level.buffers);
+      g_value_set_uint (value, queue->cur_level.buffers +
+          (queue->ring ? gst_bounded_queue_length (queue->ring) : 0));
       break;
     case PROP_CUR_LEVEL_TIME:
       g_value_set_uint64 (value, queue->cur_level.time);
@@ -1897,6 +2353,15 @@ gst_queue_get_property (GObject * object,
     case PROP_FLUSH_ON_EOS:
       g_value_set_boolean (value, queue->flush_on_eos);
       break;
+    case PROP_LOCKLESS:
+      g_value_set_boolean (value, queue->lockless);
+      break;
+    case PROP_MAX_BATCH_BUFFERS:
+      g_value_set_uint (value, queue->max_batch_buffers);
+      break;
+    case PROP_MAX_BATCH_TIME:
+      g_value_set_uint64 (value, queue->max_batch_time);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
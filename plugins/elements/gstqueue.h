@@ -138,6 +138,17 @@ struct _GstQueue {
   GstQuery *last_handled_query;
 
   gboolean flush_on_eos; /* flush on EOS */
+
+  /* lockless mode: buffers go through a ring that is pushed into by the
+   * chain function and popped from by the streaming thread without qlock */
+  gboolean lockless;
+  GstBoundedQueue *ring;
+  gint n_locked_items;  /* ATOMIC, number of items in queue */
+  gint ring_flush;      /* ATOMIC, the streaming thread must drop the ring */
+
+  /* push up to this many queued buffers as one buffer list */
+  guint max_batch_buffers;
+  GstClockTime max_batch_time;
 };
 
 struct _GstQueueClass {
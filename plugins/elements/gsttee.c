@@ -35,6 +35,14 @@
  * provide separate threads for each branch. Otherwise a blocked dataflow in one
  * branch would stall the other branches.
  *
+ * Alternatively, when #GstTee:parallel is enabled, tee itself pushes on each
+ * branch from a worker thread. Every branch then has a backlog of at most
+ * #GstTee:max-backlog buffers or buffer lists, and #GstTee:drop-policy
+ * decides what happens when a slow branch lets its backlog fill up. Since the
+ * pushes happen asynchronously, the flow return of a branch is only reported
+ * upstream with the next buffer. Serialized events and queries wait until all
+ * the backlogs are pushed so that they stay in order with the data.
+ *
  * ## Example launch line
  * |[
  * gst-launch-1.0 filesrc location=song.ogg ! decodebin ! tee name=t ! queue ! audioconvert ! audioresample ! autoaudiosink t. ! queue ! audioconvert ! goom ! videoconvert ! autovideosink
@@ -82,12 +90,34 @@ gst_tee_pull_mode_get_type (void)
   return type;
 }
 
+#define GST_TYPE_TEE_DROP_POLICY (gst_tee_drop_policy_get_type())
+static GType
+gst_tee_drop_policy_get_type (void)
+{
+  static GType type = 0;
+  static const GEnumValue data[] = {
+    {GST_TEE_DROP_POLICY_BLOCK, "Block until the backlog has room", "block"},
+    {GST_TEE_DROP_POLICY_DROP_NEW, "Drop the new data", "drop-new"},
+    {GST_TEE_DROP_POLICY_DROP_OLD, "Drop the oldest data in the backlog",
+        "drop-old"},
+    {0, NULL, NULL},
+  };
+
+  if (!type) {
+    type = g_enum_register_static ("GstTeeDropPolicy", data);
+  }
+  return type;
+}
+
 #define DEFAULT_PROP_NUM_SRC_PADS	0
 #define DEFAULT_PROP_HAS_CHAIN		TRUE
 #define DEFAULT_PROP_SILENT		TRUE
 #define DEFAULT_PROP_LAST_MESSAGE	NULL
 #define DEFAULT_PULL_MODE		GST_TEE_PULL_MODE_NEVER
 #define DEFAULT_PROP_ALLOW_NOT_LINKED	FALSE
+#define DEFAULT_PROP_PARALLEL		FALSE
+#define DEFAULT_PROP_MAX_BACKLOG	4
+#define DEFAULT_PROP_DROP_POLICY	GST_TEE_DROP_POLICY_BLOCK
 
 enum
 {
@@ -99,6 +129,10 @@ enum
   PROP_PULL_MODE,
   PROP_ALLOC_PAD,
   PROP_ALLOW_NOT_LINKED,
+  PROP_PARALLEL,
+  PROP_MAX_BACKLOG,
+  PROP_DROP_POLICY,
+  PROP_STATS,
 };
 
 static GstStaticPadTemplate src_template = GST_STATIC_PAD_TEMPLATE ("src_%u",
@@ -138,9 +172,12 @@ struct _GstTeePad
   GstPad parent;
 
   guint index;
-  gboolean pushed;
   GstFlowReturn result;
-  gboolean removed;
+  gboolean removed;             /* ATOMIC */
+
+  /* parallel mode, protected by the branch_lock of the tee */
+  GstQueueArray *backlog;
+  gboolean busy;
 };
 
 struct _GstTeePadClass
@@ -150,15 +187,27 @@ struct _GstTeePadClass
 
 G_DEFINE_TYPE (GstTeePad, gst_tee_pad, GST_TYPE_PAD);
 
+static void
+gst_tee_pad_finalize (GObject * object)
+{
+  GstTeePad *pad = GST_TEE_PAD_CAST (object);
+
+  gst_queue_array_free (pad->backlog);
+
+  G_OBJECT_CLASS (gst_tee_pad_parent_class)->finalize (object);
+}
+
 static void
 gst_tee_pad_class_init (GstTeePadClass * klass)
 {
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+
+  gobject_class->finalize = gst_tee_pad_finalize;
 }
 
 static void
 gst_tee_pad_reset (GstTeePad * pad)
 {
-  pad->pushed = FALSE;
   pad->result = GST_FLOW_NOT_LINKED;
   pad->removed = FALSE;
 }
@@ -167,6 +216,78 @@ static void
 gst_tee_pad_init (GstTeePad * pad)
 {
   gst_tee_pad_reset (pad);
+
+  pad->backlog = gst_queue_array_new (DEFAULT_PROP_MAX_BACKLOG);
+  gst_queue_array_set_clear_func (pad->backlog,
+      (GDestroyNotify) gst_mini_object_unref);
+}
+
+/* An immutable array of the src pads. A new one is published whenever a pad
+ * is added or removed while the streaming thread keeps using the one it took a
+ * ref on, so the data path never has to go over the pad list again when it
+ * changes. */
+struct _GstTeePads
+{
+  gint refcount;
+  guint n_pads;
+  GstPad *pads[1];
+};
+
+/* with the object lock */
+static GstTeePads *
+gst_tee_pads_new (GstTee * tee)
+{
+  GstTeePads *pads;
+  GList *walk;
+  guint n_pads;
+
+  n_pads = GST_ELEMENT_CAST (tee)->numsrcpads;
+  pads = g_malloc (sizeof (GstTeePads) + MAX (n_pads, 1) * sizeof (GstPad *));
+  pads->refcount = 1;
+  pads->n_pads = 0;
+
+  for (walk = GST_ELEMENT_CAST (tee)->srcpads; walk; walk = walk->next)
+    pads->pads[pads->n_pads++] = gst_object_ref (walk->data);
+
+  return pads;
+}
+
+static GstTeePads *
+gst_tee_pads_ref (GstTeePads * pads)
+{
+  g_atomic_int_inc (&pads->refcount);
+
+  return pads;
+}
+
+static void
+gst_tee_pads_unref (GstTeePads * pads)
+{
+  guint i;
+
+  if (!g_atomic_int_dec_and_test (&pads->refcount))
+    return;
+
+  for (i = 0; i < pads->n_pads; i++)
+    gst_object_unref (pads->pads[i]);
+  g_free (pads);
+}
+
+/* publish a new snapshot of the src pads */
+static void
+gst_tee_update_pads (GstTee * tee)
+{
+  GstTeePads *old;
+
+  GST_OBJECT_LOCK (tee);
+  old = tee->pads;
+  tee->pads = gst_tee_pads_new (tee);
+  tee->num_pad_snapshots++;
+  GST_DEBUG_OBJECT (tee, "published snapshot of %u pads", tee->pads->n_pads);
+  GST_OBJECT_UNLOCK (tee);
+
+  /* readers that still use the old snapshot keep it alive */
+  gst_tee_pads_unref (old);
 }
 
 static GstPad *gst_tee_request_new_pad (GstElement * element,
@@ -179,6 +300,8 @@ static void gst_tee_set_property (GObject * object, guint prop_id,
 static void gst_tee_get_property (GObject * object, guint prop_id,
     GValue * value, GParamSpec * pspec);
 static void gst_tee_dispose (GObject * object);
+static GstStateChangeReturn gst_tee_change_state (GstElement * element,
+    GstStateChange transition);
 
 static GstFlowReturn gst_tee_chain (GstPad * pad, GstObject * parent,
     GstBuffer * buffer);
@@ -222,9 +345,13 @@ gst_tee_finalize (GObject * object)
   tee = GST_TEE (object);
 
   g_hash_table_unref (tee->pad_indexes);
+  gst_tee_pads_unref (tee->pads);
 
   g_free (tee->last_message);
 
+  g_mutex_clear (&tee->branch_lock);
+  g_cond_clear (&tee->branch_cond);
+
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
@@ -288,6 +415,73 @@ gst_tee_class_init (GstTeeClass * klass)
           "all unlinked", DEFAULT_PROP_ALLOW_NOT_LINKED,
           G_PARAM_CONSTRUCT | G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
+  /**
+   * GstTee:parallel
+   *
+   * Push on every src pad from a separate worker thread instead of pushing
+   * on the src pads one after the other from the streaming thread. This
+   * makes the latency of tee that of its slowest branch instead of the sum
+   * of all branches.
+   *
+   * Since: 1.20
+   */
+  g_object_class_install_property (gobject_class, PROP_PARALLEL,
+      g_param_spec_boolean ("parallel", "Parallel",
+          "Push on the src pads in parallel from worker threads",
+          DEFAULT_PROP_PARALLEL,
+          G_PARAM_READWRITE | GST_PARAM_MUTABLE_READY |
+          G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstTee:max-backlog
+   *
+   * The maximum number of buffers or buffer lists that can wait to be pushed
+   * on a src pad in parallel mode.
+   *
+   * Since: 1.20
+   */
+  g_object_class_install_property (gobject_class, PROP_MAX_BACKLOG,
+      g_param_spec_uint ("max-backlog", "Max backlog",
+          "Maximum number of buffers (lists) waiting per src pad in parallel "
+          "mode", 1, G_MAXUINT, DEFAULT_PROP_MAX_BACKLOG,
+          G_PARAM_READWRITE | GST_PARAM_MUTABLE_READY |
+          G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstTee:drop-policy
+   *
+   * What to do in parallel mode when the backlog of a src pad is full.
+   *
+   * Since: 1.20
+   */
+  g_object_class_install_property (gobject_class, PROP_DROP_POLICY,
+      g_param_spec_enum ("drop-policy", "Drop policy",
+          "What to do when the backlog of a src pad is full",
+          GST_TYPE_TEE_DROP_POLICY, DEFAULT_PROP_DROP_POLICY,
+          G_PARAM_READWRITE | GST_PARAM_MUTABLE_PLAYING |
+          G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstTee:stats:
+   *
+   * Statistics about the src pads of tee. This property returns a
+   * #GstStructure with name application/x-tee-stats and the following
+   * fields:
+   *
+   * * #guint64 `num-requested-pads`: the number of src pads that were
+   *   requested.
+   * * #guint64 `num-released-pads`: the number of src pads that were
+   *   released.
+   * * #guint64 `num-pad-snapshots`: the number of times a new array of src
+   *   pads was published for the streaming thread.
+   *
+   * Since: 1.20
+   */
+  g_object_class_install_property (gobject_class, PROP_STATS,
+      g_param_spec_boxed ("stats", "Statistics",
+          "Statistics", GST_TYPE_STRUCTURE,
+          G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
   gst_element_class_set_static_metadata (gstelement_class,
       "Tee pipe fitting",
       "Generic",
@@ -299,8 +493,10 @@ gst_tee_class_init (GstTeeClass * klass)
   gstelement_class->request_new_pad =
       GST_DEBUG_FUNCPTR (gst_tee_request_new_pad);
   gstelement_class->release_pad = GST_DEBUG_FUNCPTR (gst_tee_release_pad);
+  gstelement_class->change_state = GST_DEBUG_FUNCPTR (gst_tee_change_state);
 
   gst_type_mark_as_plugin_api (GST_TYPE_TEE_PULL_MODE, 0);
+  gst_type_mark_as_plugin_api (GST_TYPE_TEE_DROP_POLICY, 0);
 }
 
 static void
@@ -322,8 +518,18 @@ gst_tee_init (GstTee * tee)
   gst_element_add_pad (GST_ELEMENT (tee), tee->sinkpad);
 
   tee->pad_indexes = g_hash_table_new (NULL, NULL);
+  GST_OBJECT_LOCK (tee);
+  tee->pads = gst_tee_pads_new (tee);
+  GST_OBJECT_UNLOCK (tee);
 
   tee->last_message = NULL;
+
+  tee->parallel = DEFAULT_PROP_PARALLEL;
+  tee->max_backlog = DEFAULT_PROP_MAX_BACKLOG;
+  tee->drop_policy = DEFAULT_PROP_DROP_POLICY;
+  g_mutex_init (&tee->branch_lock);
+  g_cond_init (&tee->branch_cond);
+  tee->branch_flushing = TRUE;
 }
 
 static void
@@ -421,6 +627,11 @@ gst_tee_request_new_pad (GstElement * element, GstPadTemplate * templ,
   gst_pad_sticky_events_foreach (tee->sinkpad, forward_sticky_events, srcpad);
   gst_element_add_pad (GST_ELEMENT_CAST (tee), srcpad);
 
+  gst_tee_update_pads (tee);
+  GST_OBJECT_LOCK (tee);
+  tee->num_requested_pads++;
+  GST_OBJECT_UNLOCK (tee);
+
   return srcpad;
 
   /* ERRORS */
@@ -457,7 +668,7 @@ gst_tee_release_pad (GstElement * element, GstPad * pad)
   GST_OBJECT_LOCK (tee);
   index = GST_TEE_PAD_CAST (pad)->index;
   /* mark the pad as removed so that future pad_alloc fails with NOT_LINKED. */
-  GST_TEE_PAD_CAST (pad)->removed = TRUE;
+  g_atomic_int_set (&GST_TEE_PAD_CAST (pad)->removed, TRUE);
   if (tee->allocpad == pad) {
     tee->allocpad = NULL;
     changed = TRUE;
@@ -465,7 +676,16 @@ gst_tee_release_pad (GstElement * element, GstPad * pad)
   GST_OBJECT_UNLOCK (tee);
 
   gst_pad_set_active (pad, FALSE);
+
+  /* drop what is still waiting to be pushed on the pad and wake up the
+   * streaming thread in case it waits for room in the backlog */
+  g_mutex_lock (&tee->branch_lock);
+  gst_queue_array_clear (GST_TEE_PAD_CAST (pad)->backlog);
+  g_cond_broadcast (&tee->branch_cond);
+  g_mutex_unlock (&tee->branch_lock);
+
   gst_element_remove_pad (GST_ELEMENT_CAST (tee), pad);
+  gst_tee_update_pads (tee);
 
   if (changed) {
     gst_tee_notify_alloc_pad (tee);
@@ -473,6 +693,7 @@ gst_tee_release_pad (GstElement * element, GstPad * pad)
 
   GST_OBJECT_LOCK (tee);
   g_hash_table_remove (tee->pad_indexes, GUINT_TO_POINTER (index));
+  tee->num_released_pads++;
   GST_OBJECT_UNLOCK (tee);
 }
 
@@ -508,6 +729,15 @@ gst_tee_set_property (GObject * object, guint prop_id, const GValue * value,
     case PROP_ALLOW_NOT_LINKED:
       tee->allow_not_linked = g_value_get_boolean (value);
       break;
+    case PROP_PARALLEL:
+      tee->parallel = g_value_get_boolean (value);
+      break;
+    case PROP_MAX_BACKLOG:
+      tee->max_backlog = g_value_get_uint (value);
+      break;
+    case PROP_DROP_POLICY:
+      tee->drop_policy = (GstTeeDropPolicy) g_value_get_enum (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -544,6 +774,22 @@ gst_tee_get_property (GObject * object, guint prop_id, GValue * value,
     case PROP_ALLOW_NOT_LINKED:
       g_value_set_boolean (value, tee->allow_not_linked);
       break;
+    case PROP_PARALLEL:
+      g_value_set_boolean (value, tee->parallel);
+      break;
+    case PROP_MAX_BACKLOG:
+      g_value_set_uint (value, tee->max_backlog);
+      break;
+    case PROP_DROP_POLICY:
+      g_value_set_enum (value, tee->drop_policy);
+      break;
+    case PROP_STATS:
+      g_value_take_boxed (value, gst_structure_new ("application/x-tee-stats",
+              "num-requested-pads", G_TYPE_UINT64, tee->num_requested_pads,
+              "num-released-pads", G_TYPE_UINT64, tee->num_released_pads,
+              "num-pad-snapshots", G_TYPE_UINT64, tee->num_pad_snapshots,
+              NULL));
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -551,13 +797,74 @@ gst_tee_get_property (GObject * object, guint prop_id, GValue * value,
   GST_OBJECT_UNLOCK (tee);
 }
 
+/* wait until the workers pushed the backlogs of all src pads */
+static void
+gst_tee_drain_branches (GstTee * tee)
+{
+  g_mutex_lock (&tee->branch_lock);
+  while (tee->n_busy_branches > 0 && !tee->branch_flushing) {
+    GST_LOG_OBJECT (tee, "waiting for %u branches to drain",
+        tee->n_busy_branches);
+    g_cond_wait (&tee->branch_cond, &tee->branch_lock);
+  }
+  g_mutex_unlock (&tee->branch_lock);
+}
+
+static void
+gst_tee_flush_branches (GstTee * tee, gboolean flushing)
+{
+  GList *pads;
+
+  g_mutex_lock (&tee->branch_lock);
+  if (flushing) {
+    tee->branch_flushing = TRUE;
+    g_cond_broadcast (&tee->branch_cond);
+  } else {
+    /* the workers stop popping from the backlogs when flushing, wait until
+     * they are done with their last push so that they can't overwrite the
+     * result of the pads anymore */
+    while (tee->n_busy_branches > 0)
+      g_cond_wait (&tee->branch_cond, &tee->branch_lock);
+  }
+  g_mutex_unlock (&tee->branch_lock);
+
+  GST_OBJECT_LOCK (tee);
+  g_mutex_lock (&tee->branch_lock);
+  for (pads = GST_ELEMENT_CAST (tee)->srcpads; pads; pads = pads->next) {
+    GstTeePad *tpad = GST_TEE_PAD_CAST (pads->data);
+
+    if (flushing)
+      gst_queue_array_clear (tpad->backlog);
+    else
+      tpad->result = GST_FLOW_NOT_LINKED;
+  }
+  if (!flushing)
+    tee->branch_flushing = FALSE;
+  g_mutex_unlock (&tee->branch_lock);
+  GST_OBJECT_UNLOCK (tee);
+}
+
 static gboolean
 gst_tee_sink_event (GstPad * pad, GstObject * parent, GstEvent * event)
 {
+  GstTee *tee = GST_TEE_CAST (parent);
   gboolean res;
 
   switch (GST_EVENT_TYPE (event)) {
+    case GST_EVENT_FLUSH_START:
+      if (tee->branch_pool)
+        gst_tee_flush_branches (tee, TRUE);
+      res = gst_pad_event_default (pad, parent, event);
+      break;
+    case GST_EVENT_FLUSH_STOP:
+      if (tee->branch_pool)
+        gst_tee_flush_branches (tee, FALSE);
+      res = gst_pad_event_default (pad, parent, event);
+      break;
     default:
+      /* don't overtake the data that is still in the backlogs */
+      if (tee->branch_pool && GST_EVENT_IS_SERIALIZED (event))
+        gst_tee_drain_branches (tee);
       res = gst_pad_event_default (pad, parent, event);
       break;
   }
@@ -739,6 +1046,10 @@ gst_tee_sink_query (GstPad * pad, GstObject * parent, GstQuery * query)
   GstTee *tee = GST_TEE (parent);
   gboolean res;
 
+  /* don't overtake the data that is still in the backlogs */
+  if (tee->branch_pool && GST_QUERY_IS_SERIALIZED (query))
+    gst_tee_drain_branches (tee);
+
   switch (GST_QUERY_TYPE (query)) {
     case GST_QUERY_ALLOCATION:
     {
@@ -859,37 +1170,171 @@ gst_tee_do_push (GstTee * tee, GstPad * pad, gpointer data, gboolean is_list)
 }
 
 static void
-clear_pads (GstPad * pad, GstTee * tee)
+gst_tee_branch_func (GstTeePad * tpad, GstTee * tee)
 {
-  GST_TEE_PAD_CAST (pad)->pushed = FALSE;
-  GST_TEE_PAD_CAST (pad)->result = GST_FLOW_NOT_LINKED;
+  GstPad *pad = GST_PAD_CAST (tpad);
+  GstMiniObject *item;
+  GstFlowReturn ret;
+
+  g_mutex_lock (&tee->branch_lock);
+  while (!tee->branch_flushing
+      && (item = gst_queue_array_pop_head (tpad->backlog))) {
+    /* the streaming thread might be waiting for room in the backlog */
+    if (gst_queue_array_get_length (tpad->backlog) + 1 >= tee->max_backlog)
+      g_cond_broadcast (&tee->branch_cond);
+    g_mutex_unlock (&tee->branch_lock);
+
+    GST_LOG_OBJECT (pad, "Starting to push %p", item);
+
+    if (GST_IS_BUFFER_LIST (item))
+      ret = gst_pad_push_list (pad, GST_BUFFER_LIST_CAST (item));
+    else
+      ret = gst_pad_push (pad, GST_BUFFER_CAST (item));
+
+    GST_LOG_OBJECT (pad, "Pushing item %p yielded result %s", item,
+        gst_flow_get_name (ret));
+
+    g_mutex_lock (&tee->branch_lock);
+    tpad->result = ret;
+  }
+  tpad->busy = FALSE;
+  tee->n_busy_branches--;
+  g_cond_broadcast (&tee->branch_cond);
+  g_mutex_unlock (&tee->branch_lock);
+
+  gst_object_unref (tpad);
+}
+
+/* called with the branch_lock, returns FALSE when flushing */
+static gboolean
+gst_tee_branch_queue (GstTee * tee, GstTeePad * tpad, gpointer data)
+{
+  while (gst_queue_array_get_length (tpad->backlog) >= tee->max_backlog) {
+    if (tee->branch_flushing)
+      return FALSE;
+    if (tpad->removed)
+      return TRUE;
+
+    switch (tee->drop_policy) {
+      case GST_TEE_DROP_POLICY_DROP_NEW:
+        GST_DEBUG_OBJECT (tpad, "backlog full, dropping new item %p", data);
+        return TRUE;
+      case GST_TEE_DROP_POLICY_DROP_OLD:
+      {
+        GstMiniObject *old = gst_queue_array_pop_head (tpad->backlog);
+
+        GST_DEBUG_OBJECT (tpad, "backlog full, dropping old item %p", old);
+        gst_mini_object_unref (old);
+        break;
+      }
+      default:
+        GST_LOG_OBJECT (tpad, "backlog full, waiting");
+        g_cond_wait (&tee->branch_cond, &tee->branch_lock);
+        break;
+    }
+  }
+
+  if (tee->branch_flushing)
+    return FALSE;
+  if (tpad->removed)
+    return TRUE;
+
+  gst_queue_array_push_tail (tpad->backlog, gst_mini_object_ref (data));
+
+  /* the worker of the pad pops until the backlog is empty, only start one
+   * when it is not running yet */
+  if (!tpad->busy) {
+    tpad->busy = TRUE;
+    tee->n_busy_branches++;
+    g_thread_pool_push (tee->branch_pool, gst_object_ref (tpad), NULL);
+  }
+  return TRUE;
+}
+
+static GstFlowReturn
+gst_tee_handle_data_parallel (GstTee * tee, GstTeePads * pads, gpointer data,
+    gboolean allow_not_linked)
+{
+  GstFlowReturn ret, cret;
+  guint i;
+
+  if (allow_not_linked) {
+    cret = GST_FLOW_OK;
+  } else {
+    cret = GST_FLOW_NOT_LINKED;
+  }
+
+  g_mutex_lock (&tee->branch_lock);
+  for (i = 0; i < pads->n_pads; i++) {
+    GstPad *pad = pads->pads[i];
+    GstTeePad *tpad = GST_TEE_PAD_CAST (pad);
+
+    /* don't push on the pad we're pulling from */
+    if (pad == tee->pull_pad) {
+      cret = GST_FLOW_OK;
+      continue;
+    }
+
+    /* we don't know the result of this push yet, use the one of the previous
+     * push on the pad. A pad that was not pushed on yet is fine when it is
+     * linked. */
+    ret = tpad->result;
+    if (tpad->removed)
+      ret = GST_FLOW_NOT_LINKED;
+    else if (ret == GST_FLOW_NOT_LINKED && gst_pad_is_linked (pad))
+      ret = GST_FLOW_OK;
+
+    /* stop pushing more buffers when we have a fatal error */
+    if (G_UNLIKELY (ret != GST_FLOW_OK && ret != GST_FLOW_NOT_LINKED)) {
+      GST_DEBUG_OBJECT (pad, "received error %s", gst_flow_get_name (ret));
+      cret = ret;
+      break;
+    }
+    if (G_LIKELY (ret != GST_FLOW_NOT_LINKED))
+      cret = ret;
+
+    if (!gst_tee_branch_queue (tee, tpad, data)) {
+      GST_DEBUG_OBJECT (tee, "flushing");
+      cret = GST_FLOW_FLUSHING;
+      break;
+    }
+  }
+  g_mutex_unlock (&tee->branch_lock);
+
+  return cret;
 }
 
 static GstFlowReturn
 gst_tee_handle_data (GstTee * tee, gpointer data, gboolean is_list)
 {
-  GList *pads;
-  guint32 cookie;
+  GstTeePads *pads;
   GstFlowReturn ret, cret;
+  gboolean allow_not_linked;
+  guint i;
 
   if (G_UNLIKELY (!tee->silent))
     gst_tee_do_message (tee, tee->sinkpad, data, is_list);
 
+  /* take the current snapshot of the src pads, pads that are added or removed
+   * while we push publish a new one and don't disturb us */
   GST_OBJECT_LOCK (tee);
-  pads = GST_ELEMENT_CAST (tee)->srcpads;
+  pads = gst_tee_pads_ref (tee->pads);
+  allow_not_linked = tee->allow_not_linked;
+  GST_OBJECT_UNLOCK (tee);
+
+  if (tee->branch_pool) {
+    ret = gst_tee_handle_data_parallel (tee, pads, data, allow_not_linked);
+    goto end;
+  }
 
   /* special case for zero pads */
-  if (G_UNLIKELY (!pads))
+  if (G_UNLIKELY (pads->n_pads == 0))
     goto no_pads;
 
-  /* special case for just one pad that avoids reffing the buffer */
-  if (!pads->next) {
-    GstPad *pad = GST_PAD_CAST (pads->data);
-
-    /* Keep another ref around, a pad probe
-     * might release and destroy the pad */
-    gst_object_ref (pad);
-    GST_OBJECT_UNLOCK (tee);
+  /* special case for just one pad that avoids reffing the buffer. The
+   * snapshot keeps the pad alive when a pad probe releases it. */
+  if (pads->n_pads == 1) {
+    GstPad *pad = pads->pads[0];
 
     if (pad == tee->pull_pad) {
       ret = GST_FLOW_OK;
@@ -899,75 +1344,43 @@ gst_tee_handle_data (GstTee * tee, gpointer data, gboolean is_list)
       ret = gst_pad_push (pad, GST_BUFFER_CAST (data));
     }
 
-    GST_OBJECT_LOCK (tee);
-    if (GST_TEE_PAD_CAST (pad)->removed)
+    if (g_atomic_int_get (&GST_TEE_PAD_CAST (pad)->removed))
       ret = GST_FLOW_NOT_LINKED;
 
-    if (ret == GST_FLOW_NOT_LINKED && tee->allow_not_linked) {
+    if (ret == GST_FLOW_NOT_LINKED && allow_not_linked) {
       ret = GST_FLOW_OK;
     }
-    GST_OBJECT_UNLOCK (tee);
 
-    gst_object_unref (pad);
+    gst_tee_pads_unref (pads);
 
     return ret;
   }
 
-  /* mark all pads as 'not pushed on yet' */
-  g_list_foreach (pads, (GFunc) clear_pads, tee);
-
-restart:
-  if (tee->allow_not_linked) {
+  if (allow_not_linked) {
     cret = GST_FLOW_OK;
   } else {
     cret = GST_FLOW_NOT_LINKED;
   }
-  pads = GST_ELEMENT_CAST (tee)->srcpads;
-  cookie = GST_ELEMENT_CAST (tee)->pads_cookie;
-
-  while (pads) {
-    GstPad *pad;
 
-    pad = GST_PAD_CAST (pads->data);
+  for (i = 0; i < pads->n_pads; i++) {
+    GstPad *pad = pads->pads[i];
 
-    if (G_LIKELY (!GST_TEE_PAD_CAST (pad)->pushed)) {
-      /* not yet pushed, release lock and start pushing */
-      gst_object_ref (pad);
-      GST_OBJECT_UNLOCK (tee);
-
-      GST_LOG_OBJECT (pad, "Starting to push %s %p",
-          is_list ? "list" : "buffer", data);
+    if (G_UNLIKELY (g_atomic_int_get (&GST_TEE_PAD_CAST (pad)->removed))) {
+      GST_LOG_OBJECT (pad, "pad was released, skipping");
+      continue;
+    }
 
-      ret = gst_tee_do_push (tee, pad, data, is_list);
+    GST_LOG_OBJECT (pad, "Starting to push %s %p",
+        is_list ? "list" : "buffer", data);
 
-      GST_LOG_OBJECT (pad, "Pushing item %p yielded result %s", data,
-          gst_flow_get_name (ret));
+    ret = gst_tee_do_push (tee, pad, data, is_list);
 
-      GST_OBJECT_LOCK (tee);
-      /* keep track of which pad we pushed and the result value */
-      if (GST_TEE_PAD_CAST (pad)->removed)
-        ret = GST_FLOW_NOT_LINKED;
-      GST_TEE_PAD_CAST (pad)->pushed = TRUE;
-      GST_TEE_PAD_CAST (pad)->result = ret;
-      gst_object_unref (pad);
-      pad = NULL;
-    } else {
-      /* already pushed, use previous return value */
-      ret = GST_TEE_PAD_CAST (pad)->result;
-      GST_LOG_OBJECT (pad, "pad already pushed with %s",
-          gst_flow_get_name (ret));
-    }
+    GST_LOG_OBJECT (pad, "Pushing item %p yielded result %s", data,
+        gst_flow_get_name (ret));
 
-    /* before we go combining the return value, check if the pad list is still
-     * the same. It could be possible that the pad we just pushed was removed
-     * and the return value it not valid anymore */
-    if (G_UNLIKELY (GST_ELEMENT_CAST (tee)->pads_cookie != cookie)) {
-      GST_LOG_OBJECT (tee, "pad list changed");
-      /* the list of pads changed, restart iteration. Pads that we already
-       * pushed on and are still in the new list, will not be pushed on
-       * again. */
-      goto restart;
-    }
+    /* the pad could have been released while we were pushing on it */
+    if (g_atomic_int_get (&GST_TEE_PAD_CAST (pad)->removed))
+      ret = GST_FLOW_NOT_LINKED;
 
     /* stop pushing more buffers when we have a fatal error */
     if (G_UNLIKELY (ret != GST_FLOW_OK && ret != GST_FLOW_NOT_LINKED))
@@ -978,19 +1391,14 @@ restart:
       GST_LOG_OBJECT (tee, "Replacing ret val %d with %d", cret, ret);
       cret = ret;
     }
-    pads = g_list_next (pads);
   }
-  GST_OBJECT_UNLOCK (tee);
-
-  gst_mini_object_unref (GST_MINI_OBJECT_CAST (data));
-
-  /* no need to unset gvalue */
-  return cret;
+  ret = cret;
+  goto end;
 
   /* ERRORS */
 no_pads:
   {
-    if (tee->allow_not_linked) {
+    if (allow_not_linked) {
       GST_DEBUG_OBJECT (tee, "there are no pads, dropping %s",
           is_list ? "buffer-list" : "buffer");
       ret = GST_FLOW_OK;
@@ -1007,7 +1415,7 @@ error:
   }
 end:
   {
-    GST_OBJECT_UNLOCK (tee);
+    gst_tee_pads_unref (pads);
     gst_mini_object_unref (GST_MINI_OBJECT_CAST (data));
     return ret;
   }
@@ -1047,6 +1455,52 @@ gst_tee_chain_list (GstPad * pad, GstObject * parent, GstBufferList * list)
   return res;
 }
 
+static GstStateChangeReturn
+gst_tee_change_state (GstElement * element, GstStateChange transition)
+{
+  GstTee *tee = GST_TEE (element);
+  GstStateChangeReturn ret;
+
+  switch (transition) {
+    case GST_STATE_CHANGE_READY_TO_PAUSED:
+      if (tee->parallel) {
+        /* reset the results of the pads */
+        gst_tee_flush_branches (tee, FALSE);
+        tee->branch_pool = g_thread_pool_new ((GFunc) gst_tee_branch_func, tee,
+            -1, FALSE, NULL);
+      }
+      break;
+    case GST_STATE_CHANGE_PAUSED_TO_READY:
+      /* wake up the streaming thread so that the sink pad can be
+       * deactivated */
+      if (tee->branch_pool)
+        gst_tee_flush_branches (tee, TRUE);
+      break;
+    default:
+      break;
+  }
+
+  ret = GST_ELEMENT_CLASS (parent_class)->change_state (element, transition);
+
+  switch (transition) {
+    case GST_STATE_CHANGE_READY_TO_PAUSED:
+      if (ret != GST_STATE_CHANGE_FAILURE)
+        break;
+      /* fallthrough */
+    case GST_STATE_CHANGE_PAUSED_TO_READY:
+      if (tee->branch_pool) {
+        /* waits for the workers to finish */
+        g_thread_pool_free (tee->branch_pool, FALSE, TRUE);
+        tee->branch_pool = NULL;
+      }
+      break;
+    default:
+      break;
+  }
+
+  return ret;
+}
+
 static gboolean
 gst_tee_sink_activate_mode (GstPad * pad, GstObject * parent, GstPadMode mode,
     gboolean active)
@@ -25,6 +25,7 @@
 #define __GST_TEE_H__
 
 #include <gst/gst.h>
+#include <gst/base/gstqueuearray.h>
 
 G_BEGIN_DECLS
 
@@ -43,6 +44,7 @@ G_BEGIN_DECLS
 
 typedef struct _GstTee 		GstTee;
 typedef struct _GstTeeClass 	GstTeeClass;
+typedef struct _GstTeePads	GstTeePads;
 
 /**
  * GstTeePullMode:
@@ -57,6 +59,23 @@ typedef enum {
   GST_TEE_PULL_MODE_SINGLE,
 } GstTeePullMode;
 
+/**
+ * GstTeeDropPolicy:
+ * @GST_TEE_DROP_POLICY_BLOCK: Block until the branch has room in its backlog.
+ * @GST_TEE_DROP_POLICY_DROP_NEW: Drop the new data for the branch.
+ * @GST_TEE_DROP_POLICY_DROP_OLD: Drop the oldest data in the backlog of the
+ *     branch.
+ *
+ * What tee does in parallel mode when the backlog of a branch is full.
+ *
+ * Since: 1.20
+ */
+typedef enum {
+  GST_TEE_DROP_POLICY_BLOCK,
+  GST_TEE_DROP_POLICY_DROP_NEW,
+  GST_TEE_DROP_POLICY_DROP_OLD,
+} GstTeeDropPolicy;
+
 /**
  * GstTee:
  *
@@ -72,6 +91,12 @@ struct _GstTee {
   GHashTable     *pad_indexes;
   guint           next_pad_index;
 
+  /* snapshot of the src pads for the streaming thread */
+  GstTeePads     *pads;
+  guint64         num_requested_pads;
+  guint64         num_released_pads;
+  guint64         num_pad_snapshots;
+
   gboolean        has_chain;
   gboolean        silent;
   gchar          *last_message;
@@ -81,6 +106,17 @@ struct _GstTee {
   GstPad         *pull_pad;
 
   gboolean        allow_not_linked;
+
+  /* parallel mode */
+  gboolean        parallel;
+  guint           max_backlog;
+  GstTeeDropPolicy drop_policy;
+
+  GThreadPool    *branch_pool;
+  GMutex          branch_lock;
+  GCond           branch_cond;
+  gboolean        branch_flushing;
+  guint           n_busy_branches;
 };
 
 struct _GstTeeClass {
@@ -0,0 +1,811 @@
+/* GStreamer
+ *
+ * gstmetrics.c: tracing module that keeps live pipeline metrics
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+/**
+ * SECTION:tracer-metrics
+ * @short_description: keep live pipeline metrics
+ *
+ * A tracing module that keeps metrics of the running pipelines in memory
+ * instead of logging the individual events, and makes them available in the
+ * Prometheus text exposition format. The metrics are:
+ *
+ * - `gst_pad_buffers_total` and `gst_pad_bytes_total`: buffers and bytes that
+ *   were pushed or pulled through each pad
+ * - `gst_pad_buffers_per_second` and `gst_pad_bytes_per_second`: the rates
+ *   since the previous snapshot
+ * - `gst_element_processing_seconds`: a histogram of the time each element
+ *   spends handling a buffer, not counting the time spent in the elements
+ *   downstream of it
+ * - `gst_element_processing_seconds_quantile`: the 50%, 90% and 99%
+ *   percentiles of the processing time since the previous snapshot
+ * - `gst_queue_level_buffers`, `gst_queue_level_bytes` and
+ *   `gst_queue_level_seconds`: the fill level of queue and queue2 elements
+ *
+ * When the `file` parameter is set, a snapshot is written to that file every
+ * `interval` milliseconds (1000 by default). The file is replaced atomically,
+ * so it can be scraped with the textfile collector of the Prometheus node
+ * exporter. Applications can get a snapshot at any time with the
+ * #GstMetricsTracer::get-metrics action signal. The metrics of pads and
+ * elements that are gone are reported one last time by the snapshots taken
+ * within `interval` after they went away.
+ *
+ * ```
+ * GST_TRACERS="metrics(file=/tmp/gst.prom,interval=5000)" gst-launch-1.0 ...
+ * ```
+ *
+ * Since: 1.20
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#include "gstmetrics.h"
+
+#include <string.h>
+
+GST_DEBUG_CATEGORY_STATIC (gst_metrics_debug);
+#define GST_CAT_DEFAULT gst_metrics_debug
+
+#define DEFAULT_INTERVAL (1 * GST_SECOND)
+
+enum
+{
+  SIGNAL_GET_METRICS,
+  LAST_SIGNAL
+};
+
+static guint gst_metrics_tracer_signals[LAST_SIGNAL] = { 0 };
+
+/* every tracer keeps its entries on the objects under its own key */
+static gint tracer_ids;         /* ATOMIC */
+
+/* the arrays of entries are not pruned before they reach this size */
+#define MIN_PRUNE_LEN 64
+
+#define _do_init \
+    GST_DEBUG_CATEGORY_INIT (gst_metrics_debug, "metrics", 0, "metrics tracer");
+#define gst_metrics_tracer_parent_class parent_class
+G_DEFINE_TYPE_WITH_CODE (GstMetricsTracer, gst_metrics_tracer,
+    GST_TYPE_TRACER, _do_init);
+
+/* upper bounds of the buckets of the processing time histogram, the last
+ * bucket has no upper bound */
+#define N_BUCKETS 11
+static const GstClockTime bucket_bounds[N_BUCKETS - 1] = {
+  10 * GST_USECOND, 100 * GST_USECOND, 500 * GST_USECOND, GST_MSECOND,
+  5 * GST_MSECOND, 10 * GST_MSECOND, 50 * GST_MSECOND, 100 * GST_MSECOND,
+  500 * GST_MSECOND, GST_SECOND
+};
+
+static const gdouble quantiles[] = { 0.5, 0.9, 0.99 };
+
+typedef struct
+{
+  /* pads */
+  guint64 buffers;
+  guint64 bytes;
+
+  /* elements */
+  guint64 buckets[N_BUCKETS];
+  guint64 count;
+  GstClockTime sum;
+} GstMetricsValues;
+
+/* The metrics of one pad or element. The entry is referenced by the object
+ * and by the tracer, so that the last values can still be reported after the
+ * object is gone. */
+typedef struct
+{
+  gint refcount;                /* ATOMIC */
+  gint alive;                   /* ATOMIC */
+  /* when the object went away, protected by the lock */
+  GstClockTime gone;
+
+  /* the Prometheus labels, escaped */
+  gchar *labels;
+
+  /* for reading the level of queues */
+  GWeakRef queue;
+
+  GMutex lock;
+  GstMetricsValues values;
+
+  /* at the previous snapshot, protected by the tracer lock */
+  GstMetricsValues last;
+} GstMetricsEntry;
+
+/* the processing time is measured between the pre and post hooks, these
+ * nest when an element pushes from its chain function */
+typedef struct
+{
+  GstClockTime start;
+  /* spent in the elements downstream */
+  GstClockTime nested;
+} GstMetricsFrame;
+
+static GPrivate frames_key = G_PRIVATE_INIT ((GDestroyNotify) g_array_unref);
+
+/* data helpers */
+
+static void
+entry_unref (gpointer data)
+{
+  GstMetricsEntry *entry = data;
+
+  if (g_atomic_int_dec_and_test (&entry->refcount)) {
+    g_weak_ref_clear (&entry->queue);
+    g_mutex_clear (&entry->lock);
+    g_free (entry->labels);
+    g_slice_free (GstMetricsEntry, entry);
+  }
+}
+
+static void
+entry_object_gone (gpointer data)
+{
+  GstMetricsEntry *entry = data;
+
+  g_mutex_lock (&entry->lock);
+  entry->gone = gst_util_get_timestamp ();
+  g_mutex_unlock (&entry->lock);
+  g_atomic_int_set (&entry->alive, FALSE);
+  entry_unref (entry);
+}
+
+/* Drop the entries of the objects that went away longer than the snapshot
+ * interval ago, so that the arrays don't grow without bound when no
+ * snapshots are taken. This is only done once the array doubled in size
+ * since the last time. Must be called with the tracer lock. */
+static void
+prune_entries (GstMetricsTracer * self, GPtrArray * entries,
+    guint * prune_len)
+{
+  GstClockTime now;
+  guint i;
+
+  if (entries->len < *prune_len)
+    return;
+
+  now = gst_util_get_timestamp ();
+  for (i = entries->len; i > 0; i--) {
+    GstMetricsEntry *entry = g_ptr_array_index (entries, i - 1);
+    GstClockTime gone;
+
+    if (g_atomic_int_get (&entry->alive))
+      continue;
+
+    g_mutex_lock (&entry->lock);
+    gone = entry->gone;
+    g_mutex_unlock (&entry->lock);
+
+    if (now - gone > self->interval)
+      g_ptr_array_remove_index (entries, i - 1);
+  }
+  *prune_len = MAX (2 * entries->len, MIN_PRUNE_LEN);
+}
+
+static void
+append_escaped (GString * s, const gchar * str)
+{
+  for (; str && *str; str++) {
+    if (*str == '\\' || *str == '"')
+      g_string_append_c (s, '\\');
+    if (*str == '\n')
+      g_string_append (s, "\\n");
+    else
+      g_string_append_c (s, *str);
+  }
+}
+
+static gchar *
+build_labels (GstObject * object)
+{
+  GString *s = g_string_new ("pipeline=\"");
+  GstObject *top = object, *parent;
+
+  while ((parent = GST_OBJECT_PARENT (top)))
+    top = parent;
+
+  append_escaped (s, GST_OBJECT_NAME (top));
+  if (GST_IS_PAD (object)) {
+    g_string_append (s, "\",pad=\"");
+    if (GST_OBJECT_PARENT (object)) {
+      append_escaped (s, GST_OBJECT_NAME (GST_OBJECT_PARENT (object)));
+      g_string_append_c (s, ':');
+    }
+  } else {
+    g_string_append (s, "\",element=\"");
+  }
+  append_escaped (s, GST_OBJECT_NAME (object));
+  g_string_append_c (s, '"');
+
+  return g_string_free (s, FALSE);
+}
+
+static GstMetricsEntry *
+get_entry (GstMetricsTracer * self, GstObject * object)
+{
+  GstMetricsEntry *entry;
+
+  /* the entry never changes once it is set on the object */
+  if (G_LIKELY ((entry = g_object_get_qdata ((GObject *) object,
+                  self->data_quark))))
+    return entry;
+
+  g_mutex_lock (&self->lock);
+  if (!(entry = g_object_get_qdata ((GObject *) object, self->data_quark))) {
+    entry = g_slice_new0 (GstMetricsEntry);
+    entry->refcount = 2;
+    entry->alive = TRUE;
+    entry->labels = build_labels (object);
+    g_weak_ref_init (&entry->queue, NULL);
+    g_mutex_init (&entry->lock);
+
+    if (GST_IS_PAD (object)) {
+      prune_entries (self, self->pads, &self->pads_prune_len);
+      g_ptr_array_add (self->pads, entry);
+    } else {
+      if (g_object_class_find_property (G_OBJECT_GET_CLASS (object),
+              "current-level-buffers"))
+        g_weak_ref_set (&entry->queue, object);
+      prune_entries (self, self->elements, &self->elements_prune_len);
+      g_ptr_array_add (self->elements, entry);
+    }
+    g_object_set_qdata_full ((GObject *) object, self->data_quark, entry,
+        entry_object_gone);
+    GST_DEBUG_OBJECT (self, "new entry %s", entry->labels);
+  }
+  g_mutex_unlock (&self->lock);
+
+  return entry;
+}
+
+/*
+ * Get the element/bin owning the pad.
+ *
+ * in: a normal pad
+ * out: the element
+ *
+ * in: a proxy pad
+ * out: the element that contains the peer of the proxy
+ *
+ * in: a ghost pad
+ * out: the bin owning the ghostpad
+ */
+static GstElement *
+get_real_pad_parent (GstPad * pad)
+{
+  GstObject *parent;
+
+  if (!pad)
+    return NULL;
+
+  parent = GST_OBJECT_PARENT (pad);
+
+  /* if parent of pad is a ghost-pad, then pad is a proxy_pad */
+  if (parent && GST_IS_GHOST_PAD (parent)) {
+    pad = GST_PAD_CAST (parent);
+    parent = GST_OBJECT_PARENT (pad);
+  }
+  return GST_ELEMENT_CAST (parent);
+}
+
+static void
+add_buffers (GstMetricsTracer * self, GstPad * pad, guint buffers,
+    gsize bytes)
+{
+  GstMetricsEntry *entry = get_entry (self, GST_OBJECT_CAST (pad));
+
+  g_mutex_lock (&entry->lock);
+  entry->values.buffers += buffers;
+  entry->values.bytes += bytes;
+  g_mutex_unlock (&entry->lock);
+}
+
+static void
+push_frame (GstClockTime ts)
+{
+  GArray *frames = g_private_get (&frames_key);
+  GstMetricsFrame frame = { ts, 0 };
+
+  if (G_UNLIKELY (frames == NULL)) {
+    frames = g_array_new (FALSE, FALSE, sizeof (GstMetricsFrame));
+    g_private_set (&frames_key, frames);
+  }
+  g_array_append_val (frames, frame);
+}
+
+static void
+pop_frame (GstMetricsTracer * self, GstPad * pad, GstClockTime ts)
+{
+  GArray *frames = g_private_get (&frames_key);
+  GstMetricsFrame *frame;
+  GstClockTime elapsed, own;
+  GstMetricsEntry *entry;
+  GstElement *peer;
+  guint i;
+
+  /* the tracer was activated while data was flowing */
+  if (G_UNLIKELY (frames == NULL || frames->len == 0))
+    return;
+
+  frame = &g_array_index (frames, GstMetricsFrame, frames->len - 1);
+  elapsed = ts > frame->start ? ts - frame->start : 0;
+  own = elapsed > frame->nested ? elapsed - frame->nested : 0;
+  g_array_set_size (frames, frames->len - 1);
+  if (frames->len > 0)
+    g_array_index (frames, GstMetricsFrame, frames->len - 1).nested += elapsed;
+
+  /* the time was spent in the element on the other side of the pad */
+  if (!(peer = get_real_pad_parent (GST_PAD_PEER (pad))))
+    return;
+
+  entry = get_entry (self, GST_OBJECT_CAST (peer));
+
+  for (i = 0; i < N_BUCKETS - 1; i++) {
+    if (own <= bucket_bounds[i])
+      break;
+  }
+
+  g_mutex_lock (&entry->lock);
+  entry->values.buckets[i]++;
+  entry->values.count++;
+  entry->values.sum += own;
+  g_mutex_unlock (&entry->lock);
+}
+
+/* snapshot */
+
+static void
+append_double (GString * s, gdouble val)
+{
+  gchar buf[G_ASCII_DTOSTR_BUF_SIZE];
+
+  g_string_append (s, g_ascii_formatd (buf, sizeof (buf), "%g", val));
+}
+
+static void
+append_header (GString * s, const gchar * name, const gchar * type,
+    const gchar * help)
+{
+  g_string_append_printf (s, "# HELP %s %s\n# TYPE %s %s\n", name, help, name,
+      type);
+}
+
+static gdouble
+estimate_quantile (const guint64 * buckets, guint64 count, gdouble q)
+{
+  guint64 rank = (guint64) (q * count + 0.5), cum = 0;
+  GstClockTime lower = 0, upper;
+  guint i;
+
+  if (rank == 0)
+    rank = 1;
+
+  for (i = 0; i < N_BUCKETS; i++) {
+    /* the last bucket has no upper bound, report its lower bound */
+    upper = i < N_BUCKETS - 1 ? bucket_bounds[i] : lower;
+    if (cum + buckets[i] >= rank)
+      break;
+    cum += buckets[i];
+    lower = upper;
+  }
+  if (i == N_BUCKETS)
+    return (gdouble) lower / GST_SECOND;
+
+  /* assume that the values are spread evenly in the bucket */
+  return (lower + (upper - lower) * (gdouble) (rank - cum) / buckets[i]) /
+      GST_SECOND;
+}
+
+static gchar *
+gst_metrics_tracer_snapshot (GstMetricsTracer * self)
+{
+  GString *s = g_string_sized_new (4096);
+  GstMetricsValues *pad_values, *elem_values;
+  GstClockTime now;
+  gdouble period;
+  guint i, j;
+
+  g_mutex_lock (&self->lock);
+
+  now = gst_util_get_timestamp ();
+  period = GST_CLOCK_TIME_IS_VALID (self->last_snapshot) &&
+      now > self->last_snapshot ?
+      (gdouble) (now - self->last_snapshot) / GST_SECOND : 0.0;
+
+  /* take a consistent copy of the values of every entry */
+  pad_values = g_new (GstMetricsValues, self->pads->len);
+  for (i = 0; i < self->pads->len; i++) {
+    GstMetricsEntry *entry = g_ptr_array_index (self->pads, i);
+
+    g_mutex_lock (&entry->lock);
+    pad_values[i] = entry->values;
+    g_mutex_unlock (&entry->lock);
+  }
+  elem_values = g_new (GstMetricsValues, self->elements->len);
+  for (i = 0; i < self->elements->len; i++) {
+    GstMetricsEntry *entry = g_ptr_array_index (self->elements, i);
+
+    g_mutex_lock (&entry->lock);
+    elem_values[i] = entry->values;
+    g_mutex_unlock (&entry->lock);
+  }
+
+  append_header (s, "gst_pad_buffers_total", "counter",
+      "Buffers that went through the pad");
+  for (i = 0; i < self->pads->len; i++) {
+    GstMetricsEntry *entry = g_ptr_array_index (self->pads, i);
+
+    g_string_append_printf (s, "gst_pad_buffers_total{%s} %" G_GUINT64_FORMAT
+        "\n", entry->labels, pad_values[i].buffers);
+  }
+  append_header (s, "gst_pad_bytes_total", "counter",
+      "Bytes that went through the pad");
+  for (i = 0; i < self->pads->len; i++) {
+    GstMetricsEntry *entry = g_ptr_array_index (self->pads, i);
+
+    g_string_append_printf (s, "gst_pad_bytes_total{%s} %" G_GUINT64_FORMAT
+        "\n", entry->labels, pad_values[i].bytes);
+  }
+
+  if (period > 0.0) {
+    append_header (s, "gst_pad_buffers_per_second", "gauge",
+        "Buffer rate of the pad since the previous snapshot");
+    for (i = 0; i < self->pads->len; i++) {
+      GstMetricsEntry *entry = g_ptr_array_index (self->pads, i);
+
+      g_string_append_printf (s, "gst_pad_buffers_per_second{%s} ",
+          entry->labels);
+      append_double (s,
+          (pad_values[i].buffers - entry->last.buffers) / period);
+      g_string_append_c (s, '\n');
+    }
+    append_header (s, "gst_pad_bytes_per_second", "gauge",
+        "Byte rate of the pad since the previous snapshot");
+    for (i = 0; i < self->pads->len; i++) {
+      GstMetricsEntry *entry = g_ptr_array_index (self->pads, i);
+
+      g_string_append_printf (s, "gst_pad_bytes_per_second{%s} ",
+          entry->labels);
+      append_double (s, (pad_values[i].bytes - entry->last.bytes) / period);
+      g_string_append_c (s, '\n');
+    }
+  }
+
+  append_header (s, "gst_element_processing_seconds", "histogram",
+      "Time the element spent handling a buffer");
+  for (i = 0; i < self->elements->len; i++) {
+    GstMetricsEntry *entry = g_ptr_array_index (self->elements, i);
+    guint64 cum = 0;
+
+    for (j = 0; j < N_BUCKETS; j++) {
+      cum += elem_values[i].buckets[j];
+      g_string_append_printf (s, "gst_element_processing_seconds_bucket{%s,"
+          "le=\"", entry->labels);
+      if (j < N_BUCKETS - 1)
+        append_double (s, (gdouble) bucket_bounds[j] / GST_SECOND);
+      else
+        g_string_append (s, "+Inf");
+      g_string_append_printf (s, "\"} %" G_GUINT64_FORMAT "\n", cum);
+    }
+    g_string_append_printf (s, "gst_element_processing_seconds_sum{%s} ",
+        entry->labels);
+    append_double (s, (gdouble) elem_values[i].sum / GST_SECOND);
+    g_string_append_printf (s, "\ngst_element_processing_seconds_count{%s} %"
+        G_GUINT64_FORMAT "\n", entry->labels, elem_values[i].count);
+  }
+
+  append_header (s, "gst_element_processing_seconds_quantile", "gauge",
+      "Percentiles of the processing time since the previous snapshot");
+  for (i = 0; i < self->elements->len; i++) {
+    GstMetricsEntry *entry = g_ptr_array_index (self->elements, i);
+    guint64 buckets[N_BUCKETS];
+    guint64 count = elem_values[i].count - entry->last.count;
+
+    if (count == 0)
+      continue;
+
+    for (j = 0; j < N_BUCKETS; j++)
+      buckets[j] = elem_values[i].buckets[j] - entry->last.buckets[j];
+
+    for (j = 0; j < G_N_ELEMENTS (quantiles); j++) {
+      g_string_append_printf (s, "gst_element_processing_seconds_quantile{%s,"
+          "quantile=\"", entry->labels);
+      append_double (s, quantiles[j]);
+      g_string_append (s, "\"} ");
+      append_double (s, estimate_quantile (buckets, count, quantiles[j]));
+      g_string_append_c (s, '\n');
+    }
+  }
+
+  append_header (s, "gst_queue_level_buffers", "gauge",
+      "Buffers in the queue");
+  append_header (s, "gst_queue_level_bytes", "gauge", "Bytes in the queue");
+  append_header (s, "gst_queue_level_seconds", "gauge",
+      "Amount of data in the queue in seconds");
+  for (i = 0; i < self->elements->len; i++) {
+    GstMetricsEntry *entry = g_ptr_array_index (self->elements, i);
+    GObject *queue = g_weak_ref_get (&entry->queue);
+    guint buffers = 0, bytes = 0;
+    guint64 time = 0;
+
+    if (queue == NULL)
+      continue;
+
+    g_object_get (queue, "current-level-buffers", &buffers,
+        "current-level-bytes", &bytes, "current-level-time", &time, NULL);
+    g_object_unref (queue);
+
+    g_string_append_printf (s, "gst_queue_level_buffers{%s} %u\n",
+        entry->labels, buffers);
+    g_string_append_printf (s, "gst_queue_level_bytes{%s} %u\n",
+        entry->labels, bytes);
+    g_string_append_printf (s, "gst_queue_level_seconds{%s} ", entry->labels);
+    append_double (s, (gdouble) time / GST_SECOND);
+    g_string_append_c (s, '\n');
+  }
+
+  /* remember the values for the rates and drop the entries of the objects
+   * that are gone, they were reported one last time */
+  for (i = self->pads->len; i > 0; i--) {
+    GstMetricsEntry *entry = g_ptr_array_index (self->pads, i - 1);
+
+    entry->last = pad_values[i - 1];
+    if (!g_atomic_int_get (&entry->alive))
+      g_ptr_array_remove_index (self->pads, i - 1);
+  }
+  for (i = self->elements->len; i > 0; i--) {
+    GstMetricsEntry *entry = g_ptr_array_index (self->elements, i - 1);
+
+    entry->last = elem_values[i - 1];
+    if (!g_atomic_int_get (&entry->alive))
+      g_ptr_array_remove_index (self->elements, i - 1);
+  }
+  self->last_snapshot = now;
+
+  g_mutex_unlock (&self->lock);
+
+  g_free (pad_values);
+  g_free (elem_values);
+
+  return g_string_free (s, FALSE);
+}
+
+static void
+gst_metrics_tracer_write (GstMetricsTracer * self)
+{
+  GError *err = NULL;
+  gchar *metrics;
+
+  metrics = gst_metrics_tracer_snapshot (self);
+  if (!g_file_set_contents (self->file, metrics, -1, &err)) {
+    GST_WARNING_OBJECT (self, "could not write %s: %s", self->file,
+        err->message);
+    g_clear_error (&err);
+  }
+  g_free (metrics);
+}
+
+static gpointer
+gst_metrics_tracer_writer (gpointer data)
+{
+  GstMetricsTracer *self = data;
+
+  g_mutex_lock (&self->thread_lock);
+  while (self->running) {
+    gint64 end_time = g_get_monotonic_time () +
+        self->interval / GST_USECOND;
+
+    g_cond_wait_until (&self->thread_cond, &self->thread_lock, end_time);
+    if (!self->running)
+      break;
+
+    g_mutex_unlock (&self->thread_lock);
+    gst_metrics_tracer_write (self);
+    g_mutex_lock (&self->thread_lock);
+  }
+  g_mutex_unlock (&self->thread_lock);
+
+  return NULL;
+}
+
+/* hooks */
+
+static void
+do_push_buffer_pre (GstMetricsTracer * self, guint64 ts, GstPad * pad,
+    GstBuffer * buffer)
+{
+  add_buffers (self, pad, 1, gst_buffer_get_size (buffer));
+  push_frame (ts);
+}
+
+static void
+do_push_buffer_list_pre (GstMetricsTracer * self, guint64 ts, GstPad * pad,
+    GstBufferList * list)
+{
+  add_buffers (self, pad, gst_buffer_list_length (list),
+      gst_buffer_list_calculate_size (list));
+  push_frame (ts);
+}
+
+static void
+do_push_buffer_post (GstMetricsTracer * self, guint64 ts, GstPad * pad,
+    GstFlowReturn res)
+{
+  pop_frame (self, pad, ts);
+}
+
+static void
+do_pull_range_pre (GstMetricsTracer * self, guint64 ts, GstPad * pad)
+{
+  push_frame (ts);
+}
+
+static void
+do_pull_range_post (GstMetricsTracer * self, guint64 ts, GstPad * pad,
+    GstBuffer * buffer)
+{
+  if (buffer != NULL)
+    add_buffers (self, pad, 1, gst_buffer_get_size (buffer));
+  pop_frame (self, pad, ts);
+}
+
+/* tracer class */
+
+static gchar *
+gst_metrics_tracer_get_metrics (GstMetricsTracer * self)
+{
+  return gst_metrics_tracer_snapshot (self);
+}
+
+static void
+gst_metrics_tracer_constructed (GObject * object)
+{
+  GstMetricsTracer *self = GST_METRICS_TRACER (object);
+  gchar *params, *tmp;
+  const gchar *name, *file;
+  GstStructure *params_struct = NULL;
+  guint interval;
+
+  g_object_get (self, "params", &params, NULL);
+
+  if (!params)
+    return;
+
+  tmp = g_strdup_printf ("metrics,%s", params);
+  params_struct = gst_structure_from_string (tmp, NULL);
+  g_free (tmp);
+  g_free (params);
+  if (!params_struct)
+    return;
+
+  /* Set the name if assigned */
+  name = gst_structure_get_string (params_struct, "name");
+  if (name)
+    gst_object_set_name (GST_OBJECT (self), name);
+
+  if (gst_structure_get_uint (params_struct, "interval", &interval)
+      && interval > 0)
+    self->interval = interval * GST_MSECOND;
+
+  file = gst_structure_get_string (params_struct, "file");
+  if (file) {
+    self->file = g_strdup (file);
+    self->running = TRUE;
+    self->thread = g_thread_new ("GstMetricsWriter",
+        gst_metrics_tracer_writer, self);
+    GST_INFO_OBJECT (self, "writing metrics to %s every %" GST_TIME_FORMAT,
+        self->file, GST_TIME_ARGS (self->interval));
+  }
+  gst_structure_free (params_struct);
+}
+
+static void
+gst_metrics_tracer_finalize (GObject * object)
+{
+  GstMetricsTracer *self = GST_METRICS_TRACER (object);
+
+  if (self->thread) {
+    g_mutex_lock (&self->thread_lock);
+    self->running = FALSE;
+    g_cond_signal (&self->thread_cond);
+    g_mutex_unlock (&self->thread_lock);
+    g_thread_join (self->thread);
+    self->thread = NULL;
+
+    /* the final values */
+    gst_metrics_tracer_write (self);
+  }
+  g_free (self->file);
+
+  g_ptr_array_unref (self->pads);
+  g_ptr_array_unref (self->elements);
+  g_mutex_clear (&self->lock);
+  g_mutex_clear (&self->thread_lock);
+  g_cond_clear (&self->thread_cond);
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
+static void
+gst_metrics_tracer_class_init (GstMetricsTracerClass * klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+
+  gobject_class->constructed = gst_metrics_tracer_constructed;
+  gobject_class->finalize = gst_metrics_tracer_finalize;
+
+  klass->get_metrics = gst_metrics_tracer_get_metrics;
+
+  /**
+   * GstMetricsTracer::get-metrics:
+   * @metricstracer: the metrics tracer object to emit this signal on
+   *
+   * Returns a snapshot of the metrics in the Prometheus text exposition
+   * format. The rates and percentiles are calculated since the previous
+   * snapshot, which includes the snapshots written to the `file`.
+   *
+   * Returns: (transfer full): the metrics
+   *
+   * Since: 1.20
+   */
+  gst_metrics_tracer_signals[SIGNAL_GET_METRICS] =
+      g_signal_new ("get-metrics", G_TYPE_FROM_CLASS (klass),
+      G_SIGNAL_RUN_LAST | G_SIGNAL_ACTION, G_STRUCT_OFFSET
+      (GstMetricsTracerClass, get_metrics), NULL, NULL, NULL, G_TYPE_STRING,
+      0, G_TYPE_NONE);
+}
+
+static void
+gst_metrics_tracer_init (GstMetricsTracer * self)
+{
+  GstTracer *tracer = GST_TRACER (self);
+  gchar *key;
+
+  /* a new tracer must not pick up the entries of a previous one */
+  key = g_strdup_printf ("gstmetrics:data-%d",
+      g_atomic_int_add (&tracer_ids, 1));
+  self->data_quark = g_quark_from_string (key);
+  g_free (key);
+
+  g_mutex_init (&self->lock);
+  self->pads = g_ptr_array_new_with_free_func (entry_unref);
+  self->elements = g_ptr_array_new_with_free_func (entry_unref);
+  self->pads_prune_len = MIN_PRUNE_LEN;
+  self->elements_prune_len = MIN_PRUNE_LEN;
+  self->last_snapshot = GST_CLOCK_TIME_NONE;
+  self->interval = DEFAULT_INTERVAL;
+  g_mutex_init (&self->thread_lock);
+  g_cond_init (&self->thread_cond);
+
+  gst_tracing_register_hook (tracer, "pad-push-pre",
+      G_CALLBACK (do_push_buffer_pre));
+  gst_tracing_register_hook (tracer, "pad-push-post",
+      G_CALLBACK (do_push_buffer_post));
+  gst_tracing_register_hook (tracer, "pad-push-list-pre",
+      G_CALLBACK (do_push_buffer_list_pre));
+  gst_tracing_register_hook (tracer, "pad-push-list-post",
+      G_CALLBACK (do_push_buffer_post));
+  gst_tracing_register_hook (tracer, "pad-pull-range-pre",
+      G_CALLBACK (do_pull_range_pre));
+  gst_tracing_register_hook (tracer, "pad-pull-range-post",
+      G_CALLBACK (do_pull_range_post));
+}
@@ -0,0 +1,85 @@
+/* GStreamer
+ *
+ * gstmetrics.h: tracing module that keeps live pipeline metrics
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __GST_METRICS_TRACER_H__
+#define __GST_METRICS_TRACER_H__
+
+#include <gst/gst.h>
+#include <gst/gsttracer.h>
+
+G_BEGIN_DECLS
+
+#define GST_TYPE_METRICS_TRACER \
+  (gst_metrics_tracer_get_type())
+#define GST_METRICS_TRACER(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST((obj),GST_TYPE_METRICS_TRACER,GstMetricsTracer))
+#define GST_METRICS_TRACER_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_CAST((klass),GST_TYPE_METRICS_TRACER,GstMetricsTracerClass))
+#define GST_IS_METRICS_TRACER(obj) \
+  (G_TYPE_CHECK_INSTANCE_TYPE((obj),GST_TYPE_METRICS_TRACER))
+#define GST_IS_METRICS_TRACER_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_TYPE((klass),GST_TYPE_METRICS_TRACER))
+#define GST_METRICS_TRACER_CAST(obj) ((GstMetricsTracer *)(obj))
+
+typedef struct _GstMetricsTracer GstMetricsTracer;
+typedef struct _GstMetricsTracerClass GstMetricsTracerClass;
+
+/**
+ * GstMetricsTracer:
+ *
+ * Opaque #GstMetricsTracer data structure
+ */
+struct _GstMetricsTracer {
+  GstTracer 	 parent;
+
+  /*< private >*/
+  /* the key of the entries on the objects */
+  GQuark data_quark;
+
+  /* protects the entries and the values of the previous snapshot */
+  GMutex lock;
+  GPtrArray *pads;
+  GPtrArray *elements;
+  /* size at which the entries of objects that are gone are dropped */
+  guint pads_prune_len;
+  guint elements_prune_len;
+  GstClockTime last_snapshot;
+
+  /* the snapshot file and the thread writing it */
+  gchar *file;
+  GstClockTime interval;
+  GThread *thread;
+  GMutex thread_lock;
+  GCond thread_cond;
+  gboolean running;
+};
+
+struct _GstMetricsTracerClass {
+  GstTracerClass parent_class;
+
+  /* actions */
+  gchar *        (*get_metrics)                 (GstMetricsTracer *tracer);
+};
+
+G_GNUC_INTERNAL GType gst_metrics_tracer_get_type (void);
+
+G_END_DECLS
+
+#endif /* __GST_METRICS_TRACER_H__ */
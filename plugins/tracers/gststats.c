@@ -23,6 +23,13 @@
  * @short_description: log event stats
  *
  * A tracing module that builds usage statistic for elements and pads.
+ *
+ * Set `GST_TRACER_FILE` to have the records written in a binary format,
+ * which is a lot cheaper than formatting them into the debug log.
+ *
+ * The time spent in each element is summed up when the tracer is destroyed.
+ * Applications can get the current values with the
+ * #GstStatsTracer::get-element-times action signal.
  */
 
 #ifdef HAVE_CONFIG_H
@@ -37,6 +44,8 @@ GST_DEBUG_CATEGORY_STATIC (gst_stats_debug);
 #define GST_CAT_DEFAULT gst_stats_debug
 
 static GQuark data_quark;
+/* only taken when creating the stats of an element or pad, the lookup does
+ * not need them */
 G_LOCK_DEFINE (_elem_stats);
 G_LOCK_DEFINE (_pad_stats);
 
@@ -47,6 +56,14 @@ G_LOCK_DEFINE (_pad_stats);
 G_DEFINE_TYPE_WITH_CODE (GstStatsTracer, gst_stats_tracer, GST_TYPE_TRACER,
     _do_init);
 
+enum
+{
+  SIGNAL_GET_ELEMENT_TIMES,
+  LAST_SIGNAL
+};
+
+static guint gst_stats_tracer_signals[LAST_SIGNAL] = { 0 };
+
 static GstTracerRecord *tr_new_element;
 static GstTracerRecord *tr_new_pad;
 static GstTracerRecord *tr_buffer;
@@ -71,12 +88,124 @@ typedef struct
   guint index;
   /* for pre + post */
   GstClockTime last_ts;
-  /* time spend in this element */
-  GstClockTime treal;
   /* hierarchy */
   guint parent_ix;
 } GstElementStats;
 
+/* Counters that are updated from the streaming threads are kept per thread,
+ * so that the threads never write to the same memory. They are summed up
+ * when they are requested and when the tracer is destroyed.
+ *
+ * A shard is owned by both the tracer and the thread that created it. The
+ * thread finds it by the id of the tracer, since the address of a destroyed
+ * tracer can be reused, and drops it once the tracer is gone. */
+typedef struct
+{
+  gint refcount;
+  /* the id of the tracer, 0 once the tracer is destroyed, ATOMIC */
+  guint tracer_id;
+  /* protects treal, only contended while the counters are summed up */
+  GMutex lock;
+  /* time spend in each element, indexed by the element index */
+  GArray *treal;
+} GstStatsShard;
+
+static gint tracer_ids;         /* ATOMIC */
+
+static void
+shard_unref (gpointer data)
+{
+  GstStatsShard *shard = data;
+
+  if (g_atomic_int_dec_and_test (&shard->refcount)) {
+    g_mutex_clear (&shard->lock);
+    g_array_free (shard->treal, TRUE);
+    g_slice_free (GstStatsShard, shard);
+  }
+}
+
+static void
+shards_free (GSList * shards)
+{
+  g_slist_free_full (shards, shard_unref);
+}
+
+static GPrivate shards_key = G_PRIVATE_INIT ((GDestroyNotify) shards_free);
+
+static GstStatsShard *
+get_shard (GstStatsTracer * self)
+{
+  GSList *shards = g_private_get (&shards_key), *l, *next;
+  GstStatsShard *shard;
+  gboolean pruned = FALSE;
+  guint id;
+
+  /* there is usually only one stats tracer */
+  for (l = shards; l; l = next) {
+    shard = l->data;
+    next = l->next;
+    id = g_atomic_int_get (&shard->tracer_id);
+    if (G_LIKELY (id == self->id)) {
+      if (G_UNLIKELY (pruned))
+        g_private_set (&shards_key, shards);
+      return shard;
+    }
+    if (id == 0) {
+      /* the tracer of this shard is gone */
+      shards = g_slist_delete_link (shards, l);
+      shard_unref (shard);
+      pruned = TRUE;
+    }
+  }
+
+  shard = g_slice_new0 (GstStatsShard);
+  shard->refcount = 2;
+  shard->tracer_id = self->id;
+  g_mutex_init (&shard->lock);
+  shard->treal = g_array_new (FALSE, TRUE, sizeof (GstClockTimeDiff));
+
+  GST_OBJECT_LOCK (self);
+  g_ptr_array_add (self->shards, shard);
+  GST_OBJECT_UNLOCK (self);
+
+  g_private_set (&shards_key, g_slist_prepend (shards, shard));
+
+  return shard;
+}
+
+static void
+release_shard (gpointer data)
+{
+  GstStatsShard *shard = data;
+
+  g_atomic_int_set (&shard->tracer_id, 0);
+  shard_unref (shard);
+}
+
+/* sum up the counters of all threads, takes the object lock */
+static GArray *
+get_element_times (GstStatsTracer * self)
+{
+  GArray *times = g_array_new (FALSE, TRUE, sizeof (GstClockTimeDiff));
+  guint i, j;
+
+  GST_OBJECT_LOCK (self);
+  for (j = 0; j < self->shards->len; j++) {
+    GstStatsShard *shard = g_ptr_array_index (self->shards, j);
+
+    g_mutex_lock (&shard->lock);
+    if (times->len < shard->treal->len)
+      g_array_set_size (times, shard->treal->len);
+    for (i = 0; i < shard->treal->len; i++)
+      g_array_index (times, GstClockTimeDiff, i) +=
+          g_array_index (shard->treal, GstClockTimeDiff, i);
+    g_mutex_unlock (&shard->lock);
+  }
+  GST_OBJECT_UNLOCK (self);
+
+  return times;
+}
+
 /* data helper */
 
 static GstElementStats no_elem_stats = { 0, };
@@ -86,7 +215,7 @@ fill_element_stats (GstStatsTracer * self, GstElement * element)
 {
   GstElementStats *stats = g_slice_new0 (GstElementStats);
 
-  stats->index = self->num_elements++;
+  stats->index = g_atomic_int_add ((gint *) & self->num_elements, 1);
   stats->parent_ix = G_MAXUINT;
   return stats;
 }
@@ -129,12 +258,16 @@ get_element_stats (GstStatsTracer * self, GstElement * element)
     return &no_elem_stats;
   }
 
-  G_LOCK (_elem_stats);
-  if (!(stats = g_object_get_qdata ((GObject *) element, data_quark))) {
-    stats = create_element_stats (self, element);
-    is_new = TRUE;
+  /* the stats never change once they are set on the element */
+  if (G_UNLIKELY (!(stats = g_object_get_qdata ((GObject *) element,
+                  data_quark)))) {
+    G_LOCK (_elem_stats);
+    if (!(stats = g_object_get_qdata ((GObject *) element, data_quark))) {
+      stats = create_element_stats (self, element);
+      is_new = TRUE;
+    }
+    G_UNLOCK (_elem_stats);
   }
-  G_UNLOCK (_elem_stats);
   if (G_UNLIKELY (stats->parent_ix == G_MAXUINT)) {
     GstElement *parent = GST_ELEMENT_PARENT (element);
     if (parent) {
@@ -188,7 +321,7 @@ fill_pad_stats (GstStatsTracer * self, GstPad * pad)
 {
   GstPadStats *stats = g_slice_new0 (GstPadStats);
 
-  stats->index = self->num_pads++;
+  stats->index = g_atomic_int_add ((gint *) & self->num_pads, 1);
   stats->parent_ix = G_MAXUINT;
 
   return stats;
@@ -220,14 +353,17 @@ get_pad_stats (GstStatsTracer * self, GstPad * pad)
     return &no_pad_stats;
   }
 
-  G_LOCK (_pad_stats);
-  if (!(stats = g_object_get_qdata ((GObject *) pad, data_quark))) {
-    stats = fill_pad_stats (self, pad);
-    g_object_set_qdata_full ((GObject *) pad, data_quark, stats,
-        free_pad_stats);
-    is_new = TRUE;
+  if (G_UNLIKELY (!(stats = g_object_get_qdata ((GObject *) pad,
+                  data_quark)))) {
+    G_LOCK (_pad_stats);
+    if (!(stats = g_object_get_qdata ((GObject *) pad, data_quark))) {
+      stats = fill_pad_stats (self, pad);
+      g_object_set_qdata_full ((GObject *) pad, data_quark, stats,
+          free_pad_stats);
+      is_new = TRUE;
+    }
+    G_UNLOCK (_pad_stats);
   }
-  G_UNLOCK (_pad_stats);
   if (G_UNLIKELY (stats->parent_ix == G_MAXUINT)) {
     GstElement *elem = get_real_pad_parent (pad);
     if (elem) {
@@ -279,6 +415,16 @@ do_query_stats (GstStatsTracer * self, GstPad * this_pad,
       gst_query_get_structure (qry), have_res, res);
 }
 
+/* call with the shard lock */
+static inline void
+add_element_time (GstStatsShard * shard, GstElementStats * stats,
+    GstClockTimeDiff elapsed)
+{
+  if (G_UNLIKELY (stats->index >= shard->treal->len))
+    g_array_set_size (shard->treal, stats->index + 1);
+  g_array_index (shard->treal, GstClockTimeDiff, stats->index) += elapsed;
+}
+
 static void
 do_element_stats (GstStatsTracer * self, GstPad * pad, GstClockTime elapsed1,
     GstClockTime elapsed2)
@@ -291,6 +437,7 @@ do_element_stats (GstStatsTracer * self, GstPad * pad, GstClockTime elapsed1,
   GstElementStats *this_stats = get_element_stats (self, this);
   GstPad *peer_pad = GST_PAD_PEER (pad);
   GstElementStats *peer_stats;
+  GstStatsShard *shard;
 
   if (!peer_pad)
     return;
@@ -341,17 +488,21 @@ do_element_stats (GstStatsTracer * self, GstPad * pad, GstClockTime elapsed1,
    *   - can we start a counter after push/pull in such elements and add then
    *     time to the element upon next pad activity?
    */
+  shard = get_shard (self);
+  g_mutex_lock (&shard->lock);
 #if 1
   /* this does not make sense for demuxers */
-  this_stats->treal -= elapsed;
-  peer_stats->treal += elapsed;
+  add_element_time (shard, this_stats, -elapsed);
+  add_element_time (shard, peer_stats, elapsed);
 #else
   /* this creates several >100% figures */
-  this_stats->treal += GST_CLOCK_DIFF (this_stats->last_ts, elapsed2) - elapsed;
-  peer_stats->treal += elapsed;
+  add_element_time (shard, this_stats,
+      GST_CLOCK_DIFF (this_stats->last_ts, elapsed2) - elapsed);
+  add_element_time (shard, peer_stats, elapsed);
   this_stats->last_ts = elapsed2;
   peer_stats->last_ts = elapsed2;
 #endif
+  g_mutex_unlock (&shard->lock);
 }
 
 /* hooks */
@@ -520,6 +671,50 @@ do_query_post (GstStatsTracer * self, guint64 ts, GstPad * this_pad,
 
 /* tracer class */
 
+static GstStructure *
+gst_stats_tracer_get_element_times (GstStatsTracer * self)
+{
+  GArray *times = get_element_times (self);
+  GValue array = G_VALUE_INIT;
+  GValue value = G_VALUE_INIT;
+  GstStructure *info;
+  guint i;
+
+  g_value_init (&array, GST_TYPE_ARRAY);
+  g_value_init (&value, G_TYPE_INT64);
+  for (i = 0; i < times->len; i++) {
+    g_value_set_int64 (&value, g_array_index (times, GstClockTimeDiff, i));
+    gst_value_array_append_value (&array, &value);
+  }
+  g_value_unset (&value);
+  g_array_free (times, TRUE);
+
+  info = gst_structure_new_empty ("element-times");
+  gst_structure_take_value (info, "times", &array);
+
+  return info;
+}
+
+static void
+gst_stats_tracer_finalize (GObject * object)
+{
+  GstStatsTracer *self = GST_STATS_TRACER (object);
+  GArray *times = get_element_times (self);
+  GstClockTimeDiff treal;
+  guint i;
+
+  for (i = 0; i < times->len; i++) {
+    treal = g_array_index (times, GstClockTimeDiff, i);
+    if (treal != 0)
+      GST_INFO_OBJECT (self, "element %u: time spent %" GST_STIME_FORMAT, i,
+          GST_STIME_ARGS (treal));
+  }
+  g_array_free (times, TRUE);
+  g_ptr_array_unref (self->shards);
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
 static void
 gst_stats_tracer_constructed (GObject * object)
 {
@@ -552,6 +747,9 @@ gst_stats_tracer_class_init (GstStatsTracerClass * klass)
   GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
 
   gobject_class->constructed = gst_stats_tracer_constructed;
+  gobject_class->finalize = gst_stats_tracer_finalize;
+
+  klass->get_element_times = gst_stats_tracer_get_element_times;
 
   /* announce trace formats */
   /* *INDENT-OFF* */
@@ -782,6 +980,25 @@ gst_stats_tracer_class_init (GstStatsTracerClass * klass)
   GST_OBJECT_FLAG_SET (tr_query, GST_OBJECT_FLAG_MAY_BE_LEAKED);
   GST_OBJECT_FLAG_SET (tr_new_element, GST_OBJECT_FLAG_MAY_BE_LEAKED);
   GST_OBJECT_FLAG_SET (tr_new_pad, GST_OBJECT_FLAG_MAY_BE_LEAKED);
+
+  /**
+   * GstStatsTracer::get-element-times:
+   * @statstracer: the stats tracer object to emit this signal on
+   *
+   * Returns a #GstStructure with a `times` field of type #GST_TYPE_ARRAY. It
+   * holds the time spent in each element so far as #gint64 nanoseconds,
+   * indexed by the `ix` of the `new-element` records. The counters of all
+   * streaming threads are summed up when the signal is emitted.
+   *
+   * Returns: (transfer full): a newly-allocated #GstStructure
+   *
+   * Since: 1.20
+   */
+  gst_stats_tracer_signals[SIGNAL_GET_ELEMENT_TIMES] =
+      g_signal_new ("get-element-times", G_TYPE_FROM_CLASS (klass),
+      G_SIGNAL_RUN_LAST | G_SIGNAL_ACTION, G_STRUCT_OFFSET (GstStatsTracerClass,
+          get_element_times), NULL, NULL, NULL, GST_TYPE_STRUCTURE, 0,
+      G_TYPE_NONE);
 }
 
 static void
@@ -789,6 +1006,9 @@ gst_stats_tracer_init (GstStatsTracer * self)
 {
   GstTracer *tracer = GST_TRACER (self);
 
+  self->id = g_atomic_int_add (&tracer_ids, 1) + 1;
+  self->shards = g_ptr_array_new_with_free_func (release_shard);
+
   gst_tracing_register_hook (tracer, "pad-push-pre",
       G_CALLBACK (do_push_buffer_pre));
   gst_tracing_register_hook (tracer, "pad-push-post",
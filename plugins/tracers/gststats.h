@@ -51,13 +51,16 @@ struct _GstStatsTracer {
   GstTracer 	 parent;
 
   /*< private >*/
-  guint num_elements, num_pads;
+  guint id;                             /* finds the per thread counters */
+  guint num_elements, num_pads;         /* ATOMIC */
+  GPtrArray *shards;                    /* per thread counters, object lock */
 };
 
 struct _GstStatsTracerClass {
   GstTracerClass parent_class;
 
-  /* signals */
+  /* actions */
+  GstStructure * (*get_element_times)   (GstStatsTracer *tracer);
 };
 
 G_GNUC_INTERNAL GType gst_stats_tracer_get_type (void);
@@ -29,6 +29,7 @@
 #include "gstrusage.h"
 #include "gststats.h"
 #include "gstleaks.h"
+#include "gstmetrics.h"
 #include "gstfactories.h"
 
 static gboolean
@@ -51,6 +52,8 @@ plugin_init (GstPlugin * plugin)
   if (!gst_tracer_register (plugin, "factories",
           gst_factories_tracer_get_type ()))
     return FALSE;
+  if (!gst_tracer_register (plugin, "metrics", gst_metrics_tracer_get_type ()))
+    return FALSE;
   return TRUE;
 }
 
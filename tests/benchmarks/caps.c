@@ -40,12 +40,21 @@
   "rate = (int) [ 1, MAX ], " \
   "channels = (int) [ 1, MAX ]"
 
+#define GST_AUDIO_FILTER_CAPS \
+  "audio/x-raw, " \
+  "format = (string) { F32LE, S16LE }, " \
+  "rate = (int) [ 8000, 96000 ], " \
+  "channels = (int) [ 1, 8 ]; " \
+  "audio/x-raw, " \
+  "format = (string) { F64LE, S32LE }, " \
+  "rate = (int) [ 8000, 192000 ], " \
+  "channels = (int) [ 1, 2 ]"
 
 gint
 main (gint argc, gchar * argv[])
 {
   GstCaps **capses;
-  GstCaps *protocaps;
+  GstCaps *protocaps, *filtercaps, *result;
   GstClockTime start, end;
   gint i;
 
@@ -69,6 +78,28 @@ main (gint argc, gchar * argv[])
       GST_TIME_ARGS (end - start), i);
 
   g_free (capses);
+
+  /* the same intersection over and over, like when negotiating many
+   * identical pipelines. Run with GST_CAPS_CACHE=0 to compare. */
+  filtercaps = gst_caps_from_string (GST_AUDIO_FILTER_CAPS);
+
+  start = gst_util_get_timestamp ();
+  for (i = 0; i < NUM_CAPS; i++) {
+    result = gst_caps_intersect (protocaps, filtercaps);
+    gst_caps_unref (result);
+  }
+  end = gst_util_get_timestamp ();
+  g_print ("%" GST_TIME_FORMAT " - intersecting %d caps\n",
+      GST_TIME_ARGS (end - start), i);
+
+  start = gst_util_get_timestamp ();
+  for (i = 0; i < NUM_CAPS; i++)
+    gst_caps_is_subset (filtercaps, protocaps);
+  end = gst_util_get_timestamp ();
+  g_print ("%" GST_TIME_FORMAT " - checking %d caps for subset\n",
+      GST_TIME_ARGS (end - start), i);
+
+  gst_caps_unref (filtercaps);
   gst_caps_unref (protocaps);
 
   return 0;
@@ -22,6 +22,7 @@
 #include <gst/gst.h>
 
 #define BUFFER_COUNT (1000)
+#define SORT_COUNT (100)
 
 gint
 main (gint argc, gchar * argv[])
@@ -93,6 +94,20 @@ main (gint argc, gchar * argv[])
   g_print ("%" GST_TIME_FORMAT " - creating and linking %u elements\n",
       GST_TIME_ARGS (end - start), i);
 
+  start = gst_util_get_timestamp ();
+  for (j = 0; j < SORT_COUNT; j++) {
+    GstIterator *it = gst_bin_iterate_sorted (GST_BIN (pipeline));
+    GValue item = { 0, };
+
+    while (gst_iterator_next (it, &item) == GST_ITERATOR_OK)
+      g_value_reset (&item);
+    g_value_unset (&item);
+    gst_iterator_free (it);
+  }
+  end = gst_util_get_timestamp ();
+  g_print ("%" GST_TIME_FORMAT " - sorting %u elements %u times\n",
+      GST_TIME_ARGS (end - start), i + 1, SORT_COUNT);
+
   start = gst_util_get_timestamp ();
   if (gst_element_set_state (pipeline,
           GST_STATE_PLAYING) == GST_STATE_CHANGE_FAILURE)
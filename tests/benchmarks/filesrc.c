@@ -0,0 +1,115 @@
+/* GStreamer
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* Reads a file with filesrc ! fakesink once for every filesrc io-mode and
+ * prints the throughput of each. The file is read once up front so all
+ * modes run against a warm page cache; drop the caches between runs to
+ * measure the device instead. */
+
+#include <stdlib.h>
+#include <gst/gst.h>
+#include <glib/gstdio.h>
+
+static GstClockTime
+run_pipeline (const gchar * location, guint blocksize, gint io_mode)
+{
+  GstElement *pipeline, *src, *sink;
+  GstMessage *msg;
+  GstClockTime start, end;
+
+  pipeline = gst_pipeline_new (NULL);
+  src = gst_element_factory_make ("filesrc", NULL);
+  sink = gst_element_factory_make ("fakesink", NULL);
+  g_assert (src && sink);
+
+  g_object_set (src, "location", location, "blocksize", blocksize,
+      "io-mode", io_mode, NULL);
+  g_object_set (sink, "sync", FALSE, NULL);
+
+  gst_bin_add_many (GST_BIN (pipeline), src, sink, NULL);
+  gst_element_link (src, sink);
+
+  start = gst_util_get_timestamp ();
+  gst_element_set_state (pipeline, GST_STATE_PLAYING);
+
+  msg = gst_bus_poll (GST_ELEMENT_BUS (pipeline),
+      GST_MESSAGE_EOS | GST_MESSAGE_ERROR, GST_CLOCK_TIME_NONE);
+  end = gst_util_get_timestamp ();
+
+  if (GST_MESSAGE_TYPE (msg) == GST_MESSAGE_ERROR)
+    g_printerr ("error reading %s\n", location);
+  gst_message_unref (msg);
+
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (pipeline);
+
+  return end - start;
+}
+
+gint
+main (gint argc, gchar * argv[])
+{
+  GstElement *src;
+  GParamSpec *pspec;
+  GEnumClass *klass;
+  guint blocksize = 4096;
+  guint64 size;
+  guint i;
+
+  gst_init (&argc, &argv);
+
+  if (argc < 2 || argc > 3) {
+    g_print ("Usage: %s FILE [BLOCKSIZE]\n", argv[0]);
+    return 1;
+  }
+
+  if (argc == 3)
+    blocksize = atoi (argv[2]);
+
+  {
+    GStatBuf st;
+
+    if (g_stat (argv[1], &st) < 0) {
+      g_printerr ("can't stat %s\n", argv[1]);
+      return 1;
+    }
+    size = st.st_size;
+  }
+
+  src = gst_element_factory_make ("filesrc", NULL);
+  g_assert (src);
+  pspec = g_object_class_find_property (G_OBJECT_GET_CLASS (src), "io-mode");
+  klass = G_PARAM_SPEC_ENUM (pspec)->enum_class;
+
+  /* warm up the page cache */
+  run_pipeline (argv[1], blocksize, klass->values[0].value);
+
+  for (i = 0; i < klass->n_values; i++) {
+    GstClockTime elapsed;
+
+    elapsed = run_pipeline (argv[1], blocksize, klass->values[i].value);
+
+    g_print ("%-10s %" GST_TIME_FORMAT " %8.1f MB/s\n",
+        klass->values[i].value_nick, GST_TIME_ARGS (elapsed),
+        (gdouble) size / (1024 * 1024) / ((gdouble) elapsed / GST_SECOND));
+  }
+
+  gst_object_unref (src);
+
+  return 0;
+}
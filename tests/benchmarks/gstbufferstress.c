@@ -17,14 +17,25 @@
  * Boston, MA 02110-1301, USA.
  */
 
+/* Creates and frees buffers from several threads at once. With a size,
+ * buffers with memory from the default allocator are created. In cross
+ * mode each thread hands its buffers to the next thread to be freed, which
+ * makes the freed slices migrate between threads. Run with
+ * GST_MAGAZINE_CACHE=0 to compare against plain g_slice allocations. */
+
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <gst/gst.h>
 #include "gst/glib-compat-private.h"
 
 #define MAX_THREADS  1000
 
 static guint64 nbbuffers;
+static gsize bufsize;
+static gboolean cross;
+static gint num_threads;
+static GstAtomicQueue *queues[MAX_THREADS];
 static GMutex mutex;
 
 
@@ -44,7 +55,17 @@ run_test (void *user_data)
   g_assert (nbbuffers > 0);
 
   for (nb = nbbuffers; nb; nb--) {
-    buf = gst_buffer_new ();
+    if (bufsize > 0)
+      buf = gst_buffer_new_allocate (NULL, bufsize, NULL);
+    else
+      buf = gst_buffer_new ();
+
+    if (cross) {
+      gst_atomic_queue_push (queues[(threadid + 1) % num_threads], buf);
+      buf = gst_atomic_queue_pop (queues[threadid]);
+      if (buf == NULL)
+        continue;
+    }
     gst_buffer_unref (buf);
   }
 
@@ -62,7 +83,6 @@ gint
 main (gint argc, gchar * argv[])
 {
   GThread *threads[MAX_THREADS];
-  gint num_threads;
   gint t;
   GstBuffer *tmp;
   GstClockTime start, end;
@@ -70,13 +90,17 @@ main (gint argc, gchar * argv[])
   gst_init (&argc, &argv);
   g_mutex_init (&mutex);
 
-  if (argc != 3) {
-    g_print ("usage: %s <num_threads> <nbbuffers>\n", argv[0]);
+  if (argc < 3 || argc > 5 || (argc == 5 && strcmp (argv[4], "cross"))) {
+    g_print ("usage: %s <num_threads> <nbbuffers> [<size> [cross]]\n",
+        argv[0]);
     exit (-1);
   }
 
   num_threads = atoi (argv[1]);
   nbbuffers = atoi (argv[2]);
+  if (argc >= 4)
+    bufsize = atoi (argv[3]);
+  cross = argc == 5;
 
   if (num_threads <= 0 || num_threads > MAX_THREADS) {
     g_print ("number of threads must be between 0 and %d\n", MAX_THREADS);
@@ -92,6 +116,9 @@ main (gint argc, gchar * argv[])
   /* Let's just make sure the GstBufferClass is loaded ... */
   tmp = gst_buffer_new ();
 
+  for (t = 0; cross && t < num_threads; t++)
+    queues[t] = gst_atomic_queue_new (1024);
+
   printf ("main(): Creating %d threads.\n", num_threads);
   for (t = 0; t < num_threads; t++) {
     GError *error = NULL;
@@ -122,6 +149,13 @@ main (gint argc, gchar * argv[])
       GST_TIME_ARGS ((end - start) / (num_threads * nbbuffers)),
       num_threads * nbbuffers);
 
+  for (t = 0; cross && t < num_threads; t++) {
+    GstBuffer *buf;
+
+    while ((buf = gst_atomic_queue_pop (queues[t])))
+      gst_buffer_unref (buf);
+    gst_atomic_queue_unref (queues[t]);
+  }
 
   gst_buffer_unref (tmp);
 
@@ -19,13 +19,20 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <gst/gst.h>
 #include <gst/glib-compat-private.h>
+#ifdef G_OS_UNIX
+#include <sys/resource.h>
+#endif
 
 #define MAX_THREADS  100
+#define ASYNC_INTERVAL (10 * GST_MSECOND)
 
 static gboolean running = TRUE;
 static gint count = 0;
+static gint64 total_late = 0;
+static gint64 max_late = 0;
 
 static void *
 run_test (void *user_data)
@@ -43,6 +50,82 @@ run_test (void *user_data)
   return NULL;
 }
 
+static gboolean
+async_cb (GstClock * clock, GstClockTime time, GstClockID id,
+    gpointer user_data)
+{
+  gint64 late;
+
+  late = GST_CLOCK_DIFF (time, gst_clock_get_time (clock));
+  g_atomic_int_inc (&count);
+
+  /* only ever called from the clock thread */
+  total_late += late;
+  max_late = MAX (max_late, late);
+
+  return TRUE;
+}
+
+/* Schedules @num_entries periodic async entries spread evenly over
+ * ASYNC_INTERVAL and reports how many callbacks were fired, how late they
+ * were and how much CPU time the process used meanwhile */
+static gint
+run_async_test (gint num_entries, GstClockTime timer_slack)
+{
+  GstClock *clock;
+  GstClockID *ids;
+  GstClockTime base;
+  gint i;
+#ifdef G_OS_UNIX
+  struct rusage start, end;
+#endif
+
+  clock = g_object_new (GST_TYPE_SYSTEM_CLOCK, "timer-slack", timer_slack,
+      NULL);
+  gst_object_ref_sink (clock);
+  ids = g_new (GstClockID, num_entries);
+
+  base = gst_clock_get_time (clock) + 100 * GST_MSECOND;
+  for (i = 0; i < num_entries; i++) {
+    ids[i] = gst_clock_new_periodic_id (clock,
+        base + ASYNC_INTERVAL * i / num_entries, ASYNC_INTERVAL);
+    gst_clock_id_wait_async (ids[i], async_cb, NULL, NULL);
+  }
+  printf ("main(): Scheduled %d entries.\n", num_entries);
+
+#ifdef G_OS_UNIX
+  getrusage (RUSAGE_SELF, &start);
+#endif
+
+  /* run for 5 seconds */
+  g_usleep (G_USEC_PER_SEC * 5);
+
+#ifdef G_OS_UNIX
+  getrusage (RUSAGE_SELF, &end);
+#endif
+
+  for (i = 0; i < num_entries; i++) {
+    gst_clock_id_unschedule (ids[i]);
+    gst_clock_id_unref (ids[i]);
+  }
+  g_free (ids);
+  gst_object_unref (clock);
+
+  g_print ("fired %d callbacks, average late %" G_GINT64_FORMAT " ns, "
+      "max late %" G_GINT64_FORMAT " ns\n", count,
+      count ? total_late / count : 0, max_late);
+#ifdef G_OS_UNIX
+  g_print ("cpu time %.3f s user, %.3f s system, %ld context switches\n",
+      (end.ru_utime.tv_sec - start.ru_utime.tv_sec) +
+      (end.ru_utime.tv_usec - start.ru_utime.tv_usec) / 1e6,
+      (end.ru_stime.tv_sec - start.ru_stime.tv_sec) +
+      (end.ru_stime.tv_usec - start.ru_stime.tv_usec) / 1e6,
+      (end.ru_nvcsw - start.ru_nvcsw) + (end.ru_nivcsw - start.ru_nivcsw));
+#endif
+
+  return 0;
+}
+
 gint
 main (gint argc, gchar * argv[])
 {
@@ -53,8 +136,23 @@ main (gint argc, gchar * argv[])
 
   gst_init (&argc, &argv);
 
+  if (argc >= 3 && argc <= 4 && !strcmp (argv[1], "async")) {
+    gint num_entries = atoi (argv[2]);
+    GstClockTime timer_slack = 0;
+
+    if (num_entries <= 0) {
+      g_print ("number of entries must be positive\n");
+      exit (-2);
+    }
+    if (argc == 4)
+      timer_slack = g_ascii_strtoull (argv[3], NULL, 10) * GST_USECOND;
+
+    return run_async_test (num_entries, timer_slack);
+  }
+
   if (argc != 2) {
     g_print ("usage: %s <num_threads>\n", argv[0]);
+    g_print ("       %s async <num_entries> [<timer_slack_us>]\n", argv[0]);
     exit (-1);
   }
 
@@ -20,9 +20,17 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <gst/gst.h>
 #include "gst/glib-compat-private.h"
 
+#ifdef G_OS_UNIX
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#endif
+
 static GstPoll *set;
 static GList *fds = NULL;
 static GMutex fdlock;
@@ -136,6 +144,101 @@ run_test (void *threadid)
   return NULL;
 }
 
+#ifdef G_OS_UNIX
+#define SCALING_WAITS 20000
+
+/* Registers @n_fds pipes and measures a wait where a single one of them is
+ * readable, once with gst_poll_wait() and once with a plain poll() over all
+ * of them for comparison. */
+static void
+measure_scaling (guint n_fds)
+{
+  GstPoll *fdset;
+  GstPollFD *pfds;
+  struct pollfd *raw;
+  gint *pipes;
+  GstClockTime start, gst_time, poll_time;
+  guint i;
+  gchar c = 'x';
+
+  fdset = gst_poll_new (FALSE);
+  pfds = g_new (GstPollFD, n_fds);
+  raw = g_new (struct pollfd, n_fds);
+  pipes = g_new (gint, 2 * n_fds);
+
+  for (i = 0; i < n_fds; i++) {
+    if (pipe (&pipes[2 * i]) < 0)
+      g_error ("pipe() failed: %s", g_strerror (errno));
+
+    gst_poll_fd_init (&pfds[i]);
+    pfds[i].fd = pipes[2 * i];
+    gst_poll_add_fd (fdset, &pfds[i]);
+    gst_poll_fd_ctl_read (fdset, &pfds[i], TRUE);
+
+    raw[i].fd = pipes[2 * i];
+    raw[i].events = POLLIN;
+  }
+
+  start = gst_util_get_timestamp ();
+  for (i = 0; i < SCALING_WAITS; i++) {
+    guint active = i % n_fds;
+
+    if (write (pipes[2 * active + 1], &c, 1) != 1)
+      g_error ("write() failed");
+    if (gst_poll_wait (fdset, GST_CLOCK_TIME_NONE) != 1)
+      g_error ("expected one active fd");
+    if (read (pipes[2 * active], &c, 1) != 1)
+      g_error ("read() failed");
+  }
+  gst_time = gst_util_get_timestamp () - start;
+
+  start = gst_util_get_timestamp ();
+  for (i = 0; i < SCALING_WAITS; i++) {
+    guint active = i % n_fds;
+
+    if (write (pipes[2 * active + 1], &c, 1) != 1)
+      g_error ("write() failed");
+    if (poll (raw, n_fds, -1) != 1)
+      g_error ("expected one active fd");
+    if (read (pipes[2 * active], &c, 1) != 1)
+      g_error ("read() failed");
+  }
+  poll_time = gst_util_get_timestamp () - start;
+
+  g_print ("%6u fds: gst_poll_wait %8.3f us/wait, poll %8.3f us/wait\n",
+      n_fds, (gdouble) gst_time / GST_USECOND / SCALING_WAITS,
+      (gdouble) poll_time / GST_USECOND / SCALING_WAITS);
+
+  gst_poll_free (fdset);
+  for (i = 0; i < n_fds; i++) {
+    close (pipes[2 * i]);
+    close (pipes[2 * i + 1]);
+  }
+  g_free (pipes);
+  g_free (raw);
+  g_free (pfds);
+}
+
+/* prints the cost of a wait with one active fd as the set grows */
+static void
+run_scaling (void)
+{
+  struct rlimit limit;
+  guint n_fds, max_fds = 1024;
+
+  /* each pipe takes two fds, get as many as we're allowed */
+  if (getrlimit (RLIMIT_NOFILE, &limit) == 0) {
+    limit.rlim_cur = limit.rlim_max;
+    setrlimit (RLIMIT_NOFILE, &limit);
+    getrlimit (RLIMIT_NOFILE, &limit);
+    max_fds = MIN (limit.rlim_cur, 65536);
+  }
+
+  for (n_fds = 1; 2 * n_fds + 64 <= max_fds; n_fds *= 4)
+    measure_scaling (n_fds);
+}
+#endif
+
 gint
 main (gint argc, gchar * argv[])
 {
@@ -150,9 +253,19 @@ main (gint argc, gchar * argv[])
 
   if (argc != 2) {
     g_print ("usage: %s <num_threads>\n", argv[0]);
+#ifdef G_OS_UNIX
+    g_print ("       %s scaling\n", argv[0]);
+#endif
     exit (-1);
   }
 
+#ifdef G_OS_UNIX
+  if (strcmp (argv[1], "scaling") == 0) {
+    run_scaling ();
+    return 0;
+  }
+#endif
+
   num_threads = atoi (argv[1]);
 
   set = gst_poll_new (TRUE);
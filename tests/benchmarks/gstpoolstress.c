@@ -23,6 +23,75 @@
 #include "gst/glib-compat-private.h"
 
 #define BUFFER_SIZE (1400)
+#define MAX_THREADS 64
+
+static GstBufferPool *contended_pool;
+static guint64 contended_nbuffers;
+
+static void
+print_stats (GstBufferPool * pool)
+{
+  GstStructure *stats;
+  gchar *str;
+
+  stats = gst_buffer_pool_get_stats (pool);
+  str = gst_structure_to_string (stats);
+  g_print ("*** %s\n", str);
+  g_free (str);
+  gst_structure_free (stats);
+}
+
+static gpointer
+run_contended (gpointer user_data)
+{
+  GstBuffer *buf;
+  guint64 i;
+
+  for (i = 0; i < contended_nbuffers; i++) {
+    if (gst_buffer_pool_acquire_buffer (contended_pool, &buf,
+            NULL) != GST_FLOW_OK)
+      break;
+    gst_buffer_unref (buf);
+  }
+  return NULL;
+}
+
+/* @num_threads threads acquire and release buffers from a pool with half as
+ * many buffers, so that they have to wait for each other */
+static void
+measure_contended (guint num_threads, guint64 nbuffers)
+{
+  GThread *threads[MAX_THREADS];
+  GstClockTime start, end;
+  GstStructure *conf;
+  guint t;
+
+  contended_pool = gst_buffer_pool_new ();
+  contended_nbuffers = nbuffers;
+
+  conf = gst_buffer_pool_get_config (contended_pool);
+  gst_buffer_pool_config_set_params (conf, NULL, BUFFER_SIZE, 0,
+      MAX (num_threads / 2, 1));
+  gst_buffer_pool_set_config (contended_pool, conf);
+  gst_buffer_pool_set_active (contended_pool, TRUE);
+
+  start = gst_util_get_timestamp ();
+  for (t = 0; t < num_threads; t++)
+    threads[t] = g_thread_new ("poolstress", run_contended, NULL);
+  for (t = 0; t < num_threads; t++)
+    g_thread_join (threads[t]);
+  end = gst_util_get_timestamp ();
+
+  g_print ("*** total %" GST_TIME_FORMAT " - average %" GST_TIME_FORMAT
+      "  - Done acquiring %" G_GUINT64_FORMAT " buffers from %u threads\n",
+      GST_TIME_ARGS (end - start),
+      GST_TIME_ARGS ((end - start) / (nbuffers * num_threads)),
+      nbuffers * num_threads, num_threads);
+  print_stats (contended_pool);
+
+  gst_buffer_pool_set_active (contended_pool, FALSE);
+  gst_object_unref (contended_pool);
+}
 
 gint
 main (gint argc, gchar * argv[])
@@ -34,15 +103,23 @@ main (gint argc, gchar * argv[])
   GstClockTimeDiff dur1, dur2;
   guint64 nbuffers;
   GstStructure *conf;
+  gint num_threads = 0;
 
   gst_init (&argc, &argv);
 
-  if (argc != 2) {
-    g_print ("usage: %s <nbuffers>\n", argv[0]);
+  if (argc < 2 || argc > 3) {
+    g_print ("usage: %s <nbuffers> [<num_threads>]\n", argv[0]);
     exit (-1);
   }
 
   nbuffers = atoi (argv[1]);
+  if (argc == 3)
+    num_threads = atoi (argv[2]);
+
+  if (num_threads < 0 || num_threads > MAX_THREADS) {
+    g_print ("number of threads must be between 0 and %d\n", MAX_THREADS);
+    exit (-2);
+  }
 
   if (nbuffers <= 0) {
     g_print ("number of buffers must be greater than 0\n");
@@ -86,9 +163,13 @@ main (gint argc, gchar * argv[])
       GST_TIME_ARGS (dur2), GST_TIME_ARGS (dur2 / nbuffers), nbuffers);
 
   g_print ("*** speedup %6.4lf\n", ((gdouble) dur1 / (gdouble) dur2));
+  print_stats (pool);
 
   gst_buffer_pool_set_active (pool, FALSE);
   gst_object_unref (pool);
 
+  if (num_threads > 0)
+    measure_contended (num_threads, nbuffers);
+
   return 0;
 }
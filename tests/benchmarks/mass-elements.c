@@ -22,6 +22,7 @@
 
 #define IDENTITY_COUNT (1000)
 #define BUFFER_COUNT (1000)
+#define SORT_COUNT (100)
 #define SRC_ELEMENT "fakesrc"
 #define SINK_ELEMENT "fakesink"
 
@@ -31,7 +32,7 @@ main (gint argc, gchar * argv[])
 {
   GstMessage *msg;
   GstElement *pipeline, *src, *sink, *current, *last;
-  guint i, buffers = BUFFER_COUNT, identities = IDENTITY_COUNT;
+  guint i, j, buffers = BUFFER_COUNT, identities = IDENTITY_COUNT;
   GstClockTime start, end;
   const gchar *src_name = SRC_ELEMENT, *sink_name = SINK_ELEMENT;
 
@@ -81,6 +82,20 @@ main (gint argc, gchar * argv[])
   g_print ("%" GST_TIME_FORMAT " - creating %u identity elements\n",
       GST_TIME_ARGS (end - start), identities);
 
+  start = gst_util_get_timestamp ();
+  for (j = 0; j < SORT_COUNT; j++) {
+    GstIterator *it = gst_bin_iterate_sorted (GST_BIN (pipeline));
+    GValue item = { 0, };
+
+    while (gst_iterator_next (it, &item) == GST_ITERATOR_OK)
+      g_value_reset (&item);
+    g_value_unset (&item);
+    gst_iterator_free (it);
+  }
+  end = gst_util_get_timestamp ();
+  g_print ("%" GST_TIME_FORMAT " - sorting %u elements %u times\n",
+      GST_TIME_ARGS (end - start), identities + 2, SORT_COUNT);
+
   start = gst_util_get_timestamp ();
   if (gst_element_set_state (pipeline,
           GST_STATE_PLAYING) == GST_STATE_CHANGE_FAILURE)
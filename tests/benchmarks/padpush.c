@@ -0,0 +1,134 @@
+/* GStreamer
+ *
+ * padpush.c: benchmark for pushing buffers from one pad to another
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* This benchmark pushes the same buffer over a linked pair of pads with a
+ * chain function that does nothing, once without any probes and once with a
+ * buffer probe on each pad, and prints how long a push takes. The difference
+ * between the two is the cost of the slow path in gst_pad_push(). */
+
+#include <stdlib.h>
+#include <gst/gst.h>
+
+static GstFlowReturn
+chain_func (GstPad * pad, GstObject * parent, GstBuffer * buffer)
+{
+  gst_buffer_unref (buffer);
+  return GST_FLOW_OK;
+}
+
+static gboolean
+event_func (GstPad * pad, GstObject * parent, GstEvent * event)
+{
+  gst_event_unref (event);
+  return TRUE;
+}
+
+static GstPadProbeReturn
+probe_func (GstPad * pad, GstPadProbeInfo * info, gpointer user_data)
+{
+  return GST_PAD_PROBE_OK;
+}
+
+static GstClockTime
+run_test (guint nbuffers, gboolean probes)
+{
+  GstPad *srcpad, *sinkpad;
+  GstClockTime start, end;
+  GstSegment segment;
+  GstBuffer *buf;
+  GstCaps *caps;
+  guint i;
+
+  srcpad = gst_pad_new ("src", GST_PAD_SRC);
+  sinkpad = gst_pad_new ("sink", GST_PAD_SINK);
+  gst_pad_set_chain_function (sinkpad, chain_func);
+  gst_pad_set_event_function (sinkpad, event_func);
+
+  if (gst_pad_link (srcpad, sinkpad) != GST_PAD_LINK_OK) {
+    g_print ("failed to link pads\n");
+    exit (-2);
+  }
+  gst_pad_set_active (sinkpad, TRUE);
+  gst_pad_set_active (srcpad, TRUE);
+
+  if (probes) {
+    gst_pad_add_probe (srcpad, GST_PAD_PROBE_TYPE_BUFFER, probe_func, NULL,
+        NULL);
+    gst_pad_add_probe (sinkpad, GST_PAD_PROBE_TYPE_BUFFER, probe_func, NULL,
+        NULL);
+  }
+
+  /* send the sticky events first, otherwise every push would go through
+   * check_sticky() and measure the slow path in both cases */
+  gst_pad_push_event (srcpad, gst_event_new_stream_start ("padpush"));
+  caps = gst_caps_new_empty_simple ("test/data");
+  gst_pad_push_event (srcpad, gst_event_new_caps (caps));
+  gst_caps_unref (caps);
+  gst_segment_init (&segment, GST_FORMAT_BYTES);
+  gst_pad_push_event (srcpad, gst_event_new_segment (&segment));
+
+  buf = gst_buffer_new ();
+
+  start = gst_util_get_timestamp ();
+  for (i = 0; i < nbuffers; i++)
+    gst_pad_push (srcpad, gst_buffer_ref (buf));
+  end = gst_util_get_timestamp ();
+
+  gst_buffer_unref (buf);
+
+  gst_pad_set_active (srcpad, FALSE);
+  gst_pad_set_active (sinkpad, FALSE);
+  gst_object_unref (srcpad);
+  gst_object_unref (sinkpad);
+
+  return end - start;
+}
+
+gint
+main (gint argc, gchar * argv[])
+{
+  GstClockTime fast, slow;
+  gint nbuffers;
+
+  gst_init (&argc, &argv);
+
+  if (argc != 2) {
+    g_print ("usage: %s <nbuffers>\n", argv[0]);
+    exit (-1);
+  }
+
+  nbuffers = atoi (argv[1]);
+  if (nbuffers <= 0) {
+    g_print ("number of buffers must be greater than 0\n");
+    exit (-3);
+  }
+
+  fast = run_test (nbuffers, FALSE);
+  slow = run_test (nbuffers, TRUE);
+
+  g_print ("*** no probes  : total %" GST_TIME_FORMAT " - average %"
+      GST_TIME_FORMAT "\n", GST_TIME_ARGS (fast),
+      GST_TIME_ARGS (fast / nbuffers));
+  g_print ("*** with probes: total %" GST_TIME_FORMAT " - average %"
+      GST_TIME_FORMAT " - ratio %6.4lf\n", GST_TIME_ARGS (slow),
+      GST_TIME_ARGS (slow / nbuffers), (gdouble) slow / (gdouble) fast);
+
+  return 0;
+}
@@ -0,0 +1,111 @@
+/* GStreamer
+ *
+ * queuebatch.c: benchmark for pushing queued buffers as buffer lists
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* This benchmark runs fakesrc ! (multi)queue ! fakesink to EOS with
+ * increasing values of the max-batch-buffers property and prints how long it
+ * takes to get all buffers through the queue.
+ */
+
+#include <stdlib.h>
+#include <gst/gst.h>
+
+static const guint batch_sizes[] = { 1, 4, 16, 64 };
+
+static GstClockTime
+run_pipeline (const gchar * queue, guint nbuffers, guint batch)
+{
+  GstElement *pipeline;
+  GstClockTime start, end;
+  GstMessage *msg;
+  GstBus *bus;
+  GError *err = NULL;
+  gchar *desc;
+
+  desc = g_strdup_printf ("fakesrc num-buffers=%u ! %s max-batch-buffers=%u ! "
+      "fakesink sync=false", nbuffers, queue, batch);
+  pipeline = gst_parse_launch (desc, &err);
+  g_free (desc);
+
+  if (pipeline == NULL) {
+    g_print ("failed to create pipeline: %s\n", err->message);
+    g_clear_error (&err);
+    exit (-2);
+  }
+
+  bus = gst_element_get_bus (pipeline);
+
+  start = gst_util_get_timestamp ();
+  gst_element_set_state (pipeline, GST_STATE_PLAYING);
+  msg = gst_bus_poll (bus, GST_MESSAGE_EOS | GST_MESSAGE_ERROR, -1);
+  end = gst_util_get_timestamp ();
+
+  if (GST_MESSAGE_TYPE (msg) == GST_MESSAGE_ERROR)
+    g_print ("pipeline posted an error\n");
+  gst_message_unref (msg);
+
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (bus);
+  gst_object_unref (pipeline);
+
+  return end - start;
+}
+
+static void
+measure (const gchar * queue, guint nbuffers)
+{
+  GstClockTime base = 0;
+  guint i;
+
+  for (i = 0; i < G_N_ELEMENTS (batch_sizes); i++) {
+    GstClockTime dur = run_pipeline (queue, nbuffers, batch_sizes[i]);
+
+    if (i == 0)
+      base = dur;
+
+    g_print ("*** %-10s batch %3u: total %" GST_TIME_FORMAT " - average %"
+        GST_TIME_FORMAT " - speedup %6.4lf\n", queue, batch_sizes[i],
+        GST_TIME_ARGS (dur), GST_TIME_ARGS (dur / nbuffers),
+        (gdouble) base / (gdouble) dur);
+  }
+}
+
+gint
+main (gint argc, gchar * argv[])
+{
+  gint nbuffers;
+
+  gst_init (&argc, &argv);
+
+  if (argc != 2) {
+    g_print ("usage: %s <nbuffers>\n", argv[0]);
+    exit (-1);
+  }
+
+  nbuffers = atoi (argv[1]);
+  if (nbuffers <= 0) {
+    g_print ("number of buffers must be greater than 0\n");
+    exit (-3);
+  }
+
+  measure ("queue", nbuffers);
+  measure ("multiqueue", nbuffers);
+
+  return 0;
+}
@@ -26,6 +26,11 @@
  * grep "log_gst_structure" trace.log >tracerserialize.gststructure.log
  * grep "log_g_variant" trace.log >tracerserialize.gvariant.log
  *
+ * to compare the GstTracerRecord text output with the binary one run:
+ *
+ * GST_DEBUG="GST_TRACER:7" GST_DEBUG_FILE=trace.log ./tracerserialize
+ * GST_TRACER_FILE=trace.bin ./tracerserialize
+ *
  */
 
 #include <gst/gst.h>
@@ -77,10 +82,27 @@ log_g_variant (const gchar * format, ...)
   va_end (var_args);
 }
 
+static GstTracerRecord *
+new_tracer_record (void)
+{
+  return gst_tracer_record_new ("name.class",
+      "ts", GST_TYPE_STRUCTURE, gst_structure_new ("value",
+          "type", G_TYPE_GTYPE, G_TYPE_UINT64, NULL),
+      "index", GST_TYPE_STRUCTURE, gst_structure_new ("value",
+          "type", G_TYPE_GTYPE, G_TYPE_UINT, NULL),
+      "test", GST_TYPE_STRUCTURE, gst_structure_new ("value",
+          "type", G_TYPE_GTYPE, G_TYPE_STRING, NULL),
+      "bool", GST_TYPE_STRUCTURE, gst_structure_new ("value",
+          "type", G_TYPE_GTYPE, G_TYPE_BOOLEAN, NULL),
+      "flag", GST_TYPE_STRUCTURE, gst_structure_new ("value",
+          "type", G_TYPE_GTYPE, GST_TYPE_PAD_DIRECTION, NULL), NULL);
+}
+
 gint
 main (gint argc, gchar * argv[])
 {
   GstClockTime start, end;
+  GstTracerRecord *tr;
   gint i;
 
   gst_init (&argc, &argv);
@@ -115,5 +137,16 @@ main (gint argc, gchar * argv[])
   end = gst_util_get_timestamp ();
   g_print ("%" GST_TIME_FORMAT ": GVariant\n", GST_TIME_ARGS (end - start));
 
+  tr = new_tracer_record ();
+  start = gst_util_get_timestamp ();
+  for (i = 0; i < NUM_LOOPS; i++) {
+    gst_tracer_record_log (tr, (guint64) 0, 10, "hallo", TRUE, GST_PAD_SRC);
+  }
+  end = gst_util_get_timestamp ();
+  g_print ("%" GST_TIME_FORMAT ": GstTracerRecord (%s)\n",
+      GST_TIME_ARGS (end - start),
+      g_getenv ("GST_TRACER_FILE") ? "binary" : "text");
+  gst_object_unref (tr);
+
   return 0;
 }
@@ -30,7 +30,9 @@
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <errno.h>
+#include <string.h>
 
+#include <glib/gstdio.h>
 #include <gst/check/gstcheck.h>
 
 static gboolean have_eos = FALSE;
@@ -202,6 +204,77 @@ GST_START_TEST (test_seeking)
 
 GST_END_TEST;
 
+/* fdsink copies file ranges from fdsrc and filesrc without reading them,
+ * the output has to be identical to the input either way */
+static void
+check_copy_to_fdsink (const gchar * src_desc)
+{
+  GstElement *pipeline;
+  GstBus *bus;
+  GstMessage *msg;
+  gchar *tmp_filename, *desc;
+  gchar *in_data, *out_data;
+  gsize in_size, out_size;
+  gint out_fd;
+
+  out_fd = g_file_open_tmp ("fdsink-XXXXXX", &tmp_filename, NULL);
+  fail_if (out_fd < 0);
+
+  desc = g_strdup_printf ("%s blocksize=1000 ! queue ! fdsink fd=%d",
+      src_desc, out_fd);
+  pipeline = gst_parse_launch (desc, NULL);
+  fail_unless (pipeline != NULL);
+  g_free (desc);
+
+  fail_unless (gst_element_set_state (pipeline,
+          GST_STATE_PLAYING) != GST_STATE_CHANGE_FAILURE);
+
+  bus = gst_element_get_bus (pipeline);
+  msg = gst_bus_timed_pop_filtered (bus, GST_CLOCK_TIME_NONE,
+      GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+  fail_unless_equals_int (GST_MESSAGE_TYPE (msg), GST_MESSAGE_EOS);
+  gst_message_unref (msg);
+  gst_object_unref (bus);
+
+  fail_unless (gst_element_set_state (pipeline,
+          GST_STATE_NULL) == GST_STATE_CHANGE_SUCCESS);
+  gst_object_unref (pipeline);
+  close (out_fd);
+
+  fail_unless (g_file_get_contents (TESTFILE, &in_data, &in_size, NULL));
+  fail_unless (g_file_get_contents (tmp_filename, &out_data, &out_size, NULL));
+  fail_unless_equals_uint64 (out_size, in_size);
+  fail_unless (memcmp (in_data, out_data, in_size) == 0);
+
+  g_free (in_data);
+  g_free (out_data);
+  g_remove (tmp_filename);
+  g_free (tmp_filename);
+}
+
+GST_START_TEST (test_fd_range_fdsrc)
+{
+  gchar *src_desc;
+  gint in_fd;
+
+  fail_if ((in_fd = open (TESTFILE, O_RDONLY)) < 0);
+  src_desc = g_strdup_printf ("fdsrc fd=%d", in_fd);
+  check_copy_to_fdsink (src_desc);
+  g_free (src_desc);
+  close (in_fd);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_fd_range_filesrc)
+{
+  check_copy_to_fdsink ("filesrc location=" TESTFILE);
+  /* an explicit io-mode provides the contents instead */
+  check_copy_to_fdsink ("filesrc io-mode=mmap location=" TESTFILE);
+}
+
+GST_END_TEST;
+
 static Suite *
 fdsrc_suite (void)
 {
@@ -212,6 +285,8 @@ fdsrc_suite (void)
   tcase_add_test (tc_chain, test_num_buffers);
   tcase_add_test (tc_chain, test_nonseeking);
   tcase_add_test (tc_chain, test_seeking);
+  tcase_add_test (tc_chain, test_fd_range_fdsrc);
+  tcase_add_test (tc_chain, test_fd_range_filesrc);
 
   return s;
 }
@@ -484,6 +484,68 @@ GST_START_TEST (test_uri_interface)
 
 GST_END_TEST;
 
+GST_START_TEST (test_async_write)
+{
+  GstElement *filesink;
+  gchar *tmp_fn;
+  GstSegment segment;
+  guint64 queued_bytes;
+  guint i;
+
+  tmp_fn = create_temporary_file ();
+  if (tmp_fn == NULL)
+    return;
+  filesink = setup_filesink ();
+
+  sync_buffers = FALSE;
+
+  GST_LOG ("using temp file '%s'", tmp_fn);
+  /* small chunks and backlog so that the streaming thread has to wait for
+   * the writer thread */
+  g_object_set (filesink, "location", tmp_fn, "async-write", TRUE,
+      "buffer-size", 4096, "max-backlog-bytes", (guint64) 8192, NULL);
+
+  fail_unless_equals_int (gst_element_set_state (filesink, GST_STATE_PLAYING),
+      GST_STATE_CHANGE_ASYNC);
+
+  fail_unless (gst_pad_push_event (mysrcpad,
+          gst_event_new_stream_start ("test")));
+
+  gst_segment_init (&segment, GST_FORMAT_BYTES);
+  fail_unless (gst_pad_push_event (mysrcpad, gst_event_new_segment (&segment)));
+
+  for (i = 0; i < 100; i++)
+    PUSH_BYTES (1000);
+  CHECK_QUERY_POSITION (filesink, GST_FORMAT_BYTES, 100000);
+
+  PUSH_BUFFER_LIST (3, 10);
+  CHECK_QUERY_POSITION (filesink, GST_FORMAT_BYTES, 100030);
+
+  /* a buffer bigger than the backlog still goes through */
+  PUSH_BYTES (20000);
+  CHECK_QUERY_POSITION (filesink, GST_FORMAT_BYTES, 120030);
+
+  fail_unless (gst_pad_push_event (mysrcpad, gst_event_new_eos ()));
+
+  g_object_get (filesink, "queued-bytes", &queued_bytes, NULL);
+  fail_unless_equals_uint64 (queued_bytes, 0);
+
+  CHECK_WRITTEN_BYTES (0, 1000, 120030);
+  CHECK_WRITTEN_BYTES (99000, 1000, 120030);
+  CHECK_WRITTEN_BYTES (100020, 10, 120030);
+  CHECK_WRITTEN_BYTES (100030, 20000, 120030);
+
+  fail_unless_equals_int (gst_element_set_state (filesink, GST_STATE_NULL),
+      GST_STATE_CHANGE_SUCCESS);
+
+  cleanup_filesink (filesink);
+
+  g_remove (tmp_fn);
+  g_free (tmp_fn);
+}
+
+GST_END_TEST;
+
 static Suite *
 filesink_suite (void)
 {
@@ -496,6 +558,7 @@ filesink_suite (void)
   tcase_add_test (tc_chain, test_uri_interface);
   tcase_add_test (tc_chain, test_seeking);
   tcase_add_test (tc_chain, test_flush);
+  tcase_add_test (tc_chain, test_async_write);
 
   return s;
 }
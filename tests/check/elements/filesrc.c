@@ -544,6 +544,81 @@ GST_START_TEST (test_uri_query)
 
 GST_END_TEST;
 
+/* reads the whole test file in pull mode with the given io-mode, with one
+ * backwards jump in the middle, and compares against the file contents */
+static void
+check_pull_io_mode (const gchar * io_mode)
+{
+  GstElement *src;
+  GstPad *pad;
+  GstFlowReturn ret;
+  GstBuffer *buffer;
+  gchar *contents;
+  gsize length, offset;
+  gboolean jumped = FALSE;
+
+  fail_unless (g_file_get_contents (TESTFILE, &contents, &length, NULL));
+
+  src = setup_filesrc ();
+
+  g_object_set (G_OBJECT (src), "location", TESTFILE, NULL);
+  gst_util_set_object_arg (G_OBJECT (src), "io-mode", io_mode);
+  fail_unless (gst_element_set_state (src,
+          GST_STATE_READY) == GST_STATE_CHANGE_SUCCESS,
+      "could not set to ready");
+
+  pad = gst_element_get_static_pad (src, "src");
+  fail_unless (pad != NULL);
+  fail_unless (gst_pad_activate_mode (pad, GST_PAD_MODE_PULL, TRUE));
+  fail_unless (gst_element_set_state (src,
+          GST_STATE_PLAYING) == GST_STATE_CHANGE_SUCCESS,
+      "could not set to playing");
+
+  offset = 0;
+  while (offset < length) {
+    buffer = NULL;
+    ret = gst_pad_get_range (pad, offset, 64, &buffer);
+    fail_unless_equals_int (ret, GST_FLOW_OK);
+    fail_unless_equals_int (gst_buffer_get_size (buffer),
+        MIN (64, length - offset));
+    fail_unless (gst_buffer_memcmp (buffer, 0, contents + offset,
+            gst_buffer_get_size (buffer)) == 0);
+    gst_buffer_unref (buffer);
+
+    if (!jumped && offset >= length / 2) {
+      jumped = TRUE;
+      offset = 10;
+    } else {
+      offset += 64;
+    }
+  }
+
+  buffer = NULL;
+  ret = gst_pad_get_range (pad, length, 64, &buffer);
+  fail_unless_equals_int (ret, GST_FLOW_EOS);
+
+  fail_unless (gst_element_set_state (src,
+          GST_STATE_NULL) == GST_STATE_CHANGE_SUCCESS, "could not set to null");
+
+  gst_object_unref (pad);
+  cleanup_filesrc (src);
+  g_free (contents);
+}
+
+GST_START_TEST (test_io_mode_uring)
+{
+  check_pull_io_mode ("io-uring");
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_io_mode_mmap)
+{
+  check_pull_io_mode ("mmap");
+}
+
+GST_END_TEST;
+
 static Suite *
 filesrc_suite (void)
 {
@@ -557,6 +632,8 @@ filesrc_suite (void)
   tcase_add_test (tc_chain, test_coverage);
   tcase_add_test (tc_chain, test_uri_interface);
   tcase_add_test (tc_chain, test_uri_query);
+  tcase_add_test (tc_chain, test_io_mode_uring);
+  tcase_add_test (tc_chain, test_io_mode_mmap);
 
   return s;
 }
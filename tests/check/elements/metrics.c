@@ -0,0 +1,196 @@
+/* GStreamer
+ *
+ * Unit test for the metrics tracer
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gst/gst.h>
+#include <gst/check/gstcheck.h>
+
+#define NUM_BUFFERS 10
+
+static GstTracer *
+get_tracer_by_name (const gchar * name)
+{
+  GList *tracers, *l;
+  GstTracer *tracer = NULL;
+
+  tracers = gst_tracing_get_active_tracers ();
+  for (l = tracers; l; l = l->next)
+    if (g_strcmp0 (GST_OBJECT_NAME (l->data), name) == 0)
+      tracer = gst_object_ref (l->data);
+
+  g_list_free_full (tracers, gst_object_unref);
+  return tracer;
+}
+
+static gchar *
+get_metrics_from (const gchar * name)
+{
+  GstTracer *tracer = get_tracer_by_name (name);
+  gchar *metrics = NULL;
+
+  fail_unless (tracer);
+  g_signal_emit_by_name (tracer, "get-metrics", &metrics);
+  gst_object_unref (tracer);
+  fail_unless (metrics != NULL);
+
+  return metrics;
+}
+
+static gchar *
+get_metrics (void)
+{
+  return get_metrics_from ("metrics");
+}
+
+GST_START_TEST (test_get_metrics)
+{
+  GstElement *pipe, *src, *queue, *sink;
+  GstMessage *m;
+  gchar *metrics;
+
+  pipe = gst_pipeline_new ("pipeline");
+  src = gst_element_factory_make ("fakesrc", "src");
+  queue = gst_element_factory_make ("queue", "q");
+  sink = gst_element_factory_make ("fakesink", "sink");
+  fail_unless (pipe && src && queue && sink);
+
+  g_object_set (src, "num-buffers", NUM_BUFFERS, "sizemax", 100, NULL);
+  gst_util_set_object_arg (G_OBJECT (src), "sizetype", "fixed");
+
+  gst_bin_add_many (GST_BIN (pipe), src, queue, sink, NULL);
+  fail_unless (gst_element_link_many (src, queue, sink, NULL));
+
+  fail_unless_equals_int (gst_element_set_state (pipe, GST_STATE_PLAYING),
+      GST_STATE_CHANGE_ASYNC);
+
+  m = gst_bus_timed_pop_filtered (GST_ELEMENT_BUS (pipe), -1, GST_MESSAGE_EOS);
+  gst_message_unref (m);
+
+  metrics = get_metrics ();
+  GST_INFO ("metrics:\n%s", metrics);
+
+  fail_unless (strstr (metrics,
+          "gst_pad_buffers_total{pipeline=\"pipeline\",pad=\"src:src\"} 10\n"));
+  fail_unless (strstr (metrics,
+          "gst_pad_bytes_total{pipeline=\"pipeline\",pad=\"src:src\"} 1000\n"));
+  fail_unless (strstr (metrics,
+          "gst_pad_buffers_total{pipeline=\"pipeline\",pad=\"q:src\"} 10\n"));
+
+  /* the time of each push is accounted to the element receiving it */
+  fail_unless (strstr (metrics, "gst_element_processing_seconds_count"
+          "{pipeline=\"pipeline\",element=\"q\"} 10\n"));
+  fail_unless (strstr (metrics, "gst_element_processing_seconds_count"
+          "{pipeline=\"pipeline\",element=\"sink\"} 10\n"));
+  fail_unless (strstr (metrics, "gst_element_processing_seconds_bucket"
+          "{pipeline=\"pipeline\",element=\"sink\",le=\"+Inf\"} 10\n"));
+  fail_unless (strstr (metrics, "gst_element_processing_seconds_quantile"
+          "{pipeline=\"pipeline\",element=\"sink\",quantile=\"0.99\"}"));
+
+  /* only the queue has a fill level */
+  fail_unless (strstr (metrics,
+          "gst_queue_level_buffers{pipeline=\"pipeline\",element=\"q\"} 0\n"));
+  fail_if (strstr (metrics, "gst_queue_level_buffers{pipeline=\"pipeline\","
+          "element=\"sink\"}"));
+  g_free (metrics);
+
+  /* nothing happened since the previous snapshot */
+  metrics = get_metrics ();
+  fail_unless (strstr (metrics,
+          "gst_pad_buffers_per_second{pipeline=\"pipeline\",pad=\"src:src\"} "
+          "0\n"));
+  fail_if (strstr (metrics, "gst_element_processing_seconds_quantile{"));
+  g_free (metrics);
+
+  fail_unless_equals_int (gst_element_set_state (pipe, GST_STATE_NULL),
+      GST_STATE_CHANGE_SUCCESS);
+  gst_object_unref (pipe);
+
+  /* the entries of the destroyed objects are reported one last time */
+  metrics = get_metrics ();
+  fail_unless (strstr (metrics,
+          "gst_pad_buffers_total{pipeline=\"pipeline\",pad=\"src:src\"} 10\n"));
+  g_free (metrics);
+
+  metrics = get_metrics ();
+  fail_if (strstr (metrics, "pipeline=\"pipeline\""));
+  g_free (metrics);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_separate_instances)
+{
+  GstElement *pipe;
+  GstMessage *m;
+  gchar *metrics;
+
+  pipe = gst_parse_launch ("fakesrc name=src num-buffers=" G_STRINGIFY
+      (NUM_BUFFERS) " ! fakesink", NULL);
+  fail_unless (pipe);
+  gst_object_set_name (GST_OBJECT (pipe), "instances");
+
+  fail_unless_equals_int (gst_element_set_state (pipe, GST_STATE_PLAYING),
+      GST_STATE_CHANGE_ASYNC);
+  m = gst_bus_timed_pop_filtered (GST_ELEMENT_BUS (pipe), -1, GST_MESSAGE_EOS);
+  gst_message_unref (m);
+
+  /* each tracer counts the buffers once on its own entries */
+  metrics = get_metrics_from ("metrics");
+  fail_unless (strstr (metrics,
+          "gst_pad_buffers_total{pipeline=\"instances\",pad=\"src:src\"} 10\n"));
+  g_free (metrics);
+  metrics = get_metrics_from ("metrics2");
+  fail_unless (strstr (metrics,
+          "gst_pad_buffers_total{pipeline=\"instances\",pad=\"src:src\"} 10\n"));
+  g_free (metrics);
+
+  fail_unless_equals_int (gst_element_set_state (pipe, GST_STATE_NULL),
+      GST_STATE_CHANGE_SUCCESS);
+  gst_object_unref (pipe);
+}
+
+GST_END_TEST;
+
+static Suite *
+metricstracer_suite (void)
+{
+  Suite *s = suite_create ("metricstracer");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_get_metrics);
+  tcase_add_test (tc_chain, test_separate_instances);
+
+  return s;
+}
+
+/* Replacement for GST_CHECK_MAIN (metricstracer); because we need to set the
+ * env before gst_init() is called */
+int
+main (int argc, char **argv)
+{
+  Suite *s;
+  g_setenv ("GST_TRACERS", "metrics(name=metrics);metrics(name=metrics2)", TRUE);
+  gst_check_init (&argc, &argv);
+  s = metricstracer_suite ();
+  return gst_check_run_suite (s, "metricstracer", __FILE__);
+}
@@ -1492,6 +1492,100 @@ GST_START_TEST (test_buffering_with_none_pts)
 
 GST_END_TEST;
 
+GST_START_TEST (test_buffering_full_queue_released)
+{
+  /* This test checks that a queue above the high watermark keeps the other
+   * queues from starting to buffer, and that it stops doing so once its pad
+   * is released. */
+  GstElement *pipe;
+  GstElement *mq, *fakesink1, *fakesink2;
+  GstPad *inputpad1, *inputpad2;
+  GstPad *mq_sinkpad1, *mq_sinkpad2;
+  GstMessage *msg;
+  GstSegment segment;
+  gint buf_perc;
+
+  pipe = gst_pipeline_new ("testbin");
+  mq = gst_element_factory_make ("multiqueue", NULL);
+  fail_unless (mq != NULL);
+  fakesink1 = gst_element_factory_make ("fakesink", NULL);
+  fail_unless (fakesink1 != NULL);
+  fakesink2 = gst_element_factory_make ("fakesink", NULL);
+  fail_unless (fakesink2 != NULL);
+  gst_bin_add_many (GST_BIN (pipe), mq, fakesink1, fakesink2, NULL);
+
+  g_object_set (mq,
+      "use-buffering", (gboolean) TRUE,
+      "max-size-bytes", (guint) 1000 * 1000,
+      "max-size-buffers", (guint) 0,
+      "max-size-time", (guint64) 0,
+      "extra-size-bytes", (guint) 0,
+      "extra-size-buffers", (guint) 0,
+      "extra-size-time", (guint64) 0,
+      "low-watermark", (gdouble) 0.10, "high-watermark", (gdouble) 0.50, NULL);
+
+  gst_segment_init (&segment, GST_FORMAT_TIME);
+
+  inputpad1 = gst_pad_new ("dummysrc1", GST_PAD_SRC);
+  gst_pad_set_query_function (inputpad1, mq_dummypad_query);
+  mq_sinkpad1 = gst_element_request_pad_simple (mq, "sink_%u");
+  fail_unless (mq_sinkpad1 != NULL);
+  fail_unless (gst_pad_link (inputpad1, mq_sinkpad1) == GST_PAD_LINK_OK);
+  fail_unless (gst_element_link_pads (mq, "src_0", fakesink1, "sink"));
+
+  inputpad2 = gst_pad_new ("dummysrc2", GST_PAD_SRC);
+  gst_pad_set_query_function (inputpad2, mq_dummypad_query);
+  mq_sinkpad2 = gst_element_request_pad_simple (mq, "sink_%u");
+  fail_unless (mq_sinkpad2 != NULL);
+  fail_unless (gst_pad_link (inputpad2, mq_sinkpad2) == GST_PAD_LINK_OK);
+  fail_unless (gst_element_link_pads (mq, "src_1", fakesink2, "sink"));
+
+  gst_pad_set_active (inputpad1, TRUE);
+  gst_pad_set_active (inputpad2, TRUE);
+  gst_pad_push_event (inputpad1, gst_event_new_stream_start ("test1"));
+  gst_pad_push_event (inputpad1, gst_event_new_segment (&segment));
+  gst_pad_push_event (inputpad2, gst_event_new_stream_start ("test2"));
+  gst_pad_push_event (inputpad2, gst_event_new_segment (&segment));
+
+  /* both queues are empty, so the multiqueue starts out buffering at 0% */
+  gst_element_set_state (pipe, GST_STATE_PAUSED);
+
+  /* an EOS queue counts as full, this ends buffering */
+  gst_pad_push_event (inputpad1, gst_event_new_eos ());
+  check_for_buffering_msg (pipe, 100);
+
+  /* the second queue stays below the low watermark. The first one is full,
+   * so the multiqueue must not start buffering again. The first buffer
+   * blocks in the prerolling fakesink, the second one stays queued */
+  gst_pad_push (inputpad2, gst_buffer_new_allocate (NULL, 40 * 1000, NULL));
+  gst_pad_push (inputpad2, gst_buffer_new_allocate (NULL, 40 * 1000, NULL));
+  g_object_set (mq, "low-watermark", (gdouble) 0.10, NULL);
+  msg = gst_bus_pop_filtered (GST_ELEMENT_BUS (pipe), GST_MESSAGE_BUFFERING);
+  fail_unless (msg == NULL, "Unexpected buffering message %" GST_PTR_FORMAT,
+      msg);
+
+  /* without the full queue, the second one is low enough to buffer */
+  gst_element_release_request_pad (mq, mq_sinkpad1);
+  g_object_set (mq, "low-watermark", (gdouble) 0.10, NULL);
+  msg = gst_bus_poll (GST_ELEMENT_BUS (pipe),
+      GST_MESSAGE_BUFFERING | GST_MESSAGE_ERROR, -1);
+  fail_if (GST_MESSAGE_TYPE (msg) == GST_MESSAGE_ERROR,
+      "Expected BUFFERING message, got ERROR message");
+  gst_message_parse_buffering (msg, &buf_perc);
+  fail_unless (buf_perc > 0 && buf_perc < 100,
+      "Got incorrect percentage: %d%%", buf_perc);
+  gst_message_unref (msg);
+
+  gst_element_set_state (pipe, GST_STATE_NULL);
+  gst_object_unref (mq_sinkpad1);
+  gst_object_unref (mq_sinkpad2);
+  gst_object_unref (inputpad1);
+  gst_object_unref (inputpad2);
+  gst_object_unref (pipe);
+}
+
+GST_END_TEST;
+
 static gboolean
 event_func_signal (GstPad * sinkpad, GstObject * parent, GstEvent * event)
 {
@@ -1510,6 +1604,99 @@ event_func_signal (GstPad * sinkpad, GstObject * parent, GstEvent * event)
   return TRUE;
 }
 
+static GstFlowReturn
+push_timed_buffer (GstPad * pad, GstClockTime ts)
+{
+  GstBuffer *buf = gst_buffer_new_allocate (NULL, 10, NULL);
+
+  GST_BUFFER_PTS (buf) = ts;
+  GST_BUFFER_DURATION (buf) = GST_SECOND;
+
+  return gst_pad_push (pad, buf);
+}
+
+GST_START_TEST (test_interleave_leading_stream)
+{
+  /* This test checks that the interleave grows while one stream runs ahead
+   * of another one that is pushed from the same thread. The lagging stream
+   * only gets a running time after the leading one, when the leading one was
+   * the only queue with a running time for a while. */
+  GstElement *pipe;
+  GstElement *mq, *fakesink1, *fakesink2;
+  GstPad *inputpad1, *inputpad2;
+  GstPad *mq_sinkpad1, *mq_sinkpad2;
+  GstSegment segment;
+  guint64 max_time;
+  gint i;
+
+  pipe = gst_pipeline_new ("testbin");
+  mq = gst_element_factory_make ("multiqueue", NULL);
+  fail_unless (mq != NULL);
+  fakesink1 = gst_element_factory_make ("fakesink", NULL);
+  fail_unless (fakesink1 != NULL);
+  fakesink2 = gst_element_factory_make ("fakesink", NULL);
+  fail_unless (fakesink2 != NULL);
+  gst_bin_add_many (GST_BIN (pipe), mq, fakesink1, fakesink2, NULL);
+
+  g_object_set (mq,
+      "use-interleave", (gboolean) TRUE,
+      "max-size-bytes", (guint) 0, "max-size-buffers", (guint) 0, NULL);
+  g_object_set (fakesink1, "sync", (gboolean) FALSE, NULL);
+  g_object_set (fakesink2, "sync", (gboolean) FALSE, NULL);
+
+  inputpad1 = gst_pad_new ("dummysrc1", GST_PAD_SRC);
+  gst_pad_set_query_function (inputpad1, mq_dummypad_query);
+  mq_sinkpad1 = gst_element_request_pad_simple (mq, "sink_%u");
+  fail_unless (mq_sinkpad1 != NULL);
+  fail_unless (gst_pad_link (inputpad1, mq_sinkpad1) == GST_PAD_LINK_OK);
+  fail_unless (gst_element_link_pads (mq, "src_0", fakesink1, "sink"));
+
+  inputpad2 = gst_pad_new ("dummysrc2", GST_PAD_SRC);
+  gst_pad_set_query_function (inputpad2, mq_dummypad_query);
+  mq_sinkpad2 = gst_element_request_pad_simple (mq, "sink_%u");
+  fail_unless (mq_sinkpad2 != NULL);
+  fail_unless (gst_pad_link (inputpad2, mq_sinkpad2) == GST_PAD_LINK_OK);
+  fail_unless (gst_element_link_pads (mq, "src_1", fakesink2, "sink"));
+
+  gst_element_set_state (pipe, GST_STATE_PLAYING);
+
+  gst_pad_set_active (inputpad1, TRUE);
+  gst_pad_set_active (inputpad2, TRUE);
+  gst_segment_init (&segment, GST_FORMAT_TIME);
+  gst_pad_push_event (inputpad1, gst_event_new_stream_start ("test1"));
+  gst_pad_push_event (inputpad1, gst_event_new_segment (&segment));
+  /* the buffers of the second stream before 10s have no running time */
+  segment.start = segment.time = segment.position = 10 * GST_SECOND;
+  gst_pad_push_event (inputpad2, gst_event_new_stream_start ("test2"));
+  gst_pad_push_event (inputpad2, gst_event_new_segment (&segment));
+
+  /* both queues are active, only the first one has a running time */
+  fail_unless_equals_int (push_timed_buffer (inputpad2, 0), GST_FLOW_OK);
+  fail_unless_equals_int (push_timed_buffer (inputpad1, 0), GST_FLOW_OK);
+
+  /* the second stream stays at running time 1s, the first one runs ahead
+   * to 11s */
+  fail_unless_equals_int (push_timed_buffer (inputpad2, 10 * GST_SECOND),
+      GST_FLOW_OK);
+  for (i = 1; i <= 10; i++)
+    fail_unless_equals_int (push_timed_buffer (inputpad1, i * GST_SECOND),
+        GST_FLOW_OK);
+
+  /* 150% of the 10s between the streams plus the minimum interleave */
+  g_object_get (mq, "max-size-time", &max_time, NULL);
+  fail_unless (max_time >= 15 * GST_SECOND,
+      "interleave did not grow: %" GST_TIME_FORMAT, GST_TIME_ARGS (max_time));
+
+  gst_element_set_state (pipe, GST_STATE_NULL);
+  gst_object_unref (mq_sinkpad1);
+  gst_object_unref (mq_sinkpad2);
+  gst_object_unref (inputpad1);
+  gst_object_unref (inputpad2);
+  gst_object_unref (pipe);
+}
+
+GST_END_TEST;
+
 GST_START_TEST (test_initial_events_nodelay)
 {
   struct PadData pad_data = { 0, };
@@ -1599,6 +1786,159 @@ GST_START_TEST (test_initial_events_nodelay)
 
 GST_END_TEST;
 
+struct BatchData
+{
+  GMutex mutex;
+  GCond cond;
+  gboolean blocked;
+  GList *buffers;
+  GList *list_sizes;
+};
+
+static GstFlowReturn
+batch_chain (GstPad * pad, GstObject * parent, GstBuffer * buffer)
+{
+  struct BatchData *data = gst_pad_get_element_private (pad);
+
+  g_mutex_lock (&data->mutex);
+  data->buffers = g_list_append (data->buffers, buffer);
+  g_cond_signal (&data->cond);
+  g_mutex_unlock (&data->mutex);
+
+  return GST_FLOW_OK;
+}
+
+static GstFlowReturn
+batch_chain_list (GstPad * pad, GstObject * parent, GstBufferList * list)
+{
+  struct BatchData *data = gst_pad_get_element_private (pad);
+  guint i, len = gst_buffer_list_length (list);
+
+  g_mutex_lock (&data->mutex);
+  data->list_sizes =
+      g_list_append (data->list_sizes, GUINT_TO_POINTER (len));
+  for (i = 0; i < len; i++)
+    data->buffers = g_list_append (data->buffers,
+        gst_buffer_ref (gst_buffer_list_get (list, i)));
+  g_cond_signal (&data->cond);
+  g_mutex_unlock (&data->mutex);
+
+  gst_buffer_list_unref (list);
+
+  return GST_FLOW_OK;
+}
+
+static GstPadProbeReturn
+batch_block_probe (GstPad * pad, GstPadProbeInfo * info, gpointer user_data)
+{
+  struct BatchData *data = user_data;
+
+  g_mutex_lock (&data->mutex);
+  data->blocked = TRUE;
+  g_cond_signal (&data->cond);
+  g_mutex_unlock (&data->mutex);
+
+  return GST_PAD_PROBE_OK;
+}
+
+GST_START_TEST (test_batch)
+{
+  struct BatchData data;
+  GstElement *pipe, *mq;
+  GstPad *inputpad, *sinkpad, *mq_sinkpad, *mq_srcpad;
+  GstSegment segment;
+  GList *l;
+  gulong probe;
+  guint i;
+
+  memset (&data, 0, sizeof (data));
+  g_mutex_init (&data.mutex);
+  g_cond_init (&data.cond);
+
+  pipe = gst_pipeline_new ("testbin");
+  mq = gst_element_factory_make ("multiqueue", NULL);
+  fail_unless (mq != NULL);
+  gst_bin_add (GST_BIN (pipe), mq);
+
+  /* batches end after 8 buffers or 30ms, whatever comes first */
+  g_object_set (mq, "max-size-buffers", 20, "max-batch-buffers", 8,
+      "max-batch-time", 30 * GST_MSECOND, NULL);
+
+  inputpad = gst_pad_new ("dummysrc", GST_PAD_SRC);
+  mq_sinkpad = gst_element_request_pad_simple (mq, "sink_%u");
+  fail_unless (mq_sinkpad != NULL);
+  fail_unless (gst_pad_link (inputpad, mq_sinkpad) == GST_PAD_LINK_OK);
+  gst_pad_set_active (inputpad, TRUE);
+
+  mq_srcpad = mq_sinkpad_to_srcpad (mq, mq_sinkpad);
+  sinkpad = gst_pad_new ("dummysink", GST_PAD_SINK);
+  gst_pad_set_chain_function (sinkpad, batch_chain);
+  gst_pad_set_chain_list_function (sinkpad, batch_chain_list);
+  gst_pad_set_element_private (sinkpad, &data);
+  fail_unless (gst_pad_link (mq_srcpad, sinkpad) == GST_PAD_LINK_OK);
+  gst_pad_set_active (sinkpad, TRUE);
+
+  gst_element_set_state (pipe, GST_STATE_PLAYING);
+
+  gst_pad_push_event (inputpad, gst_event_new_stream_start ("test"));
+  gst_segment_init (&segment, GST_FORMAT_TIME);
+  gst_pad_push_event (inputpad, gst_event_new_segment (&segment));
+
+  probe = gst_pad_add_probe (mq_srcpad, GST_PAD_PROBE_TYPE_BLOCK |
+      GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_BUFFER_LIST,
+      batch_block_probe, &data, NULL);
+
+  /* the first buffer goes out alone and blocks, the others queue up behind
+   * it */
+  for (i = 0; i < 7; i++) {
+    GstBuffer *buffer = gst_buffer_new ();
+
+    GST_BUFFER_OFFSET (buffer) = i;
+    GST_BUFFER_PTS (buffer) = i * 10 * GST_MSECOND;
+    GST_BUFFER_DURATION (buffer) = 10 * GST_MSECOND;
+    fail_unless (gst_pad_push (inputpad, buffer) == GST_FLOW_OK);
+
+    if (i == 0) {
+      g_mutex_lock (&data.mutex);
+      while (!data.blocked)
+        g_cond_wait (&data.cond, &data.mutex);
+      g_mutex_unlock (&data.mutex);
+    }
+  }
+
+  gst_pad_remove_probe (mq_srcpad, probe);
+
+  g_mutex_lock (&data.mutex);
+  while (g_list_length (data.buffers) < 7)
+    g_cond_wait (&data.cond, &data.mutex);
+  g_mutex_unlock (&data.mutex);
+
+  for (l = data.buffers, i = 0; l; l = l->next, i++)
+    fail_unless_equals_int (GST_BUFFER_OFFSET (l->data), i);
+
+  /* the six queued buffers are pushed as two lists of 30ms */
+  fail_unless_equals_int (g_list_length (data.list_sizes), 2);
+  fail_unless_equals_int (GPOINTER_TO_UINT (data.list_sizes->data), 3);
+  fail_unless_equals_int (GPOINTER_TO_UINT (data.list_sizes->next->data), 3);
+
+  gst_element_set_state (pipe, GST_STATE_NULL);
+
+  gst_pad_unlink (inputpad, mq_sinkpad);
+  gst_element_release_request_pad (mq, mq_sinkpad);
+  gst_object_unref (mq_sinkpad);
+  gst_object_unref (mq_srcpad);
+  gst_object_unref (inputpad);
+  gst_object_unref (sinkpad);
+  gst_object_unref (pipe);
+
+  g_list_free_full (data.buffers, (GDestroyNotify) gst_buffer_unref);
+  g_list_free (data.list_sizes);
+  g_cond_clear (&data.cond);
+  g_mutex_clear (&data.mutex);
+}
+
+GST_END_TEST;
+
 static void
 check_for_stream_status_msg (GstElement * pipeline, GstElement * multiqueue,
     GstStreamStatusType expected_type)
@@ -1689,7 +2029,10 @@ multiqueue_suite (void)
   tcase_add_test (tc_chain, test_limit_changes);
 
   tcase_add_test (tc_chain, test_buffering_with_none_pts);
+  tcase_add_test (tc_chain, test_buffering_full_queue_released);
+  tcase_add_test (tc_chain, test_interleave_leading_stream);
   tcase_add_test (tc_chain, test_initial_events_nodelay);
+  tcase_add_test (tc_chain, test_batch);
 
   tcase_add_test (tc_chain, test_stream_status_messages);
 
@@ -1181,6 +1181,261 @@ GST_START_TEST (test_initial_events_nodelay)
 
 GST_END_TEST;
 
+static guint buffers_before_event;
+
+static gboolean
+lockless_event_func (GstPad * pad, GstObject * parent, GstEvent * event)
+{
+  if (GST_EVENT_TYPE (event) == GST_EVENT_CUSTOM_DOWNSTREAM) {
+    g_mutex_lock (&check_mutex);
+    buffers_before_event = g_list_length (buffers);
+    g_mutex_unlock (&check_mutex);
+  }
+  return event_func (pad, parent, event);
+}
+
+#define LOCKLESS_NUM_BUFFERS 500
+
+GST_START_TEST (test_lockless)
+{
+  GstSegment segment;
+  GList *l;
+  guint i;
+
+  g_object_set (G_OBJECT (queue), "lockless", TRUE, "max-size-buffers", 8,
+      "max-size-bytes", 0, "max-size-time", (guint64) 0, NULL);
+
+  mysinkpad = gst_check_setup_sink_pad (queue, &sinktemplate);
+  gst_pad_set_event_function (mysinkpad, lockless_event_func);
+  gst_pad_set_active (mysinkpad, TRUE);
+
+  fail_unless (gst_element_set_state (queue,
+          GST_STATE_PLAYING) == GST_STATE_CHANGE_SUCCESS,
+      "could not set to playing");
+
+  gst_pad_push_event (mysrcpad, gst_event_new_stream_start ("test"));
+  gst_segment_init (&segment, GST_FORMAT_BYTES);
+  gst_pad_push_event (mysrcpad, gst_event_new_segment (&segment));
+
+  /* the ring is smaller than the number of buffers, so the pushes have to
+   * wait for the streaming thread and the buffers have to stay in order
+   * around the serialized event */
+  for (i = 0; i < LOCKLESS_NUM_BUFFERS; i++) {
+    GstBuffer *buffer = gst_buffer_new ();
+
+    GST_BUFFER_OFFSET (buffer) = i;
+    fail_unless (gst_pad_push (mysrcpad, buffer) == GST_FLOW_OK);
+
+    if (i == LOCKLESS_NUM_BUFFERS / 2 - 1)
+      gst_pad_push_event (mysrcpad,
+          gst_event_new_custom (GST_EVENT_CUSTOM_DOWNSTREAM,
+              gst_structure_new_empty ("test")));
+  }
+
+  g_mutex_lock (&check_mutex);
+  while (g_list_length (buffers) < LOCKLESS_NUM_BUFFERS)
+    g_cond_wait (&check_cond, &check_mutex);
+  g_mutex_unlock (&check_mutex);
+
+  for (l = buffers, i = 0; l; l = l->next, i++)
+    fail_unless_equals_int (GST_BUFFER_OFFSET (l->data), i);
+  fail_unless_equals_int (buffers_before_event, LOCKLESS_NUM_BUFFERS / 2);
+
+  g_mutex_lock (&events_lock);
+  fail_unless_equals_int (events_count, 3);
+  g_mutex_unlock (&events_lock);
+
+  gst_element_set_state (queue, GST_STATE_NULL);
+}
+
+GST_END_TEST;
+
+/* with a byte limit the lockless mode can't be used, the limit has to be
+ * respected anyway */
+GST_START_TEST (test_lockless_byte_limit)
+{
+  GstBuffer *buffer1;
+  GstBuffer *buffer2;
+  GstBuffer *buffer3;
+  GstSegment segment;
+  guint bytes;
+
+  g_signal_connect (queue, "overrun", G_CALLBACK (queue_overrun), NULL);
+  g_object_set (G_OBJECT (queue), "lockless", TRUE, "max-size-buffers", 0,
+      "max-size-time", (guint64) 0, "max-size-bytes", 8, "leaky", 1, NULL);
+
+  block_src ();
+
+  UNDERRUN_LOCK ();
+  fail_unless (gst_element_set_state (queue,
+          GST_STATE_PLAYING) == GST_STATE_CHANGE_SUCCESS,
+      "could not set to playing");
+  UNDERRUN_WAIT ();
+  UNDERRUN_UNLOCK ();
+
+  gst_segment_init (&segment, GST_FORMAT_BYTES);
+  gst_pad_push_event (mysrcpad, gst_event_new_stream_start ("test"));
+  gst_pad_push_event (mysrcpad, gst_event_new_segment (&segment));
+
+  buffer1 = gst_buffer_new_and_alloc (4);
+  gst_pad_push (mysrcpad, buffer1);
+  buffer2 = gst_buffer_new_and_alloc (4);
+  gst_pad_push (mysrcpad, buffer2);
+  fail_unless (overrun_count == 0);
+
+  g_object_get (G_OBJECT (queue), "current-level-bytes", &bytes, NULL);
+  fail_unless_equals_int (bytes, 8);
+
+  /* the queue is full, this one is leaked */
+  buffer3 = gst_buffer_new_and_alloc (4);
+  gst_buffer_ref (buffer3);
+  gst_pad_push (mysrcpad, buffer3);
+  fail_unless (overrun_count == 1);
+  ASSERT_BUFFER_REFCOUNT (buffer3, "buffer", 1);
+  gst_buffer_unref (buffer3);
+
+  g_object_get (G_OBJECT (queue), "current-level-bytes", &bytes, NULL);
+  fail_unless_equals_int (bytes, 8);
+
+  unblock_src ();
+  fail_unless (gst_element_set_state (queue,
+          GST_STATE_NULL) == GST_STATE_CHANGE_SUCCESS, "could not set to null");
+}
+
+GST_END_TEST;
+
+static gboolean src_blocked;
+
+static GstPadProbeReturn
+src_blocked_probe (GstPad * pad, GstPadProbeInfo * info, gpointer user_data)
+{
+  g_mutex_lock (&check_mutex);
+  src_blocked = TRUE;
+  g_cond_signal (&check_cond);
+  g_mutex_unlock (&check_mutex);
+
+  return GST_PAD_PROBE_OK;
+}
+
+/* the ring is larger than max-size-buffers, the limit has to be respected
+ * anyway */
+GST_START_TEST (test_lockless_buffer_limit)
+{
+  GstBuffer *buffer;
+  GstSegment segment;
+  guint i;
+
+  g_signal_connect (queue, "overrun", G_CALLBACK (queue_overrun), NULL);
+  g_object_set (G_OBJECT (queue), "lockless", TRUE, "max-size-buffers", 5,
+      "max-size-bytes", 0, "max-size-time", (guint64) 0, "leaky", 1, NULL);
+
+  mysinkpad = gst_check_setup_sink_pad (queue, &sinktemplate);
+  gst_pad_set_active (mysinkpad, TRUE);
+
+  fail_unless (gst_element_set_state (queue,
+          GST_STATE_PLAYING) == GST_STATE_CHANGE_SUCCESS,
+      "could not set to playing");
+
+  gst_pad_push_event (mysrcpad, gst_event_new_stream_start ("test"));
+  gst_segment_init (&segment, GST_FORMAT_BYTES);
+  gst_pad_push_event (mysrcpad, gst_event_new_segment (&segment));
+
+  /* keep the first buffer in the streaming thread */
+  src_blocked = FALSE;
+  qsrcpad = gst_element_get_static_pad (queue, "src");
+  probe_id = gst_pad_add_probe (qsrcpad,
+      GST_PAD_PROBE_TYPE_BLOCK | GST_PAD_PROBE_TYPE_BUFFER, src_blocked_probe,
+      NULL, NULL);
+  fail_unless (gst_pad_push (mysrcpad, gst_buffer_new ()) == GST_FLOW_OK);
+  g_mutex_lock (&check_mutex);
+  while (!src_blocked)
+    g_cond_wait (&check_cond, &check_mutex);
+  g_mutex_unlock (&check_mutex);
+
+  for (i = 0; i < 5; i++)
+    fail_unless (gst_pad_push (mysrcpad, gst_buffer_new ()) == GST_FLOW_OK);
+  fail_unless_equals_int (overrun_count, 0);
+
+  /* the queue is full, this one is leaked */
+  buffer = gst_buffer_new ();
+  gst_buffer_ref (buffer);
+  fail_unless (gst_pad_push (mysrcpad, buffer) == GST_FLOW_OK);
+  fail_unless_equals_int (overrun_count, 1);
+  ASSERT_BUFFER_REFCOUNT (buffer, "buffer", 1);
+  gst_buffer_unref (buffer);
+
+  unblock_src ();
+
+  g_mutex_lock (&check_mutex);
+  while (g_list_length (buffers) < 6)
+    g_cond_wait (&check_cond, &check_mutex);
+  g_mutex_unlock (&check_mutex);
+
+  fail_unless (gst_element_set_state (queue,
+          GST_STATE_NULL) == GST_STATE_CHANGE_SUCCESS, "could not set to null");
+}
+
+GST_END_TEST;
+
+static GstPadProbeReturn
+count_lists_probe (GstPad * pad, GstPadProbeInfo * info, gpointer user_data)
+{
+  guint *n_listed = user_data;
+
+  *n_listed += gst_buffer_list_length (GST_PAD_PROBE_INFO_BUFFER_LIST (info));
+
+  return GST_PAD_PROBE_OK;
+}
+
+GST_START_TEST (test_batch)
+{
+  GstSegment segment;
+  guint n_listed = 0;
+  GList *l;
+  guint i;
+
+  g_object_set (G_OBJECT (queue), "max-batch-buffers", 8, NULL);
+
+  mysinkpad = gst_check_setup_sink_pad (queue, &sinktemplate);
+  gst_pad_set_active (mysinkpad, TRUE);
+
+  fail_unless (gst_element_set_state (queue,
+          GST_STATE_PLAYING) == GST_STATE_CHANGE_SUCCESS,
+      "could not set to playing");
+
+  gst_pad_push_event (mysrcpad, gst_event_new_stream_start ("test"));
+  gst_segment_init (&segment, GST_FORMAT_BYTES);
+  gst_pad_push_event (mysrcpad, gst_event_new_segment (&segment));
+
+  block_src ();
+  gst_pad_add_probe (qsrcpad, GST_PAD_PROBE_TYPE_BUFFER_LIST,
+      count_lists_probe, &n_listed, NULL);
+
+  /* everything after the first buffer queues up behind the blocked pad */
+  for (i = 0; i < 5; i++) {
+    GstBuffer *buffer = gst_buffer_new ();
+
+    GST_BUFFER_OFFSET (buffer) = i;
+    fail_unless (gst_pad_push (mysrcpad, buffer) == GST_FLOW_OK);
+  }
+
+  unblock_src ();
+
+  g_mutex_lock (&check_mutex);
+  while (g_list_length (buffers) < 5)
+    g_cond_wait (&check_cond, &check_mutex);
+  g_mutex_unlock (&check_mutex);
+
+  for (l = buffers, i = 0; l; l = l->next, i++)
+    fail_unless_equals_int (GST_BUFFER_OFFSET (l->data), i);
+  /* either all buffers or all but the first were pushed as a list */
+  fail_unless (n_listed >= 4);
+
+  gst_element_set_state (queue, GST_STATE_NULL);
+}
+
+GST_END_TEST;
+
 static Suite *
 queue_suite (void)
 {
@@ -1204,6 +1459,10 @@ queue_suite (void)
   tcase_add_test (tc_chain, test_sticky_not_linked);
   tcase_add_test (tc_chain, test_time_level_buffer_list);
   tcase_add_test (tc_chain, test_initial_events_nodelay);
+  tcase_add_test (tc_chain, test_lockless);
+  tcase_add_test (tc_chain, test_lockless_byte_limit);
+  tcase_add_test (tc_chain, test_lockless_buffer_limit);
+  tcase_add_test (tc_chain, test_batch);
 
   return s;
 }
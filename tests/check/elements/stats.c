@@ -0,0 +1,123 @@
+/* GStreamer
+ *
+ * Unit test for the stats tracer
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gst/gst.h>
+#include <gst/check/gstcheck.h>
+
+static GstTracer *
+get_tracer_by_name (const gchar * name)
+{
+  GList *tracers, *l;
+  GstTracer *tracer = NULL;
+
+  tracers = gst_tracing_get_active_tracers ();
+  for (l = tracers; l; l = l->next)
+    if (g_strcmp0 (GST_OBJECT_NAME (l->data), name) == 0)
+      tracer = l->data;
+
+  g_list_free (tracers);
+  return tracer;
+}
+
+GST_START_TEST (test_get_element_times)
+{
+  GstElement *pipe, *src, *identity, *sink;
+  GstTracer *tracer;
+  GstStructure *info = NULL;
+  const GValue *times;
+  GstMessage *m;
+  gint64 sum = 0;
+  gboolean found = FALSE;
+  guint i;
+
+  pipe = gst_pipeline_new ("pipeline");
+  src = gst_element_factory_make ("fakesrc", "src");
+  identity = gst_element_factory_make ("identity", "identity");
+  sink = gst_element_factory_make ("fakesink", "sink");
+  fail_unless (pipe && src && identity && sink);
+
+  g_object_set (src, "num-buffers", 10, NULL);
+  /* make sure that the time spent in identity can be measured */
+  g_object_set (identity, "sleep-time", 1000, NULL);
+
+  gst_bin_add_many (GST_BIN (pipe), src, identity, sink, NULL);
+  fail_unless (gst_element_link_many (src, identity, sink, NULL));
+
+  fail_unless_equals_int (gst_element_set_state (pipe, GST_STATE_PLAYING),
+      GST_STATE_CHANGE_ASYNC);
+
+  m = gst_bus_timed_pop_filtered (GST_ELEMENT_BUS (pipe), -1, GST_MESSAGE_EOS);
+  gst_message_unref (m);
+
+  /* the counters of the streaming thread are summed up on demand */
+  tracer = get_tracer_by_name ("stats");
+  fail_unless (tracer);
+  g_signal_emit_by_name (tracer, "get-element-times", &info);
+  gst_object_unref (tracer);
+  fail_unless (info != NULL);
+
+  times = gst_structure_get_value (info, "times");
+  fail_unless (times != NULL);
+  fail_unless (GST_VALUE_HOLDS_ARRAY (times));
+  for (i = 0; i < gst_value_array_get_size (times); i++) {
+    gint64 t = g_value_get_int64 (gst_value_array_get_value (times, i));
+
+    if (t >= GST_MSECOND)
+      found = TRUE;
+    sum += t;
+  }
+  /* the time of a push is moved from the pushing element to its peer */
+  fail_unless (found);
+  fail_unless_equals_int64 (sum, 0);
+  gst_structure_free (info);
+
+  fail_unless_equals_int (gst_element_set_state (pipe, GST_STATE_NULL),
+      GST_STATE_CHANGE_SUCCESS);
+  gst_object_unref (pipe);
+}
+
+GST_END_TEST;
+
+static Suite *
+statstracer_suite (void)
+{
+  Suite *s = suite_create ("statstracer");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_get_element_times);
+
+  return s;
+}
+
+/* Replacement for GST_CHECK_MAIN (statstracer); because we need to set the
+ * env before gst_init() is called */
+int
+main (int argc, char **argv)
+{
+  Suite *s;
+  g_setenv ("GST_TRACERS", "stats(name=stats)", TRUE);
+  gst_check_init (&argc, &argv);
+  s = statstracer_suite ();
+  return gst_check_run_suite (s, "statstracer", __FILE__);
+}
@@ -108,6 +108,60 @@ GST_START_TEST (test_num_buffers)
 
 GST_END_TEST;
 
+/* construct fakesrc num-buffers=100 ! tee parallel=true ! fakesink with a
+ * number of fakesinks that are pushed on from the tee workers. Each fakesink
+ * should receive all the buffers and the EOS.
+ */
+GST_START_TEST (test_parallel)
+{
+#define NUM_BRANCHES 4
+#define NUM_PARALLEL_BUFFERS 100
+  GstElement *pipeline, *src, *tee;
+  GstElement *sinks[NUM_BRANCHES];
+  guint counts[NUM_BRANCHES];
+  GstBus *bus;
+  GstMessage *msg;
+  gint i;
+
+  pipeline = gst_pipeline_new ("pipeline");
+  src = gst_check_setup_element ("fakesrc");
+  g_object_set (src, "num-buffers", NUM_PARALLEL_BUFFERS, NULL);
+  tee = gst_check_setup_element ("tee");
+  g_object_set (tee, "parallel", TRUE, "max-backlog", 2, NULL);
+  fail_unless (gst_bin_add (GST_BIN (pipeline), src));
+  fail_unless (gst_bin_add (GST_BIN (pipeline), tee));
+  fail_unless (gst_element_link (src, tee));
+
+  for (i = 0; i < NUM_BRANCHES; ++i) {
+    counts[i] = 0;
+
+    sinks[i] = gst_check_setup_element ("fakesink");
+    g_object_set (sinks[i], "signal-handoffs", TRUE, "sync", FALSE, NULL);
+    g_signal_connect (sinks[i], "handoff", (GCallback) handoff, &counts[i]);
+    fail_unless (gst_bin_add (GST_BIN (pipeline), sinks[i]));
+    fail_unless (gst_element_link (tee, sinks[i]));
+  }
+
+  bus = gst_element_get_bus (pipeline);
+  fail_if (bus == NULL);
+  gst_element_set_state (pipeline, GST_STATE_PLAYING);
+
+  msg = gst_bus_poll (bus, GST_MESSAGE_EOS | GST_MESSAGE_ERROR, -1);
+  fail_if (GST_MESSAGE_TYPE (msg) != GST_MESSAGE_EOS);
+  gst_message_unref (msg);
+
+  /* EOS is serialized, so all buffers were pushed before it */
+  for (i = 0; i < NUM_BRANCHES; ++i) {
+    fail_unless_equals_int (counts[i], NUM_PARALLEL_BUFFERS);
+  }
+
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (bus);
+  gst_object_unref (pipeline);
+}
+
+GST_END_TEST;
+
 /* we use fakesrc ! tee ! fakesink and then randomly request/release and link
  * some pads from tee. This should happily run without any errors. */
 GST_START_TEST (test_stress)
@@ -696,6 +750,68 @@ GST_START_TEST (test_allow_not_linked)
 
 GST_END_TEST;
 
+/* request and release a src pad around every buffer and check that the data
+ * keeps flowing and that the churn shows up in the stats */
+GST_START_TEST (test_pad_churn)
+{
+#define NUM_CHURN 10
+  GstElement *tee;
+  GstPad *srcpad, *teesrc;
+  GstBuffer *buffer;
+  GstStructure *stats;
+  GstSegment segment;
+  guint64 val;
+  gint i;
+
+  static GstStaticPadTemplate srctemplate = GST_STATIC_PAD_TEMPLATE ("src",
+      GST_PAD_SRC,
+      GST_PAD_ALWAYS,
+      GST_STATIC_CAPS_ANY);
+
+  tee = gst_check_setup_element ("tee");
+  g_object_set (tee, "allow-not-linked", TRUE, NULL);
+
+  srcpad = gst_check_setup_src_pad (tee, &srctemplate);
+  gst_pad_set_active (srcpad, TRUE);
+
+  gst_pad_push_event (srcpad, gst_event_new_stream_start ("test"));
+  gst_segment_init (&segment, GST_FORMAT_BYTES);
+  gst_pad_push_event (srcpad, gst_event_new_segment (&segment));
+
+  fail_unless (gst_element_set_state (tee,
+          GST_STATE_PLAYING) == GST_STATE_CHANGE_SUCCESS);
+
+  buffer = gst_buffer_new ();
+
+  for (i = 0; i < NUM_CHURN; i++) {
+    teesrc = gst_element_request_pad_simple (tee, "src_%u");
+    fail_unless (teesrc != NULL);
+
+    fail_unless (gst_pad_push (srcpad, gst_buffer_ref (buffer)) == GST_FLOW_OK);
+
+    gst_element_release_request_pad (tee, teesrc);
+    gst_object_unref (teesrc);
+  }
+
+  g_object_get (tee, "stats", &stats, NULL);
+  fail_unless (gst_structure_get_uint64 (stats, "num-requested-pads", &val));
+  fail_unless_equals_uint64 (val, NUM_CHURN);
+  fail_unless (gst_structure_get_uint64 (stats, "num-released-pads", &val));
+  fail_unless_equals_uint64 (val, NUM_CHURN);
+  fail_unless (gst_structure_get_uint64 (stats, "num-pad-snapshots", &val));
+  fail_unless_equals_uint64 (val, 2 * NUM_CHURN);
+  gst_structure_free (stats);
+
+  gst_pad_set_active (srcpad, FALSE);
+  gst_check_teardown_src_pad (tee);
+  gst_check_teardown_element (tee);
+
+  fail_if (buffer->mini_object.refcount != 1);
+  gst_buffer_unref (buffer);
+}
+
+GST_END_TEST;
+
 static gboolean
 allocation_query_empty (GstPad * pad, GstObject * parent, GstQuery * query)
 {
@@ -952,12 +1068,14 @@ tee_suite (void)
   suite_add_tcase (s, tc_chain);
   tcase_add_test (tc_chain, test_num_buffers);
   tcase_add_test (tc_chain, test_stress);
+  tcase_add_test (tc_chain, test_parallel);
   tcase_add_test (tc_chain, test_release_while_buffer_alloc);
   tcase_add_test (tc_chain, test_release_while_second_buffer_alloc);
   tcase_add_test (tc_chain, test_internal_links);
   tcase_add_test (tc_chain, test_flow_aggregation);
   tcase_add_test (tc_chain, test_request_pads);
   tcase_add_test (tc_chain, test_allow_not_linked);
+  tcase_add_test (tc_chain, test_pad_churn);
   tcase_add_test (tc_chain, test_allocation_query_aggregation);
   tcase_add_test (tc_chain, test_allocation_query_allow_not_linked);
   tcase_add_test (tc_chain, test_allocation_query_failure);
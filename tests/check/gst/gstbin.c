@@ -1258,6 +1258,69 @@ GST_START_TEST (test_iterate_sorted)
 
 GST_END_TEST;
 
+static void
+check_sorted (GstBin * bin, GstElement * first, ...)
+{
+  GstIterator *it;
+  GstElement *expected;
+  GValue elem = { 0, };
+  va_list args;
+
+  it = gst_bin_iterate_sorted (bin);
+  va_start (args, first);
+  for (expected = first; expected; expected = va_arg (args, GstElement *)) {
+    fail_unless (gst_iterator_next (it, &elem) == GST_ITERATOR_OK);
+    fail_unless (g_value_get_object (&elem) == (gpointer) expected,
+        "expected %s, got %s", GST_ELEMENT_NAME (expected),
+        GST_ELEMENT_NAME (g_value_get_object (&elem)));
+    g_value_reset (&elem);
+  }
+  va_end (args);
+  fail_unless (gst_iterator_next (it, &elem) == GST_ITERATOR_DONE);
+
+  g_value_unset (&elem);
+  gst_iterator_free (it);
+}
+
+GST_START_TEST (test_iterate_sorted_relink)
+{
+  GstElement *pipeline, *src, *sink, *identity;
+
+  pipeline = gst_pipeline_new (NULL);
+  fail_unless (pipeline != NULL, "Could not create pipeline");
+
+  src = gst_element_factory_make ("fakesrc", NULL);
+  fail_if (src == NULL, "Could not create fakesrc");
+
+  sink = gst_element_factory_make ("fakesink", NULL);
+  fail_if (sink == NULL, "Could not create fakesink");
+
+  identity = gst_element_factory_make ("identity", NULL);
+  fail_if (identity == NULL, "Could not create identity");
+
+  gst_bin_add_many (GST_BIN (pipeline), sink, identity, src, NULL);
+  fail_unless (gst_element_link (src, sink));
+
+  /* the second time the order comes from the cache */
+  check_sorted (GST_BIN (pipeline), sink, src, identity, NULL);
+  check_sorted (GST_BIN (pipeline), sink, src, identity, NULL);
+
+  /* relinking invalidates the cached order */
+  gst_element_unlink (src, sink);
+  fail_unless (gst_element_link_many (src, identity, sink, NULL));
+  check_sorted (GST_BIN (pipeline), sink, identity, src, NULL);
+  check_sorted (GST_BIN (pipeline), sink, identity, src, NULL);
+
+  /* and so does removing an element */
+  gst_bin_remove (GST_BIN (pipeline), identity);
+  check_sorted (GST_BIN (pipeline), sink, src, NULL);
+
+  ASSERT_OBJECT_REFCOUNT (pipeline, "pipeline", 1);
+  gst_object_unref (pipeline);
+}
+
+GST_END_TEST;
+
 GST_START_TEST (test_iterate_sorted_unlinked)
 {
   GstElement *pipeline, *src, *sink, *identity;
@@ -1936,6 +1999,116 @@ GST_START_TEST (test_suppressed_flags_when_removing)
 
 GST_END_TEST;
 
+#define NUM_BRANCHES 8
+
+GST_START_TEST (test_parallel_state_change)
+{
+  GstElement *pipeline, *srcs[NUM_BRANCHES], *sinks[NUM_BRANCHES];
+  GstStateChangeReturn ret;
+  GstMessage *msg;
+  GstBus *bus;
+  guint i, n_sinks = 0;
+
+  pipeline = gst_pipeline_new (NULL);
+  fail_unless (pipeline != NULL, "Could not create pipeline");
+  g_object_set (pipeline, "parallel-state-change", TRUE, NULL);
+
+  bus = gst_element_get_bus (pipeline);
+
+  for (i = 0; i < NUM_BRANCHES; i++) {
+    srcs[i] = gst_element_factory_make ("fakesrc", NULL);
+    fail_if (srcs[i] == NULL, "Could not create fakesrc");
+    sinks[i] = gst_element_factory_make ("fakesink", NULL);
+    fail_if (sinks[i] == NULL, "Could not create fakesink");
+    gst_bin_add_many (GST_BIN (pipeline), srcs[i], sinks[i], NULL);
+    fail_unless (gst_element_link (srcs[i], sinks[i]));
+  }
+
+  ret = gst_element_set_state (pipeline, GST_STATE_READY);
+  fail_unless_equals_int (ret, GST_STATE_CHANGE_SUCCESS);
+
+  /* all sinks change state before any source does, the sinks and the sources
+   * among each other change state in any order */
+  for (i = 0; i < 2 * NUM_BRANCHES; i++) {
+    GstState old, new, pending;
+
+    msg = gst_bus_poll (bus, GST_MESSAGE_STATE_CHANGED, GST_SECOND);
+    fail_if (msg == NULL, "No state change message within 1 second");
+    gst_message_parse_state_changed (msg, &old, &new, &pending);
+    fail_unless_equals_int (old, GST_STATE_NULL);
+    fail_unless_equals_int (new, GST_STATE_READY);
+
+    if (GST_OBJECT_FLAG_IS_SET (GST_MESSAGE_SRC (msg), GST_ELEMENT_FLAG_SINK)) {
+      fail_unless (i < NUM_BRANCHES, "sink changed state after a source");
+      n_sinks++;
+    } else {
+      fail_unless (i >= NUM_BRANCHES, "source changed state before a sink");
+    }
+    gst_message_unref (msg);
+  }
+  fail_unless_equals_int (n_sinks, NUM_BRANCHES);
+  ASSERT_STATE_CHANGE_MSG (bus, pipeline, GST_STATE_NULL, GST_STATE_READY, 1);
+
+  /* the sinks preroll asynchronously */
+  ret = gst_element_set_state (pipeline, GST_STATE_PAUSED);
+  fail_unless_equals_int (ret, GST_STATE_CHANGE_ASYNC);
+  ret = gst_element_get_state (pipeline, NULL, NULL, GST_CLOCK_TIME_NONE);
+  fail_unless_equals_int (ret, GST_STATE_CHANGE_SUCCESS);
+
+  ret = gst_element_set_state (pipeline, GST_STATE_PLAYING);
+  fail_unless (ret != GST_STATE_CHANGE_FAILURE);
+  ret = gst_element_get_state (pipeline, NULL, NULL, GST_CLOCK_TIME_NONE);
+  fail_unless_equals_int (ret, GST_STATE_CHANGE_SUCCESS);
+
+  ret = gst_element_set_state (pipeline, GST_STATE_READY);
+  fail_unless_equals_int (ret, GST_STATE_CHANGE_SUCCESS);
+
+  /* one live source makes the pipeline NO_PREROLL */
+  g_object_set (srcs[0], "is-live", TRUE, NULL);
+  ret = gst_element_set_state (pipeline, GST_STATE_PAUSED);
+  fail_unless_equals_int (ret, GST_STATE_CHANGE_NO_PREROLL);
+
+  ret = gst_element_set_state (pipeline, GST_STATE_NULL);
+  fail_unless_equals_int (ret, GST_STATE_CHANGE_SUCCESS);
+
+  gst_object_unref (bus);
+  gst_object_unref (pipeline);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_parallel_state_change_failure)
+{
+  GstElement *pipeline, *src, *sink, *fail;
+  GstStateChangeReturn ret;
+
+  pipeline = gst_pipeline_new (NULL);
+  g_object_set (pipeline, "parallel-state-change", TRUE,
+      "state-change-threads", 2, NULL);
+
+  src = gst_element_factory_make ("fakesrc", NULL);
+  sink = gst_element_factory_make ("fakesink", NULL);
+  /* a sink that fails to go to PAUSED */
+  fail = gst_element_factory_make ("fakesink", NULL);
+  gst_util_set_object_arg (G_OBJECT (fail), "state-error", "ready-to-paused");
+  gst_bin_add_many (GST_BIN (pipeline), src, sink, fail, NULL);
+  fail_unless (gst_element_link (src, sink));
+
+  ret = gst_element_set_state (pipeline, GST_STATE_PAUSED);
+  fail_unless_equals_int (ret, GST_STATE_CHANGE_FAILURE);
+
+  /* the other children are switched back */
+  fail_unless_equals_int (GST_STATE (src), GST_STATE_READY);
+  fail_unless_equals_int (GST_STATE (sink), GST_STATE_READY);
+
+  ret = gst_element_set_state (pipeline, GST_STATE_NULL);
+  fail_unless_equals_int (ret, GST_STATE_CHANGE_SUCCESS);
+
+  gst_object_unref (pipeline);
+}
+
+GST_END_TEST;
+
 static Suite *
 gst_bin_suite (void)
 {
@@ -1962,6 +2135,7 @@ gst_bin_suite (void)
   tcase_add_test (tc_chain, test_add_self);
   tcase_add_test (tc_chain, test_iterate_sorted);
   tcase_add_test (tc_chain, test_iterate_sorted_unlinked);
+  tcase_add_test (tc_chain, test_iterate_sorted_relink);
   tcase_add_test (tc_chain, test_link_structure_change);
   tcase_add_test (tc_chain, test_state_failure_remove);
   tcase_add_test (tc_chain, test_state_failure_unref);
@@ -1971,6 +2145,8 @@ gst_bin_suite (void)
   tcase_add_test (tc_chain, test_deep_added_removed);
   tcase_add_test (tc_chain, test_suppressed_flags);
   tcase_add_test (tc_chain, test_suppressed_flags_when_removing);
+  tcase_add_test (tc_chain, test_parallel_state_change);
+  tcase_add_test (tc_chain, test_parallel_state_change_failure);
 
   /* fails on OSX build bot for some reason, and is a bit silly anyway */
   if (0)
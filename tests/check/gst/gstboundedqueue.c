@@ -0,0 +1,183 @@
+/* GStreamer
+ *
+ * unit test for GstBoundedQueue
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gst/check/gstcheck.h>
+#include <gst/gst.h>
+
+GST_START_TEST (test_create_free)
+{
+  GstBoundedQueue *bq;
+
+  bq = gst_bounded_queue_new (20, GST_BOUNDED_QUEUE_FLAG_NONE);
+  fail_unless_equals_int (gst_bounded_queue_get_capacity (bq), 32);
+  fail_unless_equals_int (gst_bounded_queue_length (bq), 0);
+  gst_bounded_queue_unref (bq);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_push_pop)
+{
+  GstBoundedQueue *bq;
+  guint i, lap;
+
+  bq = gst_bounded_queue_new (4, GST_BOUNDED_QUEUE_FLAG_NONE);
+
+  fail_unless (gst_bounded_queue_pop (bq) == NULL);
+  fail_unless (gst_bounded_queue_peek (bq) == NULL);
+
+  /* go around a couple of times */
+  for (lap = 0; lap < 3; lap++) {
+    for (i = 1; i <= 4; i++)
+      fail_unless (gst_bounded_queue_push (bq, GUINT_TO_POINTER (i)));
+    fail_if (gst_bounded_queue_push (bq, GUINT_TO_POINTER (5)));
+    fail_unless_equals_int (gst_bounded_queue_length (bq), 4);
+
+    fail_unless_equals_pointer (gst_bounded_queue_peek (bq),
+        GUINT_TO_POINTER (1));
+    for (i = 1; i <= 4; i++)
+      fail_unless_equals_pointer (gst_bounded_queue_pop (bq),
+          GUINT_TO_POINTER (i));
+    fail_unless (gst_bounded_queue_pop (bq) == NULL);
+    fail_unless_equals_int (gst_bounded_queue_length (bq), 0);
+  }
+
+  gst_bounded_queue_unref (bq);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_push_pop_many)
+{
+  GstBoundedQueue *bq;
+  gpointer in[8], out[8];
+  guint i;
+
+  for (i = 0; i < 8; i++)
+    in[i] = GUINT_TO_POINTER (i + 1);
+
+  bq = gst_bounded_queue_new (4, GST_BOUNDED_QUEUE_FLAG_SINGLE_PRODUCER);
+
+  /* only the first 4 fit */
+  fail_unless_equals_int (gst_bounded_queue_push_many (bq, in, 8), 4);
+  fail_unless_equals_int (gst_bounded_queue_push_many (bq, in + 4, 4), 0);
+
+  fail_unless_equals_int (gst_bounded_queue_pop_many (bq, out, 3), 3);
+  for (i = 0; i < 3; i++)
+    fail_unless_equals_pointer (out[i], in[i]);
+
+  fail_unless_equals_int (gst_bounded_queue_push_many (bq, in + 4, 4), 3);
+  fail_unless_equals_int (gst_bounded_queue_pop_many (bq, out, 8), 4);
+  for (i = 0; i < 4; i++)
+    fail_unless_equals_pointer (out[i], in[i + 3]);
+  fail_unless_equals_int (gst_bounded_queue_pop_many (bq, out, 8), 0);
+
+  gst_bounded_queue_unref (bq);
+}
+
+GST_END_TEST;
+
+#define NUM_PRODUCERS 4
+#define NUM_ITEMS 100000
+
+static GstBoundedQueue *test_queue;
+
+static gpointer
+produce (gpointer data)
+{
+  guint id = GPOINTER_TO_UINT (data);
+  guint i = 0;
+
+  while (i < NUM_ITEMS) {
+    gpointer items[4];
+    guint j, n;
+
+    n = MIN (G_N_ELEMENTS (items), NUM_ITEMS - i);
+    for (j = 0; j < n; j++)
+      items[j] = GUINT_TO_POINTER ((id << 24) | (i + j + 1));
+
+    n = gst_bounded_queue_push_many (test_queue, items, n);
+    if (n == 0)
+      g_thread_yield ();
+    i += n;
+  }
+  return NULL;
+}
+
+GST_START_TEST (test_multi_producer)
+{
+  GThread *threads[NUM_PRODUCERS];
+  guint next[NUM_PRODUCERS] = { 0, };
+  guint i, total = 0;
+
+  test_queue = gst_bounded_queue_new (64, GST_BOUNDED_QUEUE_FLAG_NONE);
+
+  for (i = 0; i < NUM_PRODUCERS; i++)
+    threads[i] = g_thread_new ("producer", produce, GUINT_TO_POINTER (i));
+
+  while (total < NUM_PRODUCERS * NUM_ITEMS) {
+    gpointer items[16];
+    guint n;
+
+    n = gst_bounded_queue_pop_many (test_queue, items, G_N_ELEMENTS (items));
+    if (n == 0)
+      g_thread_yield ();
+
+    for (i = 0; i < n; i++) {
+      guint v = GPOINTER_TO_UINT (items[i]);
+      guint id = v >> 24;
+
+      /* items of one producer come out in the order they went in */
+      fail_unless (id < NUM_PRODUCERS);
+      fail_unless_equals_int (v & 0xffffff, ++next[id]);
+    }
+    total += n;
+  }
+
+  for (i = 0; i < NUM_PRODUCERS; i++) {
+    g_thread_join (threads[i]);
+    fail_unless_equals_int (next[i], NUM_ITEMS);
+  }
+  fail_unless (gst_bounded_queue_pop (test_queue) == NULL);
+
+  gst_bounded_queue_unref (test_queue);
+}
+
+GST_END_TEST;
+
+static Suite *
+gst_bounded_queue_suite (void)
+{
+  Suite *s = suite_create ("GstBoundedQueue");
+  TCase *tc_chain = tcase_create ("GstBoundedQueue tests");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_create_free);
+  tcase_add_test (tc_chain, test_push_pop);
+  tcase_add_test (tc_chain, test_push_pop_many);
+  tcase_add_test (tc_chain, test_multi_producer);
+
+  return s;
+}
+
+GST_CHECK_MAIN (gst_bounded_queue);
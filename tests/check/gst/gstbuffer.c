@@ -944,6 +944,63 @@ GST_START_TEST (test_new_memdup)
 
 GST_END_TEST;
 
+#define N_CROSS_THREAD_BUFFERS 1000
+
+static gpointer
+free_buffers_thread (GstAtomicQueue * queue)
+{
+  guint n = 0;
+
+  while (n < N_CROSS_THREAD_BUFFERS) {
+    GstBuffer *buf = gst_atomic_queue_pop (queue);
+    GstMapInfo info;
+    guint i;
+
+    if (buf == NULL) {
+      g_thread_yield ();
+      continue;
+    }
+
+    fail_unless (gst_buffer_map (buf, &info, GST_MAP_READ));
+    for (i = 0; i < info.size; i++)
+      fail_unless_equals_int (info.data[i], n & 0xff);
+    gst_buffer_unmap (buf, &info);
+
+    gst_buffer_unref (buf);
+    n++;
+  }
+
+  return NULL;
+}
+
+/* buffers are freed in another thread than the one they were allocated in,
+ * the slices they used are then reused for new buffers */
+GST_START_TEST (test_free_other_thread)
+{
+  GstAtomicQueue *queue;
+  GThread *thread;
+  guint n;
+
+  queue = gst_atomic_queue_new (16);
+  thread = g_thread_new ("free-buffers", (GThreadFunc) free_buffers_thread,
+      queue);
+
+  for (n = 0; n < N_CROSS_THREAD_BUFFERS; n++) {
+    GstBuffer *buf;
+    gsize size = n % 2000;
+
+    buf = gst_buffer_new_allocate (NULL, size, NULL);
+    gst_buffer_memset (buf, 0, n & 0xff, size);
+    gst_atomic_queue_push (queue, buf);
+  }
+
+  g_thread_join (thread);
+  fail_unless_equals_int (gst_atomic_queue_length (queue), 0);
+  gst_atomic_queue_unref (queue);
+}
+
+GST_END_TEST;
+
 static Suite *
 gst_buffer_suite (void)
 {
@@ -970,6 +1027,7 @@ gst_buffer_suite (void)
   tcase_add_test (tc_chain, test_writable_memory);
   tcase_add_test (tc_chain, test_wrapped_bytes);
   tcase_add_test (tc_chain, test_new_memdup);
+  tcase_add_test (tc_chain, test_free_other_thread);
 
   return s;
 }
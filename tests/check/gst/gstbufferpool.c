@@ -336,6 +336,66 @@ GST_START_TEST (test_no_deadlock_for_buffer_discard)
 
 GST_END_TEST;
 
+static gpointer
+release_buf_delayed (gpointer p)
+{
+  g_usleep (G_USEC_PER_SEC / 100);
+  gst_buffer_unref (GST_BUFFER_CAST (p));
+  return NULL;
+}
+
+GST_START_TEST (test_pool_stats)
+{
+  GstBufferPoolAcquireParams params = { 0, };
+  GstBufferPool *pool;
+  GstBuffer *buf, *buf2;
+  GstStructure *stats;
+  const GValue *histogram;
+  GThread *thread;
+  guint64 acquired, starved, sum = 0;
+  guint i;
+
+  pool = create_pool (10, 1, 1);
+  gst_buffer_pool_set_active (pool, TRUE);
+
+  /* found in the pool */
+  fail_unless (gst_buffer_pool_acquire_buffer (pool, &buf,
+          NULL) == GST_FLOW_OK);
+
+  /* the pool is empty and can't allocate more */
+  params.flags = GST_BUFFER_POOL_ACQUIRE_FLAG_DONTWAIT;
+  fail_unless (gst_buffer_pool_acquire_buffer (pool, &buf2,
+          &params) == GST_FLOW_EOS);
+
+  /* waits until the other thread released the buffer */
+  thread = g_thread_new (NULL, release_buf_delayed, buf);
+  fail_unless (gst_buffer_pool_acquire_buffer (pool, &buf2,
+          NULL) == GST_FLOW_OK);
+  g_thread_join (thread);
+  gst_buffer_unref (buf2);
+
+  stats = gst_buffer_pool_get_stats (pool);
+  fail_unless (gst_structure_get_uint64 (stats, "acquired", &acquired));
+  fail_unless (gst_structure_get_uint64 (stats, "starved", &starved));
+  fail_unless_equals_uint64 (acquired, 2);
+  fail_unless_equals_uint64 (starved, 2);
+
+  histogram = gst_structure_get_value (stats, "latency-histogram");
+  fail_unless (GST_VALUE_HOLDS_ARRAY (histogram));
+  for (i = 0; i < gst_value_array_get_size (histogram); i++)
+    sum += g_value_get_uint64 (gst_value_array_get_value (histogram, i));
+  fail_unless_equals_uint64 (sum, acquired);
+  /* the first acquire was not timed */
+  fail_unless (g_value_get_uint64 (gst_value_array_get_value (histogram,
+              0)) >= 1);
+  gst_structure_free (stats);
+
+  gst_buffer_pool_set_active (pool, FALSE);
+  gst_object_unref (pool);
+}
+
+GST_END_TEST;
+
 static Suite *
 gst_buffer_pool_suite (void)
 {
@@ -355,6 +415,7 @@ gst_buffer_pool_suite (void)
   tcase_add_test (tc_chain, test_pool_config_validate);
   tcase_add_test (tc_chain, test_flushing_pool_returns_flushing);
   tcase_add_test (tc_chain, test_no_deadlock_for_buffer_discard);
+  tcase_add_test (tc_chain, test_pool_stats);
 
   return s;
 }
@@ -105,6 +105,35 @@ GST_START_TEST (test_hammer_bus)
 
 GST_END_TEST;
 
+/* same with a bounded queue that is too small for all messages */
+GST_START_TEST (test_hammer_bus_bounded)
+{
+  GThread *threads[NUM_THREADS];
+  guint capacity;
+  gint i;
+
+  test_bus = g_object_new (GST_TYPE_BUS, "queue-capacity", 64, NULL);
+  gst_object_ref_sink (test_bus);
+
+  g_object_get (test_bus, "queue-capacity", &capacity, NULL);
+  fail_unless_equals_int (capacity, 64);
+
+  for (i = 0; i < NUM_THREADS; i++)
+    threads[i] = g_thread_try_new ("gst-check", pound_bus_with_messages,
+        GINT_TO_POINTER (i), NULL);
+
+  for (i = 0; i < NUM_THREADS; i++)
+    g_thread_join (threads[i]);
+
+  fail_unless (gst_bus_have_pending (test_bus));
+  pull_messages ();
+  fail_if (gst_bus_have_pending (test_bus));
+
+  gst_object_unref ((GstObject *) test_bus);
+}
+
+GST_END_TEST;
+
 static gboolean
 message_func_eos (GstBus * bus, GstMessage * message, guint * p_counter)
 {
@@ -936,6 +965,7 @@ gst_bus_suite (void)
 
   suite_add_tcase (s, tc_chain);
   tcase_add_test (tc_chain, test_hammer_bus);
+  tcase_add_test (tc_chain, test_hammer_bus_bounded);
   tcase_add_test (tc_chain, test_watch);
   tcase_add_test (tc_chain, test_watch_with_poll);
   tcase_add_test (tc_chain, test_watch_twice);
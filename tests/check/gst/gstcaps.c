@@ -1118,6 +1118,102 @@ GST_START_TEST (test_intersect_flagset)
 
 GST_END_TEST;
 
+static const gchar *
+first_format (GstCaps * caps)
+{
+  const GValue *formats;
+
+  formats = gst_structure_get_value (gst_caps_get_structure (caps, 0),
+      "format");
+  fail_unless (GST_VALUE_HOLDS_LIST (formats));
+
+  return g_value_get_string (gst_value_list_get_value (formats, 0));
+}
+
+GST_START_TEST (test_intersect_repeated)
+{
+  GstCaps *c1, *c2, *c3, *ci;
+  guint i;
+
+  c1 = gst_caps_from_string ("video/x-raw, format = { I420, YV12 }, "
+      "width = [ 1, 100 ]");
+  c2 = gst_caps_from_string ("video/x-raw, format = { YV12, I420 }, "
+      "width = [ 1, 100 ]");
+  c3 = gst_caps_from_string ("video/x-raw, format = { NV12, YV12, I420 }, "
+      "width = [ 50, 200 ]; video/x-raw, format = RGB");
+
+  /* the same result comes back every time, and can still be modified */
+  for (i = 0; i < 3; i++) {
+    ci = gst_caps_intersect_full (c1, c3, GST_CAPS_INTERSECT_FIRST);
+    fail_unless (gst_caps_is_writable (ci));
+    fail_unless_equals_int (gst_caps_get_size (ci), 1);
+    fail_unless_equals_string (first_format (ci), "I420");
+    gst_caps_set_simple (ci, "height", G_TYPE_INT, 10, NULL);
+    gst_caps_unref (ci);
+
+    fail_unless (gst_caps_can_intersect (c1, c3));
+    fail_unless (gst_caps_is_subset (c1, c2));
+    fail_if (gst_caps_is_subset (c3, c1));
+  }
+
+  /* caps that are only equal without looking at the order of the lists
+   * give a differently ordered result */
+  ci = gst_caps_intersect_full (c2, c3, GST_CAPS_INTERSECT_FIRST);
+  fail_unless_equals_string (first_format (ci), "YV12");
+  gst_caps_unref (ci);
+
+  /* modifying the caps after the call is taken into account */
+  c1 = gst_caps_make_writable (c1);
+  gst_caps_set_simple (c1, "width", GST_TYPE_INT_RANGE, 1, 10, NULL);
+  fail_if (gst_caps_can_intersect (c1, c3));
+  fail_if (gst_caps_is_subset (c2, c1));
+
+  gst_caps_unref (c1);
+  gst_caps_unref (c2);
+  gst_caps_unref (c3);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_intersect_cache_stats)
+{
+  static GstStaticCaps scaps1 = GST_STATIC_CAPS ("audio/x-raw, "
+      "format = { S16LE, F32LE }, rate = [ 1, 48000 ]");
+  static GstStaticCaps scaps2 = GST_STATIC_CAPS ("audio/x-raw, "
+      "format = { F32LE, S32LE }, rate = [ 8000, 96000 ]");
+  GstCaps *c1, *c2, *ci, *expected;
+  guint hits, misses, hits2, misses2;
+
+  c1 = gst_static_caps_get (&scaps1);
+  c2 = gst_static_caps_get (&scaps2);
+  expected = gst_caps_from_string ("audio/x-raw, format = F32LE, "
+      "rate = [ 8000, 48000 ]");
+
+  gst_caps_get_cache_stats (&hits, &misses);
+  ci = gst_caps_intersect (c1, c2);
+  fail_unless (gst_caps_is_equal (ci, expected));
+  gst_caps_unref (ci);
+  gst_caps_get_cache_stats (&hits2, &misses2);
+  fail_unless_equals_int (hits2, hits);
+  fail_unless_equals_int (misses2, misses + 1);
+
+  /* static caps are found again without comparing their contents, and the
+   * result can still be modified */
+  ci = gst_caps_intersect (c1, c2);
+  fail_unless (gst_caps_is_equal (ci, expected));
+  fail_unless (gst_caps_is_writable (ci));
+  gst_caps_unref (ci);
+  gst_caps_get_cache_stats (&hits, &misses);
+  fail_unless_equals_int (hits, hits2 + 1);
+  fail_unless_equals_int (misses, misses2);
+
+  gst_caps_unref (expected);
+  gst_caps_unref (c1);
+  gst_caps_unref (c2);
+}
+
+GST_END_TEST;
+
 GST_START_TEST (test_union)
 {
   GstCaps *c1, *c2, *test, *expect;
@@ -1844,6 +1940,8 @@ gst_caps_suite (void)
   tcase_add_test (tc_chain, test_intersect_first2);
   tcase_add_test (tc_chain, test_intersect_duplication);
   tcase_add_test (tc_chain, test_intersect_flagset);
+  tcase_add_test (tc_chain, test_intersect_repeated);
+  tcase_add_test (tc_chain, test_intersect_cache_stats);
   tcase_add_test (tc_chain, test_union);
   tcase_add_test (tc_chain, test_normalize);
   tcase_add_test (tc_chain, test_broken);
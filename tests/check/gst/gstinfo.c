@@ -519,6 +519,56 @@ GST_START_TEST (info_post_gst_init_category_registration)
 
 GST_END_TEST;
 
+#ifndef GST_DISABLE_GST_DEBUG
+GST_START_TEST (info_ring_buffer_logger_deferred)
+{
+  GstElement *e;
+  gchar **logs;
+  gchar *str;
+  gint i;
+  /* not terminated, the precision limits what is read */
+  const gchar fourcc[4] = { 'a', 'b', 'c', 'd' };
+
+  gst_debug_remove_log_function (gst_debug_log_default);
+  gst_debug_add_ring_buffer_logger_full (4096, 0,
+      GST_DEBUG_RING_BUFFER_LOGGER_FLAG_DEFERRED);
+  gst_debug_set_default_threshold (GST_LEVEL_LOG);
+
+  /* the arguments are only formatted when fetching the logs */
+  e = gst_pipeline_new ("pipeline");
+  str = g_strdup ("string");
+  GST_DEBUG_OBJECT (e, "int %d, string %s, double %.1f, 100%%, element %"
+      GST_PTR_FORMAT ", fourcc %.4s", 42, str, 0.5, e, fourcc);
+  g_free (str);
+  gst_object_unref (e);
+
+  logs = gst_debug_ring_buffer_logger_get_logs ();
+  fail_unless (logs[0] != NULL);
+  fail_unless (strstr (logs[0], ":info_ring_buffer_logger_deferred:<pipeline> "
+          "int 42, string string, double 0.5, 100%, element <pipeline>, "
+          "fourcc abcd\n"));
+  g_strfreev (logs);
+
+  /* older messages make room for newer ones */
+  for (i = 0; i < 1000; i++)
+    GST_DEBUG ("message %d", i);
+
+  logs = gst_debug_ring_buffer_logger_get_logs ();
+  fail_unless (logs[0] != NULL);
+  fail_unless (strstr (logs[0], " message 999\n"));
+  fail_if (strstr (logs[0], " message 0\n"));
+  fail_if (strstr (logs[0], "<pipeline>"));
+  g_strfreev (logs);
+
+  /* clean up */
+  gst_debug_set_default_threshold (GST_LEVEL_NONE);
+  gst_debug_remove_ring_buffer_logger ();
+  gst_debug_add_log_function (gst_debug_log_default, NULL, NULL);
+}
+
+GST_END_TEST;
+#endif
+
 static Suite *
 gst_info_suite (void)
 {
@@ -541,6 +591,7 @@ gst_info_suite (void)
   tcase_add_test (tc_chain, info_set_and_unset_single);
   tcase_add_test (tc_chain, info_set_and_unset_multiple);
   tcase_add_test (tc_chain, info_post_gst_init_category_registration);
+  tcase_add_test (tc_chain, info_ring_buffer_logger_deferred);
 #endif
 
   return s;
@@ -0,0 +1,173 @@
+/* GStreamer
+ *
+ * Unit tests for the asynchronous debug log output
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gst/check/gstcheck.h>
+
+#include <glib/gstdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+GST_DEBUG_CATEGORY_STATIC (async_debug);
+#define GST_CAT_DEFAULT async_debug
+
+/* more than the buffer of a thread can hold */
+#define HUGE_LINE_SIZE (2 * 1024 * 1024)
+
+static gchar *log_file_name;
+
+static gboolean
+log_file_contains (const gchar * str)
+{
+  gchar *contents = NULL;
+  gboolean ret;
+
+  fail_unless (g_file_get_contents (log_file_name, &contents, NULL, NULL));
+  ret = strstr (contents, str) != NULL;
+  g_free (contents);
+
+  return ret;
+}
+
+GST_START_TEST (test_lines_written)
+{
+  guint i;
+
+  GST_INFO ("written by the writer thread");
+
+  /* the writer thread drains the buffers every 50ms */
+  for (i = 0; i < 100; i++) {
+    if (log_file_contains ("written by the writer thread"))
+      break;
+    g_usleep (50 * G_TIME_SPAN_MILLISECOND);
+  }
+  fail_unless (i < 100);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_flush_on_error)
+{
+  GST_INFO ("logged before the error");
+  GST_ERROR ("error flushing the log");
+
+  /* the error is written out before it returns, together with the lines
+   * before it */
+  fail_unless (log_file_contains ("logged before the error"));
+  fail_unless (log_file_contains ("error flushing the log"));
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_dropped_lines)
+{
+  gchar *huge = g_malloc (HUGE_LINE_SIZE + 1);
+
+  memset (huge, 'x', HUGE_LINE_SIZE);
+  huge[HUGE_LINE_SIZE] = '\0';
+
+  /* a line that can never fit into the buffer is dropped */
+  GST_INFO ("%s", huge);
+  GST_ERROR ("flush after the huge line");
+  g_free (huge);
+
+  fail_unless (log_file_contains ("flush after the huge line"));
+  fail_unless (log_file_contains ("*** 1 debug log lines dropped ***"));
+  fail_if (log_file_contains ("xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx"));
+}
+
+GST_END_TEST;
+
+static Suite *
+gst_info_async_suite (void)
+{
+  Suite *s = suite_create ("GstInfoAsync");
+  TCase *tc_chain = tcase_create ("async");
+
+  tcase_set_timeout (tc_chain, 30);
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_lines_written);
+  tcase_add_test (tc_chain, test_flush_on_error);
+  tcase_add_test (tc_chain, test_dropped_lines);
+
+  return s;
+}
+
+/* runs after gst_check_deinit() and before the exit handler of the debug
+ * log, so only the flush in gst_deinit() can have written the line */
+static void
+check_flush_on_deinit (void)
+{
+  gboolean flushed;
+  gchar *contents = NULL;
+
+  flushed = g_file_get_contents (log_file_name, &contents, NULL, NULL)
+      && strstr (contents, "logged right before deinit") != NULL;
+  g_free (contents);
+
+  g_unlink (log_file_name);
+  g_free (log_file_name);
+
+  if (!flushed) {
+    g_printerr ("the debug log was not written out by gst_deinit()\n");
+    _exit (1);
+  }
+}
+
+/* Replacement for GST_CHECK_MAIN (gst_info_async); because we need to set
+ * the env before gst_init() is called */
+int
+main (int argc, char **argv)
+{
+  Suite *s;
+  gint fd, ret;
+
+  fd = g_file_open_tmp ("gstinfoasync-XXXXXX.log", &log_file_name, NULL);
+  g_assert (fd != -1);
+  g_close (fd, NULL);
+
+  g_setenv ("GST_DEBUG_ASYNC", "1", TRUE);
+  g_setenv ("GST_DEBUG_FILE", log_file_name, TRUE);
+  g_setenv ("GST_DEBUG", "infoasync:4", TRUE);
+  g_setenv ("GST_DEBUG_NO_COLOR", "1", TRUE);
+  /* the writer thread only exists in this process, not in forked children */
+  g_setenv ("CK_FORK", "no", TRUE);
+
+  /* exit handlers run in reverse order: initialize first so that
+   * check_flush_on_deinit() runs between the ones of gst_init() and
+   * gst_check_init() */
+  gst_init (NULL, NULL);
+  atexit (check_flush_on_deinit);
+  gst_check_init (&argc, &argv);
+  GST_DEBUG_CATEGORY_INIT (async_debug, "infoasync", 0, "async log test");
+
+  s = gst_info_async_suite ();
+  ret = gst_check_run_suite (s, "gst_info_async", __FILE__);
+
+  GST_INFO ("logged right before deinit");
+
+  return ret;
+}
@@ -738,6 +738,83 @@ GST_START_TEST (test_no_error_and_no_warning_on_map_failure)
 GST_END_TEST;
 #endif /* !GST_DISABLE_GST_DEBUG */
 
+#ifdef __linux__
+#define HUGE_SIZE (3 * 1024 * 1024)
+
+static guint64
+huge_page_in_use (GstAllocator * alloc)
+{
+  GstStructure *stats;
+  guint64 in_use;
+
+  g_object_get (alloc, "stats", &stats, NULL);
+  fail_unless (gst_structure_get_uint64 (stats, "in-use", &in_use));
+  gst_structure_free (stats);
+
+  return in_use;
+}
+
+GST_START_TEST (test_huge_page_allocator)
+{
+  GstAllocator *alloc;
+  GstMemory *mem, *sub, *copy, *small;
+  GstMapInfo info;
+  guint64 mapped, mapped_again;
+  GstStructure *stats;
+
+  alloc = gst_allocator_find ("HugePageMemory");
+  fail_unless (alloc != NULL);
+
+  /* small blocks come from the system memory allocator */
+  small = gst_allocator_alloc (alloc, 100, NULL);
+  fail_unless (small != NULL);
+  fail_unless (small->allocator != alloc);
+  gst_memory_unref (small);
+
+  mem = gst_allocator_alloc (alloc, HUGE_SIZE, NULL);
+  fail_unless (mem != NULL);
+  fail_unless (mem->allocator == alloc);
+  fail_unless_equals_uint64 (huge_page_in_use (alloc), 4 * 1024 * 1024);
+
+  fail_unless (gst_memory_map (mem, &info, GST_MAP_WRITE));
+  fail_unless_equals_int (info.size, HUGE_SIZE);
+  memset (info.data, 0x5a, info.size);
+  gst_memory_unmap (mem, &info);
+
+  sub = gst_memory_share (mem, 1024, 16);
+  fail_unless (gst_memory_map (sub, &info, GST_MAP_READ));
+  fail_unless_equals_int (info.data[0], 0x5a);
+  gst_memory_unmap (sub, &info);
+  gst_memory_unref (sub);
+
+  copy = gst_memory_copy (mem, 0, -1);
+  fail_unless (gst_memory_map (copy, &info, GST_MAP_READ));
+  fail_unless_equals_int (info.size, HUGE_SIZE);
+  fail_unless_equals_int (info.data[HUGE_SIZE - 1], 0x5a);
+  gst_memory_unmap (copy, &info);
+  gst_memory_unref (copy);
+
+  gst_memory_unref (mem);
+  fail_unless_equals_uint64 (huge_page_in_use (alloc), 0);
+
+  /* the freed block is kept in the arena and reused */
+  g_object_get (alloc, "stats", &stats, NULL);
+  fail_unless (gst_structure_get_uint64 (stats, "mapped", &mapped));
+  gst_structure_free (stats);
+  mem = gst_allocator_alloc (alloc, HUGE_SIZE, NULL);
+  g_object_get (alloc, "stats", &stats, NULL);
+  fail_unless (gst_structure_has_field (stats, "node-in-use"));
+  fail_unless (gst_structure_get_uint64 (stats, "mapped", &mapped_again));
+  gst_structure_free (stats);
+  fail_unless_equals_uint64 (mapped_again, mapped);
+  gst_memory_unref (mem);
+
+  gst_object_unref (alloc);
+}
+
+GST_END_TEST;
+#endif
+
 static Suite *
 gst_memory_suite (void)
 {
@@ -760,6 +837,9 @@ gst_memory_suite (void)
 #ifndef GST_DISABLE_GST_DEBUG
   tcase_add_test (tc_chain, test_no_error_and_no_warning_on_map_failure);
 #endif
+#ifdef __linux__
+  tcase_add_test (tc_chain, test_huge_page_allocator);
+#endif
 
   return s;
 }
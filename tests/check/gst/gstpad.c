@@ -1761,6 +1761,66 @@ GST_START_TEST (test_pad_probe_remove)
 
 GST_END_TEST;
 
+static GstPadProbeReturn
+probe_append_cb (GstPad * pad, GstPadProbeInfo * info, gpointer user_data)
+{
+  GString *calls = g_object_get_data (G_OBJECT (pad), "calls");
+
+  g_string_append (calls, user_data);
+
+  /* the "c" probe removes itself on the first buffer */
+  if (!strcmp (user_data, "c") && (info->type & GST_PAD_PROBE_TYPE_BUFFER))
+    return GST_PAD_PROBE_REMOVE;
+
+  return GST_PAD_PROBE_OK;
+}
+
+GST_START_TEST (test_pad_probe_types_order)
+{
+  GstPad *pad;
+  GString *calls;
+
+  pad = gst_pad_new ("src", GST_PAD_SRC);
+  fail_unless (pad != NULL);
+  gst_pad_set_active (pad, TRUE);
+
+  calls = g_string_new (NULL);
+  g_object_set_data (G_OBJECT (pad), "calls", calls);
+
+  gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_BUFFER, probe_append_cb, "a",
+      NULL);
+  gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM,
+      probe_append_cb, "b", NULL);
+  gst_pad_add_probe (pad,
+      GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM,
+      probe_append_cb, "c", NULL);
+  gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_BUFFER, probe_append_cb, "d",
+      NULL);
+  fail_unless_equals_int (pad->num_probes, 4);
+
+  /* only the probes for the type of the item are called, in the order they
+   * were added */
+  gst_pad_push_event (pad, gst_event_new_stream_start ("test"));
+  fail_unless_equals_string (calls->str, "bc");
+  g_string_truncate (calls, 0);
+
+  fail_unless_equals_int (gst_pad_push (pad, gst_buffer_new ()),
+      GST_FLOW_NOT_LINKED);
+  fail_unless_equals_string (calls->str, "acd");
+  g_string_truncate (calls, 0);
+  fail_unless_equals_int (pad->num_probes, 3);
+
+  /* the removed probe is not called anymore */
+  fail_unless_equals_int (gst_pad_push (pad, gst_buffer_new ()),
+      GST_FLOW_NOT_LINKED);
+  fail_unless_equals_string (calls->str, "ad");
+
+  gst_object_unref (pad);
+  g_string_free (calls, TRUE);
+}
+
+GST_END_TEST;
+
 GST_START_TEST (test_pad_disjoint_blocks_probe_remove)
 {
   GstPad *pad;
@@ -3412,6 +3472,7 @@ gst_pad_suite (void)
   tcase_add_test (tc_chain, test_pad_probe_pull_idle);
   tcase_add_test (tc_chain, test_pad_probe_pull_buffer);
   tcase_add_test (tc_chain, test_pad_probe_remove);
+  tcase_add_test (tc_chain, test_pad_probe_types_order);
   tcase_add_test (tc_chain, test_pad_disjoint_blocks_probe_remove);
   tcase_add_test (tc_chain, test_pad_probe_block_add_remove);
   tcase_add_test (tc_chain, test_pad_probe_block_and_drop_buffer);
@@ -321,6 +321,99 @@ GST_START_TEST (test_poll_controllable)
 
 GST_END_TEST;
 
+GST_START_TEST (test_poll_edge_triggered)
+{
+  GstPoll *set;
+  GstPollFD rfd = GST_POLL_FD_INIT;
+  gint socks[2];
+  guchar c = 'A';
+
+  set = gst_poll_new (FALSE);
+  fail_if (set == NULL, "Failed to create a GstPoll");
+
+  if (!gst_poll_set_edge_triggered (set, TRUE)) {
+    GST_INFO ("edge-triggered mode not supported");
+    gst_poll_free (set);
+    return;
+  }
+
+  fail_if (socketpair (PF_UNIX, SOCK_STREAM, 0, socks) < 0,
+      "Could not create a pipe");
+  rfd.fd = socks[0];
+
+  fail_unless (gst_poll_add_fd (set, &rfd), "Could not add read descriptor");
+  fail_unless (gst_poll_fd_ctl_read (set, &rfd, TRUE),
+      "Could not mark the descriptor as readable");
+
+  fail_unless (write (socks[1], &c, 1) == 1, "write() failed");
+
+  fail_unless (gst_poll_wait (set, GST_CLOCK_TIME_NONE) == 1,
+      "One descriptor should be available");
+  fail_unless (gst_poll_fd_can_read (set, &rfd),
+      "Read descriptor should be readable");
+
+  /* not reported again until new data arrives */
+  fail_unless (gst_poll_wait (set, 50 * GST_MSECOND) == 0,
+      "Waiting did not timeout");
+  fail_if (gst_poll_fd_can_read (set, &rfd),
+      "Read descriptor should not be reported");
+
+  fail_unless (write (socks[1], &c, 1) == 1, "write() failed");
+
+  fail_unless (gst_poll_wait (set, GST_CLOCK_TIME_NONE) == 1,
+      "One descriptor should be available");
+  fail_unless (gst_poll_fd_can_read (set, &rfd),
+      "Read descriptor should be readable");
+
+  /* an ignored descriptor is reported once more */
+  gst_poll_fd_ignored (set, &rfd);
+  fail_unless (gst_poll_wait (set, GST_CLOCK_TIME_NONE) == 1,
+      "One descriptor should be available");
+  fail_unless (gst_poll_fd_can_read (set, &rfd),
+      "Read descriptor should be readable");
+
+  fail_unless (gst_poll_remove_fd (set, &rfd), "Could not remove descriptor");
+
+  gst_poll_free (set);
+  close (socks[0]);
+  close (socks[1]);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_poll_closed_fd)
+{
+  GstPoll *set;
+  GstPollFD rfd = GST_POLL_FD_INIT;
+  gint socks[2];
+
+  set = gst_poll_new (FALSE);
+  fail_if (set == NULL, "Failed to create a GstPoll");
+
+  fail_if (socketpair (PF_UNIX, SOCK_STREAM, 0, socks) < 0,
+      "Could not create a pipe");
+  rfd.fd = socks[0];
+
+  /* a descriptor that is not valid anymore when added is reported as an
+   * error instead of blocking the wait, like poll() does */
+  close (socks[0]);
+  fail_unless (gst_poll_add_fd (set, &rfd), "Could not add read descriptor");
+  fail_unless (gst_poll_fd_ctl_read (set, &rfd, TRUE),
+      "Could not mark the descriptor as readable");
+
+  fail_unless (gst_poll_wait (set, 5 * GST_SECOND) == 1,
+      "One descriptor should be available");
+  fail_unless (gst_poll_fd_has_error (set, &rfd),
+      "Closed descriptor should have an error");
+
+  fail_unless (gst_poll_remove_fd (set, &rfd), "Could not remove descriptor");
+
+  gst_poll_free (set);
+  close (socks[1]);
+}
+
+GST_END_TEST;
+
 static Suite *
 gst_poll_suite (void)
 {
@@ -339,6 +432,8 @@ gst_poll_suite (void)
   tcase_add_test (tc_chain, test_poll_wait_restart);
   tcase_add_test (tc_chain, test_poll_wait_flush);
   tcase_add_test (tc_chain, test_poll_controllable);
+  tcase_add_test (tc_chain, test_poll_edge_triggered);
+  tcase_add_test (tc_chain, test_poll_closed_fd);
 #else
   tcase_skip_broken_test (tc_chain, test_poll_basic);
   tcase_skip_broken_test (tc_chain, test_poll_wait);
@@ -197,6 +197,83 @@ GST_START_TEST (test_async_full)
 
 GST_END_TEST;
 
+#define N_ASYNC_ORDER 100
+
+typedef struct
+{
+  GMutex lock;
+  GCond cond;
+  GstClockTime fired[N_ASYNC_ORDER];
+  gint n_fired;
+  gint n_early;
+} AsyncOrderData;
+
+static gboolean
+test_async_order_callback (GstClock * clock, GstClockTime time,
+    GstClockID id, AsyncOrderData * data)
+{
+  GstClockTime now = gst_clock_get_time (clock);
+
+  g_mutex_lock (&data->lock);
+  /* the clock fires entries that are due in less than its minimum wait time
+   * right away */
+  if (GST_CLOCK_DIFF (now, time) > GST_USECOND)
+    data->n_early++;
+  data->fired[data->n_fired++] = time;
+  g_cond_signal (&data->cond);
+  g_mutex_unlock (&data->lock);
+
+  return TRUE;
+}
+
+/* async entries scheduled in random order with some timer slack are fired in
+ * order of their time and not before it */
+GST_START_TEST (test_async_order_slack)
+{
+  GstClock *clock;
+  GstClockID ids[N_ASYNC_ORDER];
+  GstClockTime base, slack;
+  AsyncOrderData data = { {0,}, };
+  gint i;
+
+  g_mutex_init (&data.lock);
+  g_cond_init (&data.cond);
+
+  clock = g_object_new (GST_TYPE_SYSTEM_CLOCK, "timer-slack",
+      5 * GST_MSECOND, NULL);
+  gst_object_ref_sink (clock);
+  g_object_get (clock, "timer-slack", &slack, NULL);
+  fail_unless_equals_uint64 (slack, 5 * GST_MSECOND);
+
+  base = gst_clock_get_time (clock) + 20 * GST_MSECOND;
+  for (i = 0; i < N_ASYNC_ORDER; i++) {
+    GstClockTime offset = g_random_int_range (0, 100) * GST_MSECOND;
+
+    ids[i] = gst_clock_new_single_shot_id (clock, base + offset);
+    fail_unless (gst_clock_id_wait_async (ids[i],
+            (GstClockCallback) test_async_order_callback, &data,
+            NULL) == GST_CLOCK_OK);
+  }
+
+  g_mutex_lock (&data.lock);
+  while (data.n_fired < N_ASYNC_ORDER)
+    g_cond_wait (&data.cond, &data.lock);
+  g_mutex_unlock (&data.lock);
+
+  fail_unless_equals_int (data.n_early, 0);
+  for (i = 1; i < N_ASYNC_ORDER; i++)
+    fail_unless (data.fired[i - 1] <= data.fired[i]);
+
+  for (i = 0; i < N_ASYNC_ORDER; i++)
+    gst_clock_id_unref (ids[i]);
+  gst_object_unref (clock);
+
+  g_cond_clear (&data.cond);
+  g_mutex_clear (&data.lock);
+}
+
+GST_END_TEST;
+
 GST_START_TEST (test_resolution)
 {
   GstClock *clock;
@@ -396,6 +473,7 @@ gst_systemclock_suite (void)
   tcase_add_test (tc_chain, test_signedness);
   tcase_add_test (tc_chain, test_diff);
   tcase_add_test (tc_chain, test_async_full);
+  tcase_add_test (tc_chain, test_async_order_slack);
   tcase_add_test (tc_chain, test_set_default);
   tcase_add_test (tc_chain, test_resolution);
   tcase_add_test (tc_chain, test_stress_cleanup_unschedule);
@@ -0,0 +1,342 @@
+/* GStreamer gst-stats unit test
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <config.h>
+#include <gst/check/gstcheck.h>
+#include <gst/gsttracerrecord.h>
+#include <glib/gstdio.h>
+
+static int gst_stats_main (int argc, char **argv);
+
+#define main gst_stats_main
+#include "../../tools/gst-stats.c"
+#undef main
+
+#define NUM_THREADS 2
+#define NUM_RECORDS 1000
+
+/* more than the ring of a thread can hold without being drained */
+#define NUM_PAYLOADS 16
+#define PAYLOAD_SIZE (64 * 1024)
+
+static gchar *trace_file_name;
+
+static GstTracerRecord *tr_test;
+static GstTracerRecord *tr_payload;
+
+/* what was read back from the trace file */
+typedef struct
+{
+  GHashTable *types;
+  guint64 last_ts;
+  guint next_seqnum[NUM_THREADS];
+  guint n_records;
+  guint n_payloads;
+  gboolean have_dropped;
+  guint32 dropped;
+} TraceContents;
+
+static void
+trace_record_type (guint32 id, const gchar * name, gpointer user_data)
+{
+  TraceContents *contents = user_data;
+
+  fail_if (id == 0 || id == G_MAXUINT32);
+  /* every type is announced once */
+  fail_if (g_hash_table_contains (contents->types, name));
+  g_hash_table_add (contents->types, g_strdup (name));
+}
+
+static void
+trace_record (GstStructure * s, guint64 ts, gpointer user_data)
+{
+  TraceContents *contents = user_data;
+  const gchar *name = gst_structure_get_name (s);
+
+  /* the records of all threads are merged in timestamp order */
+  fail_unless (ts >= contents->last_ts);
+  contents->last_ts = ts;
+
+  fail_unless (g_hash_table_contains (contents->types, name));
+
+  if (!strcmp (name, "test")) {
+    const GstStructure *info;
+    GstPadDirection direction;
+    gpointer ptr;
+    guint thread, seqnum, info_seqnum;
+    guint64 big;
+    gdouble ratio;
+    gboolean flag;
+
+    fail_unless (gst_structure_get (s, "thread", G_TYPE_UINT, &thread,
+            "seqnum", G_TYPE_UINT, &seqnum, "big", G_TYPE_UINT64, &big,
+            "ratio", G_TYPE_DOUBLE, &ratio, "flag", G_TYPE_BOOLEAN, &flag,
+            "direction", GST_TYPE_PAD_DIRECTION, &direction,
+            "ptr", G_TYPE_POINTER, &ptr, NULL));
+    fail_unless (thread < NUM_THREADS);
+
+    /* nothing is lost or reordered within a thread */
+    fail_unless_equals_int (seqnum, contents->next_seqnum[thread]);
+    contents->next_seqnum[thread]++;
+
+    fail_unless_equals_uint64 (big, G_MAXUINT64 - seqnum);
+    fail_unless_equals_float (ratio, seqnum / 2.0);
+    fail_unless_equals_int (flag, seqnum % 2);
+    fail_unless_equals_int (direction, GST_PAD_SRC);
+    fail_unless_equals_pointer (ptr, GUINT_TO_POINTER (seqnum + 1));
+    fail_unless_equals_string (gst_structure_get_string (s, "name"),
+        thread ? "second" : "first");
+
+    info = gst_value_get_structure (gst_structure_get_value (s, "info"));
+    fail_unless (info != NULL);
+    fail_unless (gst_structure_get_uint (info, "seqnum", &info_seqnum));
+    fail_unless_equals_int (info_seqnum, seqnum);
+
+    contents->n_records++;
+  } else if (!strcmp (name, "test-payload")) {
+    const gchar *payload = gst_structure_get_string (s, "payload");
+
+    fail_unless (payload != NULL);
+    fail_unless_equals_int (strlen (payload), PAYLOAD_SIZE);
+    contents->n_payloads++;
+  }
+}
+
+static void
+trace_dropped (guint32 dropped, guint64 ts, gpointer user_data)
+{
+  TraceContents *contents = user_data;
+
+  /* only written when the number grew */
+  fail_unless (dropped > contents->dropped);
+  contents->have_dropped = TRUE;
+  contents->dropped = dropped;
+}
+
+static void
+read_trace_file (TraceContents * contents)
+{
+  static const TracerFileFuncs funcs = {
+    trace_record_type, trace_record, trace_dropped
+  };
+  FILE *log;
+
+  if (contents->types)
+    g_hash_table_unref (contents->types);
+  memset (contents, 0, sizeof (TraceContents));
+  contents->types = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+      NULL);
+
+  log = g_fopen (trace_file_name, "rb");
+  fail_unless (log != NULL);
+  fail_unless (parse_binary_trace (log, &funcs, contents));
+  fclose (log);
+}
+
+static void
+clear_trace_contents (TraceContents * contents)
+{
+  g_hash_table_unref (contents->types);
+}
+
+static gpointer
+log_records (gpointer data)
+{
+  guint thread = GPOINTER_TO_UINT (data);
+  guint i;
+
+  for (i = 0; i < NUM_RECORDS; i++) {
+    GstStructure *info = gst_structure_new ("info", "seqnum", G_TYPE_UINT, i,
+        NULL);
+
+    gst_tracer_record_log (tr_test, thread, i, G_MAXUINT64 - i, i / 2.0,
+        i % 2, GST_PAD_SRC, GUINT_TO_POINTER (i + 1),
+        thread ? "second" : "first", info);
+    gst_structure_free (info);
+  }
+
+  return NULL;
+}
+
+static gpointer
+log_payloads (gpointer data)
+{
+  gchar *payload = g_malloc (PAYLOAD_SIZE + 1);
+  guint i;
+
+  memset (payload, 'x', PAYLOAD_SIZE);
+  payload[PAYLOAD_SIZE] = '\0';
+
+  for (i = 0; i < NUM_PAYLOADS; i++)
+    gst_tracer_record_log (tr_payload, payload);
+
+  g_free (payload);
+
+  return NULL;
+}
+
+GST_START_TEST (test_binary_records)
+{
+  GThread *threads[NUM_THREADS];
+  TraceContents contents = { NULL, };
+  guint i;
+
+  for (i = 0; i < NUM_THREADS; i++)
+    threads[i] = g_thread_new ("log", log_records, GUINT_TO_POINTER (i));
+  for (i = 0; i < NUM_THREADS; i++)
+    g_thread_join (threads[i]);
+
+  /* the writer drains the records once they are older than 50ms */
+  for (i = 0; i < 100; i++) {
+    read_trace_file (&contents);
+    if (contents.n_records == NUM_THREADS * NUM_RECORDS)
+      break;
+    g_usleep (50 * G_TIME_SPAN_MILLISECOND);
+  }
+  fail_unless_equals_int (contents.n_records, NUM_THREADS * NUM_RECORDS);
+  fail_unless_equals_int (contents.next_seqnum[0], NUM_RECORDS);
+  fail_unless_equals_int (contents.next_seqnum[1], NUM_RECORDS);
+  fail_if (contents.have_dropped);
+
+  clear_trace_contents (&contents);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_dropped_records)
+{
+  TraceContents contents = { NULL, };
+  guint i;
+
+  g_thread_join (g_thread_new ("log", log_payloads, NULL));
+
+  /* every payload is either in the file or counted as dropped */
+  for (i = 0; i < 100; i++) {
+    read_trace_file (&contents);
+    if (contents.n_payloads + contents.dropped == NUM_PAYLOADS)
+      break;
+    g_usleep (50 * G_TIME_SPAN_MILLISECOND);
+  }
+  fail_unless_equals_int (contents.n_payloads + contents.dropped,
+      NUM_PAYLOADS);
+  fail_unless (contents.have_dropped);
+  fail_unless (contents.n_payloads > 0);
+
+  clear_trace_contents (&contents);
+
+  /* gst-stats reads the file as well */
+  {
+    const gchar *argv[] = { "gst-stats-1.0", trace_file_name, NULL };
+
+    fail_unless_equals_int (gst_stats_main (2, (gchar **) argv), 0);
+  }
+}
+
+GST_END_TEST;
+
+static void
+setup_records (void)
+{
+  /* *INDENT-OFF* */
+  tr_test = gst_tracer_record_new ("test.class",
+      "thread", GST_TYPE_STRUCTURE, gst_structure_new ("value",
+          "type", G_TYPE_GTYPE, G_TYPE_UINT,
+          NULL),
+      "seqnum", GST_TYPE_STRUCTURE, gst_structure_new ("value",
+          "type", G_TYPE_GTYPE, G_TYPE_UINT,
+          NULL),
+      "big", GST_TYPE_STRUCTURE, gst_structure_new ("value",
+          "type", G_TYPE_GTYPE, G_TYPE_UINT64,
+          NULL),
+      "ratio", GST_TYPE_STRUCTURE, gst_structure_new ("value",
+          "type", G_TYPE_GTYPE, G_TYPE_DOUBLE,
+          NULL),
+      "flag", GST_TYPE_STRUCTURE, gst_structure_new ("value",
+          "type", G_TYPE_GTYPE, G_TYPE_BOOLEAN,
+          NULL),
+      "direction", GST_TYPE_STRUCTURE, gst_structure_new ("value",
+          "type", G_TYPE_GTYPE, GST_TYPE_PAD_DIRECTION,
+          NULL),
+      "ptr", GST_TYPE_STRUCTURE, gst_structure_new ("value",
+          "type", G_TYPE_GTYPE, G_TYPE_POINTER,
+          NULL),
+      "name", GST_TYPE_STRUCTURE, gst_structure_new ("value",
+          "type", G_TYPE_GTYPE, G_TYPE_STRING,
+          NULL),
+      "info", GST_TYPE_STRUCTURE, gst_structure_new ("value",
+          "type", G_TYPE_GTYPE, GST_TYPE_STRUCTURE,
+          NULL),
+      NULL);
+  tr_payload = gst_tracer_record_new ("test-payload.class",
+      "payload", GST_TYPE_STRUCTURE, gst_structure_new ("value",
+          "type", G_TYPE_GTYPE, G_TYPE_STRING,
+          NULL),
+      NULL);
+  /* *INDENT-ON* */
+}
+
+static void
+teardown_records (void)
+{
+  gst_object_unref (tr_test);
+  gst_object_unref (tr_payload);
+}
+
+static Suite *
+gst_stats_suite (void)
+{
+  Suite *s = suite_create ("gst-stats");
+  TCase *tc_chain = tcase_create ("binary");
+
+  tcase_set_timeout (tc_chain, 30);
+  tcase_add_unchecked_fixture (tc_chain, setup_records, teardown_records);
+
+  suite_add_tcase (s, tc_chain);
+  /* the dropped records are counted for the whole process, so this runs
+   * first and checks that nothing was dropped */
+  tcase_add_test (tc_chain, test_binary_records);
+  tcase_add_test (tc_chain, test_dropped_records);
+
+  return s;
+}
+
+/* Replacement for GST_CHECK_MAIN (gst_stats); because we need to set the env
+ * before gst_init() is called */
+int
+main (int argc, char **argv)
+{
+  Suite *s;
+  gint fd, ret;
+
+  fd = g_file_open_tmp ("gststats-XXXXXX.trace", &trace_file_name, NULL);
+  g_assert (fd != -1);
+  g_close (fd, NULL);
+
+  g_setenv ("GST_TRACER_FILE", trace_file_name, TRUE);
+  /* the writer thread only exists in this process, not in forked children */
+  g_setenv ("CK_FORK", "no", TRUE);
+  gst_check_init (&argc, &argv);
+
+  s = gst_stats_suite ();
+  ret = gst_check_run_suite (s, "gst_stats", __FILE__);
+
+  g_unlink (trace_file_name);
+  g_free (trace_file_name);
+
+  return ret;
+}
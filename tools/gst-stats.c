@@ -46,6 +46,7 @@ static guint num_elements = 0, num_bins = 0, num_pads = 0, num_ghostpads = 0;
 static GstClockTime last_ts = G_GUINT64_CONSTANT (0);
 static guint total_cpuload = 0;
 static gboolean have_cpuload = FALSE;
+static guint32 num_dropped_records = 0;
 
 static GPtrArray *plugin_stats = NULL;
 
@@ -1040,6 +1041,9 @@ print_stats (void)
   if (have_cpuload) {
     g_print ("Avg CPU load: %4.1f %%\n", (gfloat) total_cpuload / 10.0);
   }
+  if (num_dropped_records) {
+    g_print ("Number of dropped trace records: %u\n", num_dropped_records);
+  }
   g_print ("\n");
 
   /* thread stats */
@@ -1163,10 +1167,416 @@ print_stats (void)
   }
 }
 
+static void
+process_entry (GstStructure * s)
+{
+  const gchar *name = gst_structure_get_name (s);
+
+  if (!strcmp (name, "new-pad")) {
+    new_pad_stats (s);
+  } else if (!strcmp (name, "new-element")) {
+    new_element_stats (s);
+  } else if (!strcmp (name, "buffer")) {
+    do_buffer_stats (s);
+  } else if (!strcmp (name, "event")) {
+    do_event_stats (s);
+  } else if (!strcmp (name, "message")) {
+    do_message_stats (s);
+  } else if (!strcmp (name, "query")) {
+    do_query_stats (s);
+  } else if (!strcmp (name, "thread-rusage")) {
+    do_thread_rusage_stats (s);
+  } else if (!strcmp (name, "proc-rusage")) {
+    do_proc_rusage_stats (s);
+  } else if (!strcmp (name, "latency")) {
+    do_latency_stats (s);
+  } else if (!strcmp (name, "element-latency")) {
+    do_element_latency_stats (s);
+  } else if (!strcmp (name, "element-reported-latency")) {
+    do_element_reported_latency (s);
+  } else if (!strcmp (name, "factory-used")) {
+    do_factory_used (s);
+  } else {
+    // TODO(ensonic): parse the xxx.class log lines
+    if (!g_str_has_suffix (name, ".class")) {
+      GST_WARNING ("unknown log entry: '%" GST_PTR_FORMAT "'", s);
+    }
+  }
+}
+
+/* binary trace file parser, this must match the writer in
+ * gst/gsttracerrecord.c */
+#define TRACER_FILE_MAGIC "GSTTRACE"
+#define TRACER_FILE_VERSION 1
+#define TRACER_FILE_BYTE_ORDER 0x01020304
+
+#define TRACER_FILE_ID_DROPPED G_MAXUINT32
+
+enum
+{
+  TRACER_FIELD_INT32 = 1,
+  TRACER_FIELD_INT64 = 2,
+  TRACER_FIELD_DOUBLE = 3,
+  TRACER_FIELD_POINTER = 4,
+  TRACER_FIELD_STRING = 5,
+  TRACER_FIELD_SERIALIZED = 6
+};
+
+typedef struct
+{
+  gchar magic[8];
+  guint32 version;
+  guint32 byte_order;
+} TracerFileHeader;
+
+typedef struct
+{
+  guint32 size;
+  guint32 id;
+  guint64 ts;
+} TracerFileRecord;
+
+typedef struct
+{
+  gchar *name;
+  GType type;
+  guint32 kind;
+} TracerField;
+
+typedef struct
+{
+  gchar *name;
+  guint n_fields;
+  TracerField *fields;
+} TracerRecordType;
+
+static void
+free_record_type (gpointer data)
+{
+  TracerRecordType *rt = data;
+  guint i;
+
+  for (i = 0; i < rt->n_fields; i++)
+    g_free (rt->fields[i].name);
+  g_free (rt->fields);
+  g_free (rt->name);
+  g_free (rt);
+}
+
+static gboolean
+read_uint32 (const guint8 ** data, const guint8 * end, guint32 * val)
+{
+  if (end - *data < sizeof (guint32))
+    return FALSE;
+  memcpy (val, *data, sizeof (guint32));
+  *data += sizeof (guint32);
+  return TRUE;
+}
+
+static gboolean
+read_uint64 (const guint8 ** data, const guint8 * end, guint64 * val)
+{
+  if (end - *data < sizeof (guint64))
+    return FALSE;
+  memcpy (val, *data, sizeof (guint64));
+  *data += sizeof (guint64);
+  return TRUE;
+}
+
+static gboolean
+read_string (const guint8 ** data, const guint8 * end, gchar ** val)
+{
+  guint32 len;
+
+  if (!read_uint32 (data, end, &len))
+    return FALSE;
+  if (len == G_MAXUINT32) {
+    *val = NULL;
+    return TRUE;
+  }
+  if (end - *data < len)
+    return FALSE;
+  *val = g_strndup ((const gchar *) *data, len);
+  *data += len;
+  return TRUE;
+}
+
+static TracerRecordType *
+parse_record_type (const guint8 * data, const guint8 * end, guint32 * id)
+{
+  TracerRecordType *rt = g_new0 (TracerRecordType, 1);
+  guint32 n_fields;
+  guint i;
+
+  if (!read_uint32 (&data, end, id) || !read_string (&data, end, &rt->name)
+      || !read_uint32 (&data, end, &n_fields) || rt->name == NULL)
+    goto error;
+
+  /* each field needs at least 12 bytes */
+  if (n_fields > (end - data) / 12)
+    goto error;
+
+  rt->fields = g_new0 (TracerField, n_fields);
+  for (i = 0; i < n_fields; i++) {
+    TracerField *field = &rt->fields[i];
+    gchar *type_name;
+
+    rt->n_fields = i + 1;
+    if (!read_string (&data, end, &field->name) || field->name == NULL)
+      goto error;
+    if (!read_string (&data, end, &type_name))
+      goto error;
+    /* types of plugins are not registered here, we fall back to the
+     * fundamental types below */
+    field->type = type_name ? g_type_from_name (type_name) : G_TYPE_INVALID;
+    g_free (type_name);
+    if (!read_uint32 (&data, end, &field->kind))
+      goto error;
+  }
+  return rt;
+
+error:
+  free_record_type (rt);
+  return NULL;
+}
+
+static gboolean
+parse_field (const TracerField * field, const guint8 ** data,
+    const guint8 * end, GValue * val)
+{
+  switch (field->kind) {
+    case TRACER_FIELD_INT32:{
+      guint32 v;
+
+      if (!read_uint32 (data, end, &v))
+        return FALSE;
+      if (field->type == G_TYPE_UINT) {
+        g_value_init (val, G_TYPE_UINT);
+        g_value_set_uint (val, v);
+      } else if (field->type == G_TYPE_BOOLEAN) {
+        g_value_init (val, G_TYPE_BOOLEAN);
+        g_value_set_boolean (val, v);
+      } else if (G_TYPE_IS_ENUM (field->type)) {
+        g_value_init (val, field->type);
+        g_value_set_enum (val, v);
+      } else if (G_TYPE_IS_FLAGS (field->type)) {
+        g_value_init (val, field->type);
+        g_value_set_flags (val, v);
+      } else {
+        g_value_init (val, G_TYPE_INT);
+        g_value_set_int (val, v);
+      }
+      break;
+    }
+    case TRACER_FIELD_INT64:{
+      guint64 v;
+
+      if (!read_uint64 (data, end, &v))
+        return FALSE;
+      if (field->type == G_TYPE_INT64) {
+        g_value_init (val, G_TYPE_INT64);
+        g_value_set_int64 (val, v);
+      } else {
+        g_value_init (val, G_TYPE_UINT64);
+        g_value_set_uint64 (val, v);
+      }
+      break;
+    }
+    case TRACER_FIELD_DOUBLE:{
+      gdouble v;
+
+      if (end - *data < sizeof (gdouble))
+        return FALSE;
+      memcpy (&v, *data, sizeof (gdouble));
+      *data += sizeof (gdouble);
+      g_value_init (val, G_TYPE_DOUBLE);
+      g_value_set_double (val, v);
+      break;
+    }
+    case TRACER_FIELD_POINTER:{
+      guint64 v;
+
+      if (!read_uint64 (data, end, &v))
+        return FALSE;
+      g_value_init (val, G_TYPE_POINTER);
+      g_value_set_pointer (val, GSIZE_TO_POINTER ((gsize) v));
+      break;
+    }
+    case TRACER_FIELD_STRING:
+    case TRACER_FIELD_SERIALIZED:{
+      GstStructure *st;
+      gchar *v;
+
+      if (!read_string (data, end, &v))
+        return FALSE;
+      if (field->type == G_TYPE_GTYPE && v && g_type_from_name (v)) {
+        g_value_init (val, G_TYPE_GTYPE);
+        g_value_set_gtype (val, g_type_from_name (v));
+        g_free (v);
+      } else if (field->type == GST_TYPE_STRUCTURE && v
+          && (st = gst_structure_from_string (v, NULL))) {
+        g_value_init (val, GST_TYPE_STRUCTURE);
+        g_value_take_boxed (val, st);
+        g_free (v);
+      } else {
+        g_value_init (val, G_TYPE_STRING);
+        g_value_take_string (val, v);
+      }
+      break;
+    }
+    default:
+      return FALSE;
+  }
+  return TRUE;
+}
+
+static GstStructure *
+parse_record (const TracerRecordType * rt, const guint8 * data,
+    const guint8 * end)
+{
+  GstStructure *s = gst_structure_new_empty (rt->name);
+  guint i;
+
+  for (i = 0; i < rt->n_fields; i++) {
+    GValue val = G_VALUE_INIT;
+
+    if (!parse_field (&rt->fields[i], &data, end, &val)) {
+      gst_structure_free (s);
+      return NULL;
+    }
+    gst_structure_take_value (s, rt->fields[i].name, &val);
+  }
+  return s;
+}
+
+/* called for the records of a binary trace file in the order of the file */
+typedef struct
+{
+  /* a record type was announced */
+  void (*record_type) (guint32 id, const gchar * name, gpointer user_data);
+  /* a record of an announced type, @s is only valid during the call */
+  void (*record) (GstStructure * s, guint64 ts, gpointer user_data);
+  /* the number of records the writer dropped so far */
+  void (*dropped) (guint32 dropped, guint64 ts, gpointer user_data);
+} TracerFileFuncs;
+
+static gboolean
+parse_binary_trace (FILE * log, const TracerFileFuncs * funcs,
+    gpointer user_data)
+{
+  GHashTable *types;
+  TracerFileHeader header;
+  TracerFileRecord record;
+  guint8 *data = NULL;
+  gsize data_size = 0;
+
+  if (fread (&header, sizeof (header), 1, log) != 1
+      || memcmp (header.magic, TRACER_FILE_MAGIC, sizeof (header.magic))
+      || header.version != TRACER_FILE_VERSION
+      || header.byte_order != TRACER_FILE_BYTE_ORDER) {
+    fprintf (stderr, "unsupported tracer file\n");
+    return FALSE;
+  }
+
+  types = g_hash_table_new_full (NULL, NULL, NULL, free_record_type);
+
+  while (fread (&record, sizeof (record), 1, log) == 1) {
+    TracerRecordType *rt;
+    GstStructure *s;
+    gsize size;
+
+    if (record.size < sizeof (record)) {
+      fprintf (stderr, "corrupt tracer file\n");
+      break;
+    }
+    size = record.size - sizeof (record);
+    if (size > data_size) {
+      data_size = size;
+      data = g_realloc (data, data_size);
+    }
+    if (fread (data, 1, size, log) != size) {
+      GST_WARNING ("truncated record");
+      break;
+    }
+
+    if (record.id == 0) {
+      guint32 id;
+
+      if ((rt = parse_record_type (data, data + size, &id))) {
+        GST_INFO ("record type %u: %s", id, rt->name);
+        g_hash_table_insert (types, GUINT_TO_POINTER (id), rt);
+        if (funcs->record_type)
+          funcs->record_type (id, rt->name, user_data);
+      } else {
+        GST_WARNING ("invalid record type");
+      }
+    } else if (record.id == TRACER_FILE_ID_DROPPED) {
+      guint32 dropped;
+
+      if (size >= sizeof (guint32) && funcs->dropped) {
+        memcpy (&dropped, data, sizeof (guint32));
+        funcs->dropped (dropped, record.ts, user_data);
+      }
+    } else if ((rt = g_hash_table_lookup (types,
+                GUINT_TO_POINTER (record.id)))) {
+      if ((s = parse_record (rt, data, data + size))) {
+        if (funcs->record)
+          funcs->record (s, record.ts, user_data);
+        gst_structure_free (s);
+      } else {
+        GST_WARNING ("invalid %s record", rt->name);
+      }
+    } else {
+      GST_WARNING ("record of unknown type %u", record.id);
+    }
+  }
+
+  g_free (data);
+  g_hash_table_destroy (types);
+
+  return TRUE;
+}
+
+static void
+collect_binary_record (GstStructure * s, guint64 ts, gpointer user_data)
+{
+  process_entry (s);
+}
+
+static void
+collect_binary_dropped (guint32 dropped, guint64 ts, gpointer user_data)
+{
+  num_dropped_records = dropped;
+}
+
+static void
+collect_binary_stats (FILE * log)
+{
+  static const TracerFileFuncs funcs = {
+    NULL, collect_binary_record, collect_binary_dropped
+  };
+
+  parse_binary_trace (log, &funcs, NULL);
+}
+
 static void
 collect_stats (const gchar * filename)
 {
   FILE *log;
+  gchar magic[8];
+
+  /* probe for a binary trace file */
+  if ((log = fopen (filename, "rb"))) {
+    if (fread (magic, sizeof (magic), 1, log) == 1
+        && !memcmp (magic, TRACER_FILE_MAGIC, sizeof (magic))) {
+      GST_INFO ("format is 'binary'");
+      rewind (log);
+      collect_binary_stats (log);
+      fclose (log);
+      return;
+    }
+    fclose (log);
+  }
 
   if ((log = fopen (filename, "rt"))) {
     gchar line[5001];
@@ -1197,38 +1607,7 @@ collect_stats (const gchar * filename)
             if (!strcmp (level, "TRACE")) {
               data = g_match_info_fetch (match_info, 7);
               if ((s = gst_structure_from_string (data, NULL))) {
-                const gchar *name = gst_structure_get_name (s);
-
-                if (!strcmp (name, "new-pad")) {
-                  new_pad_stats (s);
-                } else if (!strcmp (name, "new-element")) {
-                  new_element_stats (s);
-                } else if (!strcmp (name, "buffer")) {
-                  do_buffer_stats (s);
-                } else if (!strcmp (name, "event")) {
-                  do_event_stats (s);
-                } else if (!strcmp (name, "message")) {
-                  do_message_stats (s);
-                } else if (!strcmp (name, "query")) {
-                  do_query_stats (s);
-                } else if (!strcmp (name, "thread-rusage")) {
-                  do_thread_rusage_stats (s);
-                } else if (!strcmp (name, "proc-rusage")) {
-                  do_proc_rusage_stats (s);
-                } else if (!strcmp (name, "latency")) {
-                  do_latency_stats (s);
-                } else if (!strcmp (name, "element-latency")) {
-                  do_element_latency_stats (s);
-                } else if (!strcmp (name, "element-reported-latency")) {
-                  do_element_reported_latency (s);
-                } else if (!strcmp (name, "factory-used")) {
-                  do_factory_used (s);
-                } else {
-                  // TODO(ensonic): parse the xxx.class log lines
-                  if (!g_str_has_suffix (data, ".class")) {
-                    GST_WARNING ("unknown log entry: '%s'", data);
-                  }
-                }
+                process_entry (s);
                 gst_structure_free (s);
               } else {
                 GST_WARNING ("unknown log entry: '%s'", data);